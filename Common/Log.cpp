@@ -22,6 +22,7 @@
 
 #include "Common/CommonTypes.h"
 #include "Common/Log.h"
+#include "Common/LogManager.h"
 #include "StringUtils.h"
 #include "Common/Data/Encoding/Utf8.h"
 #include "Common/Thread/ThreadUtil.h"
@@ -68,6 +69,9 @@ bool HandleAssert(const char *function, const char *file, int line, const char *
 	ERROR_LOG(SYSTEM, "%s", formatted);
 	// Also do a simple printf for good measure, in case logging of SYSTEM is disabled (should we disallow that?)
 	fprintf(stderr, "%s\n", formatted);
+	// The listeners run on another thread, make sure they've seen it before we might go down.
+	if (LogManager::GetInstance())
+		LogManager::GetInstance()->Flush();
 
 	hitAnyAsserts = true;
 
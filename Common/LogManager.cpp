@@ -24,7 +24,9 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <ctime>
 
 #include "Common/Data/Encoding/Utf8.h"
 
@@ -33,6 +35,7 @@
 #include "Common/TimeUtil.h"
 #include "Common/File/FileUtil.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ThreadUtil.h"
 
 // Don't need to savestate this.
 const char *hleCurrentThreadName = nullptr;
@@ -41,6 +44,23 @@ bool *g_bLogEnabledSetting = nullptr;
 
 static const char level_to_char[8] = "-NEWIDV";
 
+// Must be a power of 2.  Most messages fit in a record, longer ones are allocated separately.
+static const int LOG_RING_SIZE = 4096;
+
+struct LogManager::LogRecord {
+	std::atomic<u64> sequence;
+	LogLevel level;
+	LogType type;
+	const char *file;
+	int line;
+	int length;
+	s64 timeMs;
+	bool hasThreadName;
+	char threadName[13];
+	char text[164];
+	std::string longText;
+};
+
 #if PPSSPP_PLATFORM(UWP) && defined(_DEBUG)
 #define LOG_MSC_OUTPUTDEBUG true
 #else
@@ -155,9 +175,25 @@ LogManager::LogManager(bool *enabledSetting) {
 #endif
 	AddListener(ringLog_);
 #endif
+
+	records_ = new LogRecord[LOG_RING_SIZE];
+	for (int i = 0; i < LOG_RING_SIZE; ++i)
+		records_[i].sequence = i;
+	drainRunning_ = true;
+	drainThread_ = std::thread(&LogManager::DrainThread, this);
 }
 
 LogManager::~LogManager() {
+	{
+		std::lock_guard<std::mutex> guard(drainLock_);
+		drainRunning_ = false;
+		drainCond_.notify_one();
+	}
+	drainThread_.join();
+	// Anything that snuck in while the thread was exiting.
+	DrainRecords();
+	ReportDropped();
+
 	for (int i = 0; i < (int)LogType::NUMBER_OF_LOGS; ++i) {
 #if !defined(MOBILE_DEVICE) || defined(_DEBUG)
 		RemoveListener(fileLog_);
@@ -178,6 +214,7 @@ LogManager::~LogManager() {
 	delete debuggerLog_;
 #endif
 	delete ringLog_;
+	delete [] records_;
 }
 
 void LogManager::ChangeFileLog(const char *filename) {
@@ -211,20 +248,92 @@ void LogManager::LoadConfig(const Section *section, bool debugDefaults) {
 	}
 }
 
+void LogManager::FormatRecord(LogRecord &record, LogLevel level, LogType type, const char *file, int line, const char *format, va_list args) {
+	record.level = level;
+	record.type = type;
+	record.file = file;
+	record.line = line;
+	record.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	// The name may change after we return, so it's copied.
+	record.hasThreadName = hleCurrentThreadName != nullptr;
+	if (record.hasThreadName)
+		truncate_cpy(record.threadName, hleCurrentThreadName);
+
+	va_list args_copy;
+	va_copy(args_copy, args);
+	int neededBytes = vsnprintf(record.text, sizeof(record.text), format, args);
+	record.length = std::max(neededBytes, 0);
+	if (record.length >= (int)sizeof(record.text)) {
+		// Needed more space? Re-run vsnprintf.
+		record.longText.resize(record.length + 1);
+		vsnprintf(&record.longText[0], record.length + 1, format, args_copy);
+	}
+	va_end(args_copy);
+}
+
+void LogManager::FormatRecordf(LogRecord &record, LogLevel level, LogType type, const char *file, int line, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	FormatRecord(record, level, type, file, line, format, args);
+	va_end(args);
+}
+
 void LogManager::Log(LogLevel level, LogType type, const char *file, int line, const char *format, va_list args) {
 	const LogChannel &log = log_[(size_t)type];
 	if (level > log.level || !log.enabled)
 		return;
 
-	LogMessage message;
-	message.level = level;
-	message.log = log.m_shortName;
+	if (!drainRunning_) {
+		// Shutting down, so there's nothing to hand it to.
+		LogRecord record;
+		FormatRecord(record, level, type, file, line, format, args);
+		LogMessage message;
+		ToMessage(record, &message);
+		std::lock_guard<std::mutex> listeners_lock(listeners_lock_);
+		Dispatch(message);
+		return;
+	}
+
+	u64 pos = writePos_.load(std::memory_order_relaxed);
+	LogRecord *record;
+	while (true) {
+		record = &records_[pos & (LOG_RING_SIZE - 1)];
+		s64 diff = (s64)(record->sequence.load(std::memory_order_acquire) - pos);
+		if (diff == 0) {
+			// Free and nobody beat us to it, so it's ours.
+			if (writePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			// Still holding a message from a lap ago, the drain thread is behind.
+			dropped_++;
+			return;
+		} else {
+			pos = writePos_.load(std::memory_order_relaxed);
+		}
+	}
+
+	FormatRecord(*record, level, type, file, line, format, args);
+	record->sequence.store(pos + 1, std::memory_order_release);
+
+	// Pairs with the drain thread checking for records after it says it's going to sleep.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (drainSleeping_.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> guard(drainLock_);
+		drainCond_.notify_one();
+	}
+}
+
+void LogManager::ToMessage(const LogRecord &record, LogMessage *message) const {
+	const LogChannel &log = log_[(size_t)record.type];
+	message->level = record.level;
+	message->log = log.m_shortName;
 
 #ifdef _WIN32
 	static const char sep = '\\';
 #else
 	static const char sep = '/';
 #endif
+	const char *file = record.file;
 	const char *fileshort = strrchr(file, sep);
 	if (fileshort != NULL) {
 		do
@@ -234,37 +343,116 @@ void LogManager::Log(LogLevel level, LogType type, const char *file, int line, c
 			file = fileshort + 1;
 	}
 
-	GetTimeFormatted(message.timestamp);
+	time_t sysTime = (time_t)(record.timeMs / 1000);
+	struct tm *localTime = localtime(&sysTime);
+	char tmp[6];
+	strftime(tmp, sizeof(tmp), "%M:%S", localTime);
+	snprintf(message->timestamp, sizeof(message->timestamp), "%s:%03u", tmp, (uint32_t)(record.timeMs % 1000));
 
-	if (hleCurrentThreadName) {
-		snprintf(message.header, sizeof(message.header), "%-12.12s %c[%s]: %s:%d",
-			hleCurrentThreadName, level_to_char[(int)level],
+	if (record.hasThreadName) {
+		snprintf(message->header, sizeof(message->header), "%-12.12s %c[%s]: %s:%d",
+			record.threadName, level_to_char[(int)record.level],
 			log.m_shortName,
-			file, line);
+			file, record.line);
 	} else {
-		snprintf(message.header, sizeof(message.header), "%s:%d %c[%s]:",
-			file, line, level_to_char[(int)level],
+		snprintf(message->header, sizeof(message->header), "%s:%d %c[%s]:",
+			file, record.line, level_to_char[(int)record.level],
 			log.m_shortName);
 	}
 
-	char msgBuf[1024];
-	va_list args_copy;
+	const char *text = record.length >= (int)sizeof(record.text) ? record.longText.c_str() : record.text;
+	message->msg.reserve(record.length + 1);
+	message->msg.assign(text, record.length);
+	message->msg += '\n';
+}
 
-	va_copy(args_copy, args);
-	size_t neededBytes = vsnprintf(msgBuf, sizeof(msgBuf), format, args);
-	message.msg.resize(neededBytes + 1);
-	if (neededBytes > sizeof(msgBuf)) {
-		// Needed more space? Re-run vsnprintf.
-		vsnprintf(&message.msg[0], neededBytes + 1, format, args_copy);
-	} else {
-		memcpy(&message.msg[0], msgBuf, neededBytes);
+void LogManager::Dispatch(const LogMessage &message) {
+	for (auto &iter : listeners_) {
+		iter->Log(message);
 	}
-	message.msg[neededBytes] = '\n';
-	va_end(args_copy);
+}
+
+bool LogManager::DrainRecords() {
+	LogMessage message;
+	bool any = false;
+	while (true) {
+		LogRecord &record = records_[readPos_ & (LOG_RING_SIZE - 1)];
+		if (record.sequence.load(std::memory_order_acquire) != readPos_ + 1)
+			break;
+
+		ToMessage(record, &message);
+		// Hand the record back to writers before the (possibly slow) listeners run.
+		record.sequence.store(readPos_ + LOG_RING_SIZE, std::memory_order_release);
+		readPos_++;
+		any = true;
+
+		{
+			std::lock_guard<std::mutex> listeners_lock(listeners_lock_);
+			Dispatch(message);
+		}
+		// Checked by Flush(), which may not want to wait for a busy log to go quiet.
+		drainedPos_ = readPos_;
+	}
+
+	if (any) {
+		std::lock_guard<std::mutex> guard(drainLock_);
+		flushedCond_.notify_all();
+	}
+	return any;
+}
+
+void LogManager::ReportDropped() {
+	u64 dropped = dropped_;
+	if (dropped == droppedReported_)
+		return;
+
+	LogRecord record;
+	FormatRecordf(record, LogLevel::LWARNING, LogType::SYSTEM, __FILE__, __LINE__, "Logging too fast, dropped %llu messages", (unsigned long long)(dropped - droppedReported_));
+	droppedReported_ = dropped;
 
+	LogMessage message;
+	ToMessage(record, &message);
 	std::lock_guard<std::mutex> listeners_lock(listeners_lock_);
-	for (auto &iter : listeners_) {
-		iter->Log(message);
+	Dispatch(message);
+}
+
+void LogManager::DrainThread() {
+	SetCurrentThreadName("LogDrain");
+
+	std::unique_lock<std::mutex> guard(drainLock_, std::defer_lock);
+	while (true) {
+		bool any = DrainRecords();
+		ReportDropped();
+		if (any)
+			continue;
+
+		{
+			std::lock_guard<std::mutex> listeners_lock(listeners_lock_);
+			for (auto &iter : listeners_)
+				iter->Flush();
+		}
+
+		guard.lock();
+		if (!drainRunning_)
+			break;
+		drainSleeping_ = true;
+		// Something may have been written before the flag was visible, so check once more.
+		if (records_[readPos_ & (LOG_RING_SIZE - 1)].sequence.load() != readPos_ + 1)
+			drainCond_.wait_for(guard, std::chrono::milliseconds(100));
+		drainSleeping_ = false;
+		guard.unlock();
+	}
+}
+
+void LogManager::Flush() {
+	if (!drainRunning_ || std::this_thread::get_id() == drainThread_.get_id())
+		return;
+
+	u64 target = writePos_;
+	std::unique_lock<std::mutex> guard(drainLock_);
+	while (drainedPos_ < target && drainRunning_) {
+		drainCond_.notify_one();
+		flushedCond_.wait_for(guard, std::chrono::milliseconds(10));
 	}
 }
 
@@ -319,6 +507,16 @@ void FileLogListener::Log(const LogMessage &message) {
 
 	std::lock_guard<std::mutex> lk(m_log_lock);
 	fprintf(fp_, "%s %s %s", message.timestamp, message.header, message.msg.c_str());
+	// Flush right away only for problems, the rest waits until the log is caught up.
+	if (message.level <= LogLevel::LWARNING)
+		fflush(fp_);
+}
+
+void FileLogListener::Flush() {
+	if (!IsValid())
+		return;
+
+	std::lock_guard<std::mutex> lk(m_log_lock);
 	fflush(fp_);
 }
 
@@ -19,7 +19,10 @@
 
 #include "ppsspp_config.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 #include <vector>
 #include <cstdarg>
 #include <cstdio>
@@ -48,6 +51,8 @@ class LogListener {
 	virtual ~LogListener() {}
 
 	virtual void Log(const LogMessage &msg) = 0;
+	// Called when there's nothing more to log for now.
+	virtual void Flush() {}
 };
 
 class FileLogListener : public LogListener {
@@ -56,6 +61,7 @@ class FileLogListener : public LogListener {
 	~FileLogListener();
 
 	void Log(const LogMessage &msg) override;
+	void Flush() override;
 
 	bool IsValid() { if (!fp_) return false; else return true; }
 	bool IsEnabled() const { return m_enable; }
@@ -124,6 +130,32 @@ class LogManager {
 	std::mutex listeners_lock_;
 	std::vector<LogListener*> listeners_;
 
+	// Callers format into a fixed ring of records without taking any lock, and a separate
+	// thread passes them on to the listeners.  If the ring is full, messages are dropped (and counted.)
+	struct LogRecord;
+	LogRecord *records_ = nullptr;
+	std::atomic<u64> writePos_{};
+	// Only used on the drain thread.
+	u64 readPos_ = 0;
+	u64 droppedReported_ = 0;
+	std::atomic<u64> drainedPos_{};
+	std::atomic<u64> dropped_{};
+
+	std::thread drainThread_;
+	std::atomic<bool> drainRunning_{};
+	std::atomic<bool> drainSleeping_{};
+	std::mutex drainLock_;
+	std::condition_variable drainCond_;
+	std::condition_variable flushedCond_;
+
+	static void FormatRecord(LogRecord &record, LogLevel level, LogType type, const char *file, int line, const char *format, va_list args);
+	static void FormatRecordf(LogRecord &record, LogLevel level, LogType type, const char *file, int line, const char *format, ...);
+	void ToMessage(const LogRecord &record, LogMessage *message) const;
+	void DrainThread();
+	bool DrainRecords();
+	void ReportDropped();
+	void Dispatch(const LogMessage &message);
+
 public:
 	void AddListener(LogListener *listener);
 	void RemoveListener(LogListener *listener);
@@ -134,6 +166,13 @@ class LogManager {
 	void Log(LogLevel level, LogType type,
 			 const char *file, int line, const char *fmt, va_list args);
 	bool IsEnabled(LogLevel level, LogType type);
+	// Waits until everything logged so far has reached the listeners.
+	void Flush();
+
+	// Messages lost because they were logged faster than the listeners could take them.
+	u64 GetDroppedCount() const {
+		return dropped_;
+	}
 
 	LogChannel *GetLogChannel(LogType type) {
 		return &log_[(size_t)type];
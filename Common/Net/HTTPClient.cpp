@@ -106,7 +106,7 @@ static void FormatAddr(char *addrbuf, size_t bufsize, const addrinfo *info) {
 	}
 }
 
-bool Connection::Connect(int maxTries, double timeout, bool *cancelConnect) {
+bool Connection::Connect(int maxTries, double timeout, std::atomic<bool> *cancelConnect) {
 	if (port_ <= 0) {
 		ERROR_LOG(IO, "Bad port");
 		return false;
@@ -9,7 +9,7 @@
 
 namespace http {
 
-Request::Request(RequestMethod method, const std::string &url, const std::string &name, bool *cancelled, ProgressBarMode mode) : method_(method), url_(url), name_(name), progress_(cancelled), progressBarMode_(mode) {
+Request::Request(RequestMethod method, const std::string &url, const std::string &name, std::atomic<bool> *cancelled, ProgressBarMode mode) : method_(method), url_(url), name_(name), progress_(cancelled), progressBarMode_(mode) {
 	INFO_LOG(HTTP, "HTTP %s request: %s (%s)", RequestMethodToString(method), url.c_str(), name.c_str());
 
 	progress_.callback = [=](int64_t bytes, int64_t contentLength, bool done) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <functional>
 #include <memory>
@@ -23,7 +24,7 @@ enum class ProgressBarMode {
 // Abstract request.
 class Request {
 public:
-	Request(RequestMethod method, const std::string &url, const std::string &name, bool *cancelled, ProgressBarMode mode);
+	Request(RequestMethod method, const std::string &url, const std::string &name, std::atomic<bool> *cancelled, ProgressBarMode mode);
 	virtual ~Request() {}
 
 	void SetAccept(const char *mime) {
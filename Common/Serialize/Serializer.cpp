@@ -15,8 +15,11 @@
 // Official SVN repository and contact information can be found at
 // http://code.google.com/p/dolphin-emu/
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 #include <snappy-c.h>
 #include <zstd.h>
 
@@ -24,6 +27,7 @@
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/File/FileUtil.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ParallelLoop.h"
 
 enum class SerializeCompressType {
 	NONE = 0,
@@ -33,6 +37,126 @@ enum class SerializeCompressType {
 
 static constexpr SerializeCompressType SAVE_TYPE = SerializeCompressType::ZSTD;
 
+// ZSTD states are saved as independent frames of ZSTD_CHUNK_SIZE bytes each, so they can be compressed
+// and decompressed in parallel. They're preceded by a skippable frame listing the compressed size of
+// each frame. ZSTD_decompress skips that and handles concatenated frames, so the result is still a
+// valid zstd stream, and older single frame states still load.
+static constexpr size_t ZSTD_CHUNK_SIZE = 4 * 1024 * 1024;
+static constexpr u32 ZSTD_CHUNK_INDEX_MAGIC = ZSTD_MAGIC_SKIPPABLE_START + 0xE;
+
+static size_t ZstdChunkCount(size_t sz) {
+	return sz == 0 ? 1 : (sz + ZSTD_CHUNK_SIZE - 1) / ZSTD_CHUNK_SIZE;
+}
+
+// Skippable frame header, chunk size and count, then a size per chunk.
+static size_t ZstdChunkIndexSize(size_t count) {
+	return 16 + 4 * count;
+}
+
+static size_t ZstdChunkedBound(size_t sz) {
+	size_t count = ZstdChunkCount(sz);
+	return ZstdChunkIndexSize(count) + count * ZSTD_compressBound(std::min(sz, ZSTD_CHUNK_SIZE));
+}
+
+static void ParallelChunks(const std::function<void(int, int)> &func, int count) {
+	if (count <= 1 || !g_threadManager.IsInitialized()) {
+		func(0, count);
+	} else {
+		ParallelRangeLoop(&g_threadManager, func, 0, count, 1);
+	}
+}
+
+// Returns the compressed size, or 0 on failure. dest must have room for ZstdChunkedBound(sz).
+static size_t CompressZstdChunks(const u8 *src, size_t sz, u8 *dest) {
+	const size_t count = ZstdChunkCount(sz);
+	const size_t indexSize = ZstdChunkIndexSize(count);
+	// Each chunk is compressed into its own worst case area first, and then packed together.
+	const size_t stride = ZSTD_compressBound(std::min(sz, ZSTD_CHUNK_SIZE));
+
+	std::vector<size_t> sizes(count);
+	std::atomic<bool> failed{};
+	ParallelChunks([&](int lower, int upper) {
+		ZSTD_CCtx *ctx = ZSTD_createCCtx();
+		if (!ctx) {
+			failed = true;
+			return;
+		}
+		for (int i = lower; i < upper; ++i) {
+			size_t offset = i * ZSTD_CHUNK_SIZE;
+			size_t len = std::min(sz - offset, ZSTD_CHUNK_SIZE);
+			// TODO: If free disk space is low, we could max this out to 22?
+			ZSTD_CCtx_reset(ctx, ZSTD_reset_session_and_parameters);
+			ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+			ZSTD_CCtx_setParameter(ctx, ZSTD_c_checksumFlag, 1);
+			ZSTD_CCtx_setPledgedSrcSize(ctx, len);
+			sizes[i] = ZSTD_compress2(ctx, dest + indexSize + i * stride, stride, src + offset, len);
+			if (ZSTD_isError(sizes[i]))
+				failed = true;
+		}
+		ZSTD_freeCCtx(ctx);
+	}, (int)count);
+
+	if (failed)
+		return 0;
+
+	u32 header[4] = { ZSTD_CHUNK_INDEX_MAGIC, (u32)(indexSize - 8), (u32)ZSTD_CHUNK_SIZE, (u32)count };
+	memcpy(dest, header, sizeof(header));
+	size_t pos = indexSize;
+	for (size_t i = 0; i < count; ++i) {
+		u32 size32 = (u32)sizes[i];
+		memcpy(dest + 16 + i * 4, &size32, 4);
+		if (pos != indexSize + i * stride)
+			memmove(dest + pos, dest + indexSize + i * stride, sizes[i]);
+		pos += sizes[i];
+	}
+	return pos;
+}
+
+// Decompresses exactly destSize bytes, in parallel if there's a chunk index.
+static bool DecompressZstdChunks(const u8 *src, size_t sz, u8 *dest, size_t destSize) {
+	u32 header[4]{};
+	if (sz >= sizeof(header))
+		memcpy(header, src, sizeof(header));
+
+	const size_t count = header[3];
+	const size_t chunkSize = header[2];
+	bool validIndex = header[0] == ZSTD_CHUNK_INDEX_MAGIC && count != 0 && chunkSize != 0;
+	validIndex = validIndex && header[1] == ZstdChunkIndexSize(count) - 8 && ZstdChunkIndexSize(count) <= sz;
+	validIndex = validIndex && (destSize + chunkSize - 1) / chunkSize == (destSize == 0 ? 0 : count);
+
+	std::vector<size_t> offsets;
+	if (validIndex) {
+		size_t pos = ZstdChunkIndexSize(count);
+		offsets.resize(count + 1);
+		for (size_t i = 0; i < count; ++i) {
+			u32 size32;
+			memcpy(&size32, src + 16 + i * 4, 4);
+			offsets[i] = pos;
+			pos += size32;
+		}
+		offsets[count] = pos;
+		validIndex = pos == sz;
+	}
+
+	if (!validIndex) {
+		// Single frame, like older states. This also skips any index.
+		size_t status = ZSTD_decompress(dest, destSize, src, sz);
+		return !ZSTD_isError(status) && status == destSize;
+	}
+
+	std::atomic<bool> failed{};
+	ParallelChunks([&](int lower, int upper) {
+		for (int i = lower; i < upper; ++i) {
+			size_t offset = i * chunkSize;
+			size_t len = std::min(destSize - offset, chunkSize);
+			size_t status = ZSTD_decompress(dest + offset, len, src + offsets[i], offsets[i + 1] - offsets[i]);
+			if (ZSTD_isError(status) || status != len)
+				failed = true;
+		}
+	}, (int)count);
+	return !failed;
+}
+
 void PointerWrap::RewindForWrite(u8 *writePtr) {
 	_assert_(mode == MODE_MEASURE);
 	// Switch to writing mode, save the size for later checking and start again.
@@ -373,11 +497,7 @@ CChunkFileReader::Error CChunkFileReader::LoadFile(const Path &filename, std::st
 			auto status = snappy_uncompress((const char *)buffer, sz, (char *)uncomp_buffer, &uncomp_size);
 			success = status == SNAPPY_OK;
 		} else if (SerializeCompressType(header.Compress) == SerializeCompressType::ZSTD) {
-			size_t status = ZSTD_decompress((char *)uncomp_buffer, uncomp_size, (const char *)buffer, sz);
-			success = !ZSTD_isError(status);
-			if (success) {
-				uncomp_size = status;
-			}
+			success = DecompressZstdChunks(buffer, sz, uncomp_buffer, uncomp_size);
 		} else {
 			ERROR_LOG(SAVESTATE, "ChunkReader: Unexpected compression type %d", header.Compress);
 		}
@@ -431,7 +551,7 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const Path &filename, const s
 		write_len = snappy_max_compressed_length(sz);
 		break;
 	case SerializeCompressType::ZSTD:
-		write_len = ZSTD_compressBound(sz);
+		write_len = ZstdChunkedBound(sz);
 		break;
 	}
 	u8 *compressed_buffer = write_len == 0 ? nullptr : (u8 *)malloc(write_len);
@@ -452,20 +572,8 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const Path &filename, const s
 			success = snappy_compress((const char *)buffer, sz, (char *)compressed_buffer, &write_len) == SNAPPY_OK;
 			break;
 		case SerializeCompressType::ZSTD:
-			{
-				auto ctx = ZSTD_createCCtx();
-				if (!ctx) {
-					success = false;
-				} else {
-					// TODO: If free disk space is low, we could max this out to 22?
-					ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
-					ZSTD_CCtx_setParameter(ctx, ZSTD_c_checksumFlag, 1);
-					ZSTD_CCtx_setPledgedSrcSize(ctx, sz);
-					write_len = ZSTD_compress2(ctx, compressed_buffer, write_len, buffer, sz);
-					success = !ZSTD_isError(write_len);
-				}
-				ZSTD_freeCCtx(ctx);
-			}
+			write_len = CompressZstdChunks(buffer, sz, compressed_buffer);
+			success = write_len != 0;
 			break;
 		}
 
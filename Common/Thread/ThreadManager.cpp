@@ -19,28 +19,104 @@
 //   They should always be scheduled to the first N threads.
 // * For some tasks, splitting the input values up linearly between the threads
 //   is not fair. However, we ignore that for now.
+// * Each thread has a lock-free queue per priority. EnqueueTask puts tasks on an idle
+//   thread's queue if there is one, and threads that run out of work steal from the other
+//   threads of the same type, highest priority first.
+// * Tasks put on a specific thread go on its private queue instead, which is never stolen from.
 
 const int MAX_CORES_TO_USE = 16;
 const int MIN_IO_BLOCKING_THREADS = 4;
 static constexpr size_t TASK_PRIORITY_COUNT = (size_t)TaskPriority::COUNT;
+static constexpr size_t TASK_QUEUE_CAPACITY = 256;
+
+// Bounded multi-producer multi-consumer queue, each slot has a sequence number
+// telling whether it's ready for the next push or pop.
+class TaskQueue {
+public:
+	TaskQueue() {
+		for (size_t i = 0; i < TASK_QUEUE_CAPACITY; ++i)
+			slots_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool Push(Task *task) {
+		size_t pos = pushPos_.load(std::memory_order_relaxed);
+		while (true) {
+			Slot &slot = slots_[pos & (TASK_QUEUE_CAPACITY - 1)];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+			if (diff == 0) {
+				if (pushPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					slot.task = task;
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				// Full.
+				return false;
+			} else {
+				pos = pushPos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	Task *Pop() {
+		size_t pos = popPos_.load(std::memory_order_relaxed);
+		while (true) {
+			Slot &slot = slots_[pos & (TASK_QUEUE_CAPACITY - 1)];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (popPos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					Task *task = slot.task;
+					slot.sequence.store(pos + TASK_QUEUE_CAPACITY, std::memory_order_release);
+					return task;
+				}
+			} else if (diff < 0) {
+				// Empty.
+				return nullptr;
+			} else {
+				pos = popPos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		Task *task;
+	};
+	Slot slots_[TASK_QUEUE_CAPACITY];
+	alignas(64) std::atomic<size_t> pushPos_{};
+	alignas(64) std::atomic<size_t> popPos_{};
+};
+
+static_assert((TASK_QUEUE_CAPACITY & (TASK_QUEUE_CAPACITY - 1)) == 0, "Queue capacity must be a power of 2");
 
 struct GlobalThreadContext {
-	std::mutex mutex;
+	std::mutex mutex; // protects the overflow queues.
+	// Only used when the thread queues are full, and for tasks left over at teardown.
 	std::deque<Task *> compute_queue[TASK_PRIORITY_COUNT];
-	std::atomic<int> compute_queue_size;
 	std::deque<Task *> io_queue[TASK_PRIORITY_COUNT];
+	// All stealable tasks not yet started, in the thread queues or the overflow queues.
+	std::atomic<int> compute_queue_size;
 	std::atomic<int> io_queue_size;
+	// Just the ones in the overflow queues, so we don't take the lock to find them empty.
+	std::atomic<int> compute_overflow_size;
+	std::atomic<int> io_overflow_size;
 	std::vector<TaskThreadContext *> threads_;
+	int numComputeThreads = 0;
 
 	std::atomic<int> roundRobin;
 };
 
 struct TaskThreadContext {
-	std::atomic<int> queue_size;
+	TaskQueue queue[TASK_PRIORITY_COUNT]; // other threads of the same type may steal from these.
+	std::atomic<int> private_queue_size;
 	std::deque<Task *> private_queue[TASK_PRIORITY_COUNT];
 	std::thread thread; // the worker thread
 	std::condition_variable cond; // used to signal new work
-	std::mutex mutex; // protects the local queue.
+	std::mutex mutex; // protects the private queue.
+	std::atomic<bool> idle; // set while looking for work, cleared by whoever decides to wake it.
 	int index;
 	TaskType type;
 	std::atomic<bool> cancelled;
@@ -50,6 +126,8 @@ struct TaskThreadContext {
 ThreadManager::ThreadManager() : global_(new GlobalThreadContext()) {
 	global_->compute_queue_size = 0;
 	global_->io_queue_size = 0;
+	global_->compute_overflow_size = 0;
+	global_->io_overflow_size = 0;
 	global_->roundRobin = 0;
 }
 
@@ -64,31 +142,62 @@ void ThreadManager::Teardown() {
 		threadCtx->cond.notify_one();
 	}
 
-	// Purge any cancellable tasks while the threads shut down.
-	if (global_->compute_queue_size > 0 || global_->io_queue_size > 0) {
-		auto drainQueue = [&](std::deque<Task *> queue[TASK_PRIORITY_COUNT], std::atomic<int> &size) {
+	// Purge any cancellable tasks while the threads shut down, so they don't wait on them.
+	// The thread queues are safe to pop from concurrently, the rest moves to the overflow queues.
+	auto drainQueue = [&](std::deque<Task *> queue[TASK_PRIORITY_COUNT], std::atomic<int> &size, std::atomic<int> &overflowSize) {
+		for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i) {
+			for (auto it = queue[i].begin(); it != queue[i].end(); ) {
+				if (TeardownTask(*it, false)) {
+					it = queue[i].erase(it);
+					size--;
+					overflowSize--;
+				} else {
+					++it;
+				}
+			}
+		}
+	};
+	auto drainThreadQueues = [&](TaskThreadContext *threadCtx) {
+		auto &queue_size = threadCtx->type == TaskType::CPU_COMPUTE ? global_->compute_queue_size : global_->io_queue_size;
+		for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i) {
+			while (Task *task = threadCtx->queue[i].Pop()) {
+				// Either cancelled, or counted again in the overflow queue.
+				queue_size--;
+				TeardownTask(task, true);
+			}
+		}
+	};
+
+	{
+		std::unique_lock<std::mutex> lock(global_->mutex);
+		drainQueue(global_->compute_queue, global_->compute_queue_size, global_->compute_overflow_size);
+		drainQueue(global_->io_queue, global_->io_queue_size, global_->io_overflow_size);
+		for (TaskThreadContext *&threadCtx : global_->threads_) {
+			drainThreadQueues(threadCtx);
+
+			std::unique_lock<std::mutex> threadLock(threadCtx->mutex);
 			for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i) {
-				for (auto it = queue[i].begin(); it != queue[i].end(); ++it) {
+				auto &queue = threadCtx->private_queue[i];
+				for (auto it = queue.begin(); it != queue.end(); ) {
 					if (TeardownTask(*it, false)) {
-						queue[i].erase(it);
-						size--;
-						return false;
+						it = queue.erase(it);
+						threadCtx->private_queue_size--;
+					} else {
+						++it;
 					}
 				}
 			}
-			return true;
-		};
-
-		std::unique_lock<std::mutex> lock(global_->mutex);
-		while (!drainQueue(global_->compute_queue, global_->compute_queue_size))
-			continue;
-		while (!drainQueue(global_->io_queue, global_->io_queue_size))
-			continue;
+		}
 	}
 
 	for (TaskThreadContext *&threadCtx : global_->threads_) {
 		threadCtx->thread.join();
-		// TODO: Is it better to just delete these?
+	}
+
+	// Now nothing else touches the queues, keep whatever is left for the next Init().
+	std::unique_lock<std::mutex> lock(global_->mutex);
+	for (TaskThreadContext *&threadCtx : global_->threads_) {
+		drainThreadQueues(threadCtx);
 		for (size_t i = 0; i < TASK_PRIORITY_COUNT; ++i) {
 			for (Task *task : threadCtx->private_queue[i]) {
 				TeardownTask(task, true);
@@ -118,9 +227,11 @@ bool ThreadManager::TeardownTask(Task *task, bool enqueue) {
 		if (task->Type() == TaskType::CPU_COMPUTE) {
 			global_->compute_queue[queueIndex].push_back(task);
 			global_->compute_queue_size++;
+			global_->compute_overflow_size++;
 		} else if (task->Type() == TaskType::IO_BLOCKING) {
 			global_->io_queue[queueIndex].push_back(task);
 			global_->io_queue_size++;
+			global_->io_overflow_size++;
 		} else {
 			_assert_(false);
 		}
@@ -128,6 +239,65 @@ bool ThreadManager::TeardownTask(Task *task, bool enqueue) {
 	return false;
 }
 
+static Task *PopPrivateTask(TaskThreadContext *thread, size_t p) {
+	if (thread->private_queue_size == 0)
+		return nullptr;
+	std::unique_lock<std::mutex> lock(thread->mutex);
+	if (thread->private_queue[p].empty())
+		return nullptr;
+	Task *task = thread->private_queue[p].front();
+	thread->private_queue[p].pop_front();
+	thread->private_queue_size--;
+	return task;
+}
+
+// Only has anything when the thread queues were full.
+static Task *PopOverflowTask(GlobalThreadContext *global, TaskThreadContext *thread, size_t p) {
+	const bool isCompute = thread->type == TaskType::CPU_COMPUTE;
+	auto &overflow_size = isCompute ? global->compute_overflow_size : global->io_overflow_size;
+	if (overflow_size == 0)
+		return nullptr;
+	std::unique_lock<std::mutex> lock(global->mutex);
+	auto &queue = isCompute ? global->compute_queue[p] : global->io_queue[p];
+	if (queue.empty())
+		return nullptr;
+	Task *task = queue.front();
+	queue.pop_front();
+	overflow_size--;
+	return task;
+}
+
+// Own queues first, then steal from the others, then the overflow queue. A higher priority task anywhere wins.
+static Task *FindTask(GlobalThreadContext *global, TaskThreadContext *thread, int minThread, int maxThread) {
+	auto &queue_size = thread->type == TaskType::CPU_COMPUTE ? global->compute_queue_size : global->io_queue_size;
+	const int numThreads = maxThread - minThread;
+
+	for (size_t p = 0; p < TASK_PRIORITY_COUNT; ++p) {
+		Task *task = PopPrivateTask(thread, p);
+		if (task)
+			return task;
+		if (queue_size == 0)
+			continue;
+
+		for (int i = 0; i < numThreads; ++i) {
+			TaskThreadContext *victim = global->threads_[minThread + (thread->index - minThread + i) % numThreads];
+			task = victim->queue[p].Pop();
+			if (task) {
+				queue_size--;
+				return task;
+			}
+		}
+
+		task = PopOverflowTask(global, thread, p);
+		if (task) {
+			queue_size--;
+			return task;
+		}
+	}
+
+	return nullptr;
+}
+
 static void WorkerThreadFunc(GlobalThreadContext *global, TaskThreadContext *thread) {
 	if (thread->type == TaskType::CPU_COMPUTE) {
 		snprintf(thread->name, sizeof(thread->name), "PoolWorker %d", thread->index);
@@ -142,68 +312,31 @@ static void WorkerThreadFunc(GlobalThreadContext *global, TaskThreadContext *thr
 	}
 
 	const bool isCompute = thread->type == TaskType::CPU_COMPUTE;
+	const int minThread = isCompute ? 0 : global->numComputeThreads;
+	const int maxThread = isCompute ? global->numComputeThreads : (int)global->threads_.size();
 	const auto global_queue_size = [isCompute, &global]() -> int {
 		return isCompute ? global->compute_queue_size.load() : global->io_queue_size.load();
 	};
 
 	while (!thread->cancelled) {
-		Task *task = nullptr;
-
-		// Check the global queue first, then check the private queue and wait if there's nothing to do.
-		if (global_queue_size() > 0) {
-			// Grab one from the global queue if there is any.
-			std::unique_lock<std::mutex> lock(global->mutex);
-			auto queue = isCompute ? global->compute_queue : global->io_queue;
-			auto &queue_size = isCompute ? global->compute_queue_size : global->io_queue_size;
-
-			for (size_t p = 0; p < TASK_PRIORITY_COUNT; ++p) {
-				if (!queue[p].empty()) {
-					task = queue[p].front();
-					queue[p].pop_front();
-					queue_size--;
-
-					// We are processing one now, so mark that.
-					thread->queue_size++;
-					break;
-				} else if (thread->queue_size != 0) {
-					// Check the thread, as we prefer a HIGH thread task to a global NORMAL task.
-					std::unique_lock<std::mutex> lock(thread->mutex);
-					if (!thread->private_queue[p].empty()) {
-						task = thread->private_queue[p].front();
-						thread->private_queue[p].pop_front();
-						break;
-					}
-				}
-			}
-		}
+		Task *task = FindTask(global, thread, minThread, maxThread);
 
 		if (!task) {
-			// We didn't have any global, do we have anything on the thread?
 			std::unique_lock<std::mutex> lock(thread->mutex);
-			for (size_t p = 0; p < TASK_PRIORITY_COUNT; ++p) {
-				if (thread->private_queue[p].empty())
-					continue;
-
-				task = thread->private_queue[p].front();
-				thread->private_queue[p].pop_front();
-				break;
-			}
-
-			// We must check both queue and single again, while locked.
-			bool wait = !thread->cancelled && !task && global_queue_size() == 0;
-
+			// Mark ourselves idle before the last check, so that EnqueueTask either sees
+			// us idle and wakes us, or we see its task counted here.
+			thread->idle = true;
+			bool wait = !thread->cancelled && thread->private_queue_size == 0 && global_queue_size() == 0;
 			if (wait)
 				thread->cond.wait(lock);
+			thread->idle = false;
+			continue;
 		}
+
 		// The task itself takes care of notifying anyone waiting on it. Not the
 		// responsibility of the ThreadManager (although it could be!).
-		if (task) {
-			task->Run();
-			task->Release();
-			// Reduce the queue size once complete.
-			thread->queue_size--;
-			// _dbg_assert_(thread->queue_size == thread->private_queue[0].size() + thread->private_queue[1].size() + thread->private_queue[2].size());
-		}
+		task->Run();
+		task->Release();
 	}
 
 	// In case it got attached to JNI, detach it. Don't think this has any side effects if called redundantly.
@@ -224,14 +357,20 @@ void ThreadManager::Init(int numRealCores, int numLogicalCoresPerCpu) {
 
 	INFO_LOG(SYSTEM, "ThreadManager::Init(compute threads: %d, all: %d)", numComputeThreads_, numThreads_);
 
+	global_->numComputeThreads = numComputeThreads_;
+	// All contexts must exist before any thread starts, since they steal from each other.
 	for (int i = 0; i < numThreads; i++) {
 		TaskThreadContext *thread = new TaskThreadContext();
 		thread->cancelled.store(false);
+		thread->idle.store(false);
+		thread->private_queue_size.store(0);
 		thread->type = i < numComputeThreads_ ? TaskType::CPU_COMPUTE : TaskType::IO_BLOCKING;
 		thread->index = i;
-		thread->thread = std::thread(&WorkerThreadFunc, global_, thread);
 		global_->threads_.push_back(thread);
 	}
+	for (TaskThreadContext *thread : global_->threads_) {
+		thread->thread = std::thread(&WorkerThreadFunc, global_, thread);
+	}
 }
 
 void ThreadManager::EnqueueTask(Task *task) {
@@ -260,42 +399,47 @@ void ThreadManager::EnqueueTask(Task *task) {
 		maxThread = numThreads_;
 	}
 
-	// Find a thread with no outstanding work.
 	_assert_(maxThread <= (int)global_->threads_.size());
-	for (int threadNum = minThread; threadNum < maxThread; threadNum++) {
-		TaskThreadContext *thread = global_->threads_[threadNum];
-		if (thread->queue_size.load() == 0) {
-			std::unique_lock<std::mutex> lock(thread->mutex);
-			thread->private_queue[queueIndex].push_back(task);
-			thread->queue_size++;
-			thread->cond.notify_one();
-			// Found it - done.
-			return;
+	const int numThreads = maxThread - minThread;
+	auto &queue_size = task->Type() == TaskType::CPU_COMPUTE ? global_->compute_queue_size : global_->io_queue_size;
+	// Count it before looking for idle threads, see WorkerThreadFunc.
+	queue_size++;
+
+	// Prefer a thread that's waiting for work, and claim it so the next task goes elsewhere.
+	uint32_t start = (uint32_t)global_->roundRobin++;
+	TaskThreadContext *chosenThread = nullptr;
+	for (int i = 0; i < numThreads; i++) {
+		TaskThreadContext *thread = global_->threads_[minThread + (start + i) % numThreads];
+		if (thread->idle.load() && thread->idle.exchange(false)) {
+			chosenThread = thread;
+			break;
 		}
 	}
 
-	// Still not scheduled? Put it on the global queue and notify a thread chosen by round-robin.
-	// Not particularly scientific, but hopefully we should not run into this too much.
-	{
+	// If they're all busy, whichever finishes first will steal it.
+	TaskThreadContext *target = chosenThread ? chosenThread : global_->threads_[minThread + start % numThreads];
+	bool queued = false;
+	for (int i = 0; i < numThreads && !queued; i++) {
+		queued = global_->threads_[minThread + (target->index - minThread + i) % numThreads]->queue[queueIndex].Push(task);
+	}
+	if (!queued) {
 		std::unique_lock<std::mutex> lock(global_->mutex);
 		if (task->Type() == TaskType::CPU_COMPUTE) {
 			global_->compute_queue[queueIndex].push_back(task);
-			global_->compute_queue_size++;
+			global_->compute_overflow_size++;
 		} else if (task->Type() == TaskType::IO_BLOCKING) {
 			global_->io_queue[queueIndex].push_back(task);
-			global_->io_queue_size++;
+			global_->io_overflow_size++;
 		} else {
 			_assert_(false);
 		}
 	}
 
-	int chosenIndex = global_->roundRobin++;
-	chosenIndex = minThread + (chosenIndex % (maxThread - minThread));
-	TaskThreadContext *&chosenThread = global_->threads_[chosenIndex];
-
-	// Lock the thread to ensure it gets the message.
-	std::unique_lock<std::mutex> lock(chosenThread->mutex);
-	chosenThread->cond.notify_one();
+	if (chosenThread) {
+		// Lock the thread to ensure it gets the message.
+		std::unique_lock<std::mutex> lock(chosenThread->mutex);
+		chosenThread->cond.notify_one();
+	}
 }
 
 void ThreadManager::EnqueueTaskOnThread(int threadNum, Task *task) {
@@ -305,10 +449,9 @@ void ThreadManager::EnqueueTaskOnThread(int threadNum, Task *task) {
 	TaskThreadContext *thread = global_->threads_[threadNum];
 	size_t queueIndex = (size_t)task->Priority();
 
-	thread->queue_size++;
-
 	std::unique_lock<std::mutex> lock(thread->mutex);
 	thread->private_queue[queueIndex].push_back(task);
+	thread->private_queue_size++;
 	thread->cond.notify_one();
 }
 
@@ -113,6 +113,9 @@ struct Config {
 	bool bHideSlowWarnings;
 	bool bHideStateWarnings;
 	bool bPreloadFunctions;
+	bool bIRBlockCache;
+	bool bIRBackgroundCompile;
+	bool bIRTraceFormation;
 	uint32_t uJitDisableFlags;
 
 	bool bDisableHTTPS;
@@ -208,6 +211,8 @@ struct Config {
 	float fUISaturation;
 
 	bool bTextureBackoffCache;
+	bool bTextureWriteTracking;  // Takes effect on boot.
+	bool bVertexCache;
 	bool bVertexDecoderJit;
 	bool bFullScreen;
 	bool bFullScreenMulti;
@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <atomic>
 #include <climits>
 #include <cstdio>
@@ -60,10 +61,26 @@ struct BaseEvent {
 	int type;
 };
 
-typedef LinkedListItem<BaseEvent> Event;
+// Events live in slots, so they keep their index while the heap moves them around.
+struct EventSlot {
+	BaseEvent ev;
+	// Scheduling order, which keeps events at the same time in FIFO order.
+	u64 order;
+	int heapPos;
+	int typePos;
+};
+
+// Types outside this range (only from broken save states) go in otherTypeSlots.
+static const int MAX_TRACKED_EVENT_TYPE = 4096;
 
-Event *first;
-Event *eventPool = 0;
+static std::vector<EventSlot> eventSlots;
+static std::vector<int> freeEventSlots;
+// Binary min-heap of slot indices, ordered by time and then scheduling order.
+static std::vector<int> eventHeap;
+// Scheduled slots per event type, so lookups by type don't have to scan everything.
+static std::vector<std::vector<int>> slotsByType;
+static std::vector<int> otherTypeSlots;
+static u64 nextEventOrder;
 
 // Downcount has been moved to currentMIPS, to save a couple of clocks in every ARM JIT block
 // as we can already reach that structure through a register.
@@ -120,20 +137,108 @@ u64 GetGlobalTimeUs() {
 	return lastGlobalTimeUs + usSinceLast;
 }
 
-Event* GetNewEvent()
-{
-	if(!eventPool)
-		return new Event;
+static inline bool EventBefore(int a, int b) {
+	const EventSlot &ea = eventSlots[a];
+	const EventSlot &eb = eventSlots[b];
+	if (ea.ev.time != eb.ev.time)
+		return ea.ev.time < eb.ev.time;
+	return ea.order < eb.order;
+}
 
-	Event* ev = eventPool;
-	eventPool = ev->next;
-	return ev;
+static inline void HeapSet(int pos, int slot) {
+	eventHeap[pos] = slot;
+	eventSlots[slot].heapPos = pos;
 }
 
-void FreeEvent(Event* ev)
-{
-	ev->next = eventPool;
-	eventPool = ev;
+static void HeapSiftUp(int pos) {
+	int slot = eventHeap[pos];
+	while (pos > 0) {
+		int parent = (pos - 1) / 2;
+		if (!EventBefore(slot, eventHeap[parent]))
+			break;
+		HeapSet(pos, eventHeap[parent]);
+		pos = parent;
+	}
+	HeapSet(pos, slot);
+}
+
+static void HeapSiftDown(int pos) {
+	const int n = (int)eventHeap.size();
+	int slot = eventHeap[pos];
+	while (true) {
+		int child = pos * 2 + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && EventBefore(eventHeap[child + 1], eventHeap[child]))
+			child++;
+		if (!EventBefore(eventHeap[child], slot))
+			break;
+		HeapSet(pos, eventHeap[child]);
+		pos = child;
+	}
+	HeapSet(pos, slot);
+}
+
+static std::vector<int> &TypeSlots(int event_type) {
+	if (event_type < 0 || event_type >= MAX_TRACKED_EVENT_TYPE)
+		return otherTypeSlots;
+	if (event_type >= (int)slotsByType.size())
+		slotsByType.resize(event_type + 1);
+	return slotsByType[event_type];
+}
+
+static inline const BaseEvent *FirstEvent() {
+	return eventHeap.empty() ? nullptr : &eventSlots[eventHeap[0]].ev;
+}
+
+static void AddEvent(const BaseEvent &ev) {
+	int slot;
+	if (!freeEventSlots.empty()) {
+		slot = freeEventSlots.back();
+		freeEventSlots.pop_back();
+	} else {
+		slot = (int)eventSlots.size();
+		eventSlots.push_back(EventSlot{});
+	}
+
+	EventSlot &e = eventSlots[slot];
+	e.ev = ev;
+	e.order = nextEventOrder++;
+
+	std::vector<int> &typeSlots = TypeSlots(ev.type);
+	e.typePos = (int)typeSlots.size();
+	typeSlots.push_back(slot);
+
+	eventHeap.push_back(slot);
+	HeapSiftUp((int)eventHeap.size() - 1);
+}
+
+static void RemoveEventSlot(int slot) {
+	const EventSlot &e = eventSlots[slot];
+
+	int pos = e.heapPos;
+	int last = eventHeap.back();
+	eventHeap.pop_back();
+	if (last != slot) {
+		HeapSet(pos, last);
+		HeapSiftUp(pos);
+		HeapSiftDown(eventSlots[last].heapPos);
+	}
+
+	std::vector<int> &typeSlots = TypeSlots(e.ev.type);
+	int lastTypeSlot = typeSlots.back();
+	typeSlots[e.typePos] = lastTypeSlot;
+	eventSlots[lastTypeSlot].typePos = e.typePos;
+	typeSlots.pop_back();
+
+	freeEventSlots.push_back(slot);
+}
+
+// In the order they will run.
+static std::vector<int> SortedEventSlots() {
+	std::vector<int> sorted = eventHeap;
+	std::sort(sorted.begin(), sorted.end(), &EventBefore);
+	return sorted;
 }
 
 int RegisterEvent(const char *name, TimedCallback callback) {
@@ -179,7 +284,7 @@ void RestoreRegisterEvent(int &event_type, const char *name, TimedCallback callb
 }
 
 void UnregisterAllEvents() {
-	_dbg_assert_msg_(first == nullptr, "Unregistering events with events pending - this isn't good.");
+	_dbg_assert_msg_(eventHeap.empty(), "Unregistering events with events pending - this isn't good.");
 	event_types.clear();
 	usedEventTypes.clear();
 	restoredEventTypes.clear();
@@ -202,11 +307,10 @@ void Shutdown()
 	ClearPendingEvents();
 	UnregisterAllEvents();
 
-	while (eventPool) {
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		delete ev;
-	}
+	eventSlots.shrink_to_fit();
+	freeEventSlots.shrink_to_fit();
+	eventHeap.shrink_to_fit();
+	slotsByType.clear();
 }
  
 u64 GetTicks()
@@ -226,30 +330,13 @@ u64 GetIdleTicks()
 
 void ClearPendingEvents()
 {
-	while (first)
-	{
-		Event *e = first->next;
-		FreeEvent(first);
-		first = e;
-	}
-}
-
-void AddEventToQueue(Event* ne)
-{
-	Event* prev = NULL;
-	Event** pNext = &first;
-	for(;;)
-	{
-		Event*& next = *pNext;
-		if(!next || ne->time < next->time)
-		{
-			ne->next = next;
-			next = ne;
-			break;
-		}
-		prev = next;
-		pNext = &prev->next;
-	}
+	eventSlots.clear();
+	freeEventSlots.clear();
+	eventHeap.clear();
+	for (auto &typeSlots : slotsByType)
+		typeSlots.clear();
+	otherTypeSlots.clear();
+	nextEventOrder = 0;
 }
 
 // This must be run ONLY from within the cpu thread
@@ -257,53 +344,37 @@ void AddEventToQueue(Event* ne)
 // than Advance
 void ScheduleEvent(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
-	Event *ne = GetNewEvent();
-	ne->userdata = userdata;
-	ne->type = event_type;
-	ne->time = GetTicks() + cyclesIntoFuture;
-	AddEventToQueue(ne);
+	BaseEvent ev;
+	ev.userdata = userdata;
+	ev.type = event_type;
+	ev.time = GetTicks() + cyclesIntoFuture;
+	AddEvent(ev);
 }
 
 // Returns cycles left in timer.
 s64 UnscheduleEvent(int event_type, u64 userdata)
 {
+	std::vector<int> &typeSlots = TypeSlots(event_type);
 	s64 result = 0;
-	if (!first)
-		return result;
-	while(first)
-	{
-		if (first->type == event_type && first->userdata == userdata)
-		{
-			result = first->time - GetTicks();
-
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return result;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type && ptr->userdata == userdata)
-		{
-			result = ptr->time - GetTicks();
-
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
+	s64 resultTime = 0;
+	u64 resultOrder = 0;
+	bool found = false;
+	for (size_t i = 0; i < typeSlots.size(); ) {
+		const EventSlot &e = eventSlots[typeSlots[i]];
+		if (e.ev.type != event_type || e.ev.userdata != userdata) {
+			++i;
+			continue;
 		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
+
+		// Like the queue order, the last one to run wins if there are several.
+		if (!found || e.ev.time > resultTime || (e.ev.time == resultTime && e.order > resultOrder)) {
+			result = e.ev.time - GetTicks();
+			resultTime = e.ev.time;
+			resultOrder = e.order;
+			found = true;
 		}
+		// This moves the last one into i.
+		RemoveEventSlot(typeSlots[i]);
 	}
 
 	return result;
@@ -315,66 +386,36 @@ void RegisterMHzChangeCallback(MHzChangeCallback callback) {
 
 bool IsScheduled(int event_type)
 {
-	if (!first)
-		return false;
-	Event *e = first;
-	while (e) {
-		if (e->type == event_type)
+	for (int slot : TypeSlots(event_type)) {
+		if (eventSlots[slot].ev.type == event_type)
 			return true;
-		e = e->next;
 	}
 	return false;
 }
 
 void RemoveEvent(int event_type)
 {
-	if (!first)
-		return;
-	while(first)
-	{
-		if (first->type == event_type)
-		{
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
+	std::vector<int> &typeSlots = TypeSlots(event_type);
+	for (size_t i = 0; i < typeSlots.size(); ) {
+		if (eventSlots[typeSlots[i]].ev.type == event_type)
+			RemoveEventSlot(typeSlots[i]);
 		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
+			++i;
 	}
 }
 
 void ProcessEvents() {
-	while (first) {
-		if (first->time <= (s64)GetTicks()) {
-			// INFO_LOG(CPU, "%s (%lld, %lld) ", first->name ? first->name : "?", (u64)GetTicks(), (u64)first->time);
-			Event *evt = first;
-			first = first->next;
-			if (evt->type >= 0 && evt->type < event_types.size()) {
-				event_types[evt->type].callback(evt->userdata, (int)(GetTicks() - evt->time));
+	while (!eventHeap.empty()) {
+		int slot = eventHeap[0];
+		if (eventSlots[slot].ev.time <= (s64)GetTicks()) {
+			// The callback may schedule events, which could reuse the slot.
+			const BaseEvent evt = eventSlots[slot].ev;
+			RemoveEventSlot(slot);
+			if (evt.type >= 0 && evt.type < event_types.size()) {
+				event_types[evt.type].callback(evt.userdata, (int)(GetTicks() - evt.time));
 			} else {
-				_dbg_assert_msg_(false, "Bad event type %d", evt->type);
+				_dbg_assert_msg_(false, "Bad event type %d", evt.type);
 			}
-			FreeEvent(evt);
 		} else {
 			// Caught up to the current time.
 			break;
@@ -404,6 +445,7 @@ void Advance() {
 
 	ProcessEvents();
 
+	const BaseEvent *first = FirstEvent();
 	if (!first) {
 		// This should never happen in PPSSPP.
 		if (slicelength < 10000) {
@@ -423,10 +465,9 @@ void Advance() {
 }
 
 void LogPendingEvents() {
-	Event *ptr = first;
-	while (ptr) {
-		//INFO_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, ptr->time, ptr->type);
-		ptr = ptr->next;
+	for (int slot : SortedEventSlots()) {
+		const BaseEvent &ev = eventSlots[slot].ev;
+		DEBUG_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", (long long)globalTimer, (long long)ev.time, ev.type);
 	}
 }
 
@@ -435,6 +476,7 @@ void Idle(int maxIdle) {
 	if (maxIdle != 0 && cyclesDown > maxIdle)
 		cyclesDown = maxIdle;
 
+	const BaseEvent *first = FirstEvent();
 	if (first && cyclesDown > 0) {
 		int cyclesExecuted = slicelength - currentMIPS->downcount;
 		int cyclesNextEvent = (int) (first->time - globalTimer);
@@ -456,14 +498,13 @@ void Idle(int maxIdle) {
 }
 
 std::string GetScheduledEventsSummary() {
-	Event *ptr = first;
 	std::string text = "Scheduled events\n";
 	text.reserve(1000);
-	while (ptr) {
+	for (int slot : SortedEventSlots()) {
+		const BaseEvent *ptr = &eventSlots[slot].ev;
 		unsigned int t = ptr->type;
 		if (t >= event_types.size()) {
 			_dbg_assert_msg_(false, "Invalid event type %d", t);
-			ptr = ptr->next;
 			continue;
 		}
 		const char *name = event_types[t].name;
@@ -472,7 +513,6 @@ std::string GetScheduledEventsSummary() {
 		char temp[512];
 		snprintf(temp, sizeof(temp), "%s : %i %08x%08x\n", name, (int)ptr->time, (u32)(ptr->userdata >> 32), (u32)(ptr->userdata));
 		text += temp;
-		ptr = ptr->next;
 	}
 	return text;
 }
@@ -490,6 +530,37 @@ void Event_DoStateOld(PointerWrap &p, BaseEvent *ev) {
 	usedEventTypes.insert(ev->type);
 }
 
+// Uses the same format as DoLinkedList(), which is how the queue used to be stored.
+static void DoEventQueue(PointerWrap &p, void (*doEvent)(PointerWrap &, BaseEvent *)) {
+	if (p.mode == PointerWrap::MODE_READ) {
+		// Events are added in the order they were saved, so ties stay in the same order.
+		ClearPendingEvents();
+		while (true) {
+			u8 shouldExist = 0;
+			Do(p, shouldExist);
+			if (shouldExist != 1) {
+				if (shouldExist != 0) {
+					WARN_LOG(SAVESTATE, "Savestate failure: incorrect item marker %d", shouldExist);
+					p.SetError(p.ERROR_FAILURE);
+				}
+				break;
+			}
+
+			BaseEvent ev{};
+			doEvent(p, &ev);
+			AddEvent(ev);
+		}
+	} else {
+		for (int slot : SortedEventSlots()) {
+			u8 shouldExist = 1;
+			Do(p, shouldExist);
+			doEvent(p, &eventSlots[slot].ev);
+		}
+		u8 shouldExist = 0;
+		Do(p, shouldExist);
+	}
+}
+
 void DoState(PointerWrap &p) {
 	auto s = p.Section("CoreTiming", 1, 3);
 	if (!s)
@@ -514,11 +585,11 @@ void DoState(PointerWrap &p) {
 	restoredEventTypes.clear();
 
 	if (s >= 3) {
-		DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(p, first, (Event **)nullptr);
+		DoEventQueue(p, &Event_DoState);
 		// This is here because we previously stored a second queue of "threadsafe" events. Gone now. Remove in the next section version upgrade.
 		DoIgnoreUnusedLinkedList(p);
 	} else {
-		DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoStateOld>(p, first, (Event **)nullptr);
+		DoEventQueue(p, &Event_DoStateOld);
 		DoIgnoreUnusedLinkedList(p);
 	}
 
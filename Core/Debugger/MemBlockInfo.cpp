@@ -449,6 +449,58 @@ static inline uint32_t NormalizeAddress(uint32_t addr) {
 	return addr & 0x3FFFFFFF;
 }
 
+// 4 KB pages over 2 MB of VRAM (mirrors fold together) and up to 64 MB of RAM.
+static constexpr uint32_t WRITE_TRACK_PAGE_SHIFT = 12;
+static constexpr uint32_t WRITE_TRACK_VRAM_PAGES = 0x00200000 >> WRITE_TRACK_PAGE_SHIFT;
+static constexpr uint32_t WRITE_TRACK_RAM_PAGES = 0x04000000 >> WRITE_TRACK_PAGE_SHIFT;
+// Each page holds the snapshot generation it was last written in.
+static uint32_t writeTrackPages[WRITE_TRACK_VRAM_PAGES + WRITE_TRACK_RAM_PAGES];
+static uint32_t writeTrackGeneration = 1;
+static uint32_t writeTrackAllWritten = 1;
+bool g_memWriteTracking = false;
+
+static inline int WriteTrackPageIndex(uint32_t addr) {
+	addr = NormalizeAddress(addr);
+	if ((addr & 0x3F000000) == 0x04000000)
+		return (addr & 0x001FFFFF) >> WRITE_TRACK_PAGE_SHIFT;
+	if (addr >= 0x08000000 && addr < 0x0C000000)
+		return WRITE_TRACK_VRAM_PAGES + ((addr - 0x08000000) >> WRITE_TRACK_PAGE_SHIFT);
+	return -1;
+}
+
+void MemWriteTrackingMark(uint32_t start, uint32_t size) {
+	if (size == 0)
+		return;
+	const uint64_t end = (uint64_t)start + size;
+	for (uint64_t addr = start & ~((1 << WRITE_TRACK_PAGE_SHIFT) - 1); addr < end; addr += 1 << WRITE_TRACK_PAGE_SHIFT) {
+		int page = WriteTrackPageIndex((uint32_t)addr);
+		if (page >= 0)
+			writeTrackPages[page] = writeTrackGeneration;
+	}
+}
+
+void MemWriteTrackingMarkAll() {
+	writeTrackAllWritten = writeTrackGeneration;
+}
+
+uint32_t MemWriteTrackingSnapshot() {
+	return ++writeTrackGeneration;
+}
+
+bool MemWriteTrackingChanged(uint32_t start, uint32_t size, uint32_t snapshot) {
+	// Zero is never a snapshot, it means it wasn't taken.
+	if (!g_memWriteTracking || snapshot == 0 || writeTrackAllWritten >= snapshot)
+		return true;
+	const uint64_t end = (uint64_t)start + size;
+	for (uint64_t addr = start & ~((1 << WRITE_TRACK_PAGE_SHIFT) - 1); addr < end; addr += 1 << WRITE_TRACK_PAGE_SHIFT) {
+		int page = WriteTrackPageIndex((uint32_t)addr);
+		// Untracked memory could have changed.
+		if (page < 0 || writeTrackPages[page] >= snapshot)
+			return true;
+	}
+	return false;
+}
+
 static inline bool MergeRecentMemInfo(const PendingNotifyMem &info, size_t copyLength) {
 	if (pendingNotifies.size() < 4)
 		return false;
@@ -484,6 +536,8 @@ void NotifyMemInfoPC(MemBlockFlags flags, uint32_t start, uint32_t size, uint32_
 	}
 	// Clear the uncached and kernel bits.
 	start = NormalizeAddress(start);
+	if (g_memWriteTracking && (flags & MemBlockFlags::WRITE))
+		MemWriteTrackingMark(start, size);
 
 	bool needFlush = false;
 	// When the setting is off, we skip smaller info to keep things fast.
@@ -538,6 +592,8 @@ void NotifyMemInfo(MemBlockFlags flags, uint32_t start, uint32_t size, const cha
 void NotifyMemInfoCopy(uint32_t destPtr, uint32_t srcPtr, uint32_t size, const char *prefix) {
 	if (size == 0)
 		return;
+	if (g_memWriteTracking)
+		MemWriteTrackingMark(destPtr, size);
 
 	bool needsFlush = false;
 	if (CBreakPoints::HasMemChecks()) {
@@ -698,6 +754,11 @@ void MemBlockInfoInit() {
 	flushThreadRunning = true;
 	flushThreadPending = false;
 	flushThread = std::thread(&FlushMemInfoThread);
+
+	memset(writeTrackPages, 0, sizeof(writeTrackPages));
+	writeTrackGeneration = 1;
+	writeTrackAllWritten = 1;
+	g_memWriteTracking = g_Config.bTextureWriteTracking;
 }
 
 void MemBlockInfoShutdown() {
@@ -710,6 +771,7 @@ void MemBlockInfoShutdown() {
 		textureMap.Reset();
 		pendingNotifies.clear();
 	}
+	g_memWriteTracking = false;
 
 	if (flushThreadRunning.load()) {
 		std::lock_guard<std::mutex> guard(flushLock);
@@ -721,6 +783,10 @@ void MemBlockInfoShutdown() {
 }
 
 void MemBlockInfoDoState(PointerWrap &p) {
+	// All of memory was just replaced.
+	if (p.mode == PointerWrap::MODE_READ)
+		MemWriteTrackingMarkAll();
+
 	auto s = p.Section("MemBlockInfo", 0, 1);
 	if (!s)
 		return;
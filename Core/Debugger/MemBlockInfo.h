@@ -86,3 +86,15 @@ static inline bool MemBlockInfoDetailed(uint32_t size) {
 static inline bool MemBlockInfoDetailed(uint32_t size1, uint32_t size2) {
 	return size1 >= MEMINFO_MIN_SIZE || size2 >= MEMINFO_MIN_SIZE || MemBlockInfoDetailed();
 }
+
+// Page-granular tracking of writes to RAM and VRAM, so caches of guest memory (like the texture
+// cache) can tell that a range hasn't changed. Sees writes reported through NotifyMemInfo and
+// Memory::Write_*, plus anything passed to MemWriteTrackingMark (like dcache writebacks.)
+// JIT stores are not seen directly. Enabled at boot by g_Config.bTextureWriteTracking.
+extern bool g_memWriteTracking;
+
+void MemWriteTrackingMark(uint32_t start, uint32_t size);
+void MemWriteTrackingMarkAll();
+// Take this before reading a range, then later writes to it make MemWriteTrackingChanged() true.
+uint32_t MemWriteTrackingSnapshot();
+bool MemWriteTrackingChanged(uint32_t start, uint32_t size, uint32_t snapshot);
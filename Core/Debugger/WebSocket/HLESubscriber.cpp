@@ -26,10 +26,27 @@
 #include "Core/MIPS/MIPSAnalyst.h"
 #include "Core/MIPS/MIPSDebugInterface.h"
 #include "Core/MIPS/MIPSStackWalk.h"
+#include "Core/HLE/HLE.h"
 #include "Core/HLE/sceKernelThread.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
+
+struct WebSocketHLEStatsState : public DebuggerSubscriber {
+	~WebSocketHLEStatsState() {
+		if (forced_)
+			Core_ForceDebugStats(false);
+	}
+
+	void Enable(DebuggerRequest &req);
+	void Get(DebuggerRequest &req);
+	void Reset(DebuggerRequest &req);
+
+protected:
+	bool forced_ = false;
+};
 
 DebuggerSubscriber *WebSocketHLEInit(DebuggerEventHandlerMap &map) {
+	auto p = new WebSocketHLEStatsState();
 	map["hle.thread.list"] = &WebSocketHLEThreadList;
 	map["hle.thread.wake"] = &WebSocketHLEThreadWake;
 	map["hle.thread.stop"] = &WebSocketHLEThreadStop;
@@ -41,8 +58,11 @@ DebuggerSubscriber *WebSocketHLEInit(DebuggerEventHandlerMap &map) {
 	map["hle.func.scan"] = &WebSocketHLEFuncScan;
 	map["hle.module.list"] = &WebSocketHLEModuleList;
 	map["hle.backtrace"] = &WebSocketHLEBacktrace;
+	map["hle.stats.enable"] = std::bind(&WebSocketHLEStatsState::Enable, p, std::placeholders::_1);
+	map["hle.stats.get"] = std::bind(&WebSocketHLEStatsState::Get, p, std::placeholders::_1);
+	map["hle.stats.reset"] = std::bind(&WebSocketHLEStatsState::Reset, p, std::placeholders::_1);
 
-	return nullptr;
+	return p;
 }
 
 // List all current HLE threads (hle.thread.list)
@@ -601,3 +621,73 @@ void WebSocketHLEBacktrace(DebuggerRequest &req) {
 	}
 	json.pop();
 }
+
+// Enable or disable syscall stats collection (hle.stats.enable)
+//
+// Parameters:
+//  - enable: optional boolean, pass false to stop collecting.
+//
+// Response (same event name) with no extra data.
+//
+// Note: syscalls can't be compiled inline while collecting, so there's some overhead.
+// Collected stats are kept (until hle.stats.reset) when disabled.
+void WebSocketHLEStatsState::Enable(DebuggerRequest &req) {
+	bool enable = true;
+	if (!req.ParamBool("enable", &enable, DebuggerParamType::OPTIONAL))
+		return;
+
+	if (forced_ != enable) {
+		Core_ForceDebugStats(enable);
+		forced_ = enable;
+	}
+	req.Respond();
+}
+
+// Get syscall stats (hle.stats.get)
+//
+// No parameters.
+//
+// Response (same event name):
+//  - frames: number of frames the stats were collected over.
+//  - functions: array of objects, most total time first, each with properties:
+//     - module: string, name of the HLE module.
+//     - name: string, name of the function.
+//     - calls: number of times it was called.
+//     - cycles: number of emulated cycles it cost, in total.
+//     - total: number of seconds of host time spent in it, in total.
+//     - p50: number, host seconds per call at the median.
+//     - p99: number, host seconds per call at the 99th percentile.
+//     - max: number, host seconds of the slowest call.
+//
+// Note: percentiles come from a histogram, and are rounded up by up to 25%.
+void WebSocketHLEStatsState::Get(DebuggerRequest &req) {
+	int frames = 0;
+	std::vector<HLESyscallStats> stats = hleGetSyscallStats(&frames);
+
+	JsonWriter &json = req.Respond();
+	json.writeInt("frames", frames);
+	json.pushArray("functions");
+	for (const HLESyscallStats &s : stats) {
+		json.pushDict();
+		json.writeString("module", s.module);
+		json.writeString("name", s.name);
+		json.writeFloat("calls", (double)s.calls);
+		json.writeFloat("cycles", (double)s.cycles);
+		json.writeFloat("total", s.totalTime);
+		json.writeFloat("p50", s.p50Time);
+		json.writeFloat("p99", s.p99Time);
+		json.writeFloat("max", s.maxTime);
+		json.pop();
+	}
+	json.pop();
+}
+
+// Clear syscall stats collected so far (hle.stats.reset)
+//
+// No parameters.
+//
+// Response (same event name) with no extra data.
+void WebSocketHLEStatsState::Reset(DebuggerRequest &req) {
+	hleResetSyscallStats();
+	req.Respond();
+}
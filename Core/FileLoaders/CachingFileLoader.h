@@ -38,6 +38,9 @@ class CachingFileLoader : public ProxiedFileLoader {
 		return ReadAt(absolutePos, bytes * count, data, flags) / bytes;
 	}
 	size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) override;
+	size_t ReadAtVectored(const ReadRange *ranges, size_t count, Flags flags = Flags::NONE) override {
+		return FileLoader::ReadAtVectored(ranges, count, flags);
+	}
 
 private:
 	void Prepare();
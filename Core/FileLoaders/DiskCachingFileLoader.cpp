@@ -453,7 +453,8 @@ bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t
 	if (size == 0) {
 		return true;
 	}
-	s64 blockOffset = GetBlockOffset(info.block);
+	// The offset is within the block, dest is already where that data goes.
+	s64 blockOffset = GetBlockOffset(info.block) + (s64)offset;
 
 	// Before we read, make sure the buffers are flushed.
 	// We might be trying to read an area we've recently written.
@@ -463,13 +464,13 @@ bool DiskCachingFileLoaderCache::ReadBlockData(u8 *dest, BlockInfo &info, size_t
 #ifdef __ANDROID__
 	if (lseek64(fd_, blockOffset, SEEK_SET) != blockOffset) {
 		failed = true;
-	} else if (read(fd_, dest + offset, size) != (ssize_t)size) {
+	} else if (read(fd_, dest, size) != (ssize_t)size) {
 		failed = true;
 	}
 #else
 	if (fseeko(f_, blockOffset, SEEK_SET) != 0) {
 		failed = true;
-	} else if (fread(dest + offset, size, 1, f_) != 1) {
+	} else if (fread(dest, size, 1, f_) != 1) {
 		failed = true;
 	}
 #endif
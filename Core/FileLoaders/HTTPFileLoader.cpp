@@ -16,12 +16,30 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <cstring>
 
 #include "Common/Log.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/Config.h"
 #include "Core/FileLoaders/HTTPFileLoader.h"
 
+class HTTPReadAheadTask : public Task {
+public:
+	HTTPReadAheadTask(HTTPFileLoader *loader, s64 block) : loader_(loader), block_(block) {}
+
+	TaskType Type() const override { return TaskType::IO_BLOCKING; }
+	TaskPriority Priority() const override { return TaskPriority::NORMAL; }
+
+	void Run() override {
+		loader_->FetchReadAhead(block_);
+	}
+
+private:
+	HTTPFileLoader *loader_;
+	s64 block_;
+};
+
 HTTPFileLoader::HTTPFileLoader(const ::Path &filename)
 	: url_(filename.ToString()), progress_(&cancel_), filename_(filename) {
 }
@@ -152,6 +170,7 @@ int HTTPFileLoader::SendHEAD(const Url &url, std::vector<std::string> &responseH
 }
 
 HTTPFileLoader::~HTTPFileLoader() {
+	StopReadAhead();
 	Disconnect();
 }
 
@@ -188,31 +207,59 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 		return 0;
 	}
 
-	Connect(10.0);
-	if (!connected_) {
-		return 0;
+	// Once it looks like streaming, keep the next few blocks coming on other connections.
+	sequentialReads_ = absolutePos == filepos_ ? sequentialReads_ + 1 : 0;
+	if (sequentialReads_ >= READAHEAD_MIN_SEQUENTIAL && g_threadManager.IsInitialized()) {
+		StartReadAhead(absolutePos);
 	}
 
+	bool stalled = false;
+	size_t readBytes = ReadFromReadAhead(absolutePos, absoluteEnd, (u8 *)data, &stalled);
+	if (absolutePos + (s64)readBytes < absoluteEnd) {
+		stalled = true;
+		Connect(10.0);
+		if (!connected_) {
+			return readBytes;
+		}
+
+		const char *error = nullptr;
+		readBytes += SendRangeRequest(client_, &progress_, absolutePos + readBytes, absoluteEnd, (u8 *)data + readBytes, &error);
+		if (error) {
+			latestError_ = error;
+		}
+
+		// TODO: Keepalive instead.
+		Disconnect();
+	}
+
+	if (stalled) {
+		stalls_++;
+	}
+	if (readBytes != 0) {
+		filepos_ = absolutePos + readBytes;
+	}
+	return readBytes;
+}
+
+size_t HTTPFileLoader::SendRangeRequest(http::Client &client, net::RequestProgress *progress, s64 absolutePos, s64 absoluteEnd, void *data, const char **error) {
 	char requestHeaders[4096];
 	// Note that the Range header is *inclusive*.
 	snprintf(requestHeaders, sizeof(requestHeaders),
 		"Range: bytes=%lld-%lld\r\n", absolutePos, absoluteEnd - 1);
 
 	http::RequestParams req(url_.Resource(), "*/*");
-	int err = client_.SendRequest("GET", req, requestHeaders, &progress_);
+	int err = client.SendRequest("GET", req, requestHeaders, progress);
 	if (err < 0) {
-		latestError_ = "Invalid response reading data";
-		Disconnect();
+		*error = "Invalid response reading data";
 		return 0;
 	}
 
 	net::Buffer readbuf;
 	std::vector<std::string> responseHeaders;
-	int code = client_.ReadResponseHeaders(&readbuf, responseHeaders, &progress_);
+	int code = client.ReadResponseHeaders(&readbuf, responseHeaders, progress);
 	if (code != 206) {
 		ERROR_LOG(LOADER, "HTTP server did not respond with range, received code=%03d", code);
-		latestError_ = "Invalid response reading data";
-		Disconnect();
+		*error = "Invalid response reading data";
 		return 0;
 	}
 
@@ -239,27 +286,120 @@ size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags f
 
 	// TODO: Would be nice to read directly.
 	net::Buffer output;
-	int res = client_.ReadResponseEntity(&readbuf, responseHeaders, &output, &progress_);
+	int res = client.ReadResponseEntity(&readbuf, responseHeaders, &output, progress);
 	if (res != 0) {
 		ERROR_LOG(LOADER, "Unable to read HTTP response entity: %d", res);
 		// Let's take anything we got anyway.  Not worse than returning nothing?
 	}
 
-	// TODO: Keepalive instead.
-	Disconnect();
-
 	if (!supportedResponse) {
 		ERROR_LOG(LOADER, "HTTP server did not respond with the range we wanted.");
-		latestError_ = "Invalid response reading data";
+		*error = "Invalid response reading data";
 		return 0;
 	}
 
-	size_t readBytes = output.size();
+	size_t readBytes = std::min(output.size(), (size_t)(absoluteEnd - absolutePos));
 	output.Take(readBytes, (char *)data);
-	filepos_ = absolutePos + readBytes;
 	return readBytes;
 }
 
+size_t HTTPFileLoader::ReadFromReadAhead(s64 absolutePos, s64 absoluteEnd, u8 *data, bool *stalled) {
+	std::unique_lock<std::mutex> guard(readAheadLock_);
+	size_t readBytes = 0;
+	while (absolutePos < absoluteEnd) {
+		const s64 block = absolutePos >> READAHEAD_BLOCK_SHIFT;
+		auto it = readAhead_.find(block);
+		if (it == readAhead_.end()) {
+			break;
+		}
+
+		std::shared_ptr<ReadAheadBlock> entry = it->second;
+		if (!entry->done) {
+			*stalled = true;
+			readAheadCond_.wait(guard, [&] { return entry->done; });
+		}
+
+		const size_t offset = (size_t)(absolutePos - (block << READAHEAD_BLOCK_SHIFT));
+		if (offset >= entry->data.size()) {
+			// The fetch failed, so let it be tried again.
+			readAhead_.erase(block);
+			break;
+		}
+		const size_t n = std::min(entry->data.size() - offset, (size_t)(absoluteEnd - absolutePos));
+		memcpy(data + readBytes, &entry->data[offset], n);
+		readBytes += n;
+		absolutePos += n;
+
+		// The caches in front of us keep it from here, if they want it.
+		if (offset + n == entry->data.size()) {
+			readAhead_.erase(block);
+		}
+	}
+	return readBytes;
+}
+
+void HTTPFileLoader::StartReadAhead(s64 pos) {
+	std::lock_guard<std::mutex> guard(readAheadLock_);
+	if (readAheadCancel_) {
+		return;
+	}
+	const s64 first = pos >> READAHEAD_BLOCK_SHIFT;
+	const s64 last = std::min(first + READAHEAD_MAX_BLOCKS, (filesize_ + READAHEAD_BLOCK_SIZE - 1) >> READAHEAD_BLOCK_SHIFT);
+
+	// After a seek, whatever was fetched around the old position is unlikely to be read soon.
+	for (auto it = readAhead_.begin(); it != readAhead_.end(); ) {
+		if (it->second->done && (it->first < first || it->first >= last)) {
+			it = readAhead_.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	for (s64 block = first; block < last && readAhead_.size() < READAHEAD_MAX_BLOCKS; ++block) {
+		if (readAhead_.find(block) != readAhead_.end()) {
+			continue;
+		}
+		readAhead_[block] = std::make_shared<ReadAheadBlock>();
+		readAheadRunning_++;
+		g_threadManager.EnqueueTask(new HTTPReadAheadTask(this, block));
+	}
+}
+
+void HTTPFileLoader::FetchReadAhead(s64 block) {
+	const s64 absolutePos = block << READAHEAD_BLOCK_SHIFT;
+	const s64 absoluteEnd = std::min(absolutePos + READAHEAD_BLOCK_SIZE, filesize_);
+	std::vector<u8> data((size_t)(absoluteEnd - absolutePos));
+
+	// Each block gets its own connection, so several can be in flight at once.
+	size_t readBytes = 0;
+	http::Client client;
+	client.SetUserAgent(StringFromFormat("PPSSPP/%s", PPSSPP_GIT_VERSION));
+	client.SetDataTimeout(20.0);
+	net::RequestProgress progress(&readAheadCancel_);
+	if (!readAheadCancel_ && client.Resolve(url_.Host().c_str(), url_.Port()) && client.Connect(3, 10.0, &readAheadCancel_)) {
+		const char *error = nullptr;
+		readBytes = SendRangeRequest(client, &progress, absolutePos, absoluteEnd, data.data(), &error);
+		client.Disconnect();
+	}
+	data.resize(readBytes);
+
+	std::lock_guard<std::mutex> guard(readAheadLock_);
+	auto it = readAhead_.find(block);
+	if (it != readAhead_.end()) {
+		it->second->data = std::move(data);
+		it->second->done = true;
+	}
+	readAheadRunning_--;
+	readAheadCond_.notify_all();
+}
+
+void HTTPFileLoader::StopReadAhead() {
+	std::unique_lock<std::mutex> guard(readAheadLock_);
+	readAheadCancel_ = true;
+	readAheadCond_.wait(guard, [&] { return readAheadRunning_ == 0; });
+	readAhead_.clear();
+}
+
 void HTTPFileLoader::Connect(double timeout) {
 	if (!connected_) {
 		cancel_ = false;
@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -48,15 +52,30 @@ class HTTPFileLoader : public FileLoader {
 
 	void Cancel() override {
 		cancel_ = true;
+		// Also stops any read-ahead still in flight.
+		readAheadCancel_ = true;
 	}
 
 	std::string LatestError() const override {
 		return latestError_;
 	}
 
+	// Reads that had to wait for the network, rather than finding read-ahead data ready.
+	int StallCount() const {
+		return stalls_;
+	}
+
+	// Fetches one read-ahead block on its own connection.  Runs on a worker thread.
+	void FetchReadAhead(s64 block);
+
 private:
 	void Prepare();
 	int SendHEAD(const Url &url, std::vector<std::string> &responseHeaders);
+	size_t SendRangeRequest(http::Client &client, net::RequestProgress *progress, s64 absolutePos, s64 absoluteEnd, void *data, const char **error);
+
+	size_t ReadFromReadAhead(s64 absolutePos, s64 absoluteEnd, u8 *data, bool *stalled);
+	void StartReadAhead(s64 pos);
+	void StopReadAhead();
 
 	void Connect(double timeout);
 
@@ -74,9 +93,30 @@ class HTTPFileLoader : public FileLoader {
 	net::RequestProgress progress_;
 	::Path filename_;
 	bool connected_ = false;
-	bool cancel_ = false;
+	std::atomic<bool> cancel_{};
 	const char *latestError_ = "";
 
 	std::once_flag preparedFlag_;
 	std::mutex readAtMutex_;
+
+	enum {
+		READAHEAD_BLOCK_SIZE = 256 * 1024,
+		READAHEAD_BLOCK_SHIFT = 18,
+		// How many blocks may be in flight or waiting to be read at once.
+		READAHEAD_MAX_BLOCKS = 4,
+		READAHEAD_MIN_SEQUENTIAL = 2,
+	};
+
+	struct ReadAheadBlock {
+		std::vector<u8> data;
+		bool done = false;
+	};
+
+	std::mutex readAheadLock_;
+	std::condition_variable readAheadCond_;
+	std::map<s64, std::shared_ptr<ReadAheadBlock>> readAhead_;
+	int readAheadRunning_ = 0;
+	std::atomic<bool> readAheadCancel_{};
+	int sequentialReads_ = 0;
+	int stalls_ = 0;
 };
@@ -38,6 +38,11 @@
 #include <fcntl.h>
 #endif
 
+#if PPSSPP_PLATFORM(LINUX) && !PPSSPP_PLATFORM(ANDROID) && !defined(HAVE_LIBRETRO_VFS)
+#include <sys/uio.h>
+#define USE_PREADV
+#endif
+
 #ifdef HAVE_LIBRETRO_VFS
 #include <streams/file_stream.h>
 #endif
@@ -222,3 +227,41 @@ size_t LocalFileLoader::ReadAt(s64 absolutePos, size_t bytes, size_t count, void
 	return result == TRUE ? (size_t)read / bytes : -1;
 #endif
 }
+
+size_t LocalFileLoader::ReadAtVectored(const ReadRange *ranges, size_t count, Flags flags) {
+#ifdef USE_PREADV
+	if (filesize_ == 0) {
+		ERROR_LOG(FILESYS, "ReadAtVectored from 0-sized file: %s", filename_.c_str());
+		return 0;
+	}
+
+	// Ranges that follow each other in the file are read with one call, wherever they go in memory.
+	static const int MAX_IOVECS = 64;
+	size_t total = 0;
+	size_t i = 0;
+	while (i < count) {
+		struct iovec iov[MAX_IOVECS];
+		int n = 0;
+		const s64 pos = ranges[i].absolutePos;
+		size_t bytes = 0;
+		while (i < count && n < MAX_IOVECS && ranges[i].absolutePos == pos + (s64)bytes) {
+			iov[n].iov_base = ranges[i].data;
+			iov[n].iov_len = ranges[i].bytes;
+			bytes += ranges[i].bytes;
+			n++;
+			i++;
+		}
+
+#if defined(_FILE_OFFSET_BITS) && _FILE_OFFSET_BITS < 64
+		ssize_t result = preadv64(fd_, iov, n, pos);
+#else
+		ssize_t result = preadv(fd_, iov, n, pos);
+#endif
+		if (result > 0)
+			total += (size_t)result;
+	}
+	return total;
+#else
+	return FileLoader::ReadAtVectored(ranges, count, flags);
+#endif
+}
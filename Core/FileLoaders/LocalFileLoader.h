@@ -44,6 +44,7 @@ class LocalFileLoader : public FileLoader {
 		return filename_;
 	}
 	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override;
+	size_t ReadAtVectored(const ReadRange *ranges, size_t count, Flags flags = Flags::NONE) override;
 
 private:
 #if !defined(_WIN32) && !defined(HAVE_LIBRETRO_VFS)
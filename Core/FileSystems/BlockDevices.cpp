@@ -15,9 +15,11 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
-#include <algorithm>
 
 #include "Common/Data/Text/I18n.h"
 #include "Common/File/FileUtil.h"
@@ -26,6 +28,7 @@
 #include "Common/Swap.h"
 #include "Common/File/FileUtil.h"
 #include "Common/File/DirListing.h"
+#include "Common/Thread/ParallelLoop.h"
 #include "Core/Loaders.h"
 #include "Core/FileSystems/BlockDevices.h"
 #include "libchdr/chd.h"
@@ -107,6 +110,24 @@ bool FileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 	return true;
 }
 
+bool FileBlockDevice::ReadBlocksVectored(const BlockRange *ranges, size_t count) {
+	std::vector<FileLoader::ReadRange> reads(count);
+	size_t expected = 0;
+	for (size_t i = 0; i < count; ++i) {
+		reads[i].absolutePos = (u64)ranges[i].minBlock * (u64)GetBlockSize();
+		reads[i].bytes = (size_t)ranges[i].count * GetBlockSize();
+		reads[i].data = ranges[i].outPtr;
+		expected += reads[i].bytes;
+	}
+
+	size_t retval = fileLoader_->ReadAtVectored(reads.data(), reads.size());
+	if (retval != expected) {
+		ERROR_LOG(FILESYS, "Could not read %d bytes in %d ranges, starting at block offset %d. Only got %d bytes", (int)expected, (int)count, count ? ranges[0].minBlock : 0, (int)retval);
+		return false;
+	}
+	return true;
+}
+
 // .CSO format
 
 // compressed ISO(9660) header format
@@ -136,6 +157,9 @@ typedef struct ciso_header
 // TODO: Need much better error handling.
 
 static const u32 CSO_READ_BUFFER_SIZE = 256 * 1024;
+// Larger reads than this inflate frames in parallel, in batches of compressed data up to CSO_BATCH_READ_SIZE.
+static const u32 CSO_PARALLEL_MIN_FRAMES = 16;
+static const u32 CSO_BATCH_READ_SIZE = 4 * 1024 * 1024;
 
 CISOFileBlockDevice::CISOFileBlockDevice(FileLoader *fileLoader)
 	: BlockDevice(fileLoader)
@@ -309,6 +333,11 @@ bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 
 	const u32 minFrameNumber = minBlock >> blockShift;
 	const u32 lastFrameNumber = lastBlock >> blockShift;
+	if (lastFrameNumber - minFrameNumber >= CSO_PARALLEL_MIN_FRAMES && g_threadManager.IsInitialized()) {
+		ReadFramesParallel(minBlock, lastBlock, outPtr);
+		return true;
+	}
+
 	const u32 afterLastIndexPos = index[lastFrameNumber + 1] & 0x7FFFFFFF;
 	const u64 totalReadEnd = (u64)afterLastIndexPos << indexShift;
 
@@ -382,6 +411,90 @@ bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 	return true;
 }
 
+bool CISOFileBlockDevice::IsPlainFrame(u32 frame) const {
+	if (ver_ >= 2) {
+		// CSO v2+ requires blocks be uncompressed if large enough to be.  High bit means other things.
+		const u64 compressedSize = (u64)((index[frame + 1] & 0x7FFFFFFF) - (index[frame] & 0x7FFFFFFF)) << indexShift;
+		return compressedSize >= frameSize;
+	}
+	return (index[frame] & 0x80000000) != 0;
+}
+
+void CISOFileBlockDevice::ReadFramesParallel(u32 minBlock, u32 lastBlock, u8 *outPtr) {
+	const u32 minFrameNumber = minBlock >> blockShift;
+	const u32 lastFrameNumber = lastBlock >> blockShift;
+	const int blockSize = GetBlockSize();
+	std::atomic<bool> failed{};
+
+	u32 frame = minFrameNumber;
+	while (frame <= lastFrameNumber) {
+		// Read the compressed data of as many frames as fit in the batch, in one go.
+		const u64 batchReadPos = (u64)(index[frame] & 0x7FFFFFFF) << indexShift;
+		u32 batchEnd = frame + 1;
+		while (batchEnd <= lastFrameNumber && ((u64)(index[batchEnd + 1] & 0x7FFFFFFF) << indexShift) - batchReadPos <= CSO_BATCH_READ_SIZE)
+			batchEnd++;
+		const u64 batchReadEnd = (u64)(index[batchEnd] & 0x7FFFFFFF) << indexShift;
+		const size_t batchReadSize = (size_t)(batchReadEnd - batchReadPos);
+
+		batchBuffer_.resize(batchReadSize);
+		const size_t readSize = fileLoader_->ReadAt(batchReadPos, 1, batchReadSize, batchBuffer_.data());
+		if (readSize < batchReadSize)
+			memset(batchBuffer_.data() + readSize, 0, batchReadSize - readSize);
+
+		ParallelRangeLoop(&g_threadManager, [&](int lower, int upper) {
+			z_stream z{};
+			if (inflateInit2(&z, -15) != Z_OK) {
+				ERROR_LOG(LOADER, "Unable to initialize inflate: %s\n", (z.msg) ? z.msg : "?");
+				failed = true;
+				return;
+			}
+
+			std::unique_ptr<u8[]> partialFrame;
+			for (u32 f = (u32)lower; f < (u32)upper; ++f) {
+				const u32 frameFirstBlock = std::max(f << blockShift, minBlock);
+				const u32 frameLastBlock = std::min(((f + 1) << blockShift) - 1, lastBlock);
+				const u32 frameBlockOffset = frameFirstBlock - (f << blockShift);
+				const u32 frameBlocks = frameLastBlock - frameFirstBlock + 1;
+				u8 *out = outPtr + (size_t)(frameFirstBlock - minBlock) * blockSize;
+
+				const u64 frameReadPos = (u64)(index[f] & 0x7FFFFFFF) << indexShift;
+				const u64 frameReadEnd = (u64)(index[f + 1] & 0x7FFFFFFF) << indexShift;
+				const u8 *rawBuffer = batchBuffer_.data() + (frameReadPos - batchReadPos);
+
+				if (IsPlainFrame(f)) {
+					memcpy(out, rawBuffer + frameBlockOffset * blockSize, frameBlocks * blockSize);
+					continue;
+				}
+
+				const bool wholeFrame = frameBlocks == (1U << blockShift);
+				if (!wholeFrame && !partialFrame)
+					partialFrame.reset(new u8[frameSize]);
+
+				z.avail_in = (uInt)(frameReadEnd - frameReadPos);
+				z.next_in = (Bytef *)rawBuffer;
+				z.avail_out = frameSize;
+				z.next_out = wholeFrame ? out : partialFrame.get();
+
+				int status = inflate(&z, Z_FINISH);
+				if (status != Z_STREAM_END || z.total_out != frameSize) {
+					ERROR_LOG(LOADER, "Inflate frame %d: failed - %s[%d], %d bytes\n", f, (z.msg) ? z.msg : "error", status, (u32)z.total_out);
+					memset(out, 0, frameBlocks * blockSize);
+					failed = true;
+				} else if (!wholeFrame) {
+					memcpy(out, partialFrame.get() + frameBlockOffset * blockSize, frameBlocks * blockSize);
+				}
+				inflateReset(&z);
+			}
+			inflateEnd(&z);
+		}, frame, batchEnd, CSO_PARALLEL_MIN_FRAMES / 2);
+
+		frame = batchEnd;
+	}
+
+	if (failed)
+		NotifyReadError();
+}
+
 NPDRMDemoBlockDevice::NPDRMDemoBlockDevice(FileLoader *fileLoader)
 	: BlockDevice(fileLoader)
 {
@@ -526,9 +639,29 @@ bool NPDRMDemoBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
  */
 static const UINT8 nullsha1[CHD_SHA1_BYTES] = { 0 };
 
+// Number of decompressed hunks kept around.
+static const size_t CHD_HUNK_CACHE_SIZE = 8;
+// Reads of at least this many whole hunks decompress them in parallel.
+static const u32 CHD_PARALLEL_MIN_HUNKS = 8;
+// chd_file isn't thread safe, so each parallel read needs its own handle. Each also has its own copy of the hunk map.
+static const int CHD_MAX_HANDLES = 4;
+
 struct CHDImpl {
 	chd_file *chd = nullptr;
 	const chd_header *header = nullptr;
+
+	struct CachedHunk {
+		u32 hunk;
+		std::vector<u8> data;
+	};
+	// Most recently used last.
+	std::vector<CachedHunk> hunkCache;
+
+	// Includes chd, while no parallel read is using it.
+	std::vector<chd_file *> freeHandles;
+	std::vector<chd_file *> extraHandles;
+	std::mutex handleLock;
+	std::condition_variable handleCond;
 };
 
 struct ExtendedCoreFile {
@@ -536,20 +669,15 @@ struct ExtendedCoreFile {
 	uint64_t seekPos;
 };
 
-CHDFileBlockDevice::CHDFileBlockDevice(FileLoader *fileLoader)
-	: BlockDevice(fileLoader), impl_(new CHDImpl())
-{
-	Path paths[8];
-	paths[0] = fileLoader->GetPath();
-	int depth = 0;
-
-	core_file_ = new ExtendedCoreFile();
-	core_file_->core.argp = fileLoader;
-	core_file_->core.fsize = [](core_file *file) -> uint64_t {
+// The file is closed (and this deleted) by chd_close.
+static ExtendedCoreFile *CreateCoreFile(FileLoader *fileLoader) {
+	ExtendedCoreFile *newFile = new ExtendedCoreFile();
+	newFile->core.argp = fileLoader;
+	newFile->core.fsize = [](core_file *file) -> uint64_t {
 		FileLoader *loader = (FileLoader *)file->argp;
 		return loader->FileSize();
 	};
-	core_file_->core.fseek = [](core_file *file, int64_t offset, int seekType) -> int {
+	newFile->core.fseek = [](core_file *file, int64_t offset, int seekType) -> int {
 		ExtendedCoreFile *coreFile = (ExtendedCoreFile *)file;
 		switch (seekType) {
 		case SEEK_SET:
@@ -569,7 +697,7 @@ CHDFileBlockDevice::CHDFileBlockDevice(FileLoader *fileLoader)
 		}
 		return 0;
 	};
-	core_file_->core.fread = [](void *out_data, size_t size, size_t count, core_file *file) {
+	newFile->core.fread = [](void *out_data, size_t size, size_t count, core_file *file) {
 		ExtendedCoreFile *coreFile = (ExtendedCoreFile *)file;
 		FileLoader *loader = (FileLoader *)file->argp;
 		uint64_t totalSize = size * count;
@@ -577,11 +705,22 @@ CHDFileBlockDevice::CHDFileBlockDevice(FileLoader *fileLoader)
 		coreFile->seekPos += totalSize;
 		return size * count;
 	};
-	core_file_->core.fclose = [](core_file *file) {
+	newFile->core.fclose = [](core_file *file) {
 		ExtendedCoreFile *coreFile = (ExtendedCoreFile *)file;
 		delete coreFile;
 		return 0;
 	};
+	return newFile;
+}
+
+CHDFileBlockDevice::CHDFileBlockDevice(FileLoader *fileLoader)
+	: BlockDevice(fileLoader), impl_(new CHDImpl())
+{
+	Path paths[8];
+	paths[0] = fileLoader->GetPath();
+	int depth = 0;
+
+	core_file_ = CreateCoreFile(fileLoader);
 
 	/*
 	// TODO: Support parent/child CHD files.
@@ -643,20 +782,48 @@ CHDFileBlockDevice::CHDFileBlockDevice(FileLoader *fileLoader)
 
 	impl_->chd = file;
 	impl_->header = chd_get_header(impl_->chd);
-	readBuffer = new u8[impl_->header->hunkbytes];
-	currentHunk = -1;
+	impl_->freeHandles.push_back(file);
 	blocksPerHunk = impl_->header->hunkbytes / impl_->header->unitbytes;
 	numBlocks = impl_->header->unitcount;
 }
 
 CHDFileBlockDevice::~CHDFileBlockDevice()
 {
+	for (chd_file *handle : impl_->extraHandles) {
+		chd_close(handle);
+	}
 	if (impl_->chd) {
 		chd_close(impl_->chd);
-		delete[] readBuffer;
 	}
 }
 
+const u8 *CHDFileBlockDevice::GetHunk(u32 hunk) {
+	auto &cache = impl_->hunkCache;
+	for (size_t i = 0; i < cache.size(); ++i) {
+		if (cache[i].hunk == hunk) {
+			std::rotate(cache.begin() + i, cache.begin() + i + 1, cache.end());
+			return cache.back().data.data();
+		}
+	}
+
+	if (cache.size() < CHD_HUNK_CACHE_SIZE) {
+		cache.push_back(CHDImpl::CachedHunk{ hunk, std::vector<u8>(impl_->header->hunkbytes) });
+	} else {
+		// Reuse the least recently used one.
+		std::rotate(cache.begin(), cache.begin() + 1, cache.end());
+		cache.back().hunk = hunk;
+	}
+
+	chd_error err = chd_read(impl_->chd, hunk, cache.back().data.data());
+	if (err != CHDERR_NONE) {
+		ERROR_LOG(LOADER, "CHD read failed: %d %s", hunk, chd_error_string(err));
+		NotifyReadError();
+		// Try again next time.
+		cache.back().hunk = (u32)-1;
+	}
+	return cache.back().data.data();
+}
+
 bool CHDFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
 {
 	if (!impl_->chd) {
@@ -670,16 +837,56 @@ bool CHDFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr, bool uncached)
 	u32 hunk = blockNumber / blocksPerHunk;
 	u32 blockInHunk = blockNumber % blocksPerHunk;
 
-	if (currentHunk != hunk) {
-		chd_error err = chd_read(impl_->chd, hunk, readBuffer);
-		if (err != CHDERR_NONE) {
-			ERROR_LOG(LOADER, "CHD read failed: %d %d %s", blockNumber, hunk, chd_error_string(err));
-			NotifyReadError();
+	const u8 *hunkData = GetHunk(hunk);
+	memcpy(outPtr, hunkData + blockInHunk * impl_->header->unitbytes, GetBlockSize());
+
+	return true;
+}
+
+void CHDFileBlockDevice::ReadHunksParallel(u32 firstHunk, u32 lastHunk, u8 *outPtr) {
+	const u32 hunkBytes = impl_->header->hunkbytes;
+	{
+		std::lock_guard<std::mutex> guard(impl_->handleLock);
+		int wanted = std::min(CHD_MAX_HANDLES, g_threadManager.GetNumLooperThreads() + 1);
+		while ((int)impl_->extraHandles.size() + 1 < wanted) {
+			chd_file *handle = nullptr;
+			chd_error err = chd_open_core_file(&CreateCoreFile(fileLoader_)->core, CHD_OPEN_READ, NULL, &handle);
+			if (err != CHDERR_NONE) {
+				WARN_LOG(LOADER, "Unable to open extra CHD handle: %s", chd_error_string(err));
+				break;
+			}
+			impl_->extraHandles.push_back(handle);
+			impl_->freeHandles.push_back(handle);
 		}
 	}
-	memcpy(outPtr, readBuffer + blockInHunk * impl_->header->unitbytes, GetBlockSize());
 
-	return true;
+	std::atomic<bool> failed{};
+	ParallelRangeLoop(&g_threadManager, [&](int lower, int upper) {
+		chd_file *handle;
+		{
+			std::unique_lock<std::mutex> guard(impl_->handleLock);
+			impl_->handleCond.wait(guard, [&] { return !impl_->freeHandles.empty(); });
+			handle = impl_->freeHandles.back();
+			impl_->freeHandles.pop_back();
+		}
+
+		for (u32 hunk = (u32)lower; hunk < (u32)upper; ++hunk) {
+			u8 *out = outPtr + (size_t)(hunk - firstHunk) * hunkBytes;
+			chd_error err = chd_read(handle, hunk, out);
+			if (err != CHDERR_NONE) {
+				ERROR_LOG(LOADER, "CHD read failed: %d %s", hunk, chd_error_string(err));
+				memset(out, 0, hunkBytes);
+				failed = true;
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(impl_->handleLock);
+		impl_->freeHandles.push_back(handle);
+		impl_->handleCond.notify_one();
+	}, firstHunk, lastHunk + 1, CHD_PARALLEL_MIN_HUNKS / 2);
+
+	if (failed)
+		NotifyReadError();
 }
 
 bool CHDFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
@@ -688,6 +895,24 @@ bool CHDFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr) {
 		return false;
 	}
 
+	// Whole hunks in the middle can be decompressed in parallel, straight into the output.
+	const u32 endBlock = minBlock + count;
+	const u32 firstWholeHunk = (minBlock + blocksPerHunk - 1) / blocksPerHunk;
+	const u32 endWholeHunk = endBlock / blocksPerHunk;
+	const bool blocksMatchUnits = impl_->chd && impl_->header->unitbytes == (u32)GetBlockSize();
+	if (blocksMatchUnits && endBlock <= numBlocks && endWholeHunk >= firstWholeHunk + CHD_PARALLEL_MIN_HUNKS && g_threadManager.IsInitialized()) {
+		const u32 middleStart = firstWholeHunk * blocksPerHunk;
+		const u32 middleEnd = endWholeHunk * blocksPerHunk;
+		for (u32 block = minBlock; block < middleStart; ++block) {
+			ReadBlock(block, outPtr + (block - minBlock) * GetBlockSize());
+		}
+		ReadHunksParallel(firstWholeHunk, endWholeHunk - 1, outPtr + (middleStart - minBlock) * GetBlockSize());
+		for (u32 block = middleEnd; block < endBlock; ++block) {
+			ReadBlock(block, outPtr + (block - minBlock) * GetBlockSize());
+		}
+		return true;
+	}
+
 	for (int i = 0; i < count; i++) {
 		if (!ReadBlock(minBlock + i, outPtr + i * GetBlockSize())) {
 			return false;
@@ -23,13 +23,21 @@
 // The ISOFileSystemReader reads from a BlockDevice, so it automatically works
 // with CISO images.
 
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Core/ELF/PBPReader.h"
 
 class FileLoader;
 
+struct BlockRange {
+	u32 minBlock;
+	int count;
+	u8 *outPtr;
+};
+
 class BlockDevice {
 public:
 	BlockDevice(FileLoader *fileLoader) : fileLoader_(fileLoader) {}
@@ -44,6 +52,15 @@ class BlockDevice {
 		}
 		return true;
 	}
+	// Reads several ranges at once, so they can be merged into fewer reads.
+	virtual bool ReadBlocksVectored(const BlockRange *ranges, size_t count) {
+		bool success = true;
+		for (size_t i = 0; i < count; ++i) {
+			if (!ReadBlocks(ranges[i].minBlock, ranges[i].count, ranges[i].outPtr))
+				success = false;
+		}
+		return success;
+	}
 	int GetBlockSize() const { return 2048;}  // forced, it cannot be changed by subclasses
 	virtual u32 GetNumBlocks() const = 0;
 	virtual u64 GetUncompressedSize() const {
@@ -68,6 +85,9 @@ class CISOFileBlockDevice : public BlockDevice {
 	bool IsDisc() const override { return true; }
 
 private:
+	bool IsPlainFrame(u32 frame) const;
+	void ReadFramesParallel(u32 minBlock, u32 lastBlock, u8 *outPtr);
+
 	u32 *index;
 	u8 *readBuffer;
 	u8 *zlibBuffer;
@@ -78,6 +98,8 @@ class CISOFileBlockDevice : public BlockDevice {
 	u32 numBlocks;
 	u32 numFrames;
 	int ver_;
+	// Compressed frames for ReadFramesParallel.
+	std::vector<u8> batchBuffer_;
 };
 
 
@@ -87,6 +109,7 @@ class FileBlockDevice : public BlockDevice {
 	~FileBlockDevice();
 	bool ReadBlock(int blockNumber, u8 *outPtr, bool uncached = false) override;
 	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr) override;
+	bool ReadBlocksVectored(const BlockRange *ranges, size_t count) override;
 	u32 GetNumBlocks() const override {return (u32)(filesize_ / GetBlockSize());}
 	bool IsDisc() const override { return true; }
 	u64 GetUncompressedSize() const override {
@@ -148,10 +171,11 @@ class CHDFileBlockDevice : public BlockDevice {
 	bool IsDisc() const override { return true; }
 
 private:
+	const u8 *GetHunk(u32 hunk);
+	void ReadHunksParallel(u32 firstHunk, u32 lastHunk, u8 *outPtr);
+
 	struct ExtendedCoreFile *core_file_ = nullptr;
 	std::unique_ptr<CHDImpl> impl_;
-	u8 *readBuffer = nullptr;
-	u32 currentHunk = 0;
 	u32 blocksPerHunk = 0;
 	u32 numBlocks = 0;
 };
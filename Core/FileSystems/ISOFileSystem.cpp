@@ -19,6 +19,7 @@
 #include <cstdio>
 #include <ctype.h>
 #include <algorithm>
+#include <unordered_set>
 
 #include "Common/CommonTypes.h"
 #include "Common/Serialize/Serializer.h"
@@ -177,6 +178,14 @@ ISOFileSystem::~ISOFileSystem() {
 	delete treeroot;
 }
 
+// Games don't always match the case used on the disc, and the PSP doesn't care.
+static void FoldPathCase(std::string &path) {
+	for (char &c : path) {
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+	}
+}
+
 std::string ISOFileSystem::TreeEntry::BuildPath() {
 	if (parent) {
 		return parent->BuildPath() + "/" + name;
@@ -186,6 +195,14 @@ std::string ISOFileSystem::TreeEntry::BuildPath() {
 }
 
 void ISOFileSystem::ReadDirectory(TreeEntry *root) {
+	std::string keyPrefix = EntryFullPath(root);
+	FoldPathCase(keyPrefix);
+	if (!keyPrefix.empty()) {
+		// Drop the leading slash, and add one for the children.
+		keyPrefix.erase(0, 1);
+		keyPrefix += '/';
+	}
+
 	for (u32 secnum = root->startsector, endsector = root->startsector + (root->dirsize + 2047) / 2048; secnum < endsector; ++secnum) {
 		u8 theSector[2048];
 		if (!blockDevice->ReadBlock(secnum, theSector)) {
@@ -251,6 +268,11 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 				}
 			}
 			root->children.push_back(entry);
+
+			std::string key = keyPrefix + entry->name;
+			FoldPathCase(key);
+			// If two names only differ in case, the first one read wins.
+			pathIndex_.emplace(std::move(key), entry);
 		}
 	}
 	root->valid = true;
@@ -278,46 +300,85 @@ ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bo
 		return treeroot;
 
 	TreeEntry *entry = treeroot;
-	while (true) {
-		if (!entry->valid) {
-			ReadDirectory(entry);
-		}
-		TreeEntry *nextEntry = nullptr;
-		std::string name = "";
-		if (pathLength > pathIndex) {
-			size_t nextSlashIndex = path.find_first_of('/', pathIndex);
+	if (!entry->valid)
+		ReadDirectory(entry);
+
+	std::string key = path.substr(pathIndex);
+	if (key.back() == '/')
+		key.pop_back();
+	FoldPathCase(key);
+
+	auto it = pathIndex_.find(key);
+	if (it == pathIndex_.end()) {
+		// Some directory along the way hasn't been read yet, walk down and read them.
+		size_t keyIndex = 0;
+		while (true) {
+			size_t nextSlashIndex = key.find('/', keyIndex);
 			if (nextSlashIndex == std::string::npos)
-				nextSlashIndex = pathLength;
-
-			const std::string firstPathComponent = path.substr(pathIndex, nextSlashIndex - pathIndex);
-			for (size_t i = 0; i < entry->children.size(); i++) {
-				const std::string &n = entry->children[i]->name;
-				if (firstPathComponent == n) {
-					//yay we got it
-					nextEntry = entry->children[i];
-					name = n;
-					break;
-				}
-			}
+				break;
+
+			auto parentIt = pathIndex_.find(key.substr(0, nextSlashIndex));
+			if (parentIt == pathIndex_.end())
+				break;
+			if (!parentIt->second->valid)
+				ReadDirectory(parentIt->second);
+			keyIndex = nextSlashIndex + 1;
 		}
-		
-		if (nextEntry) {
-			entry = nextEntry;
-			if (!entry->valid)
-				ReadDirectory(entry);
-			pathIndex += name.length();
-			if (pathIndex < pathLength && path[pathIndex] == '/')
-				++pathIndex;
-
-			if (pathLength <= pathIndex)
-				return entry;
-		} else {
-			if (catchError)
-				ERROR_LOG(FILESYS, "File '%s' not found", path.c_str());
+		it = pathIndex_.find(key);
+	}
 
-			return 0;
+	if (it == pathIndex_.end()) {
+		if (catchError)
+			ERROR_LOG(FILESYS, "File '%s' not found", path.c_str());
+		return nullptr;
+	}
+
+	entry = it->second;
+	if (!entry->valid)
+		ReadDirectory(entry);
+	return entry;
+}
+
+ISOFileSystem::TreeEntry *ISOFileSystem::GetFromLBN(u32 sector) {
+	if (!lbnIndexBuilt_) {
+		// Reading the directories here shouldn't count as a seek for the game.
+		const u32 savedLastReadBlock = lastReadBlock_;
+		std::vector<TreeEntry *> pending{ treeroot };
+		std::unordered_set<u32> seenDirectories;
+		while (!pending.empty()) {
+			TreeEntry *dir = pending.back();
+			pending.pop_back();
+			// Corrupt ISOs may have loops, see ReadDirectory.
+			if (!seenDirectories.insert(dir->startsector).second)
+				continue;
+			if (!dir->valid)
+				ReadDirectory(dir);
+
+			for (TreeEntry *child : dir->children) {
+				if (child->name == "." || child->name == "..")
+					continue;
+				if (child->isDirectory) {
+					pending.push_back(child);
+				} else if (child->size > 0) {
+					const u32 sectors = (u32)((child->size + sectorSize - 1) / sectorSize);
+					lbnIndex_.push_back(LBNRange{ child->startsector, child->startsector + sectors, child });
+				}
+			}
 		}
+		std::sort(lbnIndex_.begin(), lbnIndex_.end(), [](const LBNRange &a, const LBNRange &b) {
+			return a.startSector < b.startSector;
+		});
+		lastReadBlock_ = savedLastReadBlock;
+		lbnIndexBuilt_ = true;
 	}
+
+	auto it = std::upper_bound(lbnIndex_.begin(), lbnIndex_.end(), sector, [](u32 sector, const LBNRange &range) {
+		return sector < range.startSector;
+	});
+	if (it == lbnIndex_.begin())
+		return nullptr;
+	--it;
+	return sector < it->endSector ? it->entry : nullptr;
 }
 
 int ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char *devicename) {
@@ -343,7 +404,10 @@ int ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char
 			ERROR_LOG(FILESYS, "Should not be able to open the block after the last on disc! %08x", sectorStart);
 		}
 
-		DEBUG_LOG(FILESYS, "Got a raw sector open: '%s', sector %08x, size %08x", filename.c_str(), sectorStart, readSize);
+		if (MAX_LOGLEVEL >= DEBUG_LEVEL && GenericLogEnabled(LogLevel::LDEBUG, LogType::FILESYS)) {
+			TreeEntry *file = GetFromLBN(sectorStart);
+			DEBUG_LOG(FILESYS, "Got a raw sector open: '%s', sector %08x, size %08x (%s)", filename.c_str(), sectorStart, readSize, file ? EntryFullPath(file).c_str() : "not in a file");
+		}
 		u32 newHandle = hAlloc->GetNewHandle();
 		entry.seekPos = 0;
 		entry.file = 0;
@@ -531,27 +595,37 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
 		const int lastBlockSize = (size - firstBlockSize) & 2047;
 		const s64 middleSize = size - firstBlockSize - lastBlockSize;
 		u32 secNum = (u32)(positionOnIso / 2048);
-		u8 theSector[2048];
+		u8 firstSector[2048];
+		u8 lastSector[2048];
 
 		if ((middleSize & 2047) != 0) {
 			ERROR_LOG(FILESYS, "Remaining size should be aligned");
 		}
 
-		const u8 *const start = pointer;
+		// Read all the sectors in one request, so the device can merge the reads.
+		BlockRange ranges[3];
+		int numRanges = 0;
 		if (firstBlockSize > 0) {
-			blockDevice->ReadBlock(secNum++, theSector);
-			memcpy(pointer, theSector + firstBlockOffset, firstBlockSize);
-			pointer += firstBlockSize;
+			ranges[numRanges++] = BlockRange{ secNum++, 1, firstSector };
 		}
 		if (middleSize > 0) {
 			const u32 sectors = (u32)(middleSize / 2048);
-			blockDevice->ReadBlocks(secNum, sectors, pointer);
+			ranges[numRanges++] = BlockRange{ secNum, (int)sectors, pointer + firstBlockSize };
 			secNum += sectors;
-			pointer += middleSize;
 		}
 		if (lastBlockSize > 0) {
-			blockDevice->ReadBlock(secNum++, theSector);
-			memcpy(pointer, theSector, lastBlockSize);
+			ranges[numRanges++] = BlockRange{ secNum++, 1, lastSector };
+		}
+		blockDevice->ReadBlocksVectored(ranges, numRanges);
+
+		const u8 *const start = pointer;
+		if (firstBlockSize > 0) {
+			memcpy(pointer, firstSector + firstBlockOffset, firstBlockSize);
+			pointer += firstBlockSize;
+		}
+		pointer += middleSize;
+		if (lastBlockSize > 0) {
+			memcpy(pointer, lastSector, lastBlockSize);
 			pointer += lastBlockSize;
 		}
 
@@ -20,6 +20,8 @@
 #include <map>
 #include <list>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "FileSystem.h"
 
@@ -96,8 +98,21 @@ class ISOFileSystem : public IFileSystem {
 
 	TreeEntry entireISO;
 
+	// Every entry read so far, by lowercased full path without the leading slash.
+	std::unordered_map<std::string, TreeEntry *> pathIndex_;
+
+	struct LBNRange {
+		u32 startSector;
+		u32 endSector;
+		TreeEntry *entry;
+	};
+	// All files sorted by start sector. Built the first time it's needed, since that reads the whole tree.
+	std::vector<LBNRange> lbnIndex_;
+	bool lbnIndexBuilt_ = false;
+
 	void ReadDirectory(TreeEntry *root);
 	TreeEntry *GetFromPath(const std::string &path, bool catchError = true);
+	TreeEntry *GetFromLBN(u32 sector);
 	std::string EntryFullPath(TreeEntry *e);
 };
 
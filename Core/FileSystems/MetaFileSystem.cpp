@@ -580,6 +580,18 @@ size_t MetaFileSystem::SeekFile(u32 handle, s32 position, FileMove type)
 		return 0;
 }
 
+size_t MetaFileSystem::PeekFile(u32 handle, u8 *pointer, s64 size, s64 &position)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	IFileSystem *sys = GetHandleOwner(handle);
+	if (!sys)
+		return 0;
+	position = (s64)sys->SeekFile(handle, 0, FILEMOVE_CURRENT);
+	size_t result = sys->ReadFile(handle, pointer, size);
+	sys->SeekFile(handle, (s32)position, FILEMOVE_BEGIN);
+	return result;
+}
+
 int MetaFileSystem::ReadEntireFile(const std::string &filename, std::vector<u8> &data, bool quiet) {
 	FileAccess access = FILEACCESS_READ;
 	if (quiet) {
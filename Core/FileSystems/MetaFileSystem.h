@@ -116,6 +116,8 @@ class MetaFileSystem : public IHandleAllocator, public IFileSystem {
 	inline size_t GetSeekPos(u32 handle) {
 		return SeekFile(handle, 0, FILEMOVE_CURRENT);
 	}
+	// Reads from the current position without moving it, and returns that position.
+	size_t PeekFile(u32 handle, u8 *pointer, s64 size, s64 &position);
 
 	virtual int ChDir(const std::string &dir);
 
@@ -177,6 +177,9 @@ void PGF::DoState(PointerWrap &p) {
 		Do(p, shadowGlyphs);
 	}
 	Do(p, firstGlyph);
+
+	if (p.mode == p.MODE_READ)
+		ClearGlyphCache();
 }
 
 bool PGF::ReadPtr(const u8 *ptr, size_t dataSize) {
@@ -186,6 +189,8 @@ bool PGF::ReadPtr(const u8 *ptr, size_t dataSize) {
 		return false;
 	}
 
+	ClearGlyphCache();
+
 	DEBUG_LOG(SCEFONT, "Reading %d bytes of PGF header", (int)sizeof(header));
 	memcpy(&header, ptr, sizeof(header));
 	ptr += sizeof(header);
@@ -555,6 +560,110 @@ bool PGF::GetCharGlyph(int charCode, int glyphType, Glyph &glyph) const {
 	return true;
 }
 
+const PGF::DecodedGlyph *PGF::GetDecodedGlyph(const Glyph &glyph, int glyphType) const {
+	const u64 key = ((u64)glyphType << 32) | glyph.ptr;
+	auto found = glyphCacheMap_.find(key);
+	if (found != glyphCacheMap_.end()) {
+		const DecodedGlyph &decoded = *found->second;
+		if (decoded.w == glyph.w && decoded.h == glyph.h && decoded.flags == glyph.flags) {
+			glyphCache_.splice(glyphCache_.begin(), glyphCache_, found->second);
+			return &decoded;
+		}
+		glyphCache_.erase(found->second);
+		glyphCacheMap_.erase(found);
+	}
+
+	if (glyphCache_.size() >= MAX_CACHED_GLYPHS) {
+		glyphCacheMap_.erase(glyphCache_.back().key);
+		glyphCache_.pop_back();
+	}
+	glyphCache_.emplace_front();
+	glyphCacheMap_[key] = glyphCache_.begin();
+
+	DecodedGlyph &decoded = glyphCache_.front();
+	decoded.key = key;
+	decoded.w = glyph.w;
+	decoded.h = glyph.h;
+	decoded.flags = glyph.flags;
+	decoded.stride = glyph.w + 2;
+	// Zeros all around, so subpixel blending can read past the edges.
+	decoded.pixels.assign(decoded.stride * (glyph.h + 2), 0);
+	u8 *origin = &decoded.pixels[decoded.stride + 1];
+	const bool vertical = (glyph.flags & FONT_PGF_BMP_OVERLAY) == FONT_PGF_BMP_V_ROWS;
+
+	size_t bitPtr = glyph.ptr * 8;
+	int numberPixels = glyph.w * glyph.h;
+	int pixelIndex = 0;
+	int xx = 0, yy = 0;
+	while (pixelIndex < numberPixels && bitPtr + 8 < fontDataSize * 8) {
+		// This is some kind of nibble based RLE compression.
+		int nibble = consumeBits(4, fontData, bitPtr);
+
+		int count;
+		int value = 0;
+		if (nibble < 8) {
+			value = consumeBits(4, fontData, bitPtr);
+			count = nibble + 1;
+		} else {
+			count = 16 - nibble;
+		}
+
+		for (int i = 0; i < count && pixelIndex < numberPixels; i++) {
+			if (nibble >= 8) {
+				value = consumeBits(4, fontData, bitPtr);
+			}
+
+			// Stored as rows either way, so drawing doesn't care.
+			origin[yy * decoded.stride + xx] = value | (value << 4);
+			pixelIndex++;
+			if (vertical) {
+				if (++yy == glyph.h) {
+					yy = 0;
+					xx++;
+				}
+			} else if (++xx == glyph.w) {
+				xx = 0;
+				yy++;
+			}
+		}
+	}
+
+	return &decoded;
+}
+
+void PGF::ClearGlyphCache() {
+	glyphCache_.clear();
+	glyphCacheMap_.clear();
+}
+
+// Each takes a row of 8-bit pixels, already clipped to the buffer.
+static void WriteFontRow4(u8 *dst, int x, const u8 *src, int count, bool reversed) {
+	// In the natural order, the even pixel is in the low nibble.
+	const int highParity = reversed ? 0 : 1;
+	int i = 0;
+	if ((x & 1) != 0 && count > 0) {
+		u8 *p = dst + (x >> 1);
+		*p = highParity ? (*p & 0x0F) | (src[0] & 0xF0) : (*p & 0xF0) | (src[0] >> 4);
+		i++;
+	}
+	// Now on a byte boundary, so two pixels at a time.
+	u8 *p = dst + ((x + i) >> 1);
+	for (; i + 1 < count; i += 2) {
+		*p++ = highParity ? (src[i + 1] & 0xF0) | (src[i] >> 4) : (src[i] & 0xF0) | (src[i + 1] >> 4);
+	}
+	if (i < count) {
+		*p = highParity ? (*p & 0xF0) | (src[i] >> 4) : (*p & 0x0F) | (src[i] & 0xF0);
+	}
+}
+
+static void WriteFontRowSpread(u8 *dst, const u8 *src, int count, int pixelBytes) {
+	// Each channel has the same value.
+	for (int i = 0; i < count; ++i) {
+		for (int j = 0; j < pixelBytes; ++j)
+			*dst++ = src[i];
+	}
+}
+
 void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipWidth, int clipHeight, int charCode, int altCharCode, int glyphType) const {
 	Glyph glyph;
 	if (!GetCharGlyph(charCode, glyphType, glyph)) {
@@ -580,9 +689,15 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 		return;
 	}
 
-	size_t bitPtr = glyph.ptr * 8;
-	int numberPixels = glyph.w * glyph.h;
-	int pixelIndex = 0;
+	const FontPixelFormat pixelFormat = (FontPixelFormat)(u32)image->pixelFormat;
+	static const u8 fontPixelSizeInBytes[] = { 0, 0, 1, 3, 4 }; // 0 means 2 pixels per byte
+	if (pixelFormat < 0 || pixelFormat > PSP_FONT_PIXELFORMAT_32) {
+		ERROR_LOG_REPORT_ONCE(pfgbadformat, SCEFONT, "Invalid image format in image: %d", (int)pixelFormat);
+		return;
+	}
+	const int pixelBytes = fontPixelSizeInBytes[pixelFormat];
+	const int bpl = image->bytesPerLine;
+	const int bufMaxWidth = pixelBytes == 0 ? bpl * 2 : bpl / pixelBytes;
 
 	int x = image->xPos64 >> 6;
 	int y = image->yPos64 >> 6;
@@ -599,136 +714,65 @@ void PGF::DrawCharacter(const GlyphImage *image, int clipX, int clipY, int clipW
 	if (clipHeight < 0)
 		clipHeight = 8192;
 
-	// Use a buffer so we can apply subpixel rendering.
-	// TODO: Cache this buffer per glyph?  Maybe even transpose it first?
-	std::vector<u8> decodedPixels;
-	decodedPixels.resize(numberPixels);
-
-	while (pixelIndex < numberPixels && bitPtr + 8 < fontDataSize * 8) {
-		// This is some kind of nibble based RLE compression.
-		int nibble = consumeBits(4, fontData, bitPtr);
-
-		int count;
-		int value = 0;
-		if (nibble < 8) {
-			value = consumeBits(4, fontData, bitPtr);
-			count = nibble + 1;
-		} else {
-			count = 16 - nibble;
-		}
-
-		for (int i = 0; i < count && pixelIndex < numberPixels; i++) {
-			if (nibble >= 8) {
-				value = consumeBits(4, fontData, bitPtr);
-			}
-
-			decodedPixels[pixelIndex++] = value | (value << 4);
-		}
-	}
-
-	auto samplePixel = [&](int xx, int yy) -> u8 {
-		if (xx < 0 || yy < 0 || xx >= glyph.w || yy >= glyph.h) {
-			return 0;
-		}
-
-		int index;
-		if ((glyph.flags & FONT_PGF_BMP_OVERLAY) == FONT_PGF_BMP_H_ROWS) {
-			index = yy * glyph.w + xx;
-		} else {
-			index = xx * glyph.h + yy;
-		}
-
-		return decodedPixels[index];
-	};
-
 	int renderX1 = std::max(clipX, x) - x;
 	int renderY1 = std::max(clipY, y) - y;
 	// We can render up to frac beyond the glyph w/h, so add 1px if necessary.
 	int renderX2 = std::min(clipX + clipWidth - x, glyph.w + (xFrac > 0 ? 1 : 0));
 	int renderY2 = std::min(clipY + clipHeight - y, glyph.h + (yFrac > 0 ? 1 : 0));
+	// And to the buffer, so rows can be written without checking each pixel.
+	renderX1 = std::max(renderX1, -x);
+	renderY1 = std::max(renderY1, -y);
+	renderX2 = std::min(renderX2, std::min((int)image->bufWidth, bufMaxWidth) - x);
+	renderY2 = std::min(renderY2, (int)image->bufHeight - y);
+	if (renderX1 >= renderX2 || renderY1 >= renderY2)
+		return;
 
-	if (xFrac == 0 && yFrac == 0) {
-		for (int yy = renderY1; yy < renderY2; ++yy) {
-			for (int xx = renderX1; xx < renderX2; ++xx) {
-				u8 pixelColor = samplePixel(xx, yy);
-				SetFontPixel(image->bufferPtr, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, pixelColor, (FontPixelFormat)(u32)image->pixelFormat);
-			}
-		}
-	} else {
-		for (int yy = renderY1; yy < renderY2; ++yy) {
-			for (int xx = renderX1; xx < renderX2; ++xx) {
+	const DecodedGlyph *decoded = GetDecodedGlyph(glyph, glyphType);
+	const u8 *origin = &decoded->pixels[decoded->stride + 1];
+	const int stride = decoded->stride;
+	const int count = renderX2 - renderX1;
+	const int dstX = x + renderX1;
+	const u32 rowOffset = pixelBytes == 0 ? dstX / 2 : dstX * pixelBytes;
+	const u32 rowBytes = pixelBytes == 0 ? (dstX + count + 1) / 2 - dstX / 2 : count * pixelBytes;
+
+	u8 blended[256];
+	_dbg_assert_(count <= (int)sizeof(blended));
+	for (int yy = renderY1; yy < renderY2; ++yy) {
+		const u32 rowAddr = image->bufferPtr + (y + yy) * bpl;
+		if (!Memory::IsValidRange(rowAddr + rowOffset, rowBytes))
+			continue;
+
+		const u8 *src = origin + yy * stride + renderX1;
+		if (xFrac != 0 || yFrac != 0) {
+			const u8 *above = src - stride;
+			for (int i = 0; i < count; ++i) {
 				// First, blend horizontally.  Tests show we blend swizzled to 8 bit.
-				u32 horiz1 = samplePixel(xx - 1, yy - 1) * xFrac + samplePixel(xx, yy - 1) * (64 - xFrac);
-				u32 horiz2 = samplePixel(xx - 1, yy + 0) * xFrac + samplePixel(xx, yy + 0) * (64 - xFrac);
+				u32 horiz1 = above[i - 1] * xFrac + above[i] * (64 - xFrac);
+				u32 horiz2 = src[i - 1] * xFrac + src[i] * (64 - xFrac);
 				// Now blend those together vertically.
-				u32 blended = horiz1 * yFrac + horiz2 * (64 - yFrac);
+				u32 result = horiz1 * yFrac + horiz2 * (64 - yFrac);
 
 				// We multiplied an 8 bit value by 64 twice, so now we have a 20 bit value.
-				u8 pixelColor = blended >> 12;
-				SetFontPixel(image->bufferPtr, image->bytesPerLine, image->bufWidth, image->bufHeight, x + xx, y + yy, pixelColor, (FontPixelFormat)(u32)image->pixelFormat);
+				blended[i] = result >> 12;
 			}
+			src = blended;
 		}
-	}
-
-	gpu->InvalidateCache(image->bufferPtr, image->bytesPerLine * image->bufHeight, GPU_INVALIDATE_SAFE);
-}
-
-void PGF::SetFontPixel(u32 base, int bpl, int bufWidth, int bufHeight, int x, int y, u8 pixelColor, FontPixelFormat pixelformat) const {
-	if (x < 0 || x >= bufWidth || y < 0 || y >= bufHeight) {
-		return;
-	}
-
-	static const u8 fontPixelSizeInBytes[] = { 0, 0, 1, 3, 4 }; // 0 means 2 pixels per byte
-	if (pixelformat < 0 || pixelformat > PSP_FONT_PIXELFORMAT_32) {
-		ERROR_LOG_REPORT_ONCE(pfgbadformat, SCEFONT, "Invalid image format in image: %d", (int)pixelformat);
-		return;
-	}
-	int pixelBytes = fontPixelSizeInBytes[pixelformat];
-	int bufMaxWidth = (pixelBytes == 0 ? bpl * 2 : bpl / pixelBytes);
-	if (x >= bufMaxWidth) {
-		return;
-	}
 
-	int framebufferAddr = base + (y * bpl) + (pixelBytes == 0 ? x / 2 : x * pixelBytes);
-
-	switch (pixelformat) {
-	case PSP_FONT_PIXELFORMAT_4:
-	case PSP_FONT_PIXELFORMAT_4_REV:
-		{
-			// We always get a 8-bit value, so take only the top 4 bits.
-			const u8 pix4 = pixelColor >> 4;
-
-			int oldColor = Memory::Read_U8(framebufferAddr);
-			int newColor;
-			if ((x & 1) != pixelformat) {
-				newColor = (pix4 << 4) | (oldColor & 0xF);
-			} else {
-				newColor = (oldColor & 0xF0) | pix4;
-			}
-			Memory::Write_U8(newColor, framebufferAddr);
+		u8 *dst = Memory::GetPointerWriteUnchecked(rowAddr);
+		switch (pixelFormat) {
+		case PSP_FONT_PIXELFORMAT_4:
+		case PSP_FONT_PIXELFORMAT_4_REV:
+			WriteFontRow4(dst, dstX, src, count, pixelFormat == PSP_FONT_PIXELFORMAT_4_REV);
 			break;
-		}
-	case PSP_FONT_PIXELFORMAT_8:
-		{
-			Memory::Write_U8(pixelColor, framebufferAddr);
+		case PSP_FONT_PIXELFORMAT_8:
+			memcpy(dst + rowOffset, src, count);
 			break;
-		}
-	case PSP_FONT_PIXELFORMAT_24:
-		{
-			// Each channel has the same value.
-			Memory::Write_U8(pixelColor, framebufferAddr + 0);
-			Memory::Write_U8(pixelColor, framebufferAddr + 1);
-			Memory::Write_U8(pixelColor, framebufferAddr + 2);
-			break;
-		}
-	case PSP_FONT_PIXELFORMAT_32:
-		{
-			// Spread the 8 bits out into one write of 32 bits.
-			u32 pix32 = pixelColor;
-			pix32 |= pix32 << 8;
-			pix32 |= pix32 << 16;
-			Memory::Write_U32(pix32, framebufferAddr);
+		default:
+			WriteFontRowSpread(dst + rowOffset, src, count, pixelBytes);
 			break;
 		}
 	}
+
+	if (gpu)
+		gpu->InvalidateCache(image->bufferPtr, image->bytesPerLine * image->bufHeight, GPU_INVALIDATE_SAFE);
 }
@@ -19,10 +19,13 @@
 
 #pragma once
 
+#include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Common/CommonTypes.h"
+#include "Common/Swap.h"
 
 class PointerWrap;
 
@@ -280,7 +283,18 @@ class PGF {
 	// Unused
 	int GetCharIndex(int charCode, const std::vector<int> &charmapCompressed);
 
-	void SetFontPixel(u32 base, int bpl, int bufWidth, int bufHeight, int x, int y, u8 pixelColor, FontPixelFormat pixelformat) const;
+	// A glyph's bitmap after RLE decoding, as 8-bit rows with a blank border.
+	struct DecodedGlyph {
+		u64 key;
+		int w;
+		int h;
+		int flags;
+		int stride;
+		std::vector<u8> pixels;
+	};
+
+	const DecodedGlyph *GetDecodedGlyph(const Glyph &glyph, int glyphType) const;
+	void ClearGlyphCache();
 
 	PGFHeaderRev3Extra rev3extra;
 
@@ -305,4 +319,9 @@ class PGF {
 	std::vector<Glyph> glyphs;
 	std::vector<Glyph> shadowGlyphs;
 	int firstGlyph;
+
+	// Most recently drawn first.  Games redraw the same text every frame.
+	enum { MAX_CACHED_GLYPHS = 1024 };
+	mutable std::list<DecodedGlyph> glyphCache_;
+	mutable std::unordered_map<u64, std::list<DecodedGlyph>::iterator> glyphCacheMap_;
 };
@@ -15,13 +15,17 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <cmath>
 #include <cstdarg>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <string>
 
 #include "Common/Profiler/Profiler.h"
 
+#include "Common/BitScan.h"
 #include "Common/Log.h"
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/TimeUtil.h"
@@ -114,6 +118,128 @@ void hleDelayResultFinish(u64 userdata, int cycleslate)
 		WARN_LOG(HLE, "Someone else woke up HLE-blocked thread %d?", threadID);
 }
 
+// Buckets are powers of two (in ns) split in quarters, so percentiles are off by at most 25%.
+static const int SYSCALL_HISTOGRAM_BUCKETS = 4 * 31;
+
+struct SyscallHistogram {
+	const char *module = nullptr;
+	const char *name = nullptr;
+	u64 calls = 0;
+	u64 cycles = 0;
+	u64 totalNs = 0;
+	u64 maxNs = 0;
+	u32 buckets[SYSCALL_HISTOGRAM_BUCKETS]{};
+
+	void Add(u64 ns, u64 callCycles) {
+		u32 clamped = (u32)std::min(ns, (u64)0xFFFFFFFF);
+		int bucket = (int)clamped;
+		if (clamped >= 4) {
+			int e = 31 - clz32_nonzero(clamped);
+			bucket = 4 * (e - 1) + ((clamped >> (e - 2)) & 3);
+		}
+		buckets[bucket]++;
+		calls++;
+		cycles += callCycles;
+		totalNs += ns;
+		maxNs = std::max(maxNs, ns);
+	}
+
+	void Merge(const SyscallHistogram &other) {
+		module = other.module;
+		name = other.name;
+		calls += other.calls;
+		cycles += other.cycles;
+		totalNs += other.totalNs;
+		maxNs = std::max(maxNs, other.maxNs);
+		for (int i = 0; i < SYSCALL_HISTOGRAM_BUCKETS; ++i)
+			buckets[i] += other.buckets[i];
+	}
+
+	double Percentile(double p) const {
+		u64 target = std::max((u64)1, (u64)ceil(calls * p));
+		u64 seen = 0;
+		for (int i = 0; i < SYSCALL_HISTOGRAM_BUCKETS; ++i) {
+			seen += buckets[i];
+			if (seen >= target) {
+				// Report the top of the bucket, but never more than we've actually seen.
+				u64 top = i < 4 ? i + 1 : (u64)(5 + (i & 3)) << (i / 4 - 1);
+				return std::min(top, maxNs) * 1e-9;
+			}
+		}
+		return maxNs * 1e-9;
+	}
+};
+
+// Syscalls only run on the emu thread, so this frame's calls are recorded without any locking.
+// Once a frame they're merged into the totals, which are what other threads read.
+static std::vector<std::vector<SyscallHistogram>> syscallFrameStats;
+static std::vector<u32> syscallFrameDirty;
+static std::mutex syscallTotalsLock;
+static std::map<u32, SyscallHistogram> syscallTotals;
+static int syscallTotalsFrames = 0;
+
+static void recordSyscallHistogram(int modulenum, int funcnum, double total, u64 cycles) {
+	if (modulenum >= (int)syscallFrameStats.size())
+		syscallFrameStats.resize(moduleDB.size());
+	std::vector<SyscallHistogram> &moduleStats = syscallFrameStats[modulenum];
+	if (moduleStats.empty())
+		moduleStats.resize(moduleDB[modulenum].numFunctions);
+
+	SyscallHistogram &stats = moduleStats[funcnum];
+	if (stats.calls == 0) {
+		stats.module = moduleDB[modulenum].name;
+		stats.name = moduleDB[modulenum].funcTable[funcnum].name;
+		syscallFrameDirty.push_back((modulenum << 12) | funcnum);
+	}
+	stats.Add((u64)(total * 1e9), cycles);
+}
+
+void hleFlushSyscallStats() {
+	if (syscallFrameDirty.empty())
+		return;
+
+	std::lock_guard<std::mutex> guard(syscallTotalsLock);
+	for (u32 callno : syscallFrameDirty) {
+		SyscallHistogram &stats = syscallFrameStats[callno >> 12][callno & 0xFFF];
+		syscallTotals[callno].Merge(stats);
+		stats = SyscallHistogram();
+	}
+	syscallFrameDirty.clear();
+	syscallTotalsFrames++;
+}
+
+std::vector<HLESyscallStats> hleGetSyscallStats(int *frames) {
+	std::vector<HLESyscallStats> result;
+	std::lock_guard<std::mutex> guard(syscallTotalsLock);
+	result.reserve(syscallTotals.size());
+	for (const auto &it : syscallTotals) {
+		const SyscallHistogram &stats = it.second;
+		HLESyscallStats s;
+		s.module = stats.module;
+		s.name = stats.name;
+		s.calls = stats.calls;
+		s.cycles = stats.cycles;
+		s.totalTime = stats.totalNs * 1e-9;
+		s.maxTime = stats.maxNs * 1e-9;
+		s.p50Time = stats.Percentile(0.5);
+		s.p99Time = stats.Percentile(0.99);
+		result.push_back(s);
+	}
+	if (frames)
+		*frames = syscallTotalsFrames;
+
+	std::sort(result.begin(), result.end(), [](const HLESyscallStats &a, const HLESyscallStats &b) {
+		return a.totalTime > b.totalTime;
+	});
+	return result;
+}
+
+void hleResetSyscallStats() {
+	std::lock_guard<std::mutex> guard(syscallTotalsLock);
+	syscallTotals.clear();
+	syscallTotalsFrames = 0;
+}
+
 void HLEInit() {
 	RegisterAllModules();
 	delayedResultEvent = CoreTiming::RegisterEvent("HLEDelayedResult", hleDelayResultFinish);
@@ -151,6 +277,9 @@ void HLEDoState(PointerWrap &p) {
 }
 
 void HLEShutdown() {
+	// The totals outlive the game, so they can still be read after it exits.
+	hleFlushSyscallStats();
+	syscallFrameStats.clear();
 	hleAfterSyscall = HLE_AFTER_NOTHING;
 	latestSyscall = nullptr;
 	latestSyscallPC = 0;
@@ -589,13 +718,15 @@ inline void hleFinishSyscall(const HLEFunction &info)
 	hleAfterSyscallReschedReason = 0;
 }
 
-static void updateSyscallStats(int modulenum, int funcnum, double total)
+static void updateSyscallStats(int modulenum, int funcnum, double total, u64 cycles)
 {
 	const char *name = moduleDB[modulenum].funcTable[funcnum].name;
 	// Ignore this one, especially for msInSyscalls (although that ignores CoreTiming events.)
 	if (0 == strcmp(name, "_sceKernelIdle"))
 		return;
 
+	recordSyscallHistogram(modulenum, funcnum, total, cycles);
+
 	if (total > kernelStats.slowestSyscallTime)
 	{
 		kernelStats.slowestSyscallTime = total;
@@ -715,8 +846,10 @@ void CallSyscall(MIPSOpcode op)
 {
 	PROFILE_THIS_SCOPE("syscall");
 	double start = 0.0;  // need to initialize to fix the race condition where coreCollectDebugStats is enabled in the middle of this func.
+	s64 startTicks = 0;
 	if (coreCollectDebugStats) {
 		start = time_now_d();
+		startTicks = CoreTiming::GetTicks();
 	}
 
 	const HLEFunction *info = GetSyscallFuncPointer(op);
@@ -748,7 +881,9 @@ void CallSyscall(MIPSOpcode op)
 		_dbg_assert_msg_(total >= 0.0, "Time spent in syscall became negative");
 		hleSteppingTime = 0.0;
 		hleFlipTime = 0.0;
-		updateSyscallStats(modulenum, funcnum, total);
+		// Started mid-call, so there's no start to compare with.
+		if (startTicks != 0)
+			updateSyscallStats(modulenum, funcnum, total, CoreTiming::GetTicks() - startTicks);
 	}
 }
 
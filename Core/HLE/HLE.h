@@ -20,6 +20,7 @@
 #include <cstdio>
 #include <cstdarg>
 #include <type_traits>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Common/Log.h"
@@ -155,6 +156,26 @@ const HLEFunction *GetSyscallFuncPointer(MIPSOpcode op);
 // For jit, takes arg: const HLEFunction *
 void *GetQuickSyscallFunc(MIPSOpcode op);
 
+// Per-function totals, collected while debug stats are on (see Core_ForceDebugStats.)
+struct HLESyscallStats {
+	const char *module;
+	const char *name;
+	u64 calls;
+	// Emulated cycles, including any the call ate.
+	u64 cycles;
+	// Host seconds.
+	double totalTime;
+	double maxTime;
+	double p50Time;
+	double p99Time;
+};
+
+// Called once a frame on the emu thread, to publish what was collected.
+void hleFlushSyscallStats();
+// Sorted by total time, most expensive first.  Safe from any thread.
+std::vector<HLESyscallStats> hleGetSyscallStats(int *frames = nullptr);
+void hleResetSyscallStats();
+
 void hleDoLogInternal(LogType t, LogLevel level, u64 res, const char *file, int line, const char *reportTag, char retmask, const char *reason, const char *formatted_reason);
 
 template <typename T>
@@ -700,6 +700,7 @@ void hleAfterFlip(u64 userdata, int cyclesLate) {
 	gpu->PSPFrame();
 
 	PPGeNotifyFrame();
+	hleFlushSyscallStats();
 
 	// This seems like as good a time as any to check if the config changed.
 	if (lagSyncScheduled != UseLagSync()) {
@@ -403,6 +403,7 @@ static void __IoFreeFd(int fd, u32 &error) {
 			// Discard any pending results.
 			AsyncIOResult managerResult;
 			ioManager.WaitResult(f->handle, managerResult);
+			ioManager.ForgetHandle(f->handle);
 
 			IoAsyncCleanupThread(fd);
 		}
@@ -1095,6 +1096,7 @@ static bool __IoRead(int &result, int id, u32 data_addr, int size, int &us) {
 				ev.buf = data;
 				ev.bytes = validSize;
 				ev.invalidateAddr = data_addr;
+				ev.ordered = GetIOTimingMethod() == IOTIMING_REALISTIC;
 				ioManager.ScheduleOperation(ev);
 				return false;
 			} else {
@@ -1233,6 +1235,7 @@ static bool __IoWrite(int &result, int id, u32 data_addr, int size, int &us) {
 			ev.buf = (u8 *) data_ptr;
 			ev.bytes = validSize;
 			ev.invalidateAddr = 0;
+			ev.ordered = GetIOTimingMethod() == IOTIMING_REALISTIC;
 			ioManager.ScheduleOperation(ev);
 			return false;
 		} else {
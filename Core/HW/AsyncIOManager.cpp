@@ -15,19 +15,44 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <condition_variable>
+#include <cstring>
+#include <map>
 #include <mutex>
+#include <set>
 
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/Serialize/SerializeMap.h"
 #include "Common/Serialize/SerializeSet.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/Reporting.h"
 #include "Core/System.h"
 #include "Core/HW/AsyncIOManager.h"
 #include "Core/FileSystems/MetaFileSystem.h"
 
+// Read-ahead kicks in after this many back to back reads on a handle.
+#define READAHEAD_MIN_SEQUENTIAL 2
+#define READAHEAD_MAX_BYTES (512 * 1024)
+
+class IOLaneTask : public Task {
+public:
+	IOLaneTask(AsyncIOManager *manager, u32 handle) : manager_(manager), handle_(handle) {}
+
+	TaskType Type() const override { return TaskType::IO_BLOCKING; }
+	TaskPriority Priority() const override { return TaskPriority::NORMAL; }
+
+	void Run() override {
+		manager_->RunLane(handle_);
+	}
+
+private:
+	AsyncIOManager *manager_;
+	u32 handle_;
+};
+
 bool AsyncIOManager::HasOperation(u32 handle) {
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	if (resultsPending_.find(handle) != resultsPending_.end()) {
@@ -49,7 +74,29 @@ void AsyncIOManager::ScheduleOperation(const AsyncIOEvent &ev) {
 	ScheduleEvent(ev);
 }
 
+void AsyncIOManager::SyncThread(bool force) {
+	IOThreadEventQueue::SyncThread(force);
+	WaitLanes();
+}
+
+void AsyncIOManager::ForgetHandle(u32 handle) {
+	std::lock_guard<std::mutex> guard(lanesLock_);
+	auto it = lanes_.find(handle);
+	if (it == lanes_.end())
+		return;
+	if (it->second.running)
+		it->second.forget = true;
+	else
+		lanes_.erase(it);
+}
+
 void AsyncIOManager::Shutdown() {
+	WaitLanes();
+	{
+		std::lock_guard<std::mutex> guard(lanesLock_);
+		lanes_.clear();
+	}
+
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	resultsPending_.clear();
 	results_.clear();
@@ -62,9 +109,10 @@ bool AsyncIOManager::HasResult(u32 handle) {
 
 bool AsyncIOManager::PopResult(u32 handle, AsyncIOResult &result) {
 	// This is called under lock from WaitResult, no need to lock again.
-	if (results_.find(handle) != results_.end()) {
-		result = results_[handle];
-		results_.erase(handle);
+	auto it = results_.find(handle);
+	if (it != results_.end()) {
+		result = it->second;
+		results_.erase(it);
 		resultsPending_.erase(handle);
 
 		if (result.invalidateAddr && result.result > 0) {
@@ -78,8 +126,9 @@ bool AsyncIOManager::PopResult(u32 handle, AsyncIOResult &result) {
 
 bool AsyncIOManager::ReadResult(u32 handle, AsyncIOResult &result) {
 	// This is called under lock from WaitResult, no need to lock again.
-	if (results_.find(handle) != results_.end()) {
-		result = results_[handle];
+	auto it = results_.find(handle);
+	if (it != results_.end()) {
+		result = it->second;
 		return true;
 	} else {
 		return false;
@@ -89,7 +138,7 @@ bool AsyncIOManager::ReadResult(u32 handle, AsyncIOResult &result) {
 bool AsyncIOManager::WaitResult(u32 handle, AsyncIOResult &result) {
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || LaneBusy(handle)) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (PopResult(handle, result)) {
 			return true;
 		}
@@ -103,7 +152,7 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 
 	std::unique_lock<std::mutex> guard(resultsLock_);
 	ScheduleEvent(IO_EVENT_SYNC);
-	while (HasEvents() && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
+	while ((HasEvents() || LaneBusy(handle)) && ThreadEnabled() && resultsPending_.find(handle) != resultsPending_.end()) {
 		if (ReadResult(handle, result)) {
 			return result.finishTicks;
 		}
@@ -119,11 +168,18 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
 	switch (ev.type) {
 	case IO_EVENT_READ:
-		Read(ev.handle, ev.buf, ev.bytes, ev.invalidateAddr);
-		break;
-
 	case IO_EVENT_WRITE:
-		Write(ev.handle, ev.buf, ev.bytes);
+		if (!ev.ordered && ThreadEnabled() && g_threadManager.IsInitialized()) {
+			StartOnLane(ev);
+			break;
+		}
+
+		// Don't let this overtake anything still running on a lane.
+		WaitLanes();
+		if (ev.type == IO_EVENT_READ)
+			Read(ev.handle, ev.buf, ev.bytes, ev.invalidateAddr);
+		else
+			Write(ev.handle, ev.buf, ev.bytes);
 		break;
 
 	default:
@@ -143,6 +199,101 @@ void AsyncIOManager::Write(u32 handle, const u8 *buf, size_t bytes) {
 	EventResult(handle, AsyncIOResult(result, usec));
 }
 
+void AsyncIOManager::StartOnLane(const AsyncIOEvent &ev) {
+	{
+		std::lock_guard<std::mutex> guard(lanesLock_);
+		IOLane &lane = lanes_[ev.handle];
+		lane.queue.push_back(ev);
+		// The running task will get to it, which keeps the order per handle.
+		if (lane.running)
+			return;
+		lane.running = true;
+		activeLanes_++;
+	}
+	g_threadManager.EnqueueTask(new IOLaneTask(this, ev.handle));
+}
+
+void AsyncIOManager::RunLane(u32 handle) {
+	std::unique_lock<std::mutex> guard(lanesLock_);
+	// References to map elements stay valid as others are added.
+	IOLane &lane = lanes_[handle];
+	while (!lane.queue.empty()) {
+		AsyncIOEvent ev = lane.queue.front();
+		lane.queue.pop_front();
+		guard.unlock();
+
+		if (ev.type == IO_EVENT_READ) {
+			LaneRead(lane, ev);
+		} else {
+			lane.readAhead.clear();
+			lane.nextPos = -1;
+			Write(ev.handle, ev.buf, ev.bytes);
+		}
+
+		guard.lock();
+	}
+
+	lane.running = false;
+	if (lane.forget)
+		lanes_.erase(handle);
+	activeLanes_--;
+	lanesWait_.notify_all();
+}
+
+void AsyncIOManager::LaneRead(IOLane &lane, const AsyncIOEvent &ev) {
+	int usec = 0;
+	s64 pos = (s64)pspFileSystem.GetSeekPos(ev.handle);
+
+	// Only for the disc, since nothing can change the data under us there.
+	// Not for raw umd0: style handles either, which count sizes and positions in sectors.
+	IFileSystem *sys = pspFileSystem.GetHandleOwner(ev.handle);
+	const bool canReadAhead = sys && (sys->Flags() & FileSystemFlags::UMD) && !(pspFileSystem.DevType(ev.handle) & PSPDevType::BLOCK);
+
+	// Nothing else moves the position while the operation is pending, so this can stand in for the read.
+	size_t fromBuffer = 0;
+	if (canReadAhead && pos >= lane.readAheadPos && pos < lane.readAheadPos + (s64)lane.readAhead.size()) {
+		size_t offset = (size_t)(pos - lane.readAheadPos);
+		fromBuffer = std::min(ev.bytes, lane.readAhead.size() - offset);
+		memcpy(ev.buf, &lane.readAhead[offset], fromBuffer);
+		pspFileSystem.SeekFile(ev.handle, (s32)(pos + fromBuffer), FILEMOVE_BEGIN);
+	}
+
+	s64 result = fromBuffer;
+	if (fromBuffer < ev.bytes) {
+		size_t rest = pspFileSystem.ReadFile(ev.handle, ev.buf + fromBuffer, ev.bytes - fromBuffer, usec);
+		if (fromBuffer == 0)
+			result = rest;
+		else if (rest <= ev.bytes - fromBuffer)
+			result += rest;
+	}
+
+	lane.sequentialReads = pos == lane.nextPos ? lane.sequentialReads + 1 : 0;
+	lane.nextPos = pos + std::max(result, (s64)0);
+	EventResult(ev.handle, AsyncIOResult(result, usec, ev.invalidateAddr));
+
+	// While the game is busy with this data, fetch the next chunk of a sequential stream.
+	s64 buffered = lane.readAheadPos + (s64)lane.readAhead.size() - lane.nextPos;
+	if (!canReadAhead || lane.sequentialReads < READAHEAD_MIN_SEQUENTIAL || result != (s64)ev.bytes || buffered >= (s64)ev.bytes)
+		return;
+
+	size_t size = std::min(ev.bytes * 2, (size_t)READAHEAD_MAX_BYTES);
+	lane.readAhead.resize(size);
+	size_t read = pspFileSystem.PeekFile(ev.handle, lane.readAhead.data(), size, lane.readAheadPos);
+	lane.readAhead.resize(read <= size ? read : 0);
+}
+
+bool AsyncIOManager::LaneBusy(u32 handle) {
+	std::lock_guard<std::mutex> guard(lanesLock_);
+	auto it = lanes_.find(handle);
+	return it != lanes_.end() && it->second.running;
+}
+
+void AsyncIOManager::WaitLanes() {
+	std::unique_lock<std::mutex> guard(lanesLock_);
+	while (activeLanes_ > 0)
+		lanesWait_.wait(guard);
+}
+
 void AsyncIOManager::EventResult(u32 handle, const AsyncIOResult &result) {
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	if (results_.find(handle) != results_.end()) {
@@ -158,15 +309,29 @@ void AsyncIOManager::DoState(PointerWrap &p) {
 		return;
 
 	SyncThread();
+	if (p.mode == PointerWrap::MODE_READ) {
+		// File positions are about to change.
+		std::lock_guard<std::mutex> guard(lanesLock_);
+		lanes_.clear();
+	}
+
 	std::lock_guard<std::mutex> guard(resultsLock_);
-	Do(p, resultsPending_);
+	// Sorted, to keep the same layout as before.
+	std::set<u32> pending(resultsPending_.begin(), resultsPending_.end());
+	std::map<u32, AsyncIOResult> results(results_.begin(), results_.end());
+	Do(p, pending);
 	if (s >= 2) {
-		Do(p, results_);
+		Do(p, results);
 	} else {
 		std::map<u32, size_t> oldResults;
 		Do(p, oldResults);
 		for (auto it = oldResults.begin(), end = oldResults.end(); it != end; ++it) {
-			results_[it->first] = AsyncIOResult(it->second);
+			results[it->first] = AsyncIOResult(it->second);
 		}
 	}
+
+	if (p.mode == PointerWrap::MODE_READ) {
+		resultsPending_ = std::unordered_set<u32>(pending.begin(), pending.end());
+		results_ = std::unordered_map<u32, AsyncIOResult>(results.begin(), results.end());
+	}
 }
@@ -17,10 +17,15 @@
 
 #pragma once
 
-#include <map>
-#include <set>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "Common/Serialize/Serializer.h"
+#include "Common/Serialize/SerializeFuncs.h"
 #include "Core/ThreadEventQueue.h"
 
 class NoBase {
@@ -41,6 +46,9 @@ struct AsyncIOEvent {
 	u8 *buf;
 	size_t bytes;
 	u32 invalidateAddr;
+	// Ordered operations run one at a time in the order scheduled, which keeps their timing deterministic.
+	// Others run on a lane per handle, in parallel with other handles.
+	bool ordered = true;
 
 	operator AsyncIOEventType() const {
 		return type;
@@ -84,12 +92,19 @@ class AsyncIOManager : public IOThreadEventQueue {
 
 	bool HasOperation(u32 handle);
 	void ScheduleOperation(const AsyncIOEvent &ev);
+	// Unlike the queue's version, this also waits for operations running on lanes.
+	void SyncThread(bool force = false);
+	// Drops any read-ahead data, call when closing the file.
+	void ForgetHandle(u32 handle);
 	void Shutdown();
 
 	bool HasResult(u32 handle);
 	bool WaitResult(u32 handle, AsyncIOResult &result);
 	u64 ResultFinishTicks(u32 handle);
 
+	// Runs the queued operations for a handle, from a task on the thread manager.
+	void RunLane(u32 handle);
+
 protected:
 	void ProcessEvent(AsyncIOEvent ref) override;
 	bool ShouldExitEventLoop() override {
@@ -97,15 +112,37 @@ class AsyncIOManager : public IOThreadEventQueue {
 	}
 
 private:
+	struct IOLane {
+		std::deque<AsyncIOEvent> queue;
+		bool running = false;
+		bool forget = false;
+
+		// Only touched by the task running the lane.
+		s64 nextPos = -1;
+		int sequentialReads = 0;
+		s64 readAheadPos = 0;
+		std::vector<u8> readAhead;
+	};
+
 	bool PopResult(u32 handle, AsyncIOResult &result);
 	bool ReadResult(u32 handle, AsyncIOResult &result);
 	void Read(u32 handle, u8 *buf, size_t bytes, u32 invalidateAddr);
 	void Write(u32 handle, const u8 *buf, size_t bytes);
+	void StartOnLane(const AsyncIOEvent &ev);
+	void LaneRead(IOLane &lane, const AsyncIOEvent &ev);
+	bool LaneBusy(u32 handle);
+	void WaitLanes();
 
 	void EventResult(u32 handle, const AsyncIOResult &result);
 
 	std::mutex resultsLock_;
 	std::condition_variable resultsWait_;
-	std::set<u32> resultsPending_;
-	std::map<u32, AsyncIOResult> results_;
+	std::unordered_set<u32> resultsPending_;
+	std::unordered_map<u32, AsyncIOResult> results_;
+
+	// Never taken before resultsLock_.
+	std::mutex lanesLock_;
+	std::condition_variable lanesWait_;
+	std::unordered_map<u32, IOLane> lanes_;
+	int activeLanes_ = 0;
 };
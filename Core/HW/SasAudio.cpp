@@ -15,9 +15,14 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include "ppsspp_config.h"
+
 #include <algorithm>
+#include <cstring>
 
+#include "Common/CPUDetect.h"
 #include "Common/Profiler/Profiler.h"
+#include "Common/Thread/ParallelLoop.h"
 
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Core/MemMapHelpers.h"
@@ -28,8 +33,25 @@
 #include "Core/Core.h"
 #include "SasAudio.h"
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#include <smmintrin.h>
+#endif
+
+#if PPSSPP_ARCH(ARM_NEON)
+#if defined(_MSC_VER) && PPSSPP_ARCH(ARM64)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
 // #define AUDIO_TO_FILE
 
+// Below this many samples per grain across all voices, rendering them on other threads isn't worth it.
+static const int SAS_PARALLEL_MIN_SAMPLES = 16384;
+static const int SAS_PARALLEL_MIN_VOICES = 4;
+
 static const u8 f[16][2] = {
 	{   0,   0 },
 	{  60,   0 },
@@ -525,108 +547,223 @@ bool SasVoice::HaveSamplesEnded() const {
 	}
 }
 
-void SasInstance::MixVoice(SasVoice &voice) {
+// Renders grainSize resampled samples and 14-bit envelope volumes for the voice, and advances its state.
+// Only touches the voice itself (and for ATRAC3, sceAtrac), so independent voices may render in parallel.
+bool SasInstance::RenderVoice(SasVoice &voice, int16_t *temp, int *samples, int *volumes) const {
 	switch (voice.type) {
 	case VOICETYPE_VAG:
-		if (voice.type == VOICETYPE_VAG && !voice.vagAddr)
-			break;
-		// else fallthrough! Don't change the check above.
+		if (!voice.vagAddr)
+			return false;
+		break;
 	case VOICETYPE_PCM:
-		if (voice.type == VOICETYPE_PCM && !voice.pcmAddr)
-			break;
-		// else fallthrough! Don't change the check above.
+		if (!voice.pcmAddr)
+			return false;
+		break;
 	default:
-		// This feels a bit hacky.  The first 32 samples after a keyon are 0s.
-		int delay = 0;
-		if (voice.envelope.NeedsKeyOn()) {
-			const bool ignorePitch = voice.type == VOICETYPE_PCM && voice.pitch > PSP_SAS_PITCH_BASE;
-			delay = ignorePitch ? 32 : (32 * (u32)voice.pitch) >> PSP_SAS_PITCH_BASE_SHIFT;
-			// VAG seems to have an extra sample delay (not shared by PCM.)
-			if (voice.type == VOICETYPE_VAG)
-				++delay;
-		}
-
-		// Resample to the correct pitch, writing exactly "grainSize" samples. We need a buffer that can
-		// fit 4x that, as the max pitch is 0x4000.
-		// TODO: Special case no-resample case (and 2x and 0.5x) for speed, it's not uncommon
+		break;
+	}
 
-		// Two passes: First read, then resample.
-		mixTemp_[0] = voice.resampleHist[0];
-		mixTemp_[1] = voice.resampleHist[1];
+	// This feels a bit hacky.  The first 32 samples after a keyon are 0s.
+	int delay = 0;
+	if (voice.envelope.NeedsKeyOn()) {
+		const bool ignorePitch = voice.type == VOICETYPE_PCM && voice.pitch > PSP_SAS_PITCH_BASE;
+		delay = ignorePitch ? 32 : (32 * (u32)voice.pitch) >> PSP_SAS_PITCH_BASE_SHIFT;
+		// VAG seems to have an extra sample delay (not shared by PCM.)
+		if (voice.type == VOICETYPE_VAG)
+			++delay;
+	}
 
-		int voicePitch = voice.pitch;
-		u32 sampleFrac = voice.sampleFrac;
-		int samplesToRead = (sampleFrac + voicePitch * std::max(0, grainSize - delay)) >> PSP_SAS_PITCH_BASE_SHIFT;
-		if (samplesToRead > ARRAY_SIZE(mixTemp_) - 2) {
-			ERROR_LOG(SCESAS, "Too many samples to read (%d)! This shouldn't happen.", samplesToRead);
-			samplesToRead = ARRAY_SIZE(mixTemp_) - 2;
-		}
-		int readPos = 2;
-		if (voice.envelope.NeedsKeyOn()) {
-			readPos = 0;
-			samplesToRead += 2;
-		}
-		voice.ReadSamples(&mixTemp_[readPos], samplesToRead);
-		int tempPos = readPos + samplesToRead;
+	// Resample to the correct pitch, writing exactly "grainSize" samples. We need a buffer that can
+	// fit 4x that, as the max pitch is 0x4000.
+	// TODO: Special case no-resample case (and 2x and 0.5x) for speed, it's not uncommon
 
-		for (int i = 0; i < delay; ++i) {
-			// Walk the curve.  This means we'll reach ATTACK already, likely.
-			// This matches the results of tests (but maybe we can just remove the STATE_KEYON_STEP hack.)
-			voice.envelope.Step();
-		}
+	// Two passes: First read, then resample.
+	temp[0] = voice.resampleHist[0];
+	temp[1] = voice.resampleHist[1];
 
-		const bool needsInterp = voicePitch != PSP_SAS_PITCH_BASE || (sampleFrac & PSP_SAS_PITCH_MASK) != 0;
-		for (int i = delay; i < grainSize; i++) {
-			const int16_t *s = mixTemp_ + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+	int voicePitch = voice.pitch;
+	u32 sampleFrac = voice.sampleFrac;
+	int samplesToRead = (sampleFrac + voicePitch * std::max(0, grainSize - delay)) >> PSP_SAS_PITCH_BASE_SHIFT;
+	if (samplesToRead > MIX_TEMP_SIZE - 2) {
+		ERROR_LOG(SCESAS, "Too many samples to read (%d)! This shouldn't happen.", samplesToRead);
+		samplesToRead = MIX_TEMP_SIZE - 2;
+	}
+	int readPos = 2;
+	if (voice.envelope.NeedsKeyOn()) {
+		readPos = 0;
+		samplesToRead += 2;
+	}
+	voice.ReadSamples(&temp[readPos], samplesToRead);
+	int tempPos = readPos + samplesToRead;
 
+	for (int i = 0; i < delay; ++i) {
+		// Walk the curve.  This means we'll reach ATTACK already, likely.
+		// This matches the results of tests (but maybe we can just remove the STATE_KEYON_STEP hack.)
+		voice.envelope.Step();
+	}
+	// Silent until then, which mixes in as nothing.
+	const int start = std::min(delay, grainSize);
+	memset(samples, 0, start * sizeof(int));
+	memset(volumes, 0, start * sizeof(int));
+
+	const bool needsInterp = voicePitch != PSP_SAS_PITCH_BASE || (sampleFrac & PSP_SAS_PITCH_MASK) != 0;
+	if (needsInterp) {
+		for (int i = start; i < grainSize; i++) {
+			const int16_t *s = temp + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
 			// Linear interpolation. Good enough. Need to make resampleHist bigger if we want more.
-			int sample = s[0];
-			if (needsInterp) {
-				int f = sampleFrac & PSP_SAS_PITCH_MASK;
-				sample = (s[0] * (PSP_SAS_PITCH_MASK - f) + s[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
-			}
+			int f = sampleFrac & PSP_SAS_PITCH_MASK;
+			samples[i] = (s[0] * (PSP_SAS_PITCH_MASK - f) + s[1] * f) >> PSP_SAS_PITCH_BASE_SHIFT;
 			sampleFrac += voicePitch;
-
-			// The maximum envelope height (PSP_SAS_ENVELOPE_HEIGHT_MAX) is (1 << 30) - 1.
-			// Reduce it to 14 bits, by shifting off 15.  Round up by adding (1 << 14) first.
-			int envelopeValue = voice.envelope.GetHeight();
-			voice.envelope.Step();
-			envelopeValue = (envelopeValue + (1 << 14)) >> 15;
-
-			// We just scale by the envelope before we scale by volumes.
-			// Again, we round up by adding (1 << 14) first (*after* multiplying.)
-			sample = ((sample * envelopeValue) + (1 << 14)) >> 15;
-
-			// We mix into this 32-bit temp buffer and clip in a second loop
-			// Ideally, the shift right should be there too but for now I'm concerned about
-			// not overflowing.
-			mixBuffer[i * 2] += (sample * voice.volumeLeft) >> 12;
-			mixBuffer[i * 2 + 1] += (sample * voice.volumeRight) >> 12;
-			sendBuffer[i * 2] += sample * voice.effectLeft >> 12;
-			sendBuffer[i * 2 + 1] += sample * voice.effectRight >> 12;
 		}
+	} else {
+		// No fraction and a pitch of exactly 1, so this is just a copy.
+		const int16_t *s = temp + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+		for (int i = start; i < grainSize; i++)
+			samples[i] = *s++;
+		sampleFrac += voicePitch * (grainSize - start);
+	}
+	voice.envelope.StepBlock(volumes + start, grainSize - start);
 
-		voice.resampleHist[0] = mixTemp_[tempPos - 2];
-		voice.resampleHist[1] = mixTemp_[tempPos - 1];
+	voice.resampleHist[0] = temp[tempPos - 2];
+	voice.resampleHist[1] = temp[tempPos - 1];
 
-		voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;
+	voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;
 
-		if (voice.HaveSamplesEnded())
-			voice.envelope.End();
-		if (voice.envelope.HasEnded()) {
-			// NOTICE_LOG(SASMIX, "Hit end of envelope");
-			voice.playing = false;
-			voice.on = false;
-		}
+	if (voice.HaveSamplesEnded())
+		voice.envelope.End();
+	if (voice.envelope.HasEnded()) {
+		// NOTICE_LOG(SASMIX, "Hit end of envelope");
+		voice.playing = false;
+		voice.on = false;
 	}
+	return true;
+}
+
+// Each of these handle as many samples as they can, and return how many.
+#ifdef _M_SSE
+[[gnu::target("sse4.1")]]
+static int MixSamplesSSE4(int *mix, int *send, const int *samples, const int *volumes, int count, const SasVoice &voice) {
+	const __m128i round = _mm_set1_epi32(1 << 14);
+	// Interleaved to match the buffers, left then right.
+	const __m128i mixVol = _mm_setr_epi32(voice.volumeLeft, voice.volumeRight, voice.volumeLeft, voice.volumeRight);
+	const __m128i sendVol = _mm_setr_epi32(voice.effectLeft, voice.effectRight, voice.effectLeft, voice.effectRight);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(samples + i));
+		__m128i v = _mm_loadu_si128((const __m128i *)(volumes + i));
+		s = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(s, v), round), 15);
+		__m128i lo = _mm_unpacklo_epi32(s, s);
+		__m128i hi = _mm_unpackhi_epi32(s, s);
+
+		__m128i *m = (__m128i *)(mix + i * 2);
+		_mm_storeu_si128(m, _mm_add_epi32(_mm_loadu_si128(m), _mm_srai_epi32(_mm_mullo_epi32(lo, mixVol), 12)));
+		_mm_storeu_si128(m + 1, _mm_add_epi32(_mm_loadu_si128(m + 1), _mm_srai_epi32(_mm_mullo_epi32(hi, mixVol), 12)));
+		__m128i *e = (__m128i *)(send + i * 2);
+		_mm_storeu_si128(e, _mm_add_epi32(_mm_loadu_si128(e), _mm_srai_epi32(_mm_mullo_epi32(lo, sendVol), 12)));
+		_mm_storeu_si128(e + 1, _mm_add_epi32(_mm_loadu_si128(e + 1), _mm_srai_epi32(_mm_mullo_epi32(hi, sendVol), 12)));
+	}
+	return i;
+}
+#elif PPSSPP_ARCH(ARM_NEON)
+static int MixSamplesNEON(int *mix, int *send, const int *samples, const int *volumes, int count, const SasVoice &voice) {
+	const int32x4_t round = vdupq_n_s32(1 << 14);
+	const int32x4_t volLeft = vdupq_n_s32(voice.volumeLeft);
+	const int32x4_t volRight = vdupq_n_s32(voice.volumeRight);
+	const int32x4_t effectLeft = vdupq_n_s32(voice.effectLeft);
+	const int32x4_t effectRight = vdupq_n_s32(voice.effectRight);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		int32x4_t s = vmulq_s32(vld1q_s32(samples + i), vld1q_s32(volumes + i));
+		s = vshrq_n_s32(vaddq_s32(s, round), 15);
+
+		int32x4x2_t m = vld2q_s32(mix + i * 2);
+		m.val[0] = vaddq_s32(m.val[0], vshrq_n_s32(vmulq_s32(s, volLeft), 12));
+		m.val[1] = vaddq_s32(m.val[1], vshrq_n_s32(vmulq_s32(s, volRight), 12));
+		vst2q_s32(mix + i * 2, m);
+		int32x4x2_t e = vld2q_s32(send + i * 2);
+		e.val[0] = vaddq_s32(e.val[0], vshrq_n_s32(vmulq_s32(s, effectLeft), 12));
+		e.val[1] = vaddq_s32(e.val[1], vshrq_n_s32(vmulq_s32(s, effectRight), 12));
+		vst2q_s32(send + i * 2, e);
+	}
+	return i;
+}
+#endif
+
+void SasInstance::MixRendered(const SasVoice &voice, const int *samples, const int *volumes) {
+	int i = 0;
+#ifdef _M_SSE
+	if (cpu_info.bSSE4_1)
+		i = MixSamplesSSE4(mixBuffer, sendBuffer, samples, volumes, grainSize, voice);
+#elif PPSSPP_ARCH(ARM_NEON)
+	i = MixSamplesNEON(mixBuffer, sendBuffer, samples, volumes, grainSize, voice);
+#endif
+
+	for (; i < grainSize; i++) {
+		// We just scale by the envelope before we scale by volumes.
+		// Again, we round up by adding (1 << 14) first (*after* multiplying.)
+		int sample = ((samples[i] * volumes[i]) + (1 << 14)) >> 15;
+
+		// We mix into this 32-bit temp buffer and clip in a second loop
+		// Ideally, the shift right should be there too but for now I'm concerned about
+		// not overflowing.
+		mixBuffer[i * 2] += (sample * voice.volumeLeft) >> 12;
+		mixBuffer[i * 2 + 1] += (sample * voice.volumeRight) >> 12;
+		sendBuffer[i * 2] += sample * voice.effectLeft >> 12;
+		sendBuffer[i * 2 + 1] += sample * voice.effectRight >> 12;
+	}
+}
+
+void SasInstance::MixVoice(SasVoice &voice) {
+	if (renderBuffer_.size() < (size_t)grainSize * 2)
+		renderBuffer_.resize(grainSize * 2);
+	int *samples = renderBuffer_.data();
+	if (RenderVoice(voice, mixTemp_, samples, samples + grainSize))
+		MixRendered(voice, samples, samples + grainSize);
 }
 
 void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
+	int active[PSP_SAS_VOICES_MAX];
+	int count = 0;
 	for (int v = 0; v < PSP_SAS_VOICES_MAX; v++) {
 		SasVoice &voice = voices[v];
-		if (!voice.playing || voice.paused)
-			continue;
-		MixVoice(voice);
+		if (voice.playing && !voice.paused)
+			active[count++] = v;
+	}
+
+	if (count * grainSize >= SAS_PARALLEL_MIN_SAMPLES && g_threadManager.IsInitialized()) {
+		// Every voice gets its own slot, then they're summed in order.  Integer sums, so the result is identical.
+		const size_t slotSize = grainSize * 2;
+		if (renderBuffer_.size() < count * slotSize)
+			renderBuffer_.resize(count * slotSize);
+		bool rendered[PSP_SAS_VOICES_MAX];
+		auto render = [&](int index, int16_t *temp) {
+			int *slot = &renderBuffer_[index * slotSize];
+			rendered[index] = RenderVoice(voices[active[index]], temp, slot, slot + grainSize);
+		};
+
+		// ATRAC3 voices decode through sceAtrac, so those stay on this thread.
+		for (int i = 0; i < count; i++) {
+			if (voices[active[i]].type == VOICETYPE_ATRAC3)
+				render(i, mixTemp_);
+		}
+		ParallelRangeLoop(&g_threadManager, [&](int lower, int upper) {
+			int16_t temp[MIX_TEMP_SIZE];
+			for (int i = lower; i < upper; i++) {
+				if (voices[active[i]].type != VOICETYPE_ATRAC3)
+					render(i, temp);
+			}
+		}, 0, count, SAS_PARALLEL_MIN_VOICES);
+
+		for (int i = 0; i < count; i++) {
+			const int *slot = &renderBuffer_[i * slotSize];
+			if (rendered[i])
+				MixRendered(voices[active[i]], slot, slot + grainSize);
+		}
+	} else {
+		for (int i = 0; i < count; i++)
+			MixVoice(voices[active[i]]);
 	}
 
 	// Then mix the send buffer in with the rest.
@@ -960,6 +1097,83 @@ inline void ADSREnvelope::Step() {
 	}
 }
 
+// How many steps of delta can be taken from height, with low <= height < high after each of them.
+static int LinearEnvelopeSteps(s64 height, s64 delta, s64 low, s64 high, int maxSteps) {
+	s64 steps;
+	if (delta == 0) {
+		steps = low <= height && height < high ? maxSteps : 0;
+	} else if (delta > 0) {
+		steps = height + delta < low || height >= high ? 0 : (high - height - 1) / delta;
+	} else {
+		steps = height + delta >= high || height < low ? 0 : (height - low) / -delta;
+	}
+	return (int)std::min(steps, (s64)maxSteps);
+}
+
+void ADSREnvelope::StepBlock(int *volumes, int count) {
+	// Large enough to never be reached, small enough not to overflow.
+	const s64 noLimit = (s64)1 << 48;
+
+	int i = 0;
+	while (i < count) {
+		int type = -1;
+		int rate = 0;
+		s64 low = -noLimit, high = noLimit;
+		switch (state_) {
+		case STATE_ATTACK:
+			type = attackType;
+			rate = attackRate;
+			low = 0;
+			high = PSP_SAS_ENVELOPE_HEIGHT_MAX;
+			break;
+		case STATE_DECAY:
+			type = decayType;
+			rate = decayRate;
+			low = sustainLevel;
+			break;
+		case STATE_SUSTAIN:
+			type = sustainType;
+			rate = sustainRate;
+			low = 1;
+			break;
+		case STATE_RELEASE:
+			type = releaseType;
+			rate = releaseRate;
+			low = 1;
+			break;
+		case STATE_OFF:
+			// Nothing more to walk, so it stays at its last height.
+			for (int volume = (GetHeight() + (1 << 14)) >> 15; i < count; ++i)
+				volumes[i] = volume;
+			return;
+		default:
+			break;
+		}
+
+		// Linear curves are just a constant delta until the state changes, the rest go one step at a time.
+		int steps = 0;
+		s64 delta = 0;
+		if (type == PSP_SAS_ADSR_CURVE_MODE_LINEAR_INCREASE || type == PSP_SAS_ADSR_CURVE_MODE_LINEAR_DECREASE) {
+			delta = type == PSP_SAS_ADSR_CURVE_MODE_LINEAR_INCREASE ? rate : -(s64)rate;
+			steps = LinearEnvelopeSteps(height_, delta, low, high, count - i);
+		}
+		if (steps == 0) {
+			// The maximum envelope height (PSP_SAS_ENVELOPE_HEIGHT_MAX) is (1 << 30) - 1.
+			// Reduce it to 14 bits, by shifting off 15.  Round up by adding (1 << 14) first.
+			volumes[i++] = (GetHeight() + (1 << 14)) >> 15;
+			Step();
+			continue;
+		}
+
+		s64 height = height_;
+		for (int end = i + steps; i < end; ++i) {
+			volumes[i] = ((int)(height > PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : height) + (1 << 14)) >> 15;
+			height += delta;
+		}
+		height_ = height;
+	}
+}
+
 void ADSREnvelope::KeyOn() {
 	SetState(STATE_KEYON);
 }
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "Common/CommonTypes.h"
 #include "Core/HW/BufferQueue.h"
 #include "Core/HW/SasReverb.h"
@@ -170,6 +172,8 @@ class ADSREnvelope {
 	void End();
 
 	inline void Step();
+	// Writes the 14-bit volume before each of the next count steps.
+	void StepBlock(int *volumes, int count);
 
 	int GetHeight() const {
 		return (int)(height_ > (s64)PSP_SAS_ENVELOPE_HEIGHT_MAX ? PSP_SAS_ENVELOPE_HEIGHT_MAX : height_);
@@ -330,9 +334,18 @@ class SasInstance {
 	WaveformEffect waveformEffect;
 
 private:
+	enum {
+		MIX_TEMP_SIZE = PSP_SAS_MAX_GRAIN * 4 + 2 + 8,  // some extra margin for very high pitches.
+	};
+
+	bool RenderVoice(SasVoice &voice, int16_t *temp, int *samples, int *volumes) const;
+	void MixRendered(const SasVoice &voice, const int *samples, const int *volumes);
+
 	SasReverb reverb_;
 	int grainSize = 0;
-	int16_t mixTemp_[PSP_SAS_MAX_GRAIN * 4 + 2 + 8];  // some extra margin for very high pitches.
+	int16_t mixTemp_[MIX_TEMP_SIZE];
+	// Resampled samples and envelope volumes of each voice, grainSize of each.
+	std::vector<int> renderBuffer_;
 };
 
 const char *ADSRCurveModeAsString(SasADSRCurveMode mode);
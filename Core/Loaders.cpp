@@ -41,6 +41,26 @@ void RegisterFileLoaderFactory(const std::string &prefix, std::unique_ptr<FileLo
 	factories[prefix] = std::move(factory);
 }
 
+size_t FileLoader::ReadAtVectored(const ReadRange *ranges, size_t count, Flags flags) {
+	size_t total = 0;
+	size_t i = 0;
+	while (i < count) {
+		s64 pos = ranges[i].absolutePos;
+		size_t bytes = ranges[i].bytes;
+		u8 *data = (u8 *)ranges[i].data;
+		size_t next = i + 1;
+		while (next < count && ranges[next].absolutePos == pos + (s64)bytes && ranges[next].data == data + bytes) {
+			bytes += ranges[next].bytes;
+			next++;
+		}
+
+		if (bytes != 0)
+			total += ReadAt(pos, bytes, data, flags);
+		i = next;
+	}
+	return total;
+}
+
 FileLoader *ConstructFileLoader(const Path &filename) {
 	if (filename.Type() == PathType::HTTP) {
 		FileLoader *baseLoader = new RetryingFileLoader(new HTTPFileLoader(filename));
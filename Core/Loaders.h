@@ -65,6 +65,13 @@ class FileLoader {
 		HINT_UNCACHED,
 	};
 
+	// One piece of a vectored read.
+	struct ReadRange {
+		s64 absolutePos;
+		size_t bytes;
+		void *data;
+	};
+
 	virtual ~FileLoader() {}
 
 	virtual bool IsRemote() {
@@ -82,6 +89,9 @@ class FileLoader {
 	virtual size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) {
 		return ReadAt(absolutePos, 1, bytes, data, flags);
 	}
+	// Reads all the ranges, and returns the total number of bytes read.
+	// By default, ranges that follow each other both in the file and in memory are merged into one ReadAt.
+	virtual size_t ReadAtVectored(const ReadRange *ranges, size_t count, Flags flags = Flags::NONE);
 
 	// Cancel any operations that might block, if possible.
 	virtual void Cancel() {}
@@ -129,6 +139,10 @@ class ProxiedFileLoader : public FileLoader {
 	size_t ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags = Flags::NONE) override {
 		return backend_->ReadAt(absolutePos, bytes, data, flags);
 	}
+	// NOTE: Subclasses that override ReadAt must override this too, usually with FileLoader::ReadAtVectored.
+	size_t ReadAtVectored(const ReadRange *ranges, size_t count, Flags flags = Flags::NONE) override {
+		return backend_->ReadAtVectored(ranges, count, flags);
+	}
 
 protected:
 	FileLoader *backend_;
@@ -100,7 +100,15 @@ void IRFrontend::BranchRSRTComp(MIPSOpcode op, IRComparison cc, bool likely) {
 	js.downcountAmount = 0;
 
 	FlushAll();
-	ir.Write(ComparisonToExit(cc), ir.AddConstant(ResolveNotTakenTarget(branchInfo)), lhs, rhs);
+	u32 notTakenTarget = ResolveNotTakenTarget(branchInfo);
+	bool canTrace = !likely && !branchInfo.delaySlotIsBranch;
+	if (canTrace && TraceContinues(notTakenTarget)) {
+		// The hot path falls through, so exit when taken instead.
+		ir.Write(ComparisonToExit(Invert(cc)), ir.AddConstant(targetAddr), lhs, rhs);
+		ContinueTrace(notTakenTarget);
+		return;
+	}
+	ir.Write(ComparisonToExit(cc), ir.AddConstant(notTakenTarget), lhs, rhs);
 	// This makes the block "impure" :(
 	if (likely && !branchInfo.delaySlotIsBranch)
 		CompileDelaySlot();
@@ -114,6 +122,10 @@ void IRFrontend::BranchRSRTComp(MIPSOpcode op, IRComparison cc, bool likely) {
 	}
 
 	FlushAll();
+	if (canTrace && TraceContinues(targetAddr)) {
+		ContinueTrace(targetAddr);
+		return;
+	}
 	ir.Write(IROp::ExitToConst, ir.AddConstant(targetAddr));
 
 	// Account for the delay slot.
@@ -151,7 +163,15 @@ void IRFrontend::BranchRSZeroComp(MIPSOpcode op, IRComparison cc, bool andLink,
 	js.downcountAmount = 0;
 
 	FlushAll();
-	ir.Write(ComparisonToExit(cc), ir.AddConstant(ResolveNotTakenTarget(branchInfo)), lhs);
+	u32 notTakenTarget = ResolveNotTakenTarget(branchInfo);
+	bool canTrace = !likely && !branchInfo.delaySlotIsBranch;
+	if (canTrace && TraceContinues(notTakenTarget)) {
+		// The hot path falls through, so exit when taken instead.
+		ir.Write(ComparisonToExit(Invert(cc)), ir.AddConstant(targetAddr), lhs);
+		ContinueTrace(notTakenTarget);
+		return;
+	}
+	ir.Write(ComparisonToExit(cc), ir.AddConstant(notTakenTarget), lhs);
 	if (likely && !branchInfo.delaySlotIsBranch)
 		CompileDelaySlot();
 	if (branchInfo.delaySlotIsBranch) {
@@ -165,6 +185,10 @@ void IRFrontend::BranchRSZeroComp(MIPSOpcode op, IRComparison cc, bool andLink,
 
 	// Taken
 	FlushAll();
+	if (canTrace && TraceContinues(targetAddr)) {
+		ContinueTrace(targetAddr);
+		return;
+	}
 	ir.Write(IROp::ExitToConst, ir.AddConstant(targetAddr));
 
 	// Account for the delay slot.
@@ -229,8 +253,16 @@ void IRFrontend::BranchFPFlag(MIPSOpcode op, IRComparison cc, bool likely) {
 	js.downcountAmount = 0;
 
 	FlushAll();
+	u32 notTakenTarget = ResolveNotTakenTarget(branchInfo);
+	bool canTrace = !likely && !branchInfo.delaySlotIsBranch;
+	if (canTrace && TraceContinues(notTakenTarget)) {
+		// The hot path falls through, so exit when taken instead.
+		ir.Write(ComparisonToExit(Invert(cc)), ir.AddConstant(targetAddr), IRTEMP_LHS, 0);
+		ContinueTrace(notTakenTarget);
+		return;
+	}
 	// Not taken
-	ir.Write(ComparisonToExit(cc), ir.AddConstant(ResolveNotTakenTarget(branchInfo)), IRTEMP_LHS, 0);
+	ir.Write(ComparisonToExit(cc), ir.AddConstant(notTakenTarget), IRTEMP_LHS, 0);
 	// Taken
 	if (likely && !branchInfo.delaySlotIsBranch)
 		CompileDelaySlot();
@@ -244,6 +276,10 @@ void IRFrontend::BranchFPFlag(MIPSOpcode op, IRComparison cc, bool likely) {
 	}
 
 	FlushAll();
+	if (canTrace && TraceContinues(targetAddr)) {
+		ContinueTrace(targetAddr);
+		return;
+	}
 	ir.Write(IROp::ExitToConst, ir.AddConstant(targetAddr));
 
 	// Account for the delay slot.
@@ -291,7 +327,15 @@ void IRFrontend::BranchVFPUFlag(MIPSOpcode op, IRComparison cc, bool likely) {
 
 	ir.Write(IROp::AndConst, IRTEMP_LHS, IRTEMP_LHS, ir.AddConstant(1 << imm3));
 	FlushAll();
-	ir.Write(ComparisonToExit(cc), ir.AddConstant(ResolveNotTakenTarget(branchInfo)), IRTEMP_LHS, 0);
+	u32 notTakenTarget = ResolveNotTakenTarget(branchInfo);
+	bool canTrace = !likely && !branchInfo.delaySlotIsBranch;
+	if (canTrace && TraceContinues(notTakenTarget)) {
+		// The hot path falls through, so exit when taken instead.
+		ir.Write(ComparisonToExit(Invert(cc)), ir.AddConstant(targetAddr), IRTEMP_LHS, 0);
+		ContinueTrace(notTakenTarget);
+		return;
+	}
+	ir.Write(ComparisonToExit(cc), ir.AddConstant(notTakenTarget), IRTEMP_LHS, 0);
 
 	if (likely && !branchInfo.delaySlotIsBranch)
 		CompileDelaySlot();
@@ -306,6 +350,10 @@ void IRFrontend::BranchVFPUFlag(MIPSOpcode op, IRComparison cc, bool likely) {
 
 	// Taken
 	FlushAll();
+	if (canTrace && TraceContinues(targetAddr)) {
+		ContinueTrace(targetAddr);
+		return;
+	}
 	ir.Write(IROp::ExitToConst, ir.AddConstant(targetAddr));
 
 	// Account for the delay slot.
@@ -362,6 +410,10 @@ void IRFrontend::Comp_Jump(MIPSOpcode op) {
 	js.downcountAmount = 0;
 
 	FlushAll();
+	if (TraceContinues(targetAddr)) {
+		ContinueTrace(targetAddr);
+		return;
+	}
 	ir.Write(IROp::ExitToConst, ir.AddConstant(targetAddr));
 
 	// Account for the delay slot.
@@ -15,12 +15,16 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "Common/Log.h"
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
+#include "Core/Config.h"
 #include "Core/Debugger/Breakpoints.h"
 #include "Core/Debugger/SymbolMap.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
 #include "Core/HLE/ReplaceTables.h"
 #include "Core/MemMap.h"
 #include "Core/MIPS/MIPSTables.h"
@@ -31,6 +35,23 @@
 
 namespace MIPSComp {
 
+// The first pass is required for correct behavior, the rest only optimize.
+static const IRPassFunc blockPasses[] = {
+	&ApplyMemoryValidation,
+	&RemoveLoadStoreLeftRight,
+	&OptimizeFPMoves,
+	&PropagateConstants,
+	&PurgeTemps,
+	&ReduceVec4Flush,
+	// &ReorderLoadStore,
+	// &MergeLoadStore,
+	// &ThreeOpToTwoOp,
+};
+
+// Limits on how far a trace can grow past its entry block.
+static const int TRACE_MAX_INSTRUCTIONS = 256;
+static const u32 TRACE_MAX_RANGE = 0x1000;
+
 IRFrontend::IRFrontend(bool startDefaultPrefix) {
 	js.startDefaultPrefix = startDefaultPrefix;
 	js.hasSetRounding = false;
@@ -238,7 +259,48 @@ MIPSOpcode IRFrontend::GetOffsetInstruction(int offset) {
 	return Memory::Read_Instruction(GetCompilerPC() + 4 * offset);
 }
 
-void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
+void IRFrontend::OptimizeBlock(const std::vector<IRInst> &instructions, std::vector<IRInst> &optimized) const {
+	IRWriter in;
+	in.Reserve(instructions.size());
+	for (const IRInst &inst : instructions)
+		in.Write(inst);
+
+	IRWriter out;
+	IRApplyPasses(blockPasses + 1, ARRAY_SIZE(blockPasses) - 1, in, out, opts);
+	optimized = out.GetInstructions();
+}
+
+bool IRFrontend::TraceContinues(u32 target) const {
+	if (!traceHints_ || !js.compiling || js.numInstructions >= TRACE_MAX_INSTRUCTIONS)
+		return false;
+	auto it = traceHints_->find(js.compilerPC);
+	if (it == traceHints_->end() || it->second != target)
+		return false;
+	// Looping back to the entry (or before it) ends the trace.
+	if (target <= js.blockStart || target >= js.blockStart + TRACE_MAX_RANGE)
+		return false;
+	return std::find(traceVisited_.begin(), traceVisited_.end(), target) == traceVisited_.end();
+}
+
+void IRFrontend::ContinueTrace(u32 target) {
+	traceVisited_.push_back(target);
+	// Include the delay slot in the range, then account for the increment in the loop.
+	traceEnd_ = std::max(traceEnd_, GetCompilerPC() + 8);
+	js.compilerPC = target - 4;
+}
+
+u32 IRFrontend::GetCompileFlags() const {
+	u32 flags = (js.startDefaultPrefix ? 1 : 0) | (js.hasSetRounding ? 2 : 0);
+	// These can change while running, so they can't just go in the store's fingerprint.
+	if (g_Config.bFastMemory)
+		flags |= 4;
+	if (PSP_CoreParameter().compat.flags().MoreAccurateVMMUL)
+		flags |= 8;
+	return flags;
+}
+
+void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload, bool optimize) {
+	const u32 startFlags = GetCompileFlags();
 	js.cancel = false;
 	js.preloading = preload;
 	js.blockStart = em_address;
@@ -254,6 +316,8 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 	js.inDelaySlot = false;
 	js.PrefixStart();
 	ir.Clear();
+	traceVisited_.clear();
+	traceEnd_ = em_address;
 
 	js.numInstructions = 0;
 	while (js.compiling) {
@@ -265,6 +329,7 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 		MIPSCompileOp(inst, this);
 		js.compilerPC += 4;
 		js.numInstructions++;
+		traceEnd_ = std::max(traceEnd_, js.compilerPC);
 	}
 
 	if (js.cancel) {
@@ -272,31 +337,29 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 		ir.Clear();
 	}
 
-	mipsBytes = js.compilerPC - em_address;
+	// A trace may have jumped around, but it stays in one range after the entry.
+	mipsBytes = traceHints_ ? traceEnd_ - em_address : js.compilerPC - em_address;
 
 	IRWriter simplified;
 	IRWriter *code = &ir;
+	lastBlockDeferred_ = false;
 	if (!js.hadBreakpoints) {
-		static const IRPassFunc passes[] = {
-			&ApplyMemoryValidation,
-			&RemoveLoadStoreLeftRight,
-			&OptimizeFPMoves,
-			&PropagateConstants,
-			&PurgeTemps,
-			&ReduceVec4Flush,
-			// &ReorderLoadStore,
-			// &MergeLoadStore,
-			// &ThreeOpToTwoOp,
-		};
-		if (IRApplyPasses(passes, ARRAY_SIZE(passes), ir, simplified, opts))
+		size_t numPasses = optimize ? ARRAY_SIZE(blockPasses) : 1;
+		if (IRApplyPasses(blockPasses, numPasses, ir, simplified, opts))
 			logBlocks = 1;
 		code = &simplified;
+		lastBlockDeferred_ = !optimize;
 		//if (ir.GetInstructions().size() >= 24)
 		//	logBlocks = 1;
 	}
 
 	instructions = code->GetInstructions();
 
+	// If we changed state mid-block or hit a prefix/breakpoint issue, this block is a one-off.
+	lastBlockCacheable_ = !js.cancel && !js.hadBreakpoints && !traceHints_ && startFlags == GetCompileFlags();
+	if (js.startDefaultPrefix && js.MayHavePrefix())
+		lastBlockCacheable_ = false;
+
 	if (logBlocks > 0 && dontLogBlocks == 0) {
 		char temp2[256];
 		NOTICE_LOG(JIT, "=============== mips %08x ===============", em_address);
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include "Common/CommonTypes.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/MIPS/JitCommon/JitState.h"
@@ -89,7 +92,30 @@ class IRFrontend : public MIPSFrontendInterface {
 	void DoState(PointerWrap &p);
 	bool CheckRounding(u32 blockAddress);  // returns true if we need a do-over
 
-	void DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload);
+	// When !optimize, only the passes needed for correctness run.  See OptimizeBlock().
+	void DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload, bool optimize = true);
+	// Applies the remaining passes to a block compiled with !optimize.  Safe to call from any thread.
+	void OptimizeBlock(const std::vector<IRInst> &instructions, std::vector<IRInst> &optimized) const;
+	// Whether the last DoJit() skipped optimization passes that OptimizeBlock() should run.
+	bool LastBlockDeferred() const {
+		return lastBlockDeferred_;
+	}
+
+	// While set, DoJit() compiles a trace: at each branch PC in hints, it continues into the
+	// mapped hot target (leaving a side exit for the other way) instead of ending the block.
+	void SetTraceHints(const std::unordered_map<u32, u32> *hints) {
+		traceHints_ = hints;
+	}
+	bool IsCompilingTrace() const {
+		return traceHints_ != nullptr;
+	}
+
+	// State that changes the IR generated for the same MIPS code.  Used to key cached blocks.
+	u32 GetCompileFlags() const;
+	// Whether the last DoJit() output only depends on the MIPS code and GetCompileFlags().
+	bool LastBlockCacheable() const {
+		return lastBlockCacheable_;
+	}
 
 	void EatPrefix() override {
 		js.EatPrefix();
@@ -112,6 +138,9 @@ class IRFrontend : public MIPSFrontendInterface {
 	void EatInstruction(MIPSOpcode op);
 	MIPSOpcode GetOffsetInstruction(int offset);
 
+	bool TraceContinues(u32 target) const;
+	void ContinueTrace(u32 target);
+
 	void CheckBreakpoint(u32 addr);
 	void CheckMemoryBreakpoint(int rs, int offset);
 
@@ -141,6 +170,12 @@ class IRFrontend : public MIPSFrontendInterface {
 
 	int dontLogBlocks = 0;
 	int logBlocks = 0;
+	bool lastBlockCacheable_ = false;
+	bool lastBlockDeferred_ = false;
+
+	const std::unordered_map<u32, u32> *traceHints_ = nullptr;
+	std::vector<u32> traceVisited_;
+	u32 traceEnd_ = 0;
 };
 
 }  // namespace
@@ -260,7 +260,6 @@ enum class IRRoundMode : uint8_t {
 	FLOOR_3 = 3,
 };
 
-// Hm, unused
 inline IRComparison Invert(IRComparison comp) {
 	switch (comp) {
 	case IRComparison::Equal: return IRComparison::NotEqual;
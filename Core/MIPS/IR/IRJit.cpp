@@ -16,18 +16,24 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include "ppsspp_config.h"
+#include <algorithm>
 #include <set>
 
 #include "ext/xxhash.h"
 #include "Common/Profiler/Profiler.h"
 
+#include "Common/File/FileUtil.h"
 #include "Common/Log.h"
 #include "Common/Serialize/Serializer.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
 
 #include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/Debugger/Breakpoints.h"
+#include "Core/ELF/ParamSFO.h"
 #include "Core/HLE/sceKernelMemory.h"
 #include "Core/MemMap.h"
 #include "Core/MIPS/MIPS.h"
@@ -40,9 +46,69 @@
 #include "Core/MIPS/IR/IRNativeCommon.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
 
 namespace MIPSComp {
 
+// Exits seen before a block is considered for a trace, and how dominant the hot exit must be.
+static const u32 TRACE_HOT_THRESHOLD = 512;
+static const u32 TRACE_HOT_PERCENT = 90;
+// Don't follow chains forever, the frontend also limits trace size.
+static const int TRACE_MAX_BLOCKS = 8;
+
+static const u32 IR_BLOCK_STORE_MAGIC = 0x43524950;  // PIRC
+static const u32 IR_BLOCK_STORE_VERSION = 2;
+
+struct IRBlockStoreHeader {
+	u32 magic;
+	u32 version;
+	u64 fingerprint;
+	u32 numEntries;
+	u32 reserved;
+};
+
+struct IRBlockStoreEntryHeader {
+	u32 addr;
+	u32 size;
+	u64 hash;
+	u32 flags;
+	u32 numInstructions;
+	float compileSeconds;
+	u32 reserved;
+};
+
+static u64 HashMIPSCode(u32 addr, u32 size) {
+	// This is unfortunate.  In case of emuhacks, we have to make a copy.
+	std::vector<u32> buffer;
+	buffer.resize(size / 4);
+	size_t pos = 0;
+	for (u32 off = 0; off < size; off += 4) {
+		// Let's actually hash the replacement, if any.
+		MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr + off, false);
+		buffer[pos++] = instr.encoding;
+	}
+
+	return XXH3_64bits(&buffer[0], size);
+}
+
+// Anything that changes the IR produced from the same MIPS code must go in here, or in the compile flags.
+static u64 IRBlockStoreFingerprint(const IROptions &opts) {
+	std::string data = PPSSPP_GIT_VERSION;
+	data.append((const char *)&opts.disableFlags, sizeof(opts.disableFlags));
+	data.push_back(opts.unalignedLoadStore ? '1' : '0');
+	data.push_back(opts.unalignedLoadStoreVec4 ? '1' : '0');
+	data.push_back(opts.preferVec4 ? '1' : '0');
+	data.push_back(opts.preferVec4Dot ? '1' : '0');
+	for (int i = 0; i < 256; ++i) {
+		const IRMeta *meta = GetIRMeta((IROp)i);
+		if (meta) {
+			data += meta->name;
+			data += meta->types;
+		}
+	}
+	return XXH3_64bits(data.data(), data.size());
+}
+
 IRJit::IRJit(MIPSState *mipsState) : frontend_(mipsState->HasDefaultPrefix()), mips_(mipsState) {
 	// u32 size = 128 * 1024;
 	// blTrampolines_ = kernelMemory.Alloc(size, true, "trampoline");
@@ -66,9 +132,19 @@ IRJit::IRJit(MIPSState *mipsState) : frontend_(mipsState->HasDefaultPrefix()), m
 	opts.preferVec4 = true;
 #endif
 	frontend_.SetOptions(opts);
+	backgroundCompile_ = g_Config.bIRBackgroundCompile && g_threadManager.IsInitialized();
+	traceFormation_ = g_Config.bIRTraceFormation;
+
+	std::string discID = g_paramSFO.GetDiscID();
+	if (g_Config.bIRBlockCache && !discID.empty()) {
+		File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+		blockStore_.Init(GetSysDirectory(DIRECTORY_APP_CACHE) / (discID + ".irblocks"), IRBlockStoreFingerprint(opts));
+	}
 }
 
 IRJit::~IRJit() {
+	CancelAllBackgroundCompiles(true);
+	blockStore_.Shutdown();
 }
 
 void IRJit::DoState(PointerWrap &p) {
@@ -80,12 +156,14 @@ void IRJit::UpdateFCR31() {
 
 void IRJit::ClearCache() {
 	INFO_LOG(JIT, "IRJit: Clearing the cache!");
+	CancelAllBackgroundCompiles(false);
 	blocks_.Clear();
 }
 
 void IRJit::InvalidateCacheAt(u32 em_address, int length) {
 	std::vector<int> numbers = blocks_.FindInvalidatedBlockNumbers(em_address, length);
 	for (int block_num : numbers) {
+		CancelBackgroundCompile(block_num);
 		auto block = blocks_.GetBlock(block_num);
 		int cookie = block->GetTargetOffset() < 0 ? block_num : block->GetTargetOffset();
 		block->Destroy(cookie);
@@ -94,6 +172,8 @@ void IRJit::InvalidateCacheAt(u32 em_address, int length) {
 
 void IRJit::Compile(u32 em_address) {
 	PROFILE_THIS_SCOPE("jitc");
+	// Only called between blocks, so nothing is running from the arena right now.
+	blocks_.CollectGarbage();
 
 	if (g_Config.bPreloadFunctions) {
 		// Look to see if we've preloaded this block.
@@ -128,7 +208,24 @@ void IRJit::Compile(u32 em_address) {
 }
 
 bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
-	frontend_.DoJit(em_address, instructions, mipsBytes, preload);
+	const u32 compileFlags = frontend_.GetCompileFlags();
+	// Breakpoints are compiled into the IR, so don't mix stored blocks with them.
+	bool useStore = blockStore_.IsEnabled() && !CBreakPoints::HasBreakPoints() && !CBreakPoints::HasMemChecks();
+	// Traces depend on profiling, not just the code.
+	if (frontend_.IsCompilingTrace())
+		useStore = false;
+	bool fromStore = false;
+	u64 storedHash = 0;
+	double compileSeconds = 0.0;
+	if (useStore) {
+		fromStore = blockStore_.Lookup(em_address, compileFlags, instructions, mipsBytes, storedHash);
+	}
+	if (!fromStore) {
+		double start = time_now_d();
+		// When compiling in the background, only run the required passes now.
+		frontend_.DoJit(em_address, instructions, mipsBytes, preload, !backgroundCompile_ || preload);
+		compileSeconds = time_now_d() - start;
+	}
 	if (instructions.empty()) {
 		_dbg_assert_(preload);
 		// We return true when preloading so it doesn't abort.
@@ -142,13 +239,23 @@ bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32
 	}
 
 	IRBlock *b = blocks_.GetBlock(block_num);
-	b->SetInstructions(instructions);
+	blocks_.SetBlockInstructions(block_num, instructions);
 	b->SetOriginalSize(mipsBytes);
-	if (preload) {
+	bool addToStore = useStore && !fromStore && frontend_.LastBlockCacheable();
+	if (fromStore) {
+		b->SetHash(storedHash);
+		_dbg_assert_(b->HashMatches());
+	} else if (preload || addToStore) {
 		// Hash, then only update page stats, don't link yet.
 		// TODO: Should we always hash?  Then we can reuse blocks.
 		b->UpdateHash();
 	}
+	if (!fromStore && frontend_.LastBlockDeferred()) {
+		// The store gets the optimized version once it's ready.
+		QueueBackgroundCompile(block_num, instructions, addToStore, compileFlags, compileSeconds);
+	} else if (addToStore) {
+		blockStore_.Add(em_address, mipsBytes, b->GetHash(), compileFlags, instructions, compileSeconds);
+	}
 	if (!CompileTargetBlock(b, block_num, preload))
 		return false;
 	// Overwrites the first instruction, and also updates stats.
@@ -159,6 +266,172 @@ bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32
 	return true;
 }
 
+void IRJit::FormTrace(int block_num) {
+	IRBlock *entryBlock = blocks_.GetBlock(block_num);
+	if (!entryBlock || !entryBlock->IsValid())
+		return;
+	const u32 entry = entryBlock->GetOriginalStart();
+
+	// Follow the hot exits from block to block, noting which way each branch goes.
+	std::unordered_map<u32, u32> hints;
+	const IRBlock *b = entryBlock;
+	for (int i = 0; i < TRACE_MAX_BLOCKS && b && b->IsValid() && !b->IsTrace(); ++i) {
+		u32 hot;
+		if (!b->GetHotExit(&hot))
+			break;
+
+		u32 start, size;
+		b->GetRange(start, size);
+		// The branch is followed by its delay slot at the end of the block.
+		u32 branchPC = start + size - 8;
+		if (hints.find(branchPC) != hints.end())
+			break;
+		hints[branchPC] = hot;
+		if (hot == entry)
+			break;
+
+		b = blocks_.GetBlock(blocks_.GetBlockNumberFromStartAddress(hot));
+	}
+
+	// Without a hint on the entry block's own branch, the trace would be the same block.
+	u32 entryStart, entrySize;
+	entryBlock->GetRange(entryStart, entrySize);
+	auto entryHint = hints.find(entryStart + entrySize - 8);
+	if (entryHint == hints.end() || entryHint->second == entry)
+		return;
+
+	// Replace the entry block.  The blocks along the trace stay for side exits to land on.
+	InvalidateCacheAt(entry, 4);
+
+	frontend_.SetTraceHints(&hints);
+	std::vector<IRInst> instructions;
+	u32 mipsBytes;
+	bool success = CompileBlock(entry, instructions, mipsBytes, false);
+	frontend_.SetTraceHints(nullptr);
+
+	if (!success) {
+		// Ran out of block numbers, like in Compile().  We'll compile normally on the next run.
+		ERROR_LOG(JIT, "Ran out of block numbers while forming trace, clearing cache");
+		ClearCache();
+		return;
+	}
+
+	IRBlock *trace = blocks_.GetBlock(blocks_.GetBlockNumberFromStartAddress(entry));
+	if (trace)
+		trace->SetTrace();
+	DEBUG_LOG(JIT, "Formed trace at %08x: %d branches, %d bytes", entry, (int)hints.size(), (int)mipsBytes);
+}
+
+class IRBackgroundCompileTask : public Task {
+public:
+	IRBackgroundCompileTask(IRJit *jit, IRBackgroundCompile *job) : jit_(jit), job_(job) {}
+
+	TaskType Type() const override { return TaskType::CPU_COMPUTE; }
+	TaskPriority Priority() const override { return TaskPriority::NORMAL; }
+
+	void Run() override {
+		jit_->RunBackgroundCompile(job_);
+	}
+
+private:
+	IRJit *jit_;
+	IRBackgroundCompile *job_;
+};
+
+void IRJit::QueueBackgroundCompile(int block_num, const std::vector<IRInst> &instructions, bool store, u32 compileFlags, double compileSeconds) {
+	// If the block number got reused (shouldn't without a clear), forget the old job.
+	CancelBackgroundCompile(block_num);
+
+	IRBackgroundCompile *job = new IRBackgroundCompile();
+	job->block_num = block_num;
+	job->generation = backgroundGeneration_;
+	job->cancelled = false;
+	job->instructions = instructions;
+	job->store = store;
+	job->compileFlags = compileFlags;
+	job->compileSeconds = compileSeconds;
+	backgroundPending_[block_num] = job;
+
+	{
+		std::lock_guard<std::mutex> guard(backgroundLock_);
+		backgroundInFlight_++;
+	}
+	g_threadManager.EnqueueTask(new IRBackgroundCompileTask(this, job));
+}
+
+void IRJit::RunBackgroundCompile(IRBackgroundCompile *job) {
+	if (!job->cancelled) {
+		double start = time_now_d();
+		std::vector<IRInst> optimized;
+		frontend_.OptimizeBlock(job->instructions, optimized);
+		job->instructions = std::move(optimized);
+		job->compileSeconds += time_now_d() - start;
+	}
+
+	std::lock_guard<std::mutex> guard(backgroundLock_);
+	backgroundFinished_.push_back(job);
+	backgroundInFlight_--;
+	hasBackgroundFinished_ = true;
+	backgroundCond_.notify_all();
+}
+
+void IRJit::PublishBackgroundCompiles() {
+	if (!hasBackgroundFinished_)
+		return;
+
+	std::vector<IRBackgroundCompile *> finished;
+	{
+		std::lock_guard<std::mutex> guard(backgroundLock_);
+		finished.swap(backgroundFinished_);
+		hasBackgroundFinished_ = false;
+	}
+
+	// We're between blocks on the emu thread, so nothing is interpreting the old instructions.
+	for (IRBackgroundCompile *job : finished) {
+		if (!job->cancelled && job->generation == backgroundGeneration_) {
+			IRBlock *b = blocks_.GetBlock(job->block_num);
+			if (b && b->IsValid()) {
+				blocks_.SetBlockInstructions(job->block_num, job->instructions);
+				if (job->store) {
+					u32 start, size;
+					b->GetRange(start, size);
+					blockStore_.Add(start, size, b->GetHash(), job->compileFlags, job->instructions, job->compileSeconds);
+				}
+			}
+			backgroundPending_.erase(job->block_num);
+		}
+		delete job;
+	}
+}
+
+void IRJit::CancelBackgroundCompile(int block_num) {
+	auto it = backgroundPending_.find(block_num);
+	if (it != backgroundPending_.end()) {
+		// The worker still owns it, it'll be deleted when it comes back.
+		it->second->cancelled = true;
+		backgroundPending_.erase(it);
+	}
+}
+
+void IRJit::CancelAllBackgroundCompiles(bool wait) {
+	for (auto &it : backgroundPending_) {
+		it.second->cancelled = true;
+	}
+	backgroundPending_.clear();
+	// Block numbers get reused after a clear, so ignore anything still coming back.
+	backgroundGeneration_++;
+
+	if (wait) {
+		std::unique_lock<std::mutex> guard(backgroundLock_);
+		backgroundCond_.wait(guard, [&] { return backgroundInFlight_ == 0; });
+		for (IRBackgroundCompile *job : backgroundFinished_) {
+			delete job;
+		}
+		backgroundFinished_.clear();
+		hasBackgroundFinished_ = false;
+	}
+}
+
 void IRJit::CompileFunction(u32 start_address, u32 length) {
 	PROFILE_THIS_SCOPE("jitc");
 
@@ -246,6 +519,7 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 		if (coreState != 0) {
 			break;
 		}
+		PublishBackgroundCompiles();
 		while (mips_->downcount >= 0) {
 			u32 inst = Memory::ReadUnchecked_U32(mips_->pc);
 			u32 opcode = inst & 0xFF000000;
@@ -253,12 +527,18 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 				u32 data = inst & 0xFFFFFF;
 				IRBlock *block = blocks_.GetBlock(data);
 				u32 startPC = mips_->pc;
-				mips_->pc = IRInterpret(mips_, block->GetInstructions(), block->GetNumInstructions());
+				mips_->pc = IRInterpret(mips_, blocks_.GetBlockInstructionPtr(*block), block->GetNumInstructions());
 				// Note: this will "jump to zero" on a badly constructed block missing exits.
 				if (!Memory::IsValidAddress(mips_->pc) || (mips_->pc & 3) != 0) {
 					Core_ExecException(mips_->pc, startPC, ExecExceptionType::JUMP);
 					break;
 				}
+				if (traceFormation_) {
+					// A syscall in the block may have cleared or replaced it, or grown blocks_.
+					block = blocks_.GetBlock(data);
+					if (block && block->IsValid() && block->GetOriginalStart() == startPC && !block->IsTrace() && block->RecordExit(mips_->pc))
+						FormTrace(data);
+				}
 			} else {
 				// RestoreRoundingMode(true);
 				Compile(mips_->pc);
@@ -289,7 +569,116 @@ void IRBlockCache::Clear() {
 		blocks_[i].Destroy(cookie);
 	}
 	blocks_.clear();
-	byPage_.clear();
+	// A syscall can clear the cache from inside a running block, so its instructions have to stay put.
+	for (auto &chunk : chunks_)
+		retiredChunks_.push_back(std::move(chunk));
+	chunks_.clear();
+	compactPending_ = false;
+	std::fill(ramPages_.begin(), ramPages_.end(), PageEntry{});
+	otherPages_.clear();
+	pageNodes_.clear();
+}
+
+void IRBlockCache::SetBlockInstructions(int i, const std::vector<IRInst> &inst) {
+	// Whatever it had before is now garbage.
+	blocks_[i].SetInstructionRange(0, 0);
+
+	bool needChunk = chunks_.empty() || chunks_.back().size() + inst.size() > chunks_.back().capacity();
+	if (needChunk && !chunks_.empty() && !compactPending_) {
+		// Before growing, see if invalidated blocks have left enough garbage to be worth reclaiming.
+		// A block might be running from the old space, so that waits for CollectGarbage().
+		size_t live = 0;
+		for (const IRBlock &b : blocks_) {
+			if (b.GetOriginalStart() != 0)
+				live += b.GetNumInstructions();
+		}
+		compactPending_ = live + inst.size() <= GetArenaCapacity() / 2;
+	}
+	if (needChunk) {
+		chunks_.emplace_back();
+		chunks_.back().reserve(std::max(ARENA_CHUNK_SIZE, inst.size()));
+	}
+
+	// Never past the reserved capacity, so this doesn't reallocate.
+	std::vector<IRInst> &chunk = chunks_.back();
+	_dbg_assert_(inst.size() <= ARENA_CHUNK_MASK + 1);
+	u32 offset = ((u32)(chunks_.size() - 1) << ARENA_CHUNK_SHIFT) | (u32)chunk.size();
+	chunk.insert(chunk.end(), inst.begin(), inst.end());
+	blocks_[i].SetInstructionRange(offset, (int)inst.size());
+}
+
+void IRBlockCache::CollectGarbage() {
+	retiredChunks_.clear();
+	if (compactPending_) {
+		// Left set until done, so refilling doesn't check for garbage again.
+		Compact();
+		compactPending_ = false;
+	}
+}
+
+void IRBlockCache::Compact() {
+	std::vector<std::vector<IRInst>> oldChunks;
+	oldChunks.swap(chunks_);
+	std::vector<IRInst> inst;
+	for (int i = 0; i < (int)blocks_.size(); ++i) {
+		IRBlock &b = blocks_[i];
+		// Destroyed blocks can't be entered anymore, so drop their instructions.
+		if (b.GetOriginalStart() == 0 || b.GetNumInstructions() == 0) {
+			b.SetInstructionRange(0, 0);
+			continue;
+		}
+
+		u32 offset = b.GetInstructionOffset();
+		const IRInst *start = oldChunks[offset >> ARENA_CHUNK_SHIFT].data() + (offset & ARENA_CHUNK_MASK);
+		inst.assign(start, start + b.GetNumInstructions());
+		SetBlockInstructions(i, inst);
+	}
+}
+
+size_t IRBlockCache::GetArenaSize() const {
+	size_t total = 0;
+	for (const auto &chunk : chunks_)
+		total += chunk.size();
+	return total;
+}
+
+size_t IRBlockCache::GetArenaCapacity() const {
+	size_t total = 0;
+	for (const auto &chunk : chunks_)
+		total += chunk.capacity();
+	return total;
+}
+
+const IRBlockCache::PageEntry *IRBlockCache::FindPage(u32 page) const {
+	if (page >= RAM_FIRST_PAGE && page < RAM_FIRST_PAGE + RAM_NUM_PAGES) {
+		if (ramPages_.empty())
+			return nullptr;
+		return &ramPages_[page - RAM_FIRST_PAGE];
+	}
+
+	auto iter = otherPages_.find(page);
+	if (iter == otherPages_.end())
+		return nullptr;
+	return &iter->second;
+}
+
+void IRBlockCache::AddBlockToPage(u32 page, int i) {
+	PageEntry *entry;
+	if (page >= RAM_FIRST_PAGE && page < RAM_FIRST_PAGE + RAM_NUM_PAGES) {
+		if (ramPages_.empty())
+			ramPages_.resize(RAM_NUM_PAGES);
+		entry = &ramPages_[page - RAM_FIRST_PAGE];
+	} else {
+		entry = &otherPages_[page];
+	}
+
+	pageNodes_.push_back(PageNode{ i, 0 });
+	u32 node = (u32)pageNodes_.size();
+	if (entry->last != 0)
+		pageNodes_[entry->last - 1].next = node;
+	else
+		entry->first = node;
+	entry->last = node;
 }
 
 std::vector<int> IRBlockCache::FindInvalidatedBlockNumbers(u32 address, u32 length) {
@@ -298,17 +687,13 @@ std::vector<int> IRBlockCache::FindInvalidatedBlockNumbers(u32 address, u32 leng
 
 	std::vector<int> found;
 	for (u32 page = startPage; page <= endPage; ++page) {
-		const auto iter = byPage_.find(page);
-		if (iter == byPage_.end())
-			continue;
-
-		const std::vector<int> &blocksInPage = iter->second;
-		for (int i : blocksInPage) {
+		ForEachBlockInPage(page, [&](int i) {
 			if (blocks_[i].OverlapsRange(address, length)) {
 				// Not removing from the page, hopefully doesn't build up with small recompiles.
 				found.push_back(i);
 			}
-		}
+			return true;
+		});
 	}
 
 	return found;
@@ -327,7 +712,7 @@ void IRBlockCache::FinalizeBlock(int i, bool preload) {
 	u32 endPage = AddressToPage(startAddr + size);
 
 	for (u32 page = startPage; page <= endPage; ++page) {
-		byPage_[page].push_back(i);
+		AddBlockToPage(page, i);
 	}
 }
 
@@ -338,20 +723,15 @@ u32 IRBlockCache::AddressToPage(u32 addr) const {
 
 int IRBlockCache::FindPreloadBlock(u32 em_address) {
 	u32 page = AddressToPage(em_address);
-	auto iter = byPage_.find(page);
-	if (iter == byPage_.end())
-		return -1;
-
-	const std::vector<int> &blocksInPage = iter->second;
-	for (int i : blocksInPage) {
-		if (blocks_[i].GetOriginalStart() == em_address) {
-			if (blocks_[i].HashMatches()) {
-				return i;
-			}
+	int found = -1;
+	ForEachBlockInPage(page, [&](int i) {
+		if (blocks_[i].GetOriginalStart() == em_address && blocks_[i].HashMatches()) {
+			found = i;
+			return false;
 		}
-	}
-
-	return -1;
+		return true;
+	});
+	return found;
 }
 
 int IRBlockCache::FindByCookie(int cookie) {
@@ -420,7 +800,7 @@ JitBlockDebugInfo IRBlockCache::GetBlockDebugInfo(int blockNum) const {
 
 	debugInfo.irDisasm.reserve(ir.GetNumInstructions());
 	for (int i = 0; i < ir.GetNumInstructions(); i++) {
-		IRInst inst = ir.GetInstructions()[i];
+		IRInst inst = GetBlockInstructionPtr(ir)[i];
 		char buffer[256];
 		DisassembleIR(buffer, sizeof(buffer), inst);
 		debugInfo.irDisasm.push_back(buffer);
@@ -461,20 +841,16 @@ void IRBlockCache::ComputeStats(BlockCacheStats &bcStats) const {
 int IRBlockCache::GetBlockNumberFromStartAddress(u32 em_address, bool realBlocksOnly) const {
 	u32 page = AddressToPage(em_address);
 
-	const auto iter = byPage_.find(page);
-	if (iter == byPage_.end())
-		return -1;
-
-	const std::vector<int> &blocksInPage = iter->second;
 	int best = -1;
-	for (int i : blocksInPage) {
+	ForEachBlockInPage(page, [&](int i) {
 		if (blocks_[i].GetOriginalStart() == em_address) {
 			best = i;
 			if (blocks_[i].IsValid()) {
-				return i;
+				return false;
 			}
 		}
-	}
+		return true;
+	});
 	return best;
 }
 
@@ -514,28 +890,177 @@ void IRBlock::Destroy(int cookie) {
 
 u64 IRBlock::CalculateHash() const {
 	if (origAddr_) {
-		// This is unfortunate.  In case of emuhacks, we have to make a copy.
-		std::vector<u32> buffer;
-		buffer.resize(origSize_ / 4);
-		size_t pos = 0;
-		for (u32 off = 0; off < origSize_; off += 4) {
-			// Let's actually hash the replacement, if any.
-			MIPSOpcode instr = Memory::ReadUnchecked_Instruction(origAddr_ + off, false);
-			buffer[pos++] = instr.encoding;
-		}
-
-		return XXH3_64bits(&buffer[0], origSize_);
+		return HashMIPSCode(origAddr_, origSize_);
 	}
 
 	return 0;
 }
 
+bool IRBlock::RecordExit(u32 pc) {
+	if (exitCounts_[0] == 0 || exitPCs_[0] == pc) {
+		exitPCs_[0] = pc;
+		exitCounts_[0]++;
+	} else if (exitCounts_[1] == 0 || exitPCs_[1] == pc) {
+		exitPCs_[1] = pc;
+		exitCounts_[1]++;
+	} else {
+		exitOther_++;
+	}
+	return exitCounts_[0] + exitCounts_[1] + exitOther_ == TRACE_HOT_THRESHOLD;
+}
+
+bool IRBlock::GetHotExit(u32 *pc) const {
+	u32 total = exitCounts_[0] + exitCounts_[1] + exitOther_;
+	// Blocks further along the trace may not have hit the threshold, but need some history.
+	if (total < TRACE_HOT_THRESHOLD / 16)
+		return false;
+	for (int i = 0; i < 2; ++i) {
+		if (exitCounts_[i] * 100 >= total * TRACE_HOT_PERCENT) {
+			*pc = exitPCs_[i];
+			return true;
+		}
+	}
+	return false;
+}
+
 bool IRBlock::OverlapsRange(u32 addr, u32 size) const {
 	addr &= 0x3FFFFFFF;
 	u32 origAddr = origAddr_ & 0x3FFFFFFF;
 	return addr + size > origAddr && addr < origAddr + origSize_;
 }
 
+void IRBlockStore::Init(const Path &filename, u64 fingerprint) {
+	filename_ = filename;
+	fingerprint_ = fingerprint;
+	stats_ = {};
+	if (!Load()) {
+		entries_.clear();
+		byAddress_.clear();
+	}
+}
+
+void IRBlockStore::Shutdown() {
+	if (!IsEnabled())
+		return;
+
+	INFO_LOG(JIT, "IR block store: %d hits, %d misses, %0.3f seconds saved", stats_.hits, stats_.misses, stats_.secondsSaved);
+	Save();
+	entries_.clear();
+	byAddress_.clear();
+	filename_.clear();
+}
+
+bool IRBlockStore::Lookup(u32 em_address, u32 flags, std::vector<IRInst> &instructions, u32 &mipsBytes, u64 &hash) {
+	double start = time_now_d();
+	auto range = byAddress_.equal_range(em_address);
+	for (auto it = range.first; it != range.second; ++it) {
+		Entry &entry = entries_[it->second];
+		if (entry.flags != flags || !Memory::IsValidRange(em_address, entry.size))
+			continue;
+		if (HashMIPSCode(em_address, entry.size) != entry.hash)
+			continue;
+
+		instructions = entry.instructions;
+		mipsBytes = entry.size;
+		hash = entry.hash;
+		entry.used = true;
+
+		stats_.hits++;
+		stats_.secondsSaved += entry.compileSeconds - (time_now_d() - start);
+		return true;
+	}
+
+	stats_.misses++;
+	return false;
+}
+
+void IRBlockStore::Add(u32 em_address, u32 mipsBytes, u64 hash, u32 flags, const std::vector<IRInst> &instructions, double compileSeconds) {
+	auto range = byAddress_.equal_range(em_address);
+	for (auto it = range.first; it != range.second; ++it) {
+		const Entry &entry = entries_[it->second];
+		if (entry.hash == hash && entry.size == mipsBytes && entry.flags == flags)
+			return;
+	}
+
+	byAddress_.emplace(em_address, entries_.size());
+	entries_.push_back(Entry{ em_address, mipsBytes, hash, flags, (float)compileSeconds, true, instructions });
+}
+
+bool IRBlockStore::Load() {
+	FILE *f = File::OpenCFile(filename_, "rb");
+	if (!f)
+		return false;
+
+	IRBlockStoreHeader header{};
+	bool success = fread(&header, sizeof(header), 1, f) == 1;
+	if (!success || header.magic != IR_BLOCK_STORE_MAGIC || header.version != IR_BLOCK_STORE_VERSION || header.fingerprint != fingerprint_) {
+		INFO_LOG(JIT, "IR block store %s is stale or invalid, ignoring", filename_.c_str());
+		fclose(f);
+		return false;
+	}
+
+	entries_.reserve(header.numEntries);
+	for (u32 i = 0; i < header.numEntries && success; ++i) {
+		IRBlockStoreEntryHeader entryHeader;
+		if (fread(&entryHeader, sizeof(entryHeader), 1, f) != 1 || entryHeader.numInstructions == 0 || entryHeader.numInstructions > 0xFFFF) {
+			success = false;
+			break;
+		}
+
+		Entry entry{ entryHeader.addr, entryHeader.size, entryHeader.hash, entryHeader.flags, entryHeader.compileSeconds, false };
+		entry.instructions.resize(entryHeader.numInstructions);
+		if (fread(&entry.instructions[0], sizeof(IRInst), entryHeader.numInstructions, f) != entryHeader.numInstructions) {
+			success = false;
+			break;
+		}
+
+		byAddress_.emplace(entry.addr, entries_.size());
+		entries_.push_back(std::move(entry));
+	}
+	fclose(f);
+
+	if (!success) {
+		ERROR_LOG(JIT, "Failed to read IR block store %s", filename_.c_str());
+		return false;
+	}
+
+	INFO_LOG(JIT, "Loaded %d blocks from IR block store %s", (int)entries_.size(), filename_.c_str());
+	return true;
+}
+
+bool IRBlockStore::Save() {
+	FILE *f = File::OpenCFile(filename_, "wb");
+	if (!f)
+		return false;
+
+	// Only keep blocks we've used this run, so the file doesn't grow forever across game updates.
+	IRBlockStoreHeader header{ IR_BLOCK_STORE_MAGIC, IR_BLOCK_STORE_VERSION, fingerprint_ };
+	for (const Entry &entry : entries_) {
+		if (entry.used)
+			header.numEntries++;
+	}
+
+	bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (const Entry &entry : entries_) {
+		if (!entry.used || !success)
+			continue;
+
+		IRBlockStoreEntryHeader entryHeader{ entry.addr, entry.size, entry.hash, entry.flags, (u32)entry.instructions.size(), entry.compileSeconds };
+		success = fwrite(&entryHeader, sizeof(entryHeader), 1, f) == 1;
+		success = success && fwrite(&entry.instructions[0], sizeof(IRInst), entry.instructions.size(), f) == entry.instructions.size();
+	}
+	fclose(f);
+
+	if (!success) {
+		ERROR_LOG(JIT, "Failed to write IR block store %s", filename_.c_str());
+		File::Delete(filename_);
+		return false;
+	}
+
+	INFO_LOG(JIT, "Saved %d blocks to IR block store %s", header.numEntries, filename_.c_str());
+	return true;
+}
+
 MIPSOpcode IRJit::GetOriginalOp(MIPSOpcode op) {
 	IRBlock *b = blocks_.GetBlock(blocks_.FindByCookie(op.encoding & 0xFFFFFF));
 	if (b) {
@@ -17,11 +17,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
 #include <unordered_map>
 
 #include "Common/CommonTypes.h"
 #include "Common/CPUDetect.h"
+#include "Common/File/Path.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/MIPS/IR/IRRegCache.h"
@@ -35,35 +39,17 @@
 
 namespace MIPSComp {
 
-// TODO : Use arena allocators. For now let's just malloc.
+// The instructions live in the IRBlockCache's arena, see IRBlockCache::GetBlockInstructionPtr().
 class IRBlock {
 public:
 	IRBlock() {}
 	IRBlock(u32 emAddr) : origAddr_(emAddr) {}
-	IRBlock(IRBlock &&b) {
-		instr_ = b.instr_;
-		hash_ = b.hash_;
-		origAddr_ = b.origAddr_;
-		origSize_ = b.origSize_;
-		origFirstOpcode_ = b.origFirstOpcode_;
-		targetOffset_ = b.targetOffset_;
-		numInstructions_ = b.numInstructions_;
-		b.instr_ = nullptr;
-	}
-
-	~IRBlock() {
-		delete[] instr_;
-	}
-
-	void SetInstructions(const std::vector<IRInst> &inst) {
-		instr_ = new IRInst[inst.size()];
-		numInstructions_ = (u16)inst.size();
-		if (!inst.empty()) {
-			memcpy(instr_, &inst[0], sizeof(IRInst) * inst.size());
-		}
-	}
 
-	const IRInst *GetInstructions() const { return instr_; }
+	void SetInstructionRange(u32 offset, int count) {
+		instOffset_ = offset;
+		numInstructions_ = (u16)count;
+	}
+	u32 GetInstructionOffset() const { return instOffset_; }
 	int GetNumInstructions() const { return numInstructions_; }
 	MIPSOpcode GetOriginalFirstOp() const { return origFirstOpcode_; }
 	bool HasOriginalFirstOp() const;
@@ -81,11 +67,28 @@ class IRBlock {
 	void UpdateHash() {
 		hash_ = CalculateHash();
 	}
+	void SetHash(u64 hash) {
+		hash_ = hash;
+	}
+	u64 GetHash() const {
+		return hash_;
+	}
 	bool HashMatches() const {
 		return origAddr_ && hash_ == CalculateHash();
 	}
 	bool OverlapsRange(u32 addr, u32 size) const;
 
+	// Exit profiling for trace formation.  Returns true once, when the block becomes hot.
+	bool RecordExit(u32 pc);
+	// Returns true if one exit dominates the others.
+	bool GetHotExit(u32 *pc) const;
+	bool IsTrace() const {
+		return isTrace_;
+	}
+	void SetTrace() {
+		isTrace_ = true;
+	}
+
 	void GetRange(u32 &start, u32 &size) const {
 		start = origAddr_;
 		size = origSize_;
@@ -100,13 +103,17 @@ class IRBlock {
 private:
 	u64 CalculateHash() const;
 
-	IRInst *instr_ = nullptr;
 	u64 hash_ = 0;
+	u32 instOffset_ = 0;
 	u32 origAddr_ = 0;
 	u32 origSize_ = 0;
 	MIPSOpcode origFirstOpcode_ = MIPSOpcode(0x68FFFFFF);
 	int targetOffset_ = -1;
 	u16 numInstructions_ = 0;
+	bool isTrace_ = false;
+	u32 exitPCs_[2]{};
+	u32 exitCounts_[2]{};
+	u32 exitOther_ = 0;
 };
 
 class IRBlockCache : public JitBlockCacheDebugInterface {
@@ -135,6 +142,19 @@ class IRBlockCache : public JitBlockCacheDebugInterface {
 		}
 	}
 
+	// Copies the instructions into the arena, replacing any the block had.
+	void SetBlockInstructions(int i, const std::vector<IRInst> &inst);
+	// Stays valid until the next CollectGarbage(), even across SetBlockInstructions() or Clear().
+	const IRInst *GetBlockInstructionPtr(const IRBlock &block) const {
+		if (block.GetNumInstructions() == 0)
+			return nullptr;
+		u32 offset = block.GetInstructionOffset();
+		return chunks_[offset >> ARENA_CHUNK_SHIFT].data() + (offset & ARENA_CHUNK_MASK);
+	}
+	// Frees or compacts what SetBlockInstructions() and Clear() left behind.
+	// Only call this when no block is running, since it moves instructions.
+	void CollectGarbage();
+
 	int FindPreloadBlock(u32 em_address);
 	int FindByCookie(int cookie);
 
@@ -145,11 +165,115 @@ class IRBlockCache : public JitBlockCacheDebugInterface {
 	void ComputeStats(BlockCacheStats &bcStats) const override;
 	int GetBlockNumberFromStartAddress(u32 em_address, bool realBlocksOnly = true) const override;
 
+	// Stats for the arena, in instructions.
+	size_t GetArenaSize() const;
+	size_t GetArenaCapacity() const;
+
 private:
+	// Pages are 1KB, see AddressToPage().  RAM (including the extra PSP-2000 RAM) gets a flat table.
+	static const u32 RAM_FIRST_PAGE = 0x08000000 >> 10;
+	static const u32 RAM_NUM_PAGES = 0x04000000 >> 10;
+
+	// Blocks in a page form a linked list of nodes, in the order they were added.
+	struct PageEntry {
+		u32 first = 0;
+		u32 last = 0;
+	};
+	struct PageNode {
+		int block;
+		u32 next;
+	};
+
 	u32 AddressToPage(u32 addr) const;
+	const PageEntry *FindPage(u32 page) const;
+	void AddBlockToPage(u32 page, int i);
+	void Compact();
+
+	// Instructions go in chunks that are never reallocated, so a running block can't move.
+	// Offsets are the chunk number, then the position in the chunk.
+	static constexpr u32 ARENA_CHUNK_SHIFT = 16;
+	static constexpr u32 ARENA_CHUNK_MASK = (1 << ARENA_CHUNK_SHIFT) - 1;
+	static constexpr size_t ARENA_CHUNK_SIZE = 16384;
+
+	template <typename F>
+	void ForEachBlockInPage(u32 page, F func) const {
+		const PageEntry *entry = FindPage(page);
+		if (!entry)
+			return;
+		for (u32 n = entry->first; n != 0; n = pageNodes_[n - 1].next) {
+			if (!func(pageNodes_[n - 1].block))
+				break;
+		}
+	}
 
 	std::vector<IRBlock> blocks_;
-	std::unordered_map<u32, std::vector<int>> byPage_;
+	std::vector<std::vector<IRInst>> chunks_;
+	// From Clear(), kept until CollectGarbage() in case a block in them is still running.
+	std::vector<std::vector<IRInst>> retiredChunks_;
+	bool compactPending_ = false;
+
+	// Flat table for pages in RAM, which is where nearly all code lives.
+	std::vector<PageEntry> ramPages_;
+	std::unordered_map<u32, PageEntry> otherPages_;
+	std::vector<PageNode> pageNodes_;
+};
+
+// Finalized IR from previous runs, keyed by the hash of the MIPS code it was compiled from.
+// Lets a warm start skip the frontend and passes for blocks whose code hasn't changed.
+class IRBlockStore {
+public:
+	struct Stats {
+		int hits;
+		int misses;
+		double secondsSaved;
+	};
+
+	void Init(const Path &filename, u64 fingerprint);
+	void Shutdown();
+	bool IsEnabled() const {
+		return !filename_.empty();
+	}
+
+	// On a hit, fills instructions and mipsBytes (already validated against memory.)
+	bool Lookup(u32 em_address, u32 flags, std::vector<IRInst> &instructions, u32 &mipsBytes, u64 &hash);
+	void Add(u32 em_address, u32 mipsBytes, u64 hash, u32 flags, const std::vector<IRInst> &instructions, double compileSeconds);
+
+	const Stats &GetStats() const {
+		return stats_;
+	}
+
+private:
+	struct Entry {
+		u32 addr;
+		u32 size;
+		u64 hash;
+		u32 flags;
+		float compileSeconds;
+		bool used;
+		std::vector<IRInst> instructions;
+	};
+
+	bool Load();
+	bool Save();
+
+	Path filename_;
+	u64 fingerprint_ = 0;
+	std::vector<Entry> entries_;
+	std::unordered_multimap<u32, size_t> byAddress_;
+	Stats stats_{};
+};
+
+// Optimization passes for a block, running on a worker while the block runs unoptimized.
+struct IRBackgroundCompile {
+	int block_num;
+	u32 generation;
+	std::atomic<bool> cancelled;
+	std::vector<IRInst> instructions;
+
+	// If set, the result also goes into the IRBlockStore.
+	bool store;
+	u32 compileFlags;
+	double compileSeconds;
 };
 
 class IRJit : public JitInterface {
@@ -194,10 +318,35 @@ class IRJit : public JitInterface {
 	virtual bool CompileTargetBlock(IRBlock *block, int block_num, bool preload) { return true; }
 	virtual void FinalizeTargetBlock(IRBlock *block, int block_num) {}
 
+	void FormTrace(int block_num);
+
+	void QueueBackgroundCompile(int block_num, const std::vector<IRInst> &instructions, bool store, u32 compileFlags, double compileSeconds);
+	void RunBackgroundCompile(IRBackgroundCompile *job);
+	void PublishBackgroundCompiles();
+	void CancelBackgroundCompile(int block_num);
+	void CancelAllBackgroundCompiles(bool wait);
+
 	JitOptions jo;
 
 	IRFrontend frontend_;
 	IRBlockCache blocks_;
+	IRBlockStore blockStore_;
+
+	// Only used when the IR runs directly, the native backends need final IR up front.
+	bool backgroundCompile_ = false;
+	// Also only for direct IR, since exits are profiled in our dispatcher.
+	bool traceFormation_ = false;
+	// Emu thread only.  Jobs are deleted when published or discarded.
+	std::unordered_map<int, IRBackgroundCompile *> backgroundPending_;
+	u32 backgroundGeneration_ = 0;
+	// Shared with workers.
+	std::mutex backgroundLock_;
+	std::condition_variable backgroundCond_;
+	std::vector<IRBackgroundCompile *> backgroundFinished_;
+	std::atomic<bool> hasBackgroundFinished_{};
+	int backgroundInFlight_ = 0;
+
+	friend class IRBackgroundCompileTask;
 
 	MIPSState *mips_;
 
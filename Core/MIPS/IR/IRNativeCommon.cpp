@@ -480,7 +480,12 @@ void IRNativeBackend::CompileIRInst(IRInst inst) {
 }
 
 IRNativeJit::IRNativeJit(MIPSState *mipsState)
-	: IRJit(mipsState), debugInterface_(blocks_) {}
+	: IRJit(mipsState), debugInterface_(blocks_) {
+	// The backend compiles right away, so it needs the optimized IR up front.
+	backgroundCompile_ = false;
+	// Exits aren't profiled in the native dispatcher.
+	traceFormation_ = false;
+}
 
 void IRNativeJit::Init(IRNativeBackend &backend) {
 	backend_ = &backend;
@@ -105,7 +105,9 @@ void IRImmRegCache::MapDirtyInIn(IRReg rd, IRReg rs, IRReg rt) {
 IRNativeRegCacheBase::IRNativeRegCacheBase(MIPSComp::JitOptions *jo)
 	: jo_(jo) {}
 
-void IRNativeRegCacheBase::Start(MIPSComp::IRBlock *irBlock) {
+void IRNativeRegCacheBase::Start(MIPSComp::IRBlockCache *irBlockCache, int blockNum) {
+	const MIPSComp::IRBlock *irBlock = irBlockCache->GetBlock(blockNum);
+
 	if (!initialReady_) {
 		SetupInitialRegs();
 		initialReady_ = true;
@@ -128,6 +130,7 @@ void IRNativeRegCacheBase::Start(MIPSComp::IRBlock *irBlock) {
 	}
 
 	irBlock_ = irBlock;
+	irInstructions_ = irBlockCache->GetBlockInstructionPtr(*irBlock);
 	irIndex_ = 0;
 }
 
@@ -430,7 +433,7 @@ bool IRNativeRegCacheBase::IsRegClobbered(MIPSLoc type, IRReg r) const {
 	info.lookaheadCount = UNUSED_LOOKAHEAD_OPS;
 	// We look starting one ahead, unlike spilling.  We want to know if it clobbers later.
 	info.currentIndex = irIndex_ + 1;
-	info.instructions = irBlock_->GetInstructions();
+	info.instructions = irInstructions_;
 	info.numInstructions = irBlock_->GetNumInstructions();
 
 	// Make sure we're on the first one if this is multi-lane.
@@ -457,7 +460,7 @@ bool IRNativeRegCacheBase::IsRegRead(MIPSLoc type, IRReg first) const {
 	info.lookaheadCount = UNUSED_LOOKAHEAD_OPS;
 	// We look starting one ahead, unlike spilling.
 	info.currentIndex = irIndex_ + 1;
-	info.instructions = irBlock_->GetInstructions();
+	info.instructions = irInstructions_;
 	info.numInstructions = irBlock_->GetNumInstructions();
 
 	// Note: this intentionally doesn't look at the full reg, only the lane.
@@ -474,7 +477,7 @@ IRNativeReg IRNativeRegCacheBase::FindBestToSpill(MIPSLoc type, MIPSMap flags, b
 	IRSituation info;
 	info.lookaheadCount = UNUSED_LOOKAHEAD_OPS;
 	info.currentIndex = irIndex_;
-	info.instructions = irBlock_->GetInstructions();
+	info.instructions = irInstructions_;
 	info.numInstructions = irBlock_->GetNumInstructions();
 
 	*clobbered = false;
@@ -1026,7 +1029,7 @@ void IRNativeRegCacheBase::MapNativeReg(MIPSLoc type, IRNativeReg nreg, IRReg fi
 							IRSituation info;
 							info.lookaheadCount = 16;
 							info.currentIndex = irIndex_;
-							info.instructions = irBlock_->GetInstructions();
+							info.instructions = irInstructions_;
 							info.numInstructions = irBlock_->GetNumInstructions();
 
 							IRReg basefpr = first - oldlane - 32;
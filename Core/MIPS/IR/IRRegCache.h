@@ -40,6 +40,7 @@ class MIPSState;
 
 namespace MIPSComp {
 class IRBlock;
+class IRBlockCache;
 struct JitOptions;
 }
 
@@ -153,7 +154,7 @@ class IRNativeRegCacheBase {
 	IRNativeRegCacheBase(MIPSComp::JitOptions *jo);
 	virtual ~IRNativeRegCacheBase() {}
 
-	virtual void Start(MIPSComp::IRBlock *irBlock);
+	virtual void Start(MIPSComp::IRBlockCache *irBlockCache, int blockNum);
 	void SetIRIndex(int index) {
 		irIndex_ = index;
 	}
@@ -249,6 +250,7 @@ class IRNativeRegCacheBase {
 
 	MIPSComp::JitOptions *jo_;
 	const MIPSComp::IRBlock *irBlock_ = nullptr;
+	const IRInst *irInstructions_ = nullptr;
 	int irIndex_ = 0;
 
 	struct {
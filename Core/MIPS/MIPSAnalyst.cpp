@@ -29,6 +29,7 @@
 #include "Common/File/FileUtil.h"
 #include "Common/Log.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ParallelLoop.h"
 #include "Common/TimeUtil.h"
 #include "Core/Config.h"
 #include "Core/MemMap.h"
@@ -53,6 +54,9 @@ std::recursive_mutex functions_lock;
 // the same hash and should all be replaced if possible.
 static std::unordered_multimap<u64, MIPSAnalyst::AnalyzedFunction *> hashToFunction;
 
+// Below this, hashing on the calling thread is quicker than handing it out.
+static const size_t HASH_PARALLEL_MIN_FUNCTIONS = 2048;
+
 struct HashMapFunc {
 	char name[64];
 	u64 hash;
@@ -868,40 +872,52 @@ namespace MIPSAnalyst {
 		return DetermineRegisterUsage(reg, addr, instrs) == USAGE_CLOBBERED;
 	}
 
+	// Immediates are left out, since relocation changes them. Fails on code we can't read back (emuhacks.)
+	static bool HashFunction(AnalyzedFunction &f, std::vector<u32> &buffer) {
+		// This is unfortunate.  In case of emuhacks or relocs, we have to make a copy.
+		buffer.resize((f.end - f.start + 4) / 4);
+		size_t pos = 0;
+		for (u32 addr = f.start; addr <= f.end; addr += 4) {
+			u32 validbits = 0xFFFFFFFF;
+			MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr, true);
+			if (MIPS_IS_EMUHACK(instr)) {
+				return false;
+			}
+
+			MIPSInfo flags = MIPSGetInfo(instr);
+			if (flags & IN_IMM16)
+				validbits &= ~0xFFFF;
+			if (flags & IN_IMM26)
+				validbits &= ~0x03FFFFFF;
+			buffer[pos++] = instr & validbits;
+		}
+
+		f.hash = CityHash64((const char *) &buffer[0], buffer.size() * sizeof(u32));
+		return true;
+	}
+
 	void HashFunctions() {
 		std::lock_guard<std::recursive_mutex> guard(functions_lock);
-		std::vector<u32> buffer;
 
-		for (auto iter = functions.begin(), end = functions.end(); iter != end; iter++) {
-			AnalyzedFunction &f = *iter;
-			if (!Memory::IsValidRange(f.start, f.end - f.start + 4)) {
-				continue;
-			}
-
-			// This is unfortunate.  In case of emuhacks or relocs, we have to make a copy.
-			buffer.resize((f.end - f.start + 4) / 4);
-			size_t pos = 0;
-			for (u32 addr = f.start; addr <= f.end; addr += 4) {
-				u32 validbits = 0xFFFFFFFF;
-				MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr, true);
-				if (MIPS_IS_EMUHACK(instr)) {
-					f.hasHash = false;
-					goto skip;
+		// Every function is hashed into its own entry, so the chunks don't need to share anything.
+		auto hashRange = [](int lower, int upper) {
+			std::vector<u32> buffer;
+			for (int i = lower; i < upper; ++i) {
+				AnalyzedFunction &f = functions[i];
+				if (!Memory::IsValidRange(f.start, f.end - f.start + 4)) {
+					continue;
 				}
-
-				MIPSInfo flags = MIPSGetInfo(instr);
-				if (flags & IN_IMM16)
-					validbits &= ~0xFFFF;
-				if (flags & IN_IMM26)
-					validbits &= ~0x03FFFFFF;
-				buffer[pos++] = instr & validbits;
+				f.hasHash = HashFunction(f, buffer);
 			}
+		};
 
-			f.hash = CityHash64((const char *) &buffer[0], buffer.size() * sizeof(u32));
-			f.hasHash = true;
-skip:
-			;
+		double st = time_now_d();
+		if (functions.size() >= HASH_PARALLEL_MIN_FUNCTIONS && g_threadManager.IsInitialized()) {
+			ParallelRangeLoop(&g_threadManager, hashRange, 0, (int)functions.size(), HASH_PARALLEL_MIN_FUNCTIONS / 2);
+		} else {
+			hashRange(0, (int)functions.size());
 		}
+		DEBUG_LOG(LOADER, "Hashed %d functions in %0.2f ms", (int)functions.size(), (time_now_d() - st) * 1000.0);
 	}
 
 	void PrecompileFunction(u32 startAddr, u32 length) {
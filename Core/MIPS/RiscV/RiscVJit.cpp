@@ -80,11 +80,12 @@ bool RiscVJitBackend::CompileBlock(IRBlock *block, int block_num, bool preload)
 	block->SetTargetOffset((int)GetOffset(blockStart));
 	compilingBlockNum_ = block_num;
 
-	regs_.Start(block);
+	regs_.Start(&blocks_, block_num);
+	const IRInst *instructions = blocks_.GetBlockInstructionPtr(*block);
 
 	std::vector<const u8 *> addresses;
 	for (int i = 0; i < block->GetNumInstructions(); ++i) {
-		const IRInst &inst = block->GetInstructions()[i];
+		const IRInst &inst = instructions[i];
 		regs_.SetIRIndex(i);
 		addresses.push_back(GetCodePtr());
 
@@ -144,7 +145,7 @@ bool RiscVJitBackend::CompileBlock(IRBlock *block, int block_num, bool preload)
 		for (const u8 *p = blockStart; p < GetCodePointer(); ) {
 			auto it = addressesLookup.find(p);
 			if (it != addressesLookup.end()) {
-				const IRInst &inst = block->GetInstructions()[it->second];
+				const IRInst &inst = instructions[it->second];
 
 				char temp[512];
 				DisassembleIR(temp, sizeof(temp), inst);
@@ -84,12 +84,13 @@ bool X64JitBackend::CompileBlock(IRBlock *block, int block_num, bool preload) {
 	compilingBlockNum_ = block_num;
 	lastConstPC_ = 0;
 
-	regs_.Start(block);
+	regs_.Start(&blocks_, block_num);
+	const IRInst *instructions = blocks_.GetBlockInstructionPtr(*block);
 
 	std::vector<const u8 *> addresses;
 	addresses.reserve(block->GetNumInstructions());
 	for (int i = 0; i < block->GetNumInstructions(); ++i) {
-		const IRInst &inst = block->GetInstructions()[i];
+		const IRInst &inst = instructions[i];
 		regs_.SetIRIndex(i);
 		addresses.push_back(GetCodePtr());
 
@@ -148,7 +149,7 @@ bool X64JitBackend::CompileBlock(IRBlock *block, int block_num, bool preload) {
 		for (const u8 *p = blockStart; p < GetCodePointer(); ) {
 			auto it = addressesLookup.find(p);
 			if (it != addressesLookup.end()) {
-				const IRInst &inst = block->GetInstructions()[it->second];
+				const IRInst &inst = instructions[it->second];
 
 				char temp[512];
 				DisassembleIR(temp, sizeof(temp), inst);
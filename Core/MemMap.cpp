@@ -512,5 +512,7 @@ void PSPPointerNotifyRW(int rw, uint32_t ptr, uint32_t bytes, const char * tag,
 			NotifyMemInfo(MemBlockFlags::WRITE, ptr, bytes, tag, tagLen);
 		if (rw & 2)
 			NotifyMemInfo(MemBlockFlags::READ, ptr, bytes, tag, tagLen);
+	} else if ((rw & 1) && g_memWriteTracking) {
+		MemWriteTrackingMark(ptr, bytes);
 	}
 }
@@ -19,6 +19,7 @@
 #include "Common/LogReporting.h"
 
 #include "Core/Core.h"
+#include "Core/Debugger/MemBlockInfo.h"
 #include "Core/MemMap.h"
 #include "Core/Config.h"
 #include "Core/ConfigValues.h"
@@ -124,6 +125,8 @@ inline void ReadFromHardware(T &var, const u32 address) {
 
 template <typename T>
 inline void WriteToHardware(u32 address, const T data) {
+	if (g_memWriteTracking)
+		MemWriteTrackingMark(address, sizeof(T));
 	if ((address & 0x3E000000) == 0x08000000) {
 		// RAM
 		*(T*)GetPointerUnchecked(address) = data;
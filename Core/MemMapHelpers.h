@@ -75,6 +75,8 @@ inline void Memcpy(const u32 to_address, const u32 from_address, const u32 len,
 			NotifyMemInfo(MemBlockFlags::READ, from_address, len, tag, tagLen);
 			NotifyMemInfo(MemBlockFlags::WRITE, to_address, len, tag, tagLen);
 		}
+	} else if (g_memWriteTracking) {
+		MemWriteTrackingMark(to_address, len);
 	}
 }
 
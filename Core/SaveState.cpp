@@ -16,12 +16,17 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
 #include <vector>
-#include <thread>
 #include <mutex>
 
+#include <zstd.h>
+
 #include "Common/Data/Text/I18n.h"
-#include "Common/Thread/ThreadUtil.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Common/Data/Text/Parsers.h"
 #include "Common/System/System.h"
 
@@ -101,174 +106,213 @@ namespace SaveState
 	}
 
 	// This ring buffer of states is for rewind save states, which are kept in RAM.
-	// Save states are compressed against one of two reference saves (bases_), and the reference
-	// is switched to a fresh save every N saves, where N is BASE_USAGE_INTERVAL.
-	// The compression is a simple block based scheme where 0 means to copy a block from the base,
-	// and 1 means that the following bytes are the next block. See Compress/LockedDecompress.
-	class StateRingbuffer {
+	// Each save is XORed against a reference save (a base), which zeroes everything that didn't change,
+	// and then compressed with zstd on a background task. A new base is taken every BASE_USAGE_INTERVAL
+	// saves, or sooner when the deltas stop paying off. Older bases are kept zstd compressed for as long
+	// as states refer to them. The oldest states are dropped when memory use goes over REWIND_MAX_BYTES.
+	class StateRingbuffer;
+
+	class RewindCompressTask : public Task {
 	public:
-		StateRingbuffer() {
-			size_ = REWIND_NUM_STATES;
-			states_.resize(size_);
-			baseMapping_.resize(size_);
+		RewindCompressTask(StateRingbuffer *ringbuffer) : ringbuffer_(ringbuffer) {}
+
+		TaskType Type() const override {
+			return TaskType::CPU_COMPUTE;
+		}
+
+		TaskPriority Priority() const override {
+			return TaskPriority::LOW;
 		}
 
+		void Run() override;
+
+	private:
+		StateRingbuffer *ringbuffer_;
+	};
+
+	static void XorBuffer(u8 *dest, const u8 *src, size_t size) {
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			u64 a, b;
+			memcpy(&a, dest + i, 8);
+			memcpy(&b, src + i, 8);
+			a ^= b;
+			memcpy(dest + i, &a, 8);
+		}
+		for (; i < size; ++i)
+			dest[i] ^= src[i];
+	}
+
+	class StateRingbuffer {
+	public:
 		~StateRingbuffer() {
-			if (compressThread_.joinable()) {
-				compressThread_.join();
-			}
+			Clear();
 		}
 
 		CChunkFileReader::Error Save()
 		{
 			rewindLastTime_ = time_now_d();
 
-			// Make sure we're not processing a previous save. That'll cause a hitch though, but at least won't
-			// crash due to contention over buffer_.
-			if (compressThread_.joinable())
-				compressThread_.join();
+			std::unique_lock<std::mutex> guard(lock_);
+			if (pendingStates_ >= MAX_PENDING_STATES) {
+				// Rather skip one than stall the game while compression catches up.
+				DEBUG_LOG(SAVESTATE, "Rewind: Compression is behind, skipping a snapshot.");
+				return CChunkFileReader::ERROR_NONE;
+			}
 
-			std::lock_guard<std::mutex> guard(lock_);
+			// Reuse an old buffer, if there's one, to avoid reallocating a large state every time.
+			std::vector<u8> data = std::move(spareBuffer_);
+			spareBuffer_.clear();
+			guard.unlock();
 
-			int n = next_++ % size_;
-			if ((next_ % size_) == first_)
-				++first_;
+			CChunkFileReader::Error err = SaveToRam(data);
 
-			std::vector<u8> *compressBuffer = &buffer_;
-			CChunkFileReader::Error err;
+			guard.lock();
+			if (err != CChunkFileReader::ERROR_NONE)
+				return err;
 
-			if (base_ == -1 || ++baseUsage_ > BASE_USAGE_INTERVAL)
-			{
-				base_ = (base_ + 1) % ARRAY_SIZE(bases_);
+			RewindState state;
+			state.size = data.size();
+			if (!base_ || baseUsage_ >= BASE_USAGE_INTERVAL || lastDeltaSize_ > base_->size / 4) {
+				if (base_) {
+					// Packs it down once the states already queued against it are done.
+					jobs_.push_back(CompressJob{ 0, base_, std::vector<u8>() });
+				}
+
+				base_ = std::make_shared<RewindBase>();
+				base_->raw = std::move(data);
+				base_->size = base_->raw.size();
 				baseUsage_ = 0;
-				err = SaveToRam(bases_[base_]);
-				// Let's not bother savestating twice.
-				compressBuffer = &bases_[base_];
-			}
-			else
-				err = SaveToRam(buffer_);
+				lastDeltaSize_ = 0;
 
-			if (err == CChunkFileReader::ERROR_NONE)
-				ScheduleCompress(&states_[n], compressBuffer, &bases_[base_]);
-			else
-				states_[n].clear();
+				// Let's not bother compressing a state against itself.
+				state.base = base_;
+				state.sameAsBase = true;
+				states_.push_back(std::move(state));
+			} else {
+				baseUsage_++;
+				state.base = base_;
+				states_.push_back(std::move(state));
+				jobs_.push_back(CompressJob{ firstId_ + states_.size() - 1, base_, std::move(data) });
+				pendingStates_++;
+			}
 
-			baseMapping_[n] = base_;
+			TrimLocked();
+			if (!jobs_.empty() && !compressRunning_) {
+				compressRunning_ = true;
+				g_threadManager.EnqueueTask(new RewindCompressTask(this));
+			}
 			return err;
 		}
 
 		CChunkFileReader::Error Restore(std::string *errorString)
 		{
-			std::lock_guard<std::mutex> guard(lock_);
+			std::unique_lock<std::mutex> guard(lock_);
+			// The newest state may still be compressing, and the base may be getting packed.
+			compressDone_.wait(guard, [&] { return !compressRunning_; });
 
 			// No valid states left.
-			if (Empty())
+			if (states_.empty())
 				return CChunkFileReader::ERROR_BAD_FILE;
 
-			int n = (--next_ + size_) % size_;
-			if (states_[n].empty())
+			RewindState state = std::move(states_.back());
+			states_.pop_back();
+			if (!state.sameAsBase && state.compressed.empty())
 				return CChunkFileReader::ERROR_BAD_FILE;
 
+			const std::vector<u8> *base = &state.base->raw;
+			std::vector<u8> unpackedBase;
+			if (base->empty()) {
+				unpackedBase.resize(state.base->size);
+				size_t status = ZSTD_decompress(unpackedBase.data(), unpackedBase.size(), state.base->compressed.data(), state.base->compressed.size());
+				if (ZSTD_isError(status) || status != unpackedBase.size())
+					return CChunkFileReader::ERROR_BAD_FILE;
+				base = &unpackedBase;
+			}
+
 			static std::vector<u8> buffer;
-			LockedDecompress(buffer, states_[n], bases_[baseMapping_[n]]);
+			if (state.sameAsBase) {
+				buffer = *base;
+			} else {
+				buffer.resize(state.size);
+				size_t status = ZSTD_decompress(buffer.data(), buffer.size(), state.compressed.data(), state.compressed.size());
+				if (ZSTD_isError(status) || status != buffer.size())
+					return CChunkFileReader::ERROR_BAD_FILE;
+				XorBuffer(buffer.data(), base->data(), std::min(buffer.size(), base->size()));
+			}
+
 			CChunkFileReader::Error error = LoadFromRam(buffer, errorString);
 			rewindLastTime_ = time_now_d();
 			return error;
 		}
 
-		void ScheduleCompress(std::vector<u8> *result, const std::vector<u8> *state, const std::vector<u8> *base)
-		{
-			if (compressThread_.joinable())
-				compressThread_.join();
-			compressThread_ = std::thread([=]{
-				SetCurrentThreadName("SaveStateCompress");
-
-				// Should do no I/O, so no JNI thread context needed.
-				Compress(*result, *state, *base);
-			});
-		}
-
-		void Compress(std::vector<u8> &result, const std::vector<u8> &state, const std::vector<u8> &base)
-		{
-			std::lock_guard<std::mutex> guard(lock_);
-			// Bail if we were cleared before locking.
-			if (first_ == 0 && next_ == 0)
-				return;
-
-			double start_time = time_now_d();
-			result.clear();
-			result.reserve(512 * 1024);
-			for (size_t i = 0; i < state.size(); i += BLOCK_SIZE)
-			{
-				int blockSize = std::min(BLOCK_SIZE, (int)(state.size() - i));
-				if (i + blockSize > base.size() || memcmp(&state[i], &base[i], blockSize) != 0)
-				{
-					result.push_back(1);
-					result.insert(result.end(), state.begin() + i, state.begin() + i + blockSize);
+		// Called from RewindCompressTask.
+		void RunCompress() {
+			std::unique_lock<std::mutex> guard(lock_);
+			while (!jobs_.empty()) {
+				CompressJob job = std::move(jobs_.front());
+				jobs_.pop_front();
+
+				if (job.state.empty()) {
+					// Nothing to do if all its states were already dropped.
+					if (job.base.use_count() > 1 && !job.base->raw.empty()) {
+						guard.unlock();
+						std::vector<u8> compressed = CompressBuffer(job.base->raw);
+						guard.lock();
+						job.base->compressed = std::move(compressed);
+						job.base->raw.clear();
+						job.base->raw.shrink_to_fit();
+					}
+					continue;
 				}
-				else
-					result.push_back(0);
-			}
-
-			double taken_s = time_now_d() - start_time;
-			DEBUG_LOG(SAVESTATE, "Rewind: Compressed save from %d bytes to %d in %0.2f ms.", (int)state.size(), (int)result.size(), taken_s * 1000.0);
-		}
 
-		void LockedDecompress(std::vector<u8> &result, const std::vector<u8> &compressed, const std::vector<u8> &base)
-		{
-			result.clear();
-			result.reserve(base.size());
-			auto basePos = base.begin();
-			for (size_t i = 0; i < compressed.size(); )
-			{
-				if (compressed[i] == 0)
-				{
-					++i;
-					int blockSize = std::min(BLOCK_SIZE, (int)(base.size() - result.size()));
-					result.insert(result.end(), basePos, basePos + blockSize);
-					basePos += blockSize;
-				}
-				else
-				{
-					++i;
-					int blockSize = std::min(BLOCK_SIZE, (int)(compressed.size() - i));
-					result.insert(result.end(), compressed.begin() + i, compressed.begin() + i + blockSize);
-					i += blockSize;
-					// This check is to avoid advancing basePos out of range, which MSVC catches.
-					// When this happens, we're at the end of decoding anyway.
-					if (base.end() - basePos >= blockSize) {
-						basePos += blockSize;
-					}
+				guard.unlock();
+				double start_time = time_now_d();
+				const std::vector<u8> &base = job.base->raw;
+				XorBuffer(job.state.data(), base.data(), std::min(job.state.size(), base.size()));
+				std::vector<u8> compressed = CompressBuffer(job.state);
+				double taken_s = time_now_d() - start_time;
+				DEBUG_LOG(SAVESTATE, "Rewind: Compressed save from %d bytes to %d in %0.2f ms.", (int)job.state.size(), (int)compressed.size(), taken_s * 1000.0);
+				guard.lock();
+
+				pendingStates_--;
+				// It might have been dropped or restored meanwhile.
+				if (job.id >= firstId_ && job.id < firstId_ + states_.size()) {
+					lastDeltaSize_ = compressed.size();
+					states_[job.id - firstId_].compressed = std::move(compressed);
+					TrimLocked();
 				}
+				if (spareBuffer_.empty())
+					spareBuffer_ = std::move(job.state);
 			}
+
+			compressRunning_ = false;
+			compressDone_.notify_all();
 		}
 
 		void Clear()
 		{
-			if (compressThread_.joinable())
-				compressThread_.join();
-
-			// This lock is mainly for shutdown.
-			std::lock_guard<std::mutex> guard(lock_);
-			first_ = 0;
-			next_ = 0;
-			for (auto &b : bases_) {
-				b.clear();
-			}
-			baseMapping_.clear();
-			baseMapping_.resize(size_);
-			for (auto &s : states_) {
-				s.clear();
-			}
-			buffer_.clear();
-			base_ = -1;
+			std::unique_lock<std::mutex> guard(lock_);
+			jobs_.clear();
+			compressDone_.wait(guard, [&] { return !compressRunning_; });
+
+			firstId_ += states_.size();
+			states_.clear();
+			base_.reset();
+			spareBuffer_.clear();
+			spareBuffer_.shrink_to_fit();
+			pendingStates_ = 0;
 			baseUsage_ = 0;
+			lastDeltaSize_ = 0;
+			ZSTD_freeCCtx(cctx_);
+			cctx_ = nullptr;
 			rewindLastTime_ = time_now_d();
 		}
 
-		bool Empty() const
+		bool Empty()
 		{
-			return next_ == first_;
+			std::lock_guard<std::mutex> guard(lock_);
+			return states_.empty();
 		}
 
 		void Process() {
@@ -295,30 +339,94 @@ namespace SaveState
 		}
 
 	private:
-		const int BLOCK_SIZE = 8192;
-		const int REWIND_NUM_STATES = 20;
-		// TODO: Instead, based on size of compressed state?
-		const int BASE_USAGE_INTERVAL = 15;
+		struct RewindBase {
+			// Kept while states are still being compressed against it.
+			std::vector<u8> raw;
+			// Afterwards, only this is kept, for restoring older states.
+			std::vector<u8> compressed;
+			size_t size = 0;
+		};
 
-		typedef std::vector<u8> StateBuffer;
+		struct RewindState {
+			std::shared_ptr<RewindBase> base;
+			// zstd compressed XOR of the state and the base.
+			std::vector<u8> compressed;
+			size_t size = 0;
+			bool sameAsBase = false;
+		};
 
-		int first_ = 0;
-		int next_ = 0;
-		int size_;
+		struct CompressJob {
+			u64 id;
+			std::shared_ptr<RewindBase> base;
+			// If empty, packs down the base instead.
+			std::vector<u8> state;
+		};
 
-		std::vector<StateBuffer> states_;
-		StateBuffer bases_[2];
-		std::vector<int> baseMapping_;
-		std::mutex lock_;
-		std::thread compressThread_;
-		std::vector<u8> buffer_;
+		std::vector<u8> CompressBuffer(const std::vector<u8> &data) {
+			// Only ever used from one compress task at a time.
+			if (!cctx_)
+				cctx_ = ZSTD_createCCtx();
+
+			std::vector<u8> result(ZSTD_compressBound(data.size()));
+			size_t size = ZSTD_compressCCtx(cctx_, result.data(), result.size(), data.data(), data.size(), ZSTD_COMPRESSION_LEVEL);
+			if (ZSTD_isError(size)) {
+				ERROR_LOG(SAVESTATE, "Rewind: Failed to compress state: %s", ZSTD_getErrorName(size));
+				return std::vector<u8>();
+			}
+			result.resize(size);
+			result.shrink_to_fit();
+			return result;
+		}
+
+		size_t UsedBytesLocked() const {
+			size_t used = 0;
+			const RewindBase *lastBase = nullptr;
+			for (const RewindState &state : states_) {
+				used += state.compressed.size();
+				// States using the same base are always next to each other.
+				if (state.base.get() != lastBase) {
+					lastBase = state.base.get();
+					used += lastBase->raw.size() + lastBase->compressed.size();
+				}
+			}
+			return used;
+		}
+
+		void TrimLocked() {
+			while (states_.size() > 1 && UsedBytesLocked() > REWIND_MAX_BYTES) {
+				states_.pop_front();
+				firstId_++;
+			}
+		}
+
+		static constexpr size_t REWIND_MAX_BYTES = 128 * 1024 * 1024;
+		static constexpr int MAX_PENDING_STATES = 3;
+		static constexpr int BASE_USAGE_INTERVAL = 15;
+		// Deltas are mostly zeroes, the fastest level handles those well.
+		static constexpr int ZSTD_COMPRESSION_LEVEL = 1;
 
-		int base_ = -1;
+		std::deque<RewindState> states_;
+		// Id of states_.front(), ids keep counting up as states are dropped.
+		u64 firstId_ = 0;
+		std::shared_ptr<RewindBase> base_;
 		int baseUsage_ = 0;
+		size_t lastDeltaSize_ = 0;
+
+		std::deque<CompressJob> jobs_;
+		int pendingStates_ = 0;
+		bool compressRunning_ = false;
+		std::condition_variable compressDone_;
+		std::mutex lock_;
+		std::vector<u8> spareBuffer_;
+		ZSTD_CCtx *cctx_ = nullptr;
 
 		double rewindLastTime_ = 0.0f;
 	};
 
+	void RewindCompressTask::Run() {
+		ringbuffer_->RunCompress();
+	}
+
 	static bool needsProcess = false;
 	static bool needsRestart = false;
 	static std::vector<Operation> pending;
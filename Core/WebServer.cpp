@@ -76,7 +76,7 @@ static ServerStatus RetrieveStatus() {
 static bool RegisterServer(int port) {
 	bool success = false;
 	http::Client http;
-	bool cancelled = false;
+	std::atomic<bool> cancelled{};
 	net::RequestProgress progress(&cancelled);
 	Buffer theVoid = Buffer::Void();
 
@@ -23,7 +23,10 @@
 #include "Common/LogReporting.h"
 #include "Common/Math/CrossSIMD.h"
 #include "Common/Math/lin/matrix4x4.h"
+#include "Common/TimeUtil.h"
+#include "ext/xxhash.h"
 #include "Core/Config.h"
+#include "Core/System.h"
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Common/SplineCommon.h"
 #include "GPU/Common/VertexDecoderCommon.h"
@@ -36,7 +39,15 @@ enum {
 	TRANSFORMED_VERTEX_BUFFER_SIZE = VERTEX_BUFFER_MAX * sizeof(TransformedVertex)
 };
 
-DrawEngineCommon::DrawEngineCommon() : decoderMap_(16) {
+// Smaller ranges aren't worth a lookup.
+#define VERTEXCACHE_MIN_VERTS 32
+#define VERTEXCACHE_MAX_BYTES 16 * 1024 * 1024
+#define VERTEXCACHE_DECIMATION_INTERVAL 17
+#define VERTEXCACHE_KILL_AGE 120
+// Changing again within this many frames makes an entry unreliable.
+#define VERTEXCACHE_FRAME_CHANGE_FREQUENT 6
+
+DrawEngineCommon::DrawEngineCommon() : decoderMap_(16), decodedVertexCache_(256) {
 	if (g_Config.bVertexDecoderJit && (g_Config.iCpuCore == (int)CPUCore::JIT || g_Config.iCpuCore == (int)CPUCore::JIT_IR)) {
 		decJitCache_ = new VertexDecoderJitCache();
 	}
@@ -55,6 +66,7 @@ DrawEngineCommon::~DrawEngineCommon() {
 	decoderMap_.Iterate([&](const uint32_t vtype, VertexDecoder *decoder) {
 		delete decoder;
 	});
+	DrawEngineCommon::ClearTrackedVertexArrays();
 	ClearSplineBezierWeights();
 }
 
@@ -133,6 +145,34 @@ void DrawEngineCommon::NotifyConfigChanged() {
 	useHWTransform_ = g_Config.bHardwareTransform;
 	useHWTessellation_ = UpdateUseHWTessellation(g_Config.bHardwareTessellation);
 	decOptions_.applySkinInDecode = g_Config.bSoftwareSkinning;
+	useVertexCache_ = g_Config.bVertexCache;
+}
+
+void DrawEngineCommon::ClearTrackedVertexArrays() {
+	decodedVertexCache_.Iterate([&](const DecodedVertexCacheKey &key, DecodedVertexCacheEntry *entry) {
+		delete[] entry->decoded;
+		delete entry;
+	});
+	decodedVertexCache_.Clear();
+	decodedVertexCacheBytes_ = 0;
+}
+
+void DrawEngineCommon::DecimateTrackedVertexArrays() {
+	const int frame = gpuStats.numFlips;
+	decodedVertexCacheDecimationFrame_ = frame;
+
+	std::vector<DecodedVertexCacheKey> dead;
+	decodedVertexCache_.Iterate([&](const DecodedVertexCacheKey &key, DecodedVertexCacheEntry *entry) {
+		if (frame - entry->lastFrame > VERTEXCACHE_KILL_AGE) {
+			decodedVertexCacheBytes_ -= entry->decoded ? entry->decodedSize : 0;
+			delete[] entry->decoded;
+			delete entry;
+			dead.push_back(key);
+		}
+	});
+	for (const auto &key : dead)
+		decodedVertexCache_.Remove(key);
+	decodedVertexCache_.Maintain();
 }
 
 u32 DrawEngineCommon::NormalizeVertices(u8 *outPtr, u8 *bufPtr, const u8 *inPtr, int lowerBound, int upperBound, u32 vertType, int *vertexSize) {
@@ -972,8 +1012,12 @@ bool DrawEngineCommon::SubmitPrim(const void *verts, const void *inds, GEPrimiti
 void DrawEngineCommon::DecodeVerts(u8 *dest) {
 	// Note that this should be able to continue a partial decode - we don't necessarily start from zero here (although we do most of the time).
 
+	const double start = coreCollectDebugStats ? time_now_d() : 0.0;
 	int i = decodeVertsCounter_;
 	int stride = (int)dec_->GetDecVtxFmt().stride;
+	// Morphing and skinning depend on more than the vertex data, so those aren't cached.
+	const bool applySkin = (lastVType_ & GE_VTYPE_WEIGHT_MASK) && decOptions_.applySkinInDecode;
+	const bool useCache = useVertexCache_ && (lastVType_ & GE_VTYPE_MORPHCOUNT_MASK) == 0 && !applySkin;
 	for (; i < numDrawVerts_; i++) {
 		DeferredVerts &dv = drawVerts_[i];
 
@@ -981,11 +1025,110 @@ void DrawEngineCommon::DecodeVerts(u8 *dest) {
 		drawVertexOffsets_[i] = numDecodedVerts_ - indexLowerBound;
 
 		int indexUpperBound = dv.indexUpperBound;
-		// Decode the verts (and at the same time apply morphing/skinning). Simple.
-		dec_->DecodeVerts(dest + numDecodedVerts_ * stride, dv.verts, &dv.uvScale, indexLowerBound, indexUpperBound);
-		numDecodedVerts_ += indexUpperBound - indexLowerBound + 1;
+		int count = indexUpperBound - indexLowerBound + 1;
+		if (useCache && count >= VERTEXCACHE_MIN_VERTS) {
+			DecodeVertsCached(dest + numDecodedVerts_ * stride, dv);
+		} else {
+			// Decode the verts (and at the same time apply morphing/skinning). Simple.
+			dec_->DecodeVerts(dest + numDecodedVerts_ * stride, dv.verts, &dv.uvScale, indexLowerBound, indexUpperBound);
+		}
+		numDecodedVerts_ += count;
 	}
 	decodeVertsCounter_ = i;
+
+	if (coreCollectDebugStats)
+		gpuStats.timeVertexDecode += time_now_d() - start;
+}
+
+void DrawEngineCommon::DecodeVertsCached(u8 *dest, const DeferredVerts &dv) {
+	const int frame = gpuStats.numFlips;
+	if (frame - decodedVertexCacheDecimationFrame_ >= VERTEXCACHE_DECIMATION_INTERVAL)
+		DecimateTrackedVertexArrays();
+
+	const int count = dv.indexUpperBound - dv.indexLowerBound + 1;
+	const u32 decodedSize = count * dec_->GetDecVtxFmt().stride;
+	DecodedVertexCacheKey key{ dv.verts, lastVType_, dv.indexLowerBound, dv.indexUpperBound };
+	DecodedVertexCacheEntry *entry = decodedVertexCache_.GetOrNull(key);
+
+	if (entry && entry->status == DecodedVertexCacheEntry::STATUS_UNRELIABLE) {
+		entry->lastFrame = frame;
+		if (frame - entry->lastChangeFrame < DecodedVertexCacheEntry::FRAMES_REGAIN_TRUST) {
+			dec_->DecodeVerts(dest, dv.verts, &dv.uvScale, dv.indexLowerBound, dv.indexUpperBound);
+			return;
+		}
+		entry->status = DecodedVertexCacheEntry::STATUS_HASHING;
+	}
+
+	const u8 *src = (const u8 *)dv.verts + dv.indexLowerBound * dec_->VertexSize();
+	const u64 hash = XXH3_64bits(src, count * dec_->VertexSize());
+
+	if (entry && entry->decoded && entry->hash == hash && !memcmp(&entry->uvScale, &dv.uvScale, sizeof(UVScale))) {
+		memcpy(dest, entry->decoded, decodedSize);
+		gstate_c.vertexFullAlpha = gstate_c.vertexFullAlpha && entry->vertexFullAlpha;
+		KnownVertexBounds &bounds = gstate_c.vertBounds;
+		bounds.minU = std::min(bounds.minU, entry->vertBounds.minU);
+		bounds.minV = std::min(bounds.minV, entry->vertBounds.minV);
+		bounds.maxU = std::max(bounds.maxU, entry->vertBounds.maxU);
+		bounds.maxV = std::max(bounds.maxV, entry->vertBounds.maxV);
+		entry->lastFrame = frame;
+		gpuStats.numVertexCacheHits++;
+		return;
+	}
+	gpuStats.numVertexCacheMisses++;
+
+	// Decode from a clean slate, so we can tell what this range contributes.
+	const bool vertexFullAlpha = gstate_c.vertexFullAlpha;
+	const KnownVertexBounds bounds = gstate_c.vertBounds;
+	gstate_c.vertexFullAlpha = true;
+	gstate_c.vertBounds.minU = 512;
+	gstate_c.vertBounds.minV = 512;
+	gstate_c.vertBounds.maxU = 0;
+	gstate_c.vertBounds.maxV = 0;
+	dec_->DecodeVerts(dest, dv.verts, &dv.uvScale, dv.indexLowerBound, dv.indexUpperBound);
+	const bool decodedFullAlpha = gstate_c.vertexFullAlpha;
+	const KnownVertexBounds decodedBounds = gstate_c.vertBounds;
+	gstate_c.vertexFullAlpha = vertexFullAlpha && decodedFullAlpha;
+	gstate_c.vertBounds.minU = std::min(bounds.minU, decodedBounds.minU);
+	gstate_c.vertBounds.minV = std::min(bounds.minV, decodedBounds.minV);
+	gstate_c.vertBounds.maxU = std::max(bounds.maxU, decodedBounds.maxU);
+	gstate_c.vertBounds.maxV = std::max(bounds.maxV, decodedBounds.maxV);
+
+	if (!entry) {
+		if (decodedVertexCacheBytes_ + decodedSize > VERTEXCACHE_MAX_BYTES) {
+			// Full, wait for decimation to make room.
+			return;
+		}
+		entry = new DecodedVertexCacheEntry{};
+		entry->lastChangeFrame = frame;
+		decodedVertexCache_.Insert(key, entry);
+	} else if (entry->decoded) {
+		// The data changed under us.
+		entry->numInvalidated++;
+		if (frame - entry->lastChangeFrame < VERTEXCACHE_FRAME_CHANGE_FREQUENT) {
+			entry->status = DecodedVertexCacheEntry::STATUS_UNRELIABLE;
+			entry->lastChangeFrame = frame;
+			entry->lastFrame = frame;
+			decodedVertexCacheBytes_ -= entry->decodedSize;
+			delete[] entry->decoded;
+			entry->decoded = nullptr;
+			return;
+		}
+		entry->lastChangeFrame = frame;
+	}
+
+	if (!entry->decoded) {
+		if (decodedVertexCacheBytes_ + decodedSize > VERTEXCACHE_MAX_BYTES)
+			return;
+		entry->decoded = new u8[decodedSize];
+		entry->decodedSize = decodedSize;
+		decodedVertexCacheBytes_ += decodedSize;
+	}
+	memcpy(entry->decoded, dest, decodedSize);
+	entry->hash = hash;
+	entry->uvScale = dv.uvScale;
+	entry->vertexFullAlpha = decodedFullAlpha;
+	entry->vertBounds = decodedBounds;
+	entry->lastFrame = frame;
 }
 
 int DrawEngineCommon::DecodeInds() {
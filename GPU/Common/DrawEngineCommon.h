@@ -69,6 +69,37 @@ class TessellationDataTransfer {
 	virtual void SendDataToShader(const SimpleVertex *const *points, int size_u, int size_v, u32 vertType, const Spline::Weight2D &weights) = 0;
 };
 
+// A vertex range decoded in an earlier flush, kept across frames so static geometry doesn't need
+// decoding again. Modeled on TexCacheEntry, but always verified against a hash of the source.
+struct DecodedVertexCacheEntry {
+	// After marking STATUS_UNRELIABLE, we'll try caching it again after this many frames.
+	const static int FRAMES_REGAIN_TRUST = 300;
+
+	enum Status : u8 {
+		STATUS_HASHING = 0,     // Hashed on every use, and the decoded copy used if it matches.
+		STATUS_UNRELIABLE = 1,  // Changed too often to be worth it, decoded directly.
+	};
+
+	u64 hash;
+	u8 *decoded;  // null when unreliable.
+	u32 decodedSize;
+	UVScale uvScale;
+	int lastFrame;
+	int lastChangeFrame;
+	int numInvalidated;
+	Status status;
+	// What the decode did to gstate_c, replayed on a hit.
+	bool vertexFullAlpha;
+	KnownVertexBounds vertBounds;
+};
+
+struct DecodedVertexCacheKey {
+	const void *verts;
+	u32 vertTypeID;
+	u16 indexLowerBound;
+	u16 indexUpperBound;
+};
+
 // Culling plane, group of 8.
 struct alignas(16) Plane8 {
 	float x[8], y[8], z[8], w[8];
@@ -145,7 +176,7 @@ class DrawEngineCommon {
 
 	VertexDecoder *GetVertexDecoder(u32 vtype);
 
-	virtual void ClearTrackedVertexArrays() {}
+	virtual void ClearTrackedVertexArrays();
 
 protected:
 	virtual bool UpdateUseHWTessellation(bool enabled) const { return enabled; }
@@ -153,6 +184,7 @@ class DrawEngineCommon {
 
 	void DecodeVerts(u8 *dest);
 	int DecodeInds();
+	void DecimateTrackedVertexArrays();
 
 	// Preprocessing for spline/bezier
 	u32 NormalizeVertices(u8 *outPtr, u8 *bufPtr, const u8 *inPtr, int lowerBound, int upperBound, u32 vertType, int *vertexSize = nullptr);
@@ -285,6 +317,8 @@ class DrawEngineCommon {
 		u16 offset;
 	};
 
+	void DecodeVertsCached(u8 *dest, const DeferredVerts &dv);
+
 	enum { MAX_DEFERRED_DRAW_VERTS = 128 };  // If you change this to more than 256, change type of DeferredInds::vertDecodeIndex.
 	enum { MAX_DEFERRED_DRAW_INDS = 512 };  // Monster Hunter spams indexed calls that we end up merging.
 	DeferredVerts drawVerts_[MAX_DEFERRED_DRAW_VERTS];
@@ -304,6 +338,12 @@ class DrawEngineCommon {
 	bool anyCCWOrIndexed_ = 0;
 	bool anyIndexed_ = 0;
 
+	// Decoded vertex cache
+	DenseHashMap<DecodedVertexCacheKey, DecodedVertexCacheEntry *> decodedVertexCache_;
+	size_t decodedVertexCacheBytes_ = 0;
+	int decodedVertexCacheDecimationFrame_ = 0;
+	bool useVertexCache_ = false;
+
 	// Vertex collector state
 	IndexGenerator indexGen;
 	int numDecodedVerts_ = 0;
@@ -523,6 +523,9 @@ TexCacheEntry *TextureCacheCommon::SetTexture() {
 				reason = "minihash";
 			} else if (entry->GetHashStatus() == TexCacheEntry::STATUS_RELIABLE) {
 				rehash = false;
+			} else if (rehash && g_Config.bTextureWriteTracking && bufw == entry->bufw && !MemWriteTrackingChanged(texaddr, entry->SizeInRAM(), entry->writeSnapshot)) {
+				// Nothing has written to it since the last hash, so the hash can't have changed.
+				rehash = false;
 			}
 		}
 
@@ -2126,6 +2129,7 @@ void TextureCacheCommon::ApplyTexture() {
 			int w = gstate.getTextureWidth(0);
 			int h = gstate.getTextureHeight(0);
 			bool swizzled = gstate.isTextureSwizzled();
+			entry->writeSnapshot = MemWriteTrackingSnapshot();
 			entry->fullhash = QuickTexHash(replacer_, entry->addr, entry->bufw, w, h, swizzled, GETextureFormat(entry->format), entry);
 
 			// TODO: Here we could check the secondary cache; maybe the texture is in there?
@@ -2560,6 +2564,7 @@ bool TextureCacheCommon::CheckFullHash(TexCacheEntry *entry, bool &doDelete) {
 	u32 fullhash;
 	{
 		PROFILE_THIS_SCOPE("texhash");
+		entry->writeSnapshot = MemWriteTrackingSnapshot();
 		fullhash = QuickTexHash(replacer_, entry->addr, entry->bufw, w, h, swizzled, GETextureFormat(entry->format), entry);
 	}
 
@@ -2639,6 +2644,11 @@ void TextureCacheCommon::Invalidate(u32 addr, int size, GPUInvalidationType type
 	addr &= 0x3FFFFFFF;
 	const u32 addr_end = addr + size;
 
+	// These come from dcache writebacks, which is how CPU writes (that we can't track) become
+	// visible to the GE.
+	if (g_memWriteTracking)
+		MemWriteTrackingMark(addr, size);
+
 	if (type == GPU_INVALIDATE_ALL) {
 		// This is an active signal from the game that something in the texture cache may have changed.
 		gstate_c.Dirty(DIRTY_TEXTURE_IMAGE);
@@ -2698,6 +2708,8 @@ void TextureCacheCommon::Invalidate(u32 addr, int size, GPUInvalidationType type
 }
 
 void TextureCacheCommon::InvalidateAll(GPUInvalidationType /*unused*/) {
+	MemWriteTrackingMarkAll();
+
 	// If we're hashing every use, without backoff, then this isn't needed.
 	if (!g_Config.bTextureBackoffCache) {
 		return;
@@ -3002,8 +3014,11 @@ void TextureCacheCommon::LoadTextureLevel(TexCacheEntry &entry, uint8_t *data, s
 			texDecFlags |= TexDecodeFlags::TO_CLUT8;
 		}
 
+		const double decodeStart = coreCollectDebugStats ? time_now_d() : 0.0;
 		CheckAlphaResult alphaResult = DecodeTextureLevel((u8 *)pixelData, decPitch, tfmt, clutformat, texaddr, srcLevel, bufw, texDecFlags);
 		entry.SetAlphaStatus(alphaResult, srcLevel);
+		if (coreCollectDebugStats)
+			gpuStats.timeTextureDecode += time_now_d() - decodeStart;
 
 		int scaledW = w, scaledH = h;
 		if (plan.scaleFactor > 1) {
@@ -192,6 +192,7 @@ struct TexCacheEntry {
 	int numInvalidated;
 	u32 framesUntilNextFullHash;
 	u32 fullhash;
+	u32 writeSnapshot;  // From MemWriteTrackingSnapshot() when fullhash was computed.
 	u32 cluthash;
 	u16 maxSeenV;
 	ReplacedTexture *replacedTexture;
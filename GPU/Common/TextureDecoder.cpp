@@ -32,6 +32,7 @@
 #ifdef _M_SSE
 #include <emmintrin.h>
 #include <smmintrin.h>
+#include <immintrin.h>
 #endif
 
 #if PPSSPP_ARCH(ARM_NEON)
@@ -825,3 +826,242 @@ void CheckMask32(const u32 *src, int width, u32 *outMask) {
 	}
 	*outMask &= (u32)mask;
 }
+
+template <typename ClutT>
+static void DeIndexTextureScalar(ClutT *dest, const u8 *indexed, int length, const ClutT *clut, u32 *outAlphaSum) {
+	ClutT alphaSum = (ClutT)(-1);
+	for (int i = 0; i < length; ++i) {
+		ClutT color = clut[indexed[i]];
+		alphaSum &= color;
+		dest[i] = color;
+	}
+	*outAlphaSum &= (u32)alphaSum;
+}
+
+template <typename ClutT>
+static void DeIndexTexture4Scalar(ClutT *dest, const u8 *indexed, int length, const ClutT *clut, u32 *outAlphaSum) {
+	ClutT alphaSum = (ClutT)(-1);
+	while (length >= 2) {
+		u8 index = *indexed++;
+		ClutT color0 = clut[index & 0xf];
+		ClutT color1 = clut[index >> 4];
+		*dest++ = color0;
+		*dest++ = color1;
+		alphaSum &= color0 & color1;
+		length -= 2;
+	}
+	if (length) {  // Last pixel. Can really only happen in 1xY textures, but making this work generically.
+		ClutT color0 = clut[*indexed & 0xf];
+		*dest = color0;
+		alphaSum &= color0;
+	}
+	*outAlphaSum &= (u32)alphaSum;
+}
+
+// The SIMD kernels below handle as many texels as they can in whole vectors, and return
+// how many that was. The rest is left for the scalar versions.
+
+#ifdef _M_SSE
+
+// A 16-entry CLUT fits a pshufb lookup once split into one table per byte.
+[[gnu::target("sse4.1")]]
+static int DeIndexTexture4SSE4(u16 *dest, const u8 *indexed, int length, const u16 *clut, u32 *outAlphaSum) {
+	const __m128i splitBytes = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	const __m128i clut0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)clut), splitBytes);
+	const __m128i clut1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 8)), splitBytes);
+	const __m128i tableLo = _mm_unpacklo_epi64(clut0, clut1);
+	const __m128i tableHi = _mm_unpackhi_epi64(clut0, clut1);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+	__m128i alpha = _mm_set1_epi32(-1);
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m128i packed = _mm_loadu_si128((const __m128i *)(indexed + i / 2));
+		const __m128i lo = _mm_and_si128(packed, nibbleMask);
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+		// The low nibble is the first texel of each byte.
+		const __m128i index[2] = { _mm_unpacklo_epi8(lo, hi), _mm_unpackhi_epi8(lo, hi) };
+		for (int j = 0; j < 2; ++j) {
+			const __m128i colorLo = _mm_shuffle_epi8(tableLo, index[j]);
+			const __m128i colorHi = _mm_shuffle_epi8(tableHi, index[j]);
+			const __m128i color0 = _mm_unpacklo_epi8(colorLo, colorHi);
+			const __m128i color1 = _mm_unpackhi_epi8(colorLo, colorHi);
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16), color0);
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16 + 8), color1);
+			alpha = _mm_and_si128(alpha, _mm_and_si128(color0, color1));
+		}
+	}
+	*outAlphaSum &= SSEReduce16And(alpha);
+	return i;
+}
+
+[[gnu::target("sse4.1")]]
+static int DeIndexTexture4SSE4(u32 *dest, const u8 *indexed, int length, const u32 *clut, u32 *outAlphaSum) {
+	// Gather byte N of each entry into table N, which is a 4x4 transpose after the shuffle.
+	const __m128i splitBytes = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	__m128i split[4];
+	for (int j = 0; j < 4; ++j)
+		split[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + j * 4)), splitBytes);
+	const __m128i t0 = _mm_unpacklo_epi32(split[0], split[1]);
+	const __m128i t1 = _mm_unpacklo_epi32(split[2], split[3]);
+	const __m128i t2 = _mm_unpackhi_epi32(split[0], split[1]);
+	const __m128i t3 = _mm_unpackhi_epi32(split[2], split[3]);
+	const __m128i table0 = _mm_unpacklo_epi64(t0, t1);
+	const __m128i table1 = _mm_unpackhi_epi64(t0, t1);
+	const __m128i table2 = _mm_unpacklo_epi64(t2, t3);
+	const __m128i table3 = _mm_unpackhi_epi64(t2, t3);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+	__m128i alpha = _mm_set1_epi32(-1);
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i packed = _mm_loadl_epi64((const __m128i *)(indexed + i / 2));
+		const __m128i lo = _mm_and_si128(packed, nibbleMask);
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+		const __m128i index = _mm_unpacklo_epi8(lo, hi);
+
+		const __m128i b0 = _mm_shuffle_epi8(table0, index);
+		const __m128i b1 = _mm_shuffle_epi8(table1, index);
+		const __m128i b2 = _mm_shuffle_epi8(table2, index);
+		const __m128i b3 = _mm_shuffle_epi8(table3, index);
+		const __m128i b01lo = _mm_unpacklo_epi8(b0, b1);
+		const __m128i b01hi = _mm_unpackhi_epi8(b0, b1);
+		const __m128i b23lo = _mm_unpacklo_epi8(b2, b3);
+		const __m128i b23hi = _mm_unpackhi_epi8(b2, b3);
+		const __m128i color0 = _mm_unpacklo_epi16(b01lo, b23lo);
+		const __m128i color1 = _mm_unpackhi_epi16(b01lo, b23lo);
+		const __m128i color2 = _mm_unpacklo_epi16(b01hi, b23hi);
+		const __m128i color3 = _mm_unpackhi_epi16(b01hi, b23hi);
+		_mm_storeu_si128((__m128i *)(dest + i + 0), color0);
+		_mm_storeu_si128((__m128i *)(dest + i + 4), color1);
+		_mm_storeu_si128((__m128i *)(dest + i + 8), color2);
+		_mm_storeu_si128((__m128i *)(dest + i + 12), color3);
+		alpha = _mm_and_si128(alpha, _mm_and_si128(_mm_and_si128(color0, color1), _mm_and_si128(color2, color3)));
+	}
+	*outAlphaSum &= SSEReduce32And(alpha);
+	return i;
+}
+
+[[gnu::target("avx2")]]
+static inline u32 AVX2Reduce32And(__m256i value) {
+	return SSEReduce32And(_mm_and_si128(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1)));
+}
+
+// 256 entries is too many for byte shuffles, but a gather fits well.
+[[gnu::target("avx2")]]
+static int DeIndexTextureAVX2(u32 *dest, const u8 *indexed, int length, const u32 *clut, u32 *outAlphaSum) {
+	__m256i alpha = _mm256_set1_epi32(-1);
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i packed = _mm_loadu_si128((const __m128i *)(indexed + i));
+		const __m256i index0 = _mm256_cvtepu8_epi32(packed);
+		const __m256i index1 = _mm256_cvtepu8_epi32(_mm_srli_si128(packed, 8));
+		const __m256i color0 = _mm256_i32gather_epi32((const int *)clut, index0, 4);
+		const __m256i color1 = _mm256_i32gather_epi32((const int *)clut, index1, 4);
+		_mm256_storeu_si256((__m256i *)(dest + i), color0);
+		_mm256_storeu_si256((__m256i *)(dest + i + 8), color1);
+		alpha = _mm256_and_si256(alpha, _mm256_and_si256(color0, color1));
+	}
+	*outAlphaSum &= AVX2Reduce32And(alpha);
+	return i;
+}
+
+#endif
+
+#if PPSSPP_ARCH(ARM64_NEON)
+
+static inline u32 NEONReduce8And(uint8x16_t value) {
+	u32 mask = NEONReduce32And(vreinterpretq_u32_u8(value));
+	mask &= mask >> 16;
+	return (mask & (mask >> 8)) & 0xFF;
+}
+
+// vld2/vld4 split the CLUT into per-byte tables for tbl, and vst2/vst4 put the bytes back together.
+static int DeIndexTexture4NEON(u16 *dest, const u8 *indexed, int length, const u16 *clut, u32 *outAlphaSum) {
+	const uint8x16x2_t table = vld2q_u8((const u8 *)clut);
+	const uint8x16_t nibbleMask = vdupq_n_u8(0x0F);
+
+	uint8x16_t alphaLo = vdupq_n_u8(0xFF);
+	uint8x16_t alphaHi = vdupq_n_u8(0xFF);
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const uint8x16_t packed = vld1q_u8(indexed + i / 2);
+		// The low nibble is the first texel of each byte.
+		const uint8x16x2_t index = vzipq_u8(vandq_u8(packed, nibbleMask), vshrq_n_u8(packed, 4));
+		for (int j = 0; j < 2; ++j) {
+			uint8x16x2_t color;
+			color.val[0] = vqtbl1q_u8(table.val[0], index.val[j]);
+			color.val[1] = vqtbl1q_u8(table.val[1], index.val[j]);
+			vst2q_u8((u8 *)(dest + i + j * 16), color);
+			alphaLo = vandq_u8(alphaLo, color.val[0]);
+			alphaHi = vandq_u8(alphaHi, color.val[1]);
+		}
+	}
+	*outAlphaSum &= NEONReduce8And(alphaLo) | (NEONReduce8And(alphaHi) << 8);
+	return i;
+}
+
+static int DeIndexTexture4NEON(u32 *dest, const u8 *indexed, int length, const u32 *clut, u32 *outAlphaSum) {
+	const uint8x16x4_t table = vld4q_u8((const u8 *)clut);
+	const uint8x8_t nibbleMask = vdup_n_u8(0x0F);
+
+	uint8x16_t alpha[4];
+	for (int j = 0; j < 4; ++j)
+		alpha[j] = vdupq_n_u8(0xFF);
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint8x8_t packed = vld1_u8(indexed + i / 2);
+		const uint8x8x2_t zipped = vzip_u8(vand_u8(packed, nibbleMask), vshr_n_u8(packed, 4));
+		const uint8x16_t index = vcombine_u8(zipped.val[0], zipped.val[1]);
+		uint8x16x4_t color;
+		for (int j = 0; j < 4; ++j) {
+			color.val[j] = vqtbl1q_u8(table.val[j], index);
+			alpha[j] = vandq_u8(alpha[j], color.val[j]);
+		}
+		vst4q_u8((u8 *)(dest + i), color);
+	}
+	u32 mask = 0;
+	for (int j = 0; j < 4; ++j)
+		mask |= NEONReduce8And(alpha[j]) << (j * 8);
+	*outAlphaSum &= mask;
+	return i;
+}
+
+#endif
+
+void DeIndexTextureNaked(u16 *dest, const u8 *indexed, int length, const u16 *clut, u32 *outAlphaSum) {
+	// Gathering 16-bit entries (as 32-bit with a fixup for the last entry) measured no faster
+	// than this loop, which compilers already unroll well.
+	DeIndexTextureScalar(dest, indexed, length, clut, outAlphaSum);
+}
+
+void DeIndexTextureNaked(u32 *dest, const u8 *indexed, int length, const u32 *clut, u32 *outAlphaSum) {
+	int done = 0;
+#ifdef _M_SSE
+	if (cpu_info.bAVX2)
+		done = DeIndexTextureAVX2(dest, indexed, length, clut, outAlphaSum);
+#endif
+	DeIndexTextureScalar(dest + done, indexed + done, length - done, clut, outAlphaSum);
+}
+
+void DeIndexTexture4Naked(u16 *dest, const u8 *indexed, int length, const u16 *clut, u32 *outAlphaSum) {
+	int done = 0;
+#ifdef _M_SSE
+	if (cpu_info.bSSE4_1)
+		done = DeIndexTexture4SSE4(dest, indexed, length, clut, outAlphaSum);
+#elif PPSSPP_ARCH(ARM64_NEON)
+	done = DeIndexTexture4NEON(dest, indexed, length, clut, outAlphaSum);
+#endif
+	DeIndexTexture4Scalar(dest + done, indexed + done / 2, length - done, clut, outAlphaSum);
+}
+
+void DeIndexTexture4Naked(u32 *dest, const u8 *indexed, int length, const u32 *clut, u32 *outAlphaSum) {
+	int done = 0;
+#ifdef _M_SSE
+	if (cpu_info.bSSE4_1)
+		done = DeIndexTexture4SSE4(dest, indexed, length, clut, outAlphaSum);
+#elif PPSSPP_ARCH(ARM64_NEON)
+	done = DeIndexTexture4NEON(dest, indexed, length, clut, outAlphaSum);
+#endif
+	DeIndexTexture4Scalar(dest + done, indexed + done / 2, length - done, clut, outAlphaSum);
+}
@@ -107,6 +107,13 @@ inline CheckAlphaResult CheckAlpha32Rect(const u32 *pixelData, int stride, int w
 	return AlphaSumIsFull(alphaSum, fullAlphaMask) ? CHECKALPHA_FULL : CHECKALPHA_ANY;
 }
 
+// The common case of DeIndexTexture/DeIndexTexture4 with 8-bit or 4-bit indices and no special
+// offset, mask, or shift. These use SIMD kernels when the CPU supports them.
+void DeIndexTextureNaked(u16 *dest, const u8 *indexed, int length, const u16 *clut, u32 *outAlphaSum);
+void DeIndexTextureNaked(u32 *dest, const u8 *indexed, int length, const u32 *clut, u32 *outAlphaSum);
+void DeIndexTexture4Naked(u16 *dest, const u8 *indexed, int length, const u16 *clut, u32 *outAlphaSum);
+void DeIndexTexture4Naked(u32 *dest, const u8 *indexed, int length, const u32 *clut, u32 *outAlphaSum);
+
 template <typename IndexT, typename ClutT>
 inline void DeIndexTexture(/*WRITEONLY*/ ClutT *dest, const IndexT *indexed, int length, const ClutT *clut, u32 *outAlphaSum) {
 	// Usually, there is no special offset, mask, or shift.
@@ -116,11 +123,8 @@ inline void DeIndexTexture(/*WRITEONLY*/ ClutT *dest, const IndexT *indexed, int
 
 	if (nakedIndex) {
 		if (sizeof(IndexT) == 1) {
-			for (int i = 0; i < length; ++i) {
-				ClutT color = clut[*indexed++];
-				alphaSum &= color;
-				*dest++ = color;
-			}
+			DeIndexTextureNaked(dest, (const u8 *)indexed, length, clut, outAlphaSum);
+			return;
 		} else {
 			for (int i = 0; i < length; ++i) {
 				ClutT color = clut[(*indexed++) & 0xFF];
@@ -150,39 +154,26 @@ inline void DeIndexTexture4(/*WRITEONLY*/ ClutT *dest, const u8 *indexed, int le
 	// Usually, there is no special offset, mask, or shift.
 	const bool nakedIndex = gstate.isClutIndexSimple();
 
-	ClutT alphaSum = (ClutT)(-1);
 	if (nakedIndex) {
-		while (length >= 2) {
-			u8 index = *indexed++;
-			ClutT color0 = clut[index & 0xf];
-			ClutT color1 = clut[index >> 4];
-			*dest++ = color0;
-			*dest++ = color1;
-			alphaSum &= color0 & color1;
-			length -= 2;
-		}
-		if (length) {  // Last pixel. Can really only happen in 1xY textures, but making this work generically.
-			u8 index = *indexed++;
-			ClutT color0 = clut[index & 0xf];
-			*dest = color0;
-			alphaSum &= color0;
-		}
-	} else {
-		while (length >= 2) {
-			u8 index = *indexed++;
-			ClutT color0 = clut[gstate.transformClutIndex((index >> 0) & 0xf)];
-			ClutT color1 = clut[gstate.transformClutIndex((index >> 4) & 0xf)];
-			*dest++ = color0;
-			*dest++ = color1;
-			alphaSum &= color0 & color1;
-			length -= 2;
-		}
-		if (length) {
-			u8 index = *indexed++;
-			ClutT color0 = clut[gstate.transformClutIndex((index >> 0) & 0xf)];
-			*dest = color0;
-			alphaSum &= color0;
-		}
+		DeIndexTexture4Naked(dest, indexed, length, clut, outAlphaSum);
+		return;
+	}
+
+	ClutT alphaSum = (ClutT)(-1);
+	while (length >= 2) {
+		u8 index = *indexed++;
+		ClutT color0 = clut[gstate.transformClutIndex((index >> 0) & 0xf)];
+		ClutT color1 = clut[gstate.transformClutIndex((index >> 4) & 0xf)];
+		*dest++ = color0;
+		*dest++ = color1;
+		alphaSum &= color0 & color1;
+		length -= 2;
+	}
+	if (length) {
+		u8 index = *indexed++;
+		ClutT color0 = clut[gstate.transformClutIndex((index >> 0) & 0xf)];
+		*dest = color0;
+		alphaSum &= color0;
 	}
 
 	*outAlphaSum &= (u32)alphaSum;
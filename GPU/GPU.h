@@ -81,6 +81,8 @@ struct GPUStatistics {
 		numListSyncs = 0;
 		numVertsSubmitted = 0;
 		numUncachedVertsDrawn = 0;
+		numVertexCacheHits = 0;
+		numVertexCacheMisses = 0;
 		numTextureInvalidations = 0;
 		numTextureInvalidationsByFramebuffer = 0;
 		numTexturesHashed = 0;
@@ -105,6 +107,10 @@ struct GPUStatistics {
 		numReplacerTrackedTex = 0;
 		numCachedReplacedTextures = 0;
 		msProcessingDisplayLists = 0;
+		timeVertexDecode = 0.0;
+		timeTextureDecode = 0.0;
+		timeBinning = 0.0;
+		timeRasterizing = 0.0;
 		vertexGPUCycles = 0;
 		otherGPUCycles = 0;
 	}
@@ -120,6 +126,8 @@ struct GPUStatistics {
 	int numPlaneUpdates;
 	int numVertsSubmitted;
 	int numUncachedVertsDrawn;
+	int numVertexCacheHits;
+	int numVertexCacheMisses;
 	int numTextureInvalidations;
 	int numTextureInvalidationsByFramebuffer;
 	int numTexturesHashed;
@@ -141,6 +149,13 @@ struct GPUStatistics {
 	int numReplacerTrackedTex;
 	int numCachedReplacedTextures;
 	double msProcessingDisplayLists;
+	// Seconds spent in each stage, only collected along with msProcessingDisplayLists.
+	double timeVertexDecode;
+	double timeTextureDecode;
+	// Software renderer only. Binning includes transform and clipping, and rasterizing
+	// includes waiting on the raster threads.
+	double timeBinning;
+	double timeRasterizing;
 	int vertexGPUCycles;
 	int otherGPUCycles;
 
@@ -22,6 +22,7 @@
 #include "Common/Thread/ThreadManager.h"
 #include "Common/TimeUtil.h"
 #include "Core/System.h"
+#include "GPU/GPU.h"
 #include "GPU/Common/TextureDecoder.h"
 #include "GPU/Software/BinManager.h"
 #include "GPU/Software/Rasterizer.h"
@@ -504,11 +505,14 @@ void BinManager::Drain(bool flushing) {
 
 	if (taskRanges_.size() <= 1) {
 		PROFILE_THIS_SCOPE("bin_drain_single");
+		const double start = coreCollectDebugStats ? time_now_d() : 0.0;
 		while (!queue_.Empty()) {
 			const BinItem &item = queue_.PeekNext();
 			DrawBinItem(item, states_[item.stateIndex]);
 			queue_.SkipNext();
 		}
+		if (coreCollectDebugStats)
+			gpuStats.timeRasterizing += time_now_d() - start;
 	} else {
 		int max = flushing ? QUEUED_PRIMS : QUEUED_PRIMS / 2;
 		while (!queue_.Empty()) {
@@ -561,8 +565,11 @@ void BinManager::Flush(const char *reason) {
 		return;
 
 	double st;
-	if (coreCollectDebugStats)
+	double rasterizingBefore;
+	if (coreCollectDebugStats) {
 		st = time_now_d();
+		rasterizingBefore = gpuStats.timeRasterizing;
+	}
 	Drain(true);
 	waitable_->Wait();
 	taskRanges_.clear();
@@ -592,6 +599,8 @@ void BinManager::Flush(const char *reason) {
 
 	if (coreCollectDebugStats) {
 		double et = time_now_d();
+		// The whole flush is rasterizing or waiting for it, don't count the drain above twice.
+		gpuStats.timeRasterizing = rasterizingBefore + (et - st);
 		flushReasonTimes_[reason] += et - st;
 		if (et - st > slowestFlushTime_) {
 			slowestFlushTime_ = et - st;
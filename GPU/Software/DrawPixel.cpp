@@ -19,6 +19,8 @@
 #include <mutex>
 #include "Common/Common.h"
 #include "Common/Data/Convert/ColorConv.h"
+#include "Common/MemoryUtil.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/Config.h"
 #include "GPU/GPUState.h"
 #include "GPU/Software/BinManager.h"
@@ -36,6 +38,8 @@ PixelJitCache *jitCache = nullptr;
 
 void Init() {
 	jitCache = new PixelJitCache();
+	// Writing code while the bin threads run other code in the same pages isn't possible with W^X.
+	jitCache->SetAsyncCompile(!PlatformIsWXExclusive());
 }
 
 void FlushJit() {
@@ -765,6 +769,218 @@ void SOFTRAST_CALL DrawSinglePixel(int x, int y, int z, int fog, Vec4IntArg colo
 	SetPixelColor(fbFormat, pixelID.cached.framebufStride, x, y, new_color, old_color, targetWriteMask);
 }
 
+#if defined(_M_SSE)
+// Quads keep two pixels per register, as 16-bit RGBARGBA.
+static inline __m128i SplatAlphaPair(__m128i c) {
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Same as GetSourceFactor()/GetDestFactor(), where other is dst for the source factor and vice versa.
+static inline __m128i BlendFactorPair(PixelBlendFactor factor, __m128i source, __m128i dst, __m128i other, __m128i fix) {
+	const __m128i full = _mm_set1_epi16(255);
+	switch (factor) {
+	case PixelBlendFactor::OTHERCOLOR:
+		return other;
+
+	case PixelBlendFactor::INVOTHERCOLOR:
+		return _mm_sub_epi16(full, other);
+
+	case PixelBlendFactor::SRCALPHA:
+		return SplatAlphaPair(source);
+
+	case PixelBlendFactor::INVSRCALPHA:
+		return _mm_sub_epi16(full, SplatAlphaPair(source));
+
+	case PixelBlendFactor::DSTALPHA:
+		return SplatAlphaPair(dst);
+
+	case PixelBlendFactor::INVDSTALPHA:
+		return _mm_sub_epi16(full, SplatAlphaPair(dst));
+
+	case PixelBlendFactor::DOUBLESRCALPHA:
+		return _mm_slli_epi16(SplatAlphaPair(source), 1);
+
+	case PixelBlendFactor::DOUBLEINVSRCALPHA:
+		return _mm_sub_epi16(full, _mm_min_epi16(_mm_slli_epi16(SplatAlphaPair(source), 1), full));
+
+	case PixelBlendFactor::DOUBLEDSTALPHA:
+		return _mm_slli_epi16(SplatAlphaPair(dst), 1);
+
+	case PixelBlendFactor::DOUBLEINVDSTALPHA:
+		return _mm_sub_epi16(full, _mm_min_epi16(_mm_slli_epi16(SplatAlphaPair(dst), 1), full));
+
+	case PixelBlendFactor::FIX:
+	default:
+		return fix;
+
+	case PixelBlendFactor::ZERO:
+		return _mm_setzero_si128();
+
+	case PixelBlendFactor::ONE:
+		return full;
+	}
+}
+
+// Matches AlphaBlendingResult(), but for two pixels at once.  Only RGB is meaningful in the result.
+static inline __m128i AlphaBlendPair(const PixelFuncID &pixelID, __m128i source, __m128i dst, __m128i srcFix, __m128i dstFix) {
+	const __m128i sf = BlendFactorPair(pixelID.AlphaBlendSrc(), source, dst, dst, srcFix);
+	const __m128i df = BlendFactorPair(pixelID.AlphaBlendDst(), source, dst, source, dstFix);
+
+	// Same 4 bits of decimal trick as AlphaBlendingResult().
+	const __m128i half = _mm_set1_epi16(1 << 3);
+	auto mulFactor = [&](__m128i c, __m128i f) {
+		return _mm_mulhi_epi16(_mm_add_epi16(_mm_slli_epi16(c, 4), half), _mm_add_epi16(_mm_slli_epi16(f, 4), half));
+	};
+
+	switch (pixelID.AlphaBlendEq()) {
+	case GE_BLENDMODE_MUL_AND_ADD:
+		return _mm_adds_epi16(mulFactor(source, sf), mulFactor(dst, df));
+
+	case GE_BLENDMODE_MUL_AND_SUBTRACT:
+		return _mm_max_epi16(_mm_subs_epi16(mulFactor(source, sf), mulFactor(dst, df)), _mm_setzero_si128());
+
+	case GE_BLENDMODE_MUL_AND_SUBTRACT_REVERSE:
+		return _mm_max_epi16(_mm_subs_epi16(mulFactor(dst, df), mulFactor(source, sf)), _mm_setzero_si128());
+
+	case GE_BLENDMODE_MIN:
+		return _mm_min_epi16(source, dst);
+
+	case GE_BLENDMODE_MAX:
+		return _mm_max_epi16(source, dst);
+
+	case GE_BLENDMODE_ABSDIFF:
+		return _mm_sub_epi16(_mm_max_epi16(source, dst), _mm_min_epi16(source, dst));
+
+	default:
+		return source;
+	}
+}
+
+static inline __m128i PackColorPair(u32 a, u32 b) {
+	return _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(a), _mm_cvtsi32_si128(b)), _mm_setzero_si128());
+}
+
+// Lanes are (x, y), (x + 1, y), (x, y + 1), (x + 1, y + 1), like the triangle rasterizer's quads.
+template <GEBufferFormat fbFormat>
+void SOFTRAST_CALL DrawQuadPixels(int x, int y, const Vec4<int> &z, const Vec4<int> &fog, const Vec4<int> *colors, const Vec4<int> &mask, const PixelFuncID &pixelID) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(255);
+	__m128i prim[2];
+	for (int i = 0; i < 2; ++i)
+		prim[i] = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(colors[i * 2].ivec, colors[i * 2 + 1].ivec), zero), full);
+
+	alignas(16) u16 primArray[16];
+	_mm_store_si128((__m128i *)primArray, prim[0]);
+	_mm_store_si128((__m128i *)(primArray + 8), prim[1]);
+
+	bool live[4];
+	for (int i = 0; i < 4; ++i) {
+		live[i] = mask[i] >= 0;
+		if (!live[i])
+			continue;
+		if (pixelID.applyDepthRange && !pixelID.earlyZChecks && (z[i] < pixelID.cached.minz || z[i] > pixelID.cached.maxz))
+			live[i] = false;
+		else if (pixelID.AlphaTestFunc() != GE_COMP_ALWAYS && !AlphaTestPassed(pixelID, primArray[i * 4 + 3]))
+			live[i] = false;
+	}
+
+	if (pixelID.applyFog) {
+		// Values stay below 65536, so unsigned 16-bit is enough.
+		const Vec4<int> fogColor = Vec4<int>::FromRGBA(pixelID.cached.fogColor & 0x00FFFFFF);
+		const __m128i fogColorPair = _mm_packs_epi32(fogColor.ivec, fogColor.ivec);
+		const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		for (int i = 0; i < 2; ++i) {
+			const __m128i f = _mm_unpacklo_epi64(_mm_set1_epi16((short)fog[i * 2]), _mm_set1_epi16((short)fog[i * 2 + 1]));
+			__m128i fogged = _mm_add_epi16(_mm_mullo_epi16(prim[i], f), _mm_mullo_epi16(fogColorPair, _mm_sub_epi16(full, f)));
+			fogged = _mm_srli_epi16(_mm_add_epi16(fogged, full), 8);
+			prim[i] = _mm_or_si128(_mm_andnot_si128(alphaMask, fogged), _mm_and_si128(alphaMask, prim[i]));
+		}
+	}
+
+	const int depthStride = pixelID.cached.depthbufStride;
+	for (int i = 0; i < 4; ++i) {
+		if (!live[i])
+			continue;
+		const int px = x + (i & 1);
+		const int py = y + (i / 2);
+		if (!pixelID.earlyZChecks && pixelID.DepthTestFunc() != GE_COMP_ALWAYS && !DepthTestPassed(pixelID.DepthTestFunc(), px, py, depthStride, z[i])) {
+			live[i] = false;
+			continue;
+		}
+		if (pixelID.depthWrite)
+			SetPixelDepth(px, py, depthStride, z[i]);
+	}
+
+	if (!live[0] && !live[1] && !live[2] && !live[3])
+		return;
+
+	const int fbStride = pixelID.cached.framebufStride;
+	u32 old_color[4];
+	for (int i = 0; i < 4; ++i)
+		old_color[i] = live[i] ? GetPixelColor(fbFormat, fbStride, x + (i & 1), y + (i / 2)) : 0;
+
+	__m128i result[2];
+	if (pixelID.alphaBlend) {
+		const Vec4<int> srcFix = Vec4<int>::FromRGBA(pixelID.cached.alphaBlendSrc & 0x00FFFFFF);
+		const Vec4<int> dstFix = Vec4<int>::FromRGBA(pixelID.cached.alphaBlendDst & 0x00FFFFFF);
+		const __m128i srcFixPair = _mm_packs_epi32(srcFix.ivec, srcFix.ivec);
+		const __m128i dstFixPair = _mm_packs_epi32(dstFix.ivec, dstFix.ivec);
+		for (int i = 0; i < 2; ++i) {
+			const __m128i dst = PackColorPair(old_color[i * 2], old_color[i * 2 + 1]);
+			result[i] = AlphaBlendPair(pixelID, prim[i], dst, srcFixPair, dstFixPair);
+		}
+	} else {
+		result[0] = prim[0];
+		result[1] = prim[1];
+	}
+
+	// Dithering happens before clamping, which the pack does for us.
+	if (pixelID.dithering) {
+		const int8_t *dither = pixelID.cached.ditherMatrix;
+		for (int i = 0; i < 2; ++i) {
+			const int row = ((y + i) & 3) * 4;
+			const __m128i d = _mm_unpacklo_epi64(_mm_set1_epi16(dither[row + (x & 3)]), _mm_set1_epi16(dither[row + ((x + 1) & 3)]));
+			result[i] = _mm_add_epi16(result[i], d);
+		}
+	}
+
+	alignas(16) u32 new_color[4];
+	_mm_store_si128((__m128i *)new_color, _mm_packus_epi16(result[0], result[1]));
+
+	for (int i = 0; i < 4; ++i) {
+		if (!live[i])
+			continue;
+		const int px = x + (i & 1);
+		const int py = y + (i / 2);
+		// No stencil test, so the stencil stays what it was.
+		if (fbFormat == GE_FORMAT_8888) {
+			fb.Set32(px, py, fbStride, (new_color[i] & 0x00FFFFFF) | (old_color[i] & 0xFF000000));
+		} else {
+			fb.Set16(px, py, fbStride, RGBA8888ToRGB565(new_color[i]));
+		}
+	}
+}
+#endif
+
+QuadFunc GetQuadFunc(const PixelFuncID &id) {
+#if defined(_M_SSE)
+	// Anything that needs the stencil, or masks parts of the write, still goes pixel by pixel.
+	if (id.clearMode || id.stencilTest || id.colorTest || id.applyLogicOp || id.applyColorWriteMask)
+		return nullptr;
+
+	switch (id.FBFormat()) {
+	case GE_FORMAT_565:
+		return &DrawQuadPixels<GE_FORMAT_565>;
+	case GE_FORMAT_8888:
+		return &DrawQuadPixels<GE_FORMAT_8888>;
+	default:
+		return nullptr;
+	}
+#else
+	return nullptr;
+#endif
+}
+
 SingleFunc GetSingleFunc(const PixelFuncID &id, BinManager *binner) {
 	SingleFunc jitted = jitCache->GetSingle(id, binner);
 	if (jitted) {
@@ -802,7 +1018,31 @@ SingleFunc PixelJitCache::GenericSingle(const PixelFuncID &id) {
 }
 
 thread_local PixelJitCache::LastCache PixelJitCache::lastSingle_;
-int PixelJitCache::clearGen_ = 0;
+std::atomic<int> PixelJitCache::clearGen_{ 0 };
+
+// x64 is typically 200-500 bytes, but let's be safe.
+static constexpr size_t COMPILE_SPACE_NEEDED = 65536;
+
+class PixelJitCompileTask : public Task {
+public:
+	PixelJitCompileTask(PixelJitCache *cache) : cache_(cache) {}
+
+	TaskType Type() const override {
+		return TaskType::CPU_COMPUTE;
+	}
+
+	TaskPriority Priority() const override {
+		// Bin tasks are waiting on the generic func meanwhile, so get it done.
+		return TaskPriority::HIGH;
+	}
+
+	void Run() override {
+		cache_->RunAsyncCompile();
+	}
+
+private:
+	PixelJitCache *cache_;
+};
 
 // 256k should be plenty of space for plenty of variations.
 PixelJitCache::PixelJitCache() : CodeBlock(1024 * 64 * 4), cache_(64) {
@@ -810,11 +1050,18 @@ PixelJitCache::PixelJitCache() : CodeBlock(1024 * 64 * 4), cache_(64) {
 	clearGen_++;
 }
 
+PixelJitCache::~PixelJitCache() {
+	std::unique_lock<std::mutex> guard(jitCacheLock);
+	asyncQueue_.clear();
+	asyncDone_.wait(guard, [&] { return !asyncRunning_; });
+}
+
 void PixelJitCache::Clear() {
 	clearGen_++;
 	CodeBlock::Clear();
 	cache_.Clear();
 	addresses_.clear();
+	asyncSpaceExhausted_ = false;
 
 	constBlendHalf_11_4s_ = nullptr;
 	constBlendInvert_11_4s_ = nullptr;
@@ -841,13 +1088,24 @@ std::string PixelJitCache::DescribeCodePtr(const u8 *ptr) {
 
 void PixelJitCache::Flush() {
 	std::unique_lock<std::mutex> guard(jitCacheLock);
+	// Nothing is running now, so take over anything the worker hasn't gotten to yet.
+	compileQueue_.insert(asyncQueue_.begin(), asyncQueue_.end());
+	asyncQueue_.clear();
+
+	bool compiled = false;
 	for (const auto &queued : compileQueue_) {
 		// Might've been compiled after enqueue, but before now.
 		size_t queuedKey = std::hash<PixelFuncID>()(queued);
-		if (!cache_.ContainsKey(queuedKey))
+		if (!cache_.ContainsKey(queuedKey)) {
 			Compile(queued);
+			compiled = true;
+		}
 	}
 	compileQueue_.clear();
+
+	// Anyone who cached a nullptr for these should look again.
+	if (compiled)
+		clearGen_++;
 }
 
 SingleFunc PixelJitCache::GetSingle(const PixelFuncID &id, BinManager *binner) {
@@ -865,6 +1123,13 @@ SingleFunc PixelJitCache::GetSingle(const PixelFuncID &id, BinManager *binner) {
 		return singleFunc;
 	}
 
+	if (asyncCompile_ && !asyncSpaceExhausted_) {
+		// Use the generic func until it's ready.  The worker bumps clearGen_ under the lock, so this can't miss it.
+		QueueAsyncCompile(id);
+		lastSingle_.Set(key, nullptr, clearGen_);
+		return nullptr;
+	}
+
 	if (!binner) {
 		// Can't compile, let's try to do it later when there's an opportunity.
 		compileQueue_.insert(id);
@@ -875,6 +1140,8 @@ SingleFunc PixelJitCache::GetSingle(const PixelFuncID &id, BinManager *binner) {
 	binner->Flush("compile");
 	guard.lock();
 
+	compileQueue_.insert(asyncQueue_.begin(), asyncQueue_.end());
+	asyncQueue_.clear();
 	for (const auto &queued : compileQueue_) {
 		// Might've been compiled after enqueue, but before now.
 		size_t queuedKey = std::hash<PixelFuncID>()(queued);
@@ -895,9 +1162,44 @@ SingleFunc PixelJitCache::GetSingle(const PixelFuncID &id, BinManager *binner) {
 	}
 }
 
+void PixelJitCache::QueueAsyncCompile(const PixelFuncID &id) {
+	asyncQueue_.insert(id);
+	if (!asyncRunning_) {
+		asyncRunning_ = true;
+		g_threadManager.EnqueueTask(new PixelJitCompileTask(this));
+	}
+}
+
+void PixelJitCache::RunAsyncCompile() {
+	std::unique_lock<std::mutex> guard(jitCacheLock);
+	while (!asyncQueue_.empty()) {
+		PixelFuncID id = *asyncQueue_.begin();
+		asyncQueue_.erase(asyncQueue_.begin());
+		if (cache_.ContainsKey(std::hash<PixelFuncID>()(id)))
+			continue;
+
+		// Clearing would pull code out from under the bin threads, so leave that for a flush.
+		if (GetSpaceLeft() < COMPILE_SPACE_NEEDED) {
+			asyncSpaceExhausted_ = true;
+			compileQueue_.insert(id);
+			continue;
+		}
+
+		Compile(id);
+		// This makes every thread look it up again, and find the jitted func.
+		clearGen_++;
+
+		// Let the GPU thread in between funcs.
+		guard.unlock();
+		guard.lock();
+	}
+
+	asyncRunning_ = false;
+	asyncDone_.notify_all();
+}
+
 void PixelJitCache::Compile(const PixelFuncID &id) {
-	// x64 is typically 200-500 bytes, but let's be safe.
-	if (GetSpaceLeft() < 65536) {
+	if (GetSpaceLeft() < COMPILE_SPACE_NEEDED) {
 		Clear();
 	}
 
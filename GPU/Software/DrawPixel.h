@@ -19,6 +19,8 @@
 
 #include "ppsspp_config.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -41,6 +43,10 @@ namespace Rasterizer {
 
 typedef void (SOFTRAST_CALL *SingleFunc)(int x, int y, int z, int fog, Vec4IntArg color_in, const PixelFuncID &pixelID);
 SingleFunc GetSingleFunc(const PixelFuncID &id, BinManager *binner);
+// Draws a 2x2 quad, skipping lanes where mask is negative.
+typedef void (SOFTRAST_CALL *QuadFunc)(int x, int y, const Math3D::Vec4<int> &z, const Math3D::Vec4<int> &fog, const Math3D::Vec4<int> *colors, const Math3D::Vec4<int> &mask, const PixelFuncID &pixelID);
+// Returns nullptr if the state needs to go through SingleFunc per pixel.
+QuadFunc GetQuadFunc(const PixelFuncID &id);
 
 void Init();
 void FlushJit();
@@ -63,6 +69,7 @@ void ComputePixelBlendState(PixelBlendState &state, const PixelFuncID &id);
 class PixelJitCache : public Rasterizer::CodeBlock {
 public:
 	PixelJitCache();
+	~PixelJitCache();
 
 	// Returns a pointer to the code to run.
 	SingleFunc GetSingle(const PixelFuncID &id, BinManager *binner);
@@ -70,10 +77,17 @@ class PixelJitCache : public Rasterizer::CodeBlock {
 	void Clear() override;
 	void Flush();
 
+	// When enabled, new IDs return nullptr (use GenericSingle) while they compile on a worker thread.
+	void SetAsyncCompile(bool enable) {
+		asyncCompile_ = enable;
+	}
+	void RunAsyncCompile();
+
 	std::string DescribeCodePtr(const u8 *ptr) override;
 
 private:
 	void Compile(const PixelFuncID &id);
+	void QueueAsyncCompile(const PixelFuncID &id);
 	SingleFunc CompileSingle(const PixelFuncID &id);
 
 	RegCache::Reg GetPixelID();
@@ -128,9 +142,17 @@ class PixelJitCache : public Rasterizer::CodeBlock {
 	DenseHashMap<size_t, SingleFunc> cache_;
 	std::unordered_map<PixelFuncID, const u8 *> addresses_;
 	std::unordered_set<PixelFuncID> compileQueue_;
-	static int clearGen_;
+	static std::atomic<int> clearGen_;
 	static thread_local LastCache lastSingle_;
 
+	// Protected by jitCacheLock, like the above.
+	std::unordered_set<PixelFuncID> asyncQueue_;
+	std::condition_variable asyncDone_;
+	bool asyncCompile_ = false;
+	bool asyncRunning_ = false;
+	// Set when the worker ran out of space, only a flush can clear the code safely.
+	bool asyncSpaceExhausted_ = false;
+
 	const u8 *constBlendHalf_11_4s_ = nullptr;
 	const u8 *constBlendInvert_11_4s_ = nullptr;
 
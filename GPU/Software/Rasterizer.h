@@ -69,6 +69,8 @@ struct RasterizerState {
 	PixelFuncID pixelID;
 	SamplerID samplerID;
 	SingleFunc drawPixel;
+	// Used for triangles when not nullptr, instead of drawPixel.
+	QuadFunc drawQuad;
 	Sampler::LinearFunc linear;
 	Sampler::NearestFunc nearest;
 	uint32_t texaddr[8]{};
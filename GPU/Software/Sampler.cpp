@@ -21,7 +21,9 @@
 #include "Common/Common.h"
 #include "Common/Data/Convert/ColorConv.h"
 #include "Common/LogReporting.h"
+#include "Common/MemoryUtil.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/Config.h"
 #include "GPU/Common/TextureDecoder.h"
 #include "GPU/GPUState.h"
@@ -56,6 +58,8 @@ SamplerJitCache *jitCache = nullptr;
 
 void Init() {
 	jitCache = new SamplerJitCache();
+	// Same as the pixel JIT, this needs code pages that stay writable while executing.
+	jitCache->SetAsyncCompile(!PlatformIsWXExclusive());
 }
 
 void FlushJit() {
@@ -109,7 +113,31 @@ FetchFunc GetFetchFunc(SamplerID id, BinManager *binner) {
 thread_local SamplerJitCache::LastCache SamplerJitCache::lastFetch_;
 thread_local SamplerJitCache::LastCache SamplerJitCache::lastNearest_;
 thread_local SamplerJitCache::LastCache SamplerJitCache::lastLinear_;
-int SamplerJitCache::clearGen_ = 0;
+std::atomic<int> SamplerJitCache::clearGen_{ 0 };
+
+// This should be sufficient.
+static constexpr size_t COMPILE_SPACE_NEEDED = 16384;
+
+class SamplerJitCompileTask : public Task {
+public:
+	SamplerJitCompileTask(SamplerJitCache *cache) : cache_(cache) {}
+
+	TaskType Type() const override {
+		return TaskType::CPU_COMPUTE;
+	}
+
+	TaskPriority Priority() const override {
+		// Bin tasks are using the C++ samplers meanwhile, so get it done.
+		return TaskPriority::HIGH;
+	}
+
+	void Run() override {
+		cache_->RunAsyncCompile();
+	}
+
+private:
+	SamplerJitCache *cache_;
+};
 
 // 256k should be enough.
 SamplerJitCache::SamplerJitCache() : Rasterizer::CodeBlock(1024 * 64 * 4), cache_(64) {
@@ -119,11 +147,18 @@ SamplerJitCache::SamplerJitCache() : Rasterizer::CodeBlock(1024 * 64 * 4), cache
 	clearGen_++;
 }
 
+SamplerJitCache::~SamplerJitCache() {
+	std::unique_lock<std::mutex> guard(jitCacheLock);
+	asyncQueue_.clear();
+	asyncDone_.wait(guard, [&] { return !asyncRunning_; });
+}
+
 void SamplerJitCache::Clear() {
 	clearGen_++;
 	CodeBlock::Clear();
 	cache_.Clear();
 	addresses_.clear();
+	asyncSpaceExhausted_ = false;
 
 	const10All16_ = nullptr;
 	const10Low_ = nullptr;
@@ -163,13 +198,24 @@ std::string SamplerJitCache::DescribeCodePtr(const u8 *ptr) {
 
 void SamplerJitCache::Flush() {
 	std::unique_lock<std::mutex> guard(jitCacheLock);
+	// Nothing is running now, so take over anything the worker hasn't gotten to yet.
+	compileQueue_.insert(asyncQueue_.begin(), asyncQueue_.end());
+	asyncQueue_.clear();
+
+	bool compiled = false;
 	for (const auto &queued : compileQueue_) {
 		// Might've been compiled after enqueue, but before now.
 		size_t queuedKey = std::hash<SamplerID>()(queued);
-		if (!cache_.ContainsKey(queuedKey))
+		if (!cache_.ContainsKey(queuedKey)) {
 			Compile(queued);
+			compiled = true;
+		}
 	}
 	compileQueue_.clear();
+
+	// Anyone who cached a nullptr for these should look again.
+	if (compiled)
+		clearGen_++;
 }
 
 NearestFunc SamplerJitCache::GetByID(const SamplerID &id, size_t key, BinManager *binner) {
@@ -180,6 +226,12 @@ NearestFunc SamplerJitCache::GetByID(const SamplerID &id, size_t key, BinManager
 		return func;
 	}
 
+	if (asyncCompile_ && !asyncSpaceExhausted_) {
+		// Use the C++ sampler until it's ready.
+		QueueAsyncCompile(id);
+		return nullptr;
+	}
+
 	if (!binner) {
 		// Can't compile, let's try to do it later when there's an opportunity.
 		compileQueue_.insert(id);
@@ -190,6 +242,8 @@ NearestFunc SamplerJitCache::GetByID(const SamplerID &id, size_t key, BinManager
 	binner->Flush("compile");
 	guard.lock();
 
+	compileQueue_.insert(asyncQueue_.begin(), asyncQueue_.end());
+	asyncQueue_.clear();
 	for (const auto &queued : compileQueue_) {
 		// Might've been compiled after enqueue, but before now.
 		size_t queuedKey = std::hash<SamplerID>()(queued);
@@ -217,8 +271,10 @@ NearestFunc SamplerJitCache::GetNearest(const SamplerID &id, BinManager *binner)
 	if (lastNearest_.Match(key, clearGen_))
 		return (NearestFunc)lastNearest_.func;
 
+	// Read first, so a func compiled on the worker meanwhile isn't missed.
+	int gen = clearGen_;
 	auto func = GetByID(id, key, binner);
-	lastNearest_.Set(key, func, clearGen_);
+	lastNearest_.Set(key, func, gen);
 	return (NearestFunc)func;
 }
 
@@ -230,8 +286,9 @@ LinearFunc SamplerJitCache::GetLinear(const SamplerID &id, BinManager *binner) {
 	if (lastLinear_.Match(key, clearGen_))
 		return (LinearFunc)lastLinear_.func;
 
+	int gen = clearGen_;
 	auto func = GetByID(id, key, binner);
-	lastLinear_.Set(key, func, clearGen_);
+	lastLinear_.Set(key, func, gen);
 	return (LinearFunc)func;
 }
 
@@ -243,14 +300,50 @@ FetchFunc SamplerJitCache::GetFetch(const SamplerID &id, BinManager *binner) {
 	if (lastFetch_.Match(key, clearGen_))
 		return (FetchFunc)lastFetch_.func;
 
+	int gen = clearGen_;
 	auto func = GetByID(id, key, binner);
-	lastFetch_.Set(key, func, clearGen_);
+	lastFetch_.Set(key, func, gen);
 	return (FetchFunc)func;
 }
 
+void SamplerJitCache::QueueAsyncCompile(const SamplerID &id) {
+	asyncQueue_.insert(id);
+	if (!asyncRunning_) {
+		asyncRunning_ = true;
+		g_threadManager.EnqueueTask(new SamplerJitCompileTask(this));
+	}
+}
+
+void SamplerJitCache::RunAsyncCompile() {
+	std::unique_lock<std::mutex> guard(jitCacheLock);
+	while (!asyncQueue_.empty()) {
+		SamplerID id = *asyncQueue_.begin();
+		asyncQueue_.erase(asyncQueue_.begin());
+		if (cache_.ContainsKey(std::hash<SamplerID>()(id)))
+			continue;
+
+		// Clearing would pull code out from under the bin threads, so leave that for a flush.
+		if (GetSpaceLeft() < COMPILE_SPACE_NEEDED) {
+			asyncSpaceExhausted_ = true;
+			compileQueue_.insert(id);
+			continue;
+		}
+
+		Compile(id);
+		// This makes every thread look it up again, and find the jitted func.
+		clearGen_++;
+
+		// Let the GPU thread in between funcs.
+		guard.unlock();
+		guard.lock();
+	}
+
+	asyncRunning_ = false;
+	asyncDone_.notify_all();
+}
+
 void SamplerJitCache::Compile(const SamplerID &id) {
-	// This should be sufficient.
-	if (GetSpaceLeft() < 16384) {
+	if (GetSpaceLeft() < COMPILE_SPACE_NEEDED) {
 		Clear();
 	}
 
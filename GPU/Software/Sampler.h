@@ -19,6 +19,8 @@
 
 #include "ppsspp_config.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <unordered_map>
 #include <unordered_set>
 #include "Common/Data/Collections/Hashmaps.h"
@@ -55,6 +57,7 @@ bool DescribeCodePtr(const u8 *ptr, std::string &name);
 class SamplerJitCache : public Rasterizer::CodeBlock {
 public:
 	SamplerJitCache();
+	~SamplerJitCache();
 
 	// Returns a pointer to the code to run.
 	NearestFunc GetNearest(const SamplerID &id, BinManager *binner);
@@ -63,10 +66,17 @@ class SamplerJitCache : public Rasterizer::CodeBlock {
 	void Clear() override;
 	void Flush();
 
+	// When enabled, new IDs return nullptr (use the C++ samplers) while they compile on a worker thread.
+	void SetAsyncCompile(bool enable) {
+		asyncCompile_ = enable;
+	}
+	void RunAsyncCompile();
+
 	std::string DescribeCodePtr(const u8 *ptr) override;
 
 private:
 	void Compile(const SamplerID &id);
+	void QueueAsyncCompile(const SamplerID &id);
 	NearestFunc GetByID(const SamplerID &id, size_t key, BinManager *binner);
 	FetchFunc CompileFetch(const SamplerID &id);
 	NearestFunc CompileNearest(const SamplerID &id);
@@ -147,10 +157,18 @@ class SamplerJitCache : public Rasterizer::CodeBlock {
 	DenseHashMap<size_t, NearestFunc> cache_;
 	std::unordered_map<SamplerID, const u8 *> addresses_;
 	std::unordered_set<SamplerID> compileQueue_;
-	static int clearGen_;
+	static std::atomic<int> clearGen_;
 	static thread_local LastCache lastFetch_;
 	static thread_local LastCache lastNearest_;
 	static thread_local LastCache lastLinear_;
+
+	// Protected by jitCacheLock, like the above.
+	std::unordered_set<SamplerID> asyncQueue_;
+	std::condition_variable asyncDone_;
+	bool asyncCompile_ = false;
+	bool asyncRunning_ = false;
+	// Set when the worker ran out of space, only a flush can clear the code safely.
+	bool asyncSpaceExhausted_ = false;
 };
 
 #if defined(__clang__) || defined(__GNUC__)
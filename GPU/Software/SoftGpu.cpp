@@ -24,6 +24,7 @@
 #include "GPU/Common/TextureDecoder.h"
 #include "Common/Data/Convert/ColorConv.h"
 #include "Common/GraphicsContext.h"
+#include "Common/TimeUtil.h"
 #include "Common/LogReporting.h"
 #include "Core/Config.h"
 #include "Core/ConfigValues.h"
@@ -31,6 +32,7 @@
 #include "Core/Debugger/MemBlockInfo.h"
 #include "Core/MemMap.h"
 #include "Core/MemMapHelpers.h"
+#include "Core/System.h"
 #include "Core/HLE/sceKernelInterrupt.h"
 #include "Core/HLE/sceGe.h"
 #include "Core/MIPS/MIPS.h"
@@ -866,7 +868,19 @@ void SoftGPU::Execute_Prim(u32 op, u32 diff) {
 	int bytesRead;
 	gstate_c.UpdateUVScaleOffset();
 	drawEngine_->transformUnit.SetDirty(dirtyFlags_);
+
+	// Whatever isn't decoding or rasterizing counts as binning.
+	double start = 0.0, otherStages = 0.0;
+	if (coreCollectDebugStats) {
+		start = time_now_d();
+		otherStages = gpuStats.timeVertexDecode + gpuStats.timeRasterizing;
+	}
 	drawEngine_->transformUnit.SubmitPrimitive(verts, indices, prim, count, gstate.vertType, &bytesRead, drawEngine_);
+	if (coreCollectDebugStats)
+		gpuStats.timeBinning += time_now_d() - start - (gpuStats.timeVertexDecode + gpuStats.timeRasterizing - otherStages);
+	gpuStats.numDrawCalls++;
+	gpuStats.numVertsSubmitted += count;
+
 	dirtyFlags_ = drawEngine_->transformUnit.GetDirty();
 
 	SoftGPUVRAMDirty mark = (gstate_c.skipDrawReason & SKIPDRAW_SKIPFRAME) != 0 ? SoftGPUVRAMDirty::DIRTY : SoftGPUVRAMDirty::DIRTY | SoftGPUVRAMDirty::REALLY_DIRTY;
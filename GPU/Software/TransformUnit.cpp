@@ -23,7 +23,9 @@
 #include "Common/Math/math_util.h"
 #include "Common/MemoryUtil.h"
 #include "Common/Profiler/Profiler.h"
+#include "Common/TimeUtil.h"
 #include "Core/Config.h"
+#include "Core/System.h"
 #include "GPU/GPUState.h"
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Common/VertexDecoderCommon.h"
@@ -359,13 +361,133 @@ static inline float Dot43(const Vec4f &a, const Vec3f &b) {
 
 ClipVertexData TransformUnit::ReadVertex(const VertexReader &vreader, const TransformState &state) {
 	PROFILE_THIS_SCOPE("read_vert");
-	// If we ever thread this, we'll have to change this.
-	ClipVertexData vertex;
 
 	ModelCoords pos;
 	// VertexDecoder normally scales z, but we want it unscaled.
 	vreader.ReadPosThroughZ16(pos.AsArray());
 
+	WorldCoords worldpos;
+	ClipCoords clippos;
+	Vec3f screenScaled;
+	if (state.enableTransform) {
+		switch (MatrixMode(state.matrixMode)) {
+		case MatrixMode::POS_TO_CLIP:
+			clippos = Vec3ByMatrix44(pos, state.matrix);
+			break;
+
+		case MatrixMode::WORLD_TO_CLIP:
+			worldpos = TransformUnit::ModelToWorld(pos);
+			clippos = Vec3ByMatrix44(worldpos, state.matrix);
+			break;
+		}
+
+#ifdef _M_SSE
+		screenScaled.vec = _mm_mul_ps(clippos.vec, state.screenScale.vec);
+		screenScaled.vec = _mm_div_ps(screenScaled.vec, _mm_shuffle_ps(clippos.vec, clippos.vec, _MM_SHUFFLE(3, 3, 3, 3)));
+		screenScaled.vec = _mm_add_ps(screenScaled.vec, state.screenAdd.vec);
+#else
+		screenScaled = clippos.xyz() * state.screenScale / clippos.w + state.screenAdd;
+#endif
+	}
+
+	return FinishVertex(vreader, state, pos, worldpos, clippos, screenScaled);
+}
+
+// Positions of a batch of vertices through each step, one array per component so the math runs across vertices.
+struct TransformBatch {
+	enum { SIZE = 8 };
+
+	alignas(16) float pos[3][SIZE];
+	alignas(16) float world[3][SIZE];
+	alignas(16) float clip[4][SIZE];
+	alignas(16) float screen[3][SIZE];
+};
+
+// These do the same operations in the same order as Vec3ByMatrix43/44, so the results match exactly.
+static void BatchByMatrix(const float (&in)[3][TransformBatch::SIZE], const float *m, int rows, int components, float (*out)[TransformBatch::SIZE]) {
+	for (int k = 0; k < components; ++k) {
+		const float m0 = m[k], m1 = m[rows + k], m2 = m[rows * 2 + k], m3 = m[rows * 3 + k];
+#if defined(_M_SSE)
+		for (int i = 0; i < TransformBatch::SIZE; i += 4) {
+			__m128 xy = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m0), _mm_load_ps(&in[0][i])), _mm_mul_ps(_mm_set1_ps(m1), _mm_load_ps(&in[1][i])));
+			__m128 zw = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m2), _mm_load_ps(&in[2][i])), _mm_set1_ps(m3));
+			_mm_store_ps(&out[k][i], _mm_add_ps(xy, zw));
+		}
+#elif PPSSPP_ARCH(ARM_NEON)
+		for (int i = 0; i < TransformBatch::SIZE; i += 4) {
+			float32x4_t xy = vaddq_f32(vmulq_n_f32(vld1q_f32(&in[0][i]), m0), vmulq_n_f32(vld1q_f32(&in[1][i]), m1));
+			float32x4_t zw = vaddq_f32(vmulq_n_f32(vld1q_f32(&in[2][i]), m2), vdupq_n_f32(m3));
+			vst1q_f32(&out[k][i], vaddq_f32(xy, zw));
+		}
+#else
+		for (int i = 0; i < TransformBatch::SIZE; ++i)
+			out[k][i] = in[0][i] * m0 + in[1][i] * m1 + in[2][i] * m2 + m3;
+#endif
+	}
+}
+
+static void BatchToScreen(TransformBatch &batch, const TransformState &state) {
+	for (int k = 0; k < 3; ++k) {
+		const float scale = state.screenScale[k], add = state.screenAdd[k];
+#if defined(_M_SSE)
+		for (int i = 0; i < TransformBatch::SIZE; i += 4) {
+			__m128 scaled = _mm_div_ps(_mm_mul_ps(_mm_load_ps(&batch.clip[k][i]), _mm_set1_ps(scale)), _mm_load_ps(&batch.clip[3][i]));
+			_mm_store_ps(&batch.screen[k][i], _mm_add_ps(scaled, _mm_set1_ps(add)));
+		}
+#else
+		for (int i = 0; i < TransformBatch::SIZE; ++i)
+			batch.screen[k][i] = batch.clip[k][i] * scale / batch.clip[3][i] + add;
+#endif
+	}
+}
+
+void TransformUnit::ReadVertices(VertexReader &vreader, const TransformState &state, int count, ClipVertexData *out) {
+	PROFILE_THIS_SCOPE("read_verts");
+	if (!state.enableTransform) {
+		for (int i = 0; i < count; ++i) {
+			vreader.Goto(i);
+			out[i] = ReadVertex(vreader, state);
+		}
+		return;
+	}
+
+	TransformBatch batch{};
+	for (int base = 0; base < count; base += TransformBatch::SIZE) {
+		const int n = std::min((int)TransformBatch::SIZE, count - base);
+		for (int i = 0; i < TransformBatch::SIZE; ++i) {
+			float pos[3]{};
+			if (i < n) {
+				vreader.Goto(base + i);
+				vreader.ReadPosThroughZ16(pos);
+			}
+			batch.pos[0][i] = pos[0];
+			batch.pos[1][i] = pos[1];
+			batch.pos[2][i] = pos[2];
+		}
+
+		if (MatrixMode(state.matrixMode) == MatrixMode::WORLD_TO_CLIP) {
+			BatchByMatrix(batch.pos, gstate.worldMatrix, 3, 3, batch.world);
+			BatchByMatrix(batch.world, state.matrix, 4, 4, batch.clip);
+		} else {
+			BatchByMatrix(batch.pos, state.matrix, 4, 4, batch.clip);
+		}
+		BatchToScreen(batch, state);
+
+		for (int i = 0; i < n; ++i) {
+			vreader.Goto(base + i);
+			ModelCoords pos(batch.pos[0][i], batch.pos[1][i], batch.pos[2][i]);
+			WorldCoords worldpos(batch.world[0][i], batch.world[1][i], batch.world[2][i]);
+			ClipCoords clippos(batch.clip[0][i], batch.clip[1][i], batch.clip[2][i], batch.clip[3][i]);
+			Vec3f screenScaled(batch.screen[0][i], batch.screen[1][i], batch.screen[2][i]);
+			out[base + i] = FinishVertex(vreader, state, pos, worldpos, clippos, screenScaled);
+		}
+	}
+}
+
+ClipVertexData TransformUnit::FinishVertex(const VertexReader &vreader, const TransformState &state, const ModelCoords &pos, const WorldCoords &worldpos, const ClipCoords &clippos, const Vec3f &screenScaled) {
+	// If we ever thread this, we'll have to change this.
+	ClipVertexData vertex;
+
 	static Vec3Packedf lastTC;
 	if (state.readUV) {
 		vreader.ReadUV(vertex.v.texturecoords.AsArray());
@@ -391,27 +513,8 @@ ClipVertexData TransformUnit::ReadVertex(const VertexReader &vreader, const Tran
 	vertex.v.color1 = 0;
 
 	if (state.enableTransform) {
-		WorldCoords worldpos;
-
-		switch (MatrixMode(state.matrixMode)) {
-		case MatrixMode::POS_TO_CLIP:
-			vertex.clippos = Vec3ByMatrix44(pos, state.matrix);
-			break;
+		vertex.clippos = clippos;
 
-		case MatrixMode::WORLD_TO_CLIP:
-			worldpos = TransformUnit::ModelToWorld(pos);
-			vertex.clippos = Vec3ByMatrix44(worldpos, state.matrix);
-			break;
-		}
-
-		Vec3f screenScaled;
-#ifdef _M_SSE
-		screenScaled.vec = _mm_mul_ps(vertex.clippos.vec, state.screenScale.vec);
-		screenScaled.vec = _mm_div_ps(screenScaled.vec, _mm_shuffle_ps(vertex.clippos.vec, vertex.clippos.vec, _MM_SHUFFLE(3, 3, 3, 3)));
-		screenScaled.vec = _mm_add_ps(screenScaled.vec, state.screenAdd.vec);
-#else
-		screenScaled = vertex.clippos.xyz() * state.screenScale / vertex.clippos.w + state.screenAdd;
-#endif
 		bool outside_range_flag = false;
 		vertex.v.screenpos = state.roundToScreen(screenScaled, vertex.clippos, &outside_range_flag);
 		if (outside_range_flag) {
@@ -419,7 +522,6 @@ ClipVertexData TransformUnit::ReadVertex(const VertexReader &vreader, const Tran
 			vertex.v.screenpos.x = 0x7FFFFFFF;
 			return vertex;
 		}
-
 		if (state.enableFog) {
 			vertex.v.fogdepth = Dot43(state.posToFog, pos);
 		} else {
@@ -488,17 +590,23 @@ class SoftwareVertexReader {
 	SoftwareVertexReader(u8 *base, VertexDecoder &vdecoder, u32 vertex_type, int vertex_count, const void *vertices, const void *indices, const TransformState &transformState, TransformUnit &transform)
 	: vreader_(base, vdecoder.GetDecVtxFmt(), vertex_type), conv_(vertex_type, indices), transformState_(transformState), transform_(transform) {
 		useIndices_ = indices != nullptr;
+		vertexCount_ = vertex_count;
 		lowerBound_ = 0;
 		upperBound_ = vertex_count == 0 ? 0 : vertex_count - 1;
 
 		if (useIndices_)
 			GetIndexBounds(indices, vertex_count, vertex_type, &lowerBound_, &upperBound_);
-		if (vertex_count != 0)
+		if (vertex_count != 0) {
+			const double start = coreCollectDebugStats ? time_now_d() : 0.0;
 			vdecoder.DecodeVerts(base, vertices, &gstate_c.uv, lowerBound_, upperBound_);
+			if (coreCollectDebugStats)
+				gpuStats.timeVertexDecode += time_now_d() - start;
+		}
 
 		// If we're only using a subset of verts, it's better to decode with random access (usually.)
 		// However, if we're reusing a lot of verts, we should read and cache them.
-		useCache_ = useIndices_ && vertex_count > (upperBound_ - lowerBound_ + 1);
+		// Without indices, every vert is read once in order, so reading them all up front in batches is faster.
+		useCache_ = !useIndices_ || vertex_count > (upperBound_ - lowerBound_ + 1);
 		if (useCache_ && (int)cached_.size() < upperBound_ - lowerBound_ + 1)
 			cached_.resize(std::max(128, upperBound_ - lowerBound_ + 1));
 	}
@@ -512,13 +620,10 @@ class SoftwareVertexReader {
 	}
 
 	void UpdateCache() {
-		if (!useCache_)
+		if (!useCache_ || vertexCount_ == 0)
 			return;
 
-		for (int i = 0; i < upperBound_ - lowerBound_ + 1; ++i) {
-			vreader_.Goto(i);
-			cached_[i] = transform_.ReadVertex(vreader_, transformState_);
-		}
+		transform_.ReadVertices(vreader_, transformState_, upperBound_ - lowerBound_ + 1, cached_.data());
 	}
 
 	inline ClipVertexData Read(int vtx) {
@@ -528,7 +633,7 @@ class SoftwareVertexReader {
 			}
 			vreader_.Goto(conv_(vtx) - lowerBound_);
 		} else {
-			vreader_.Goto(vtx);
+			return cached_[vtx];
 		}
 
 		return transform_.ReadVertex(vreader_, transformState_);
@@ -542,6 +647,7 @@ class SoftwareVertexReader {
 	uint16_t lowerBound_;
 	uint16_t upperBound_;
 	static std::vector<ClipVertexData> cached_;
+	int vertexCount_ = 0;
 	bool useIndices_ = false;
 	bool useCache_ = false;
 };
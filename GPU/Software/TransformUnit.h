@@ -152,6 +152,9 @@ class TransformUnit {
 
 private:
 	ClipVertexData ReadVertex(const VertexReader &vreader, const TransformState &state);
+	// Same as ReadVertex() on vertices 0 to count - 1, but transforms their positions several at a time.
+	void ReadVertices(VertexReader &vreader, const TransformState &state, int count, ClipVertexData *out);
+	ClipVertexData FinishVertex(const VertexReader &vreader, const TransformState &state, const ModelCoords &pos, const WorldCoords &worldpos, const ClipCoords &clippos, const Vec3f &screenScaled);
 	void SendTriangle(CullType cullType, const ClipVertexData *verts, int provoking = 2);
 
 	u8 *decoded_ = nullptr;
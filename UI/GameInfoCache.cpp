@@ -21,6 +21,7 @@
 #include <map>
 #include <memory>
 #include <algorithm>
+#include <atomic>
 
 #include "Common/GPU/thin3d.h"
 #include "Common/Thread/ThreadManager.h"
@@ -28,6 +29,9 @@
 #include "Common/File/FileUtil.h"
 #include "Common/File/Path.h"
 #include "Common/Render/ManagedTexture.h"
+#include "Common/Serialize/Serializer.h"
+#include "Common/Serialize/SerializeFuncs.h"
+#include "Common/Serialize/SerializeMap.h"
 #include "Common/StringUtils.h"
 #include "Common/TimeUtil.h"
 #include "Core/FileSystems/ISOFileSystem.h"
@@ -43,6 +47,173 @@
 
 GameInfoCache *g_gameInfoCache;
 
+// The flags that can be served from the index. Sizes of savedata and such change behind the game's back, so aren't.
+static const GameInfoFlags INDEXED_FLAGS = GameInfoFlags::FILE_TYPE | GameInfoFlags::PARAM_SFO | GameInfoFlags::ICON | GameInfoFlags::UNCOMPRESSED_SIZE;
+
+// What was found out about a file the last time it was opened, valid as long as its size and mtime match.
+struct GameInfoIndexEntry {
+	u64 size = 0;
+	u64 mtime = 0;
+	GameInfoFlags flags{};
+	IdentifiedFileType fileType = IdentifiedFileType::UNKNOWN;
+	std::string title;
+	std::string id;
+	std::string id_version;
+	int disc_total = 0;
+	int disc_number = 0;
+	int region = -1;
+	std::vector<u8> paramSFO;
+	std::string icon;
+	u64 gameSizeUncompressed = 0;
+
+	void DoState(PointerWrap &p) {
+		Do(p, size);
+		Do(p, mtime);
+		Do(p, flags);
+		Do(p, fileType);
+		Do(p, title);
+		Do(p, id);
+		Do(p, id_version);
+		Do(p, disc_total);
+		Do(p, disc_number);
+		Do(p, region);
+		Do(p, paramSFO);
+		Do(p, icon);
+		Do(p, gameSizeUncompressed);
+	}
+};
+
+class GameInfoIndex {
+public:
+	static bool Indexable(const Path &gamePath) {
+		// Remote files can't be checked for changes cheaply, so they're always fetched.
+		return gamePath.Type() == PathType::NATIVE || gamePath.Type() == PathType::CONTENT_URI;
+	}
+
+	void Load(const Path &filename) {
+		std::lock_guard<std::mutex> guard(lock_);
+		filename_ = filename;
+		if (!File::Exists(filename))
+			return;
+
+		std::string gitVersion;
+		std::string errorString;
+		if (CChunkFileReader::Load(filename, &gitVersion, *this, &errorString) != CChunkFileReader::ERROR_NONE) {
+			WARN_LOG(LOADER, "Game info index unusable, starting over: %s", errorString.c_str());
+			entries_.clear();
+		}
+	}
+
+	// Skipped if the last save was less than minInterval seconds ago, since it rewrites the whole file.
+	void Save(double minInterval = 0.0) {
+		// Writes happen in the order the snapshots were taken, but lookups don't wait on the disk.
+		std::lock_guard<std::mutex> saveGuard(saveLock_);
+		GameInfoIndex snapshot;
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			if (!dirty_ || filename_.empty())
+				return;
+			double now = time_now_d();
+			if (now - lastSave_ < minInterval)
+				return;
+			snapshot.entries_ = entries_;
+			snapshot.filename_ = filename_;
+			dirty_ = false;
+			lastSave_ = now;
+		}
+
+		File::CreateFullPath(snapshot.filename_.NavigateUp());
+		if (CChunkFileReader::Save(snapshot.filename_, "GameInfoIndex", PPSSPP_GIT_VERSION, snapshot) != CChunkFileReader::ERROR_NONE) {
+			std::lock_guard<std::mutex> guard(lock_);
+			dirty_ = true;
+		}
+	}
+
+	// Mobile apps rarely get to shut down cleanly, so save when a batch of lookups is done.
+	// Scrolling through a big list finishes lots of small batches, so not every time.
+	void BeginWork() {
+		pendingWork_++;
+	}
+	void EndWork() {
+		if (--pendingWork_ == 0)
+			Save(SAVE_INTERVAL);
+	}
+
+	// Doesn't touch the file, it's up to the caller to check it later with Matches().
+	bool Lookup(const Path &gamePath, GameInfoIndexEntry *entry) {
+		std::lock_guard<std::mutex> guard(lock_);
+		auto iter = entries_.find(gamePath.ToString());
+		if (iter == entries_.end())
+			return false;
+		*entry = iter->second;
+		return true;
+	}
+
+	// A file that doesn't match anymore is dropped, and gets a new entry once it's been looked at again.
+	bool Matches(const Path &gamePath, const File::FileInfo &fileInfo) {
+		std::lock_guard<std::mutex> guard(lock_);
+		auto iter = entries_.find(gamePath.ToString());
+		if (iter == entries_.end())
+			return false;
+		if (fileInfo.exists && iter->second.size == fileInfo.size && iter->second.mtime == fileInfo.mtime)
+			return true;
+		entries_.erase(iter);
+		dirty_ = true;
+		return false;
+	}
+
+	void Update(const Path &gamePath, const File::FileInfo &fileInfo, GameInfo *info) {
+		GameInfoIndexEntry entry;
+		info->SaveToIndex(&entry);
+		entry.size = fileInfo.size;
+		entry.mtime = fileInfo.mtime;
+
+		std::lock_guard<std::mutex> guard(lock_);
+		entries_[gamePath.ToString()] = std::move(entry);
+		dirty_ = true;
+	}
+
+	void DoState(PointerWrap &p) {
+		auto s = p.Section("GameInfoIndex", 1);
+		if (!s)
+			return;
+
+		Do(p, entries_);
+	}
+
+private:
+	static constexpr double SAVE_INTERVAL = 30.0;
+
+	std::mutex lock_;
+	std::mutex saveLock_;
+	std::map<std::string, GameInfoIndexEntry> entries_;
+	Path filename_;
+	bool dirty_ = false;
+	// time_now_d() starts at 0, so the first batch still gets saved.
+	double lastSave_ = -SAVE_INTERVAL;
+	std::atomic<int> pendingWork_{};
+};
+
+class GameInfoIndexSaveTask : public Task {
+public:
+	GameInfoIndexSaveTask(const std::shared_ptr<GameInfoIndex> &index) : index_(index) {}
+
+	TaskType Type() const override {
+		return TaskType::IO_BLOCKING;
+	}
+
+	TaskPriority Priority() const override {
+		return TaskPriority::HIGH;
+	}
+
+	void Run() override {
+		index_->Save();
+	}
+
+private:
+	std::shared_ptr<GameInfoIndex> index_;
+};
+
 void GameInfoTex::Clear() {
 	if (!data.empty()) {
 		data.clear();
@@ -328,6 +499,57 @@ void GameInfo::ParseParamSFO() {
 	}
 }
 
+void GameInfo::LoadFromIndex(const Path &gamePath, const GameInfoIndexEntry &entry) {
+	std::lock_guard<std::mutex> guard(lock);
+	filePath_ = gamePath;
+	title = filePath_.GetFilename();
+	fileType = entry.fileType;
+	if (entry.flags & GameInfoFlags::PARAM_SFO) {
+		if (!entry.paramSFO.empty())
+			paramSFO.ReadSFO(entry.paramSFO);
+		title = entry.title;
+		id = entry.id;
+		id_version = entry.id_version;
+		disc_total = entry.disc_total;
+		disc_number = entry.disc_number;
+		region = entry.region;
+	}
+	// Not marked as loaded until the file has been checked, since a texture made from it would stick around.
+	if (entry.flags & GameInfoFlags::ICON)
+		icon.data = entry.icon;
+	gameSizeUncompressed = entry.gameSizeUncompressed;
+
+	GameInfoFlags ready = entry.flags;
+	ready &= INDEXED_FLAGS;
+	ready &= ~GameInfoFlags::ICON;
+	hasFlags |= ready;
+}
+
+void GameInfo::SaveToIndex(GameInfoIndexEntry *entry) {
+	std::lock_guard<std::mutex> guard(lock);
+	entry->flags = hasFlags;
+	entry->flags &= INDEXED_FLAGS;
+	entry->fileType = fileType;
+	if (hasFlags & GameInfoFlags::PARAM_SFO) {
+		u8 *sfoData = nullptr;
+		size_t sfoSize = 0;
+		if (paramSFO.WriteSFO(&sfoData, &sfoSize))
+			entry->paramSFO.assign(sfoData, sfoData + sfoSize);
+		delete[] sfoData;
+		entry->title = title;
+		entry->id = id;
+		entry->id_version = id_version;
+		entry->disc_total = disc_total;
+		entry->disc_number = disc_number;
+		entry->region = region;
+	}
+	if ((hasFlags & GameInfoFlags::ICON) && icon.dataLoaded)
+		entry->icon = icon.data;
+	else
+		entry->flags &= ~GameInfoFlags::ICON;
+	entry->gameSizeUncompressed = gameSizeUncompressed;
+}
+
 std::string GameInfo::GetTitle() {
 	std::lock_guard<std::mutex> guard(lock);
 	if (hasFlags & GameInfoFlags::PARAM_SFO) {
@@ -430,11 +652,16 @@ static bool ReadVFSToString(const char *filename, std::string *contents, std::mu
 
 class GameInfoWorkItem : public Task {
 public:
-	GameInfoWorkItem(const Path &gamePath, std::shared_ptr<GameInfo> &info, GameInfoFlags flags)
-		: gamePath_(gamePath), info_(info), flags_(flags) {}
+	GameInfoWorkItem(const Path &gamePath, std::shared_ptr<GameInfo> &info, GameInfoFlags flags, const std::shared_ptr<GameInfoIndex> &index, GameInfoFlags fromIndex)
+		: gamePath_(gamePath), info_(info), flags_(flags), index_(index), fromIndex_(fromIndex) {
+		if (index_)
+			index_->BeginWork();
+	}
 
 	~GameInfoWorkItem() {
 		info_->DisposeFileLoader();
+		if (index_)
+			index_->EndWork();
 	}
 
 	TaskType Type() const override {
@@ -454,6 +681,31 @@ class GameInfoWorkItem : public Task {
 	}
 
 	void Run() override {
+		// Checked before reading anything, so a file changing meanwhile isn't remembered as unchanged.
+		File::FileInfo fileInfo;
+		bool wantsIndex = fromIndex_ != (GameInfoFlags)0 || (flags_ & INDEXED_FLAGS);
+		bool canIndex = wantsIndex && index_ && GameInfoIndex::Indexable(gamePath_) && File::GetFileInfo(gamePath_, &fileInfo);
+
+		if (fromIndex_ != (GameInfoFlags)0) {
+			if (canIndex && index_->Matches(gamePath_, fileInfo)) {
+				info_->hasConfig = g_Config.hasGameConfig(info_->id);
+				std::lock_guard<std::mutex> lock(info_->lock);
+				if (fromIndex_ & GameInfoFlags::ICON)
+					info_->icon.dataLoaded = true;
+				info_->hasFlags |= fromIndex_;
+				info_->pendingFlags &= ~fromIndex_;
+				flags_ &= ~fromIndex_;
+			} else {
+				// What we showed is out of date, look it all up again.
+				std::lock_guard<std::mutex> lock(info_->lock);
+				info_->hasFlags &= ~fromIndex_;
+				info_->pendingFlags |= fromIndex_;
+				flags_ |= fromIndex_;
+			}
+			if (flags_ == (GameInfoFlags)0)
+				return;
+		}
+
 		// An early-return will result in the destructor running, where we can set
 		// flags like working and pending.
 		if (!info_->LoadFromPath(gamePath_)) {
@@ -769,16 +1021,27 @@ class GameInfoWorkItem : public Task {
 		}
 
 		// Time to update the flags.
-		std::unique_lock<std::mutex> lock(info_->lock);
-		info_->hasFlags |= flags_;
-		info_->pendingFlags &= ~flags_;
-		// INFO_LOG(SYSTEM, "Completed writing info for %s", info_->GetTitle().c_str());
+		{
+			std::unique_lock<std::mutex> lock(info_->lock);
+			info_->hasFlags |= flags_;
+			info_->pendingFlags &= ~flags_;
+			// INFO_LOG(SYSTEM, "Completed writing info for %s", info_->GetTitle().c_str());
+		}
+
+		GameInfoFlags indexed = flags_;
+		indexed &= INDEXED_FLAGS;
+		if (canIndex && indexed != (GameInfoFlags)0) {
+			index_->Update(gamePath_, fileInfo, info_.get());
+		}
 	}
 
 private:
 	Path gamePath_;
 	std::shared_ptr<GameInfo> info_;
 	GameInfoFlags flags_{};
+	std::shared_ptr<GameInfoIndex> index_;
+	// What was filled in from the index, and still needs to be checked against the file.
+	GameInfoFlags fromIndex_{};
 
 	DISALLOW_COPY_AND_ASSIGN(GameInfoWorkItem);
 };
@@ -792,10 +1055,23 @@ GameInfoCache::~GameInfoCache() {
 	Shutdown();
 }
 
-void GameInfoCache::Init() {}
+void GameInfoCache::Init() {
+	index_ = std::make_shared<GameInfoIndex>();
+	index_->Load(GetSysDirectory(DIRECTORY_CACHE) / "gameinfo.index");
+}
 
 void GameInfoCache::Shutdown() {
 	CancelAll();
+	// Work items still running keep their own reference, and save what they add once they're done.
+	index_->Save();
+}
+
+void GameInfoCache::SaveIndex() {
+	index_->Save();
+}
+
+void GameInfoCache::SaveIndexAsync() {
+	g_threadManager.EnqueueTask(new GameInfoIndexSaveTask(index_));
 }
 
 void GameInfoCache::Clear() {
@@ -874,20 +1150,29 @@ std::shared_ptr<GameInfo> GameInfoCache::GetInfo(Draw::DrawContext *draw, const
 		}
 		if (wanted != (GameInfoFlags)0) {
 			// We're missing info that we want. Go get it!
-			GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info, wanted);
+			GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info, wanted, index_, (GameInfoFlags)0);
 			g_threadManager.EnqueueTask(item);
 		}
 		return info;
 	}
 
 	std::shared_ptr<GameInfo> info = std::make_shared<GameInfo>();
-	info->pendingFlags = wantFlags;
+	// If we've seen it before, show that right away. The work item checks that it's still right.
+	GameInfoIndexEntry entry;
+	GameInfoFlags fromIndex{};
+	if (GameInfoIndex::Indexable(gamePath) && index_->Lookup(gamePath, &entry)) {
+		info->LoadFromIndex(gamePath, entry);
+		fromIndex = entry.flags;
+	}
+	GameInfoFlags wanted = wantFlags;
+	wanted &= ~info->hasFlags;
+	info->pendingFlags = wanted;
 	info->lastAccessedTime = time_now_d();
 	info_.insert(std::make_pair(pathStr, info));
 	mapLock_.unlock();
 
 	// Just get all the stuff we wanted.
-	GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info, wantFlags);
+	GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info, wanted, index_, fromIndex);
 	g_threadManager.EnqueueTask(item);
 	return info;
 }
@@ -62,6 +62,8 @@ enum class GameInfoFlags {
 ENUM_CLASS_BITOPS(GameInfoFlags);
 
 class FileLoader;
+class GameInfoIndex;
+struct GameInfoIndexEntry;
 enum class IdentifiedFileType;
 
 struct GameInfoTex {
@@ -98,6 +100,9 @@ class GameInfo {
 	u64 GetInstallDataSizeInBytes();
 
 	void ParseParamSFO();
+	// Fills in what was remembered about the file on a previous run, without touching it.
+	void LoadFromIndex(const Path &gamePath, const GameInfoIndexEntry &entry);
+	void SaveToIndex(GameInfoIndexEntry *entry);
 	void FinishPendingTextureLoads(Draw::DrawContext *draw);
 
 	std::vector<Path> GetSaveDataDirectories();
@@ -188,6 +193,10 @@ class GameInfoCache {
 
 	void CancelAll();
 	void WaitUntilDone(std::shared_ptr<GameInfo> &info);
+	// Also happens after batches of lookups, but call this when the app might get killed.
+	void SaveIndex();
+	// Same, without blocking the caller.
+	void SaveIndexAsync();
 
 private:
 	void Init();
@@ -197,6 +206,10 @@ class GameInfoCache {
 	// and if they get destructed while being in use, that's bad.
 	std::map<std::string, std::shared_ptr<GameInfo> > info_;
 	std::mutex mapLock_;
+
+	// What we knew about files last time, so known games show up without being opened again.
+	// Shared with the work items, which keep it up to date.
+	std::shared_ptr<GameInfoIndex> index_;
 };
 
 // This one can be global, no good reason not to.
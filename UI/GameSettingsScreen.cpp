@@ -448,6 +448,16 @@ void GameSettingsScreen::CreateGraphicsSettings(UI::ViewGroup *graphicsSettings)
 		return UI::EVENT_CONTINUE;
 	});
 
+	CheckBox *texWriteTracking = graphicsSettings->Add(new CheckBox(&g_Config.bTextureWriteTracking, gr->T("Skip hashing unchanged textures")));
+	texWriteTracking->SetDisabledPtr(&g_Config.bSoftwareRendering);
+	texWriteTracking->OnClick.Add([=](EventParams &e) {
+		settingInfo_->Show(gr->T("Skip hashing unchanged textures Tip", "Faster, but can miss texture changes in a few games. Takes effect on game restart"), e.v);
+		return UI::EVENT_CONTINUE;
+	});
+
+	CheckBox *vertexCache = graphicsSettings->Add(new CheckBox(&g_Config.bVertexCache, gr->T("Vertex cache")));
+	vertexCache->SetDisabledPtr(&g_Config.bSoftwareRendering);
+
 	static const char *quality[] = { "Low", "Medium", "High" };
 	PopupMultiChoice *beziersChoice = graphicsSettings->Add(new PopupMultiChoice(&g_Config.iSplineBezierQuality, gr->T("LowCurves", "Spline/Bezier curves quality"), quality, 0, ARRAY_SIZE(quality), I18NCat::GRAPHICS, screenManager()));
 	beziersChoice->OnChoice.Add([=](EventParams &e) {
@@ -1251,6 +1251,11 @@ bool HandleGlobalMessage(UIMessage message, const std::string &value) {
 		// Assume that the user may have modified things.
 		MemoryStick_NotifyWrite();
 		return true;
+	} else if (message == UIMessage::LOST_FOCUS) {
+		// On iOS, this may be the last we hear before being killed.
+		if (g_gameInfoCache)
+			g_gameInfoCache->SaveIndexAsync();
+		return true;
 	} else {
 		return false;
 	}
@@ -902,6 +902,17 @@ ifeq ($(UNITTEST),1)
   LOCAL_MODULE := ppsspp_unittest
   LOCAL_SRC_FILES := \
     $(SRC)/unittest/JitHarness.cpp \
+    $(SRC)/unittest/TestIRBlockCache.cpp \
+    $(SRC)/unittest/TestCoreTiming.cpp \
+    $(SRC)/unittest/TestBlockDevices.cpp \
+    $(SRC)/unittest/TestTextureDecoder.cpp \
+    $(SRC)/unittest/TestISOFileSystem.cpp \
+    $(SRC)/unittest/TestVertexCache.cpp \
+    $(SRC)/unittest/TestAsyncIOManager.cpp \
+    $(SRC)/unittest/TestSasAudio.cpp \
+    $(SRC)/unittest/TestHTTPFileLoader.cpp \
+    $(SRC)/unittest/TestLogManager.cpp \
+    $(SRC)/unittest/TestPGF.cpp \
     $(SRC)/unittest/TestIRPassSimplify.cpp \
     $(SRC)/unittest/TestShaderGenerators.cpp \
     $(SRC)/unittest/TestSoftwareGPUJit.cpp \
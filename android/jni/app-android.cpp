@@ -900,6 +900,10 @@ extern "C" void Java_org_ppsspp_ppsspp_NativeApp_resume(JNIEnv *, jclass) {
 extern "C" void Java_org_ppsspp_ppsspp_NativeApp_pause(JNIEnv *, jclass) {
 	INFO_LOG(SYSTEM, "NativeApp.pause() - pausing audio");
 	AndroidAudio_Pause(g_audioState);
+
+	// We often get killed after this without a chance to shut down.
+	if (g_gameInfoCache)
+		g_gameInfoCache->SaveIndex();
 }
 
 extern "C" void Java_org_ppsspp_ppsspp_NativeApp_shutdown(JNIEnv *, jclass) {
@@ -1677,7 +1681,11 @@ extern "C" jstring Java_org_ppsspp_ppsspp_ShortcutActivity_queryGameName(JNIEnv
 
 	std::string result = "";
 
-	GameInfoCache *cache = new GameInfoCache();
+	// A second cache would load and save the same index, overwriting what the other one learned.
+	GameInfoCache *cache = g_gameInfoCache;
+	bool ownCache = cache == nullptr;
+	if (ownCache)
+		cache = new GameInfoCache();
 	std::shared_ptr<GameInfo> info = cache->GetInfo(nullptr, path, GameInfoFlags::PARAM_SFO);
 	// Wait until it's done: this is synchronous, unfortunately.
 	if (info) {
@@ -1702,7 +1710,8 @@ extern "C" jstring Java_org_ppsspp_ppsspp_ShortcutActivity_queryGameName(JNIEnv
 	} else {
 		INFO_LOG(SYSTEM, "No info from cache");
 	}
-	delete cache;
+	if (ownCache)
+		delete cache;
 
 	if (teardownThreadManager) {
 		g_threadManager.Teardown();
@@ -5,9 +5,11 @@
 // > --root pspautotests/tests/../ --compare --timeout=5 --graphics=software pspautotests/tests/cpu/cpu_alu/cpu_alu.prx
 
 #include "ppsspp_config.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
+#include <memory>
 #if PPSSPP_PLATFORM(ANDROID)
 #include <jni.h>
 #endif
@@ -24,6 +26,8 @@
 #include <csignal>
 #endif
 #include "Common/CPUDetect.h"
+#include "Common/Data/Format/JSONWriter.h"
+#include "Common/File/DirListing.h"
 #include "Common/File/VFS/VFS.h"
 #include "Common/File/VFS/ZipFileReader.h"
 #include "Common/File/VFS/DirectoryReader.h"
@@ -35,11 +39,14 @@
 #include "Core/ConfigValues.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/Loaders.h"
 #include "Core/System.h"
 #include "Core/WebServer.h"
+#include "Core/HLE/HLE.h"
 #include "Core/HLE/sceUtility.h"
 #include "Core/SaveState.h"
 #include "GPU/Common/FramebufferManagerCommon.h"
+#include "GPU/GPU.h"
 #include "Log.h"
 #include "LogManager.h"
 
@@ -172,6 +179,9 @@ int printUsage(const char *progname, const char *reason)
 	fprintf(stderr, "  -j                    use jit (default)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
 	fprintf(stderr, "  --bench               run multiple times and output speed\n");
+	fprintf(stderr, "  --bench-runs=COUNT    number of runs for --bench (default 100)\n");
+	fprintf(stderr, "  --bench-json=FILE     also write --bench results to FILE as JSON\n");
+	fprintf(stderr, "  --hle-stats=FILE      write time spent per HLE function to FILE as JSON\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 
 	return 1;
@@ -194,12 +204,35 @@ static HeadlessHost *getHost(GPUCore gpuCore) {
 struct AutoTestOptions {
 	double timeout;
 	double maxScreenshotError;
+	int benchRuns;
 	bool compare : 1;
 	bool verbose : 1;
 	bool bench : 1;
 };
 
-bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const AutoTestOptions &opt) {
+// Totals over all runs of a GE dump, from gpuStats.
+struct GPUBenchStats {
+	int frames = 0;
+	int draws = 0;
+	double gpuTime = 0.0;
+	double vertexDecode = 0.0;
+	double textureDecode = 0.0;
+	double binning = 0.0;
+	double rasterizing = 0.0;
+
+	void Add(const GPUStatistics &stats) {
+		// Each run of a dump replays a single frame.
+		frames++;
+		draws += stats.numDrawCalls;
+		gpuTime += stats.msProcessingDisplayLists;
+		vertexDecode += stats.timeVertexDecode;
+		textureDecode += stats.timeTextureDecode;
+		binning += stats.timeBinning;
+		rasterizing += stats.timeRasterizing;
+	}
+};
+
+bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const AutoTestOptions &opt, GPUBenchStats *gpuBench = nullptr) {
 	// Kinda ugly, trying to guesstimate the test name from filename...
 	currentTestName = GetTestName(coreParameter.fileToStart);
 
@@ -232,7 +265,7 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const
 
 	System_Notify(SystemNotification::BOOT_DONE);
 
-	Core_UpdateDebugStats((DebugOverlay)g_Config.iDebugOverlay == DebugOverlay::DEBUG_STATS || g_Config.bLogFrameDrops);
+	Core_UpdateDebugStats((DebugOverlay)g_Config.iDebugOverlay == DebugOverlay::DEBUG_STATS || g_Config.bLogFrameDrops || gpuBench != nullptr);
 
 	PSP_BeginHostFrame();
 	Draw::DrawContext *draw = coreParameter.graphicsContext ? coreParameter.graphicsContext->GetDrawContext() : nullptr;
@@ -271,6 +304,9 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const
 	}
 	PSP_EndHostFrame();
 
+	if (gpuBench)
+		gpuBench->Add(gpuStats);
+
 	if (draw) {
 		draw->BindFramebufferAsRenderTarget(nullptr, { Draw::RPAction::CLEAR, Draw::RPAction::DONT_CARE, Draw::RPAction::DONT_CARE }, "Headless");
 		// Vulkan may get angry if we don't do a final present.
@@ -293,6 +329,82 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, const
 	return passed;
 }
 
+static void ExpandDirectories(std::vector<std::string> &testFilenames) {
+	std::vector<std::string> expanded;
+	for (const std::string &filename : testFilenames) {
+		Path path(filename);
+		std::vector<File::FileInfo> files;
+		if (File::IsDirectory(path)) {
+			// Directory games (EBOOT.PBP or PSP_GAME inside) still run as themselves.
+			std::unique_ptr<FileLoader> loader(ConstructFileLoader(path));
+			std::string errorString;
+			if (Identify_File(loader.get(), &errorString) == IdentifiedFileType::NORMAL_DIRECTORY)
+				File::GetFilesInDir(path, &files, "ppdmp:");
+		}
+		if (files.empty()) {
+			expanded.push_back(filename);
+			continue;
+		}
+
+		// Otherwise, a directory means every GE dump inside it.
+		std::sort(files.begin(), files.end());
+		for (const File::FileInfo &file : files)
+			expanded.push_back(file.fullName.ToString());
+	}
+	testFilenames = std::move(expanded);
+}
+
+static void PrintGPUBench(const GPUBenchStats &stats) {
+	if (stats.frames == 0 || stats.gpuTime <= 0.0)
+		return;
+	const double msPerFrame = 1000.0 / stats.frames;
+	printf("    %0.1f fps, %0.3f ms/frame, %d draws/frame, %0.2f us/draw\n", stats.frames / stats.gpuTime, stats.gpuTime * msPerFrame, stats.draws / stats.frames, stats.draws == 0 ? 0.0 : stats.gpuTime * 1000000.0 / stats.draws);
+	printf("    ms/frame: vertex decode %0.3f, texture decode %0.3f, binning %0.3f, rasterizing %0.3f\n", stats.vertexDecode * msPerFrame, stats.textureDecode * msPerFrame, stats.binning * msPerFrame, stats.rasterizing * msPerFrame);
+}
+
+static void WriteGPUBenchJson(json::JsonWriter &writer, const GPUBenchStats &stats) {
+	const double msPerFrame = stats.frames == 0 ? 0.0 : 1000.0 / stats.frames;
+	writer.pushDict("gpu");
+	writer.writeInt("frames", stats.frames);
+	writer.writeFloat("fps", stats.gpuTime <= 0.0 ? 0.0 : stats.frames / stats.gpuTime);
+	writer.writeFloat("msPerFrame", stats.gpuTime * msPerFrame);
+	writer.writeInt("drawsPerFrame", stats.frames == 0 ? 0 : stats.draws / stats.frames);
+	writer.writeFloat("usPerDraw", stats.draws == 0 ? 0.0 : stats.gpuTime * 1000000.0 / stats.draws);
+	writer.pushDict("msPerFrameByStage");
+	writer.writeFloat("vertexDecode", stats.vertexDecode * msPerFrame);
+	writer.writeFloat("textureDecode", stats.textureDecode * msPerFrame);
+	writer.writeFloat("binning", stats.binning * msPerFrame);
+	writer.writeFloat("rasterizing", stats.rasterizing * msPerFrame);
+	writer.pop();
+	writer.pop();
+}
+
+// Totals over every test run, for finding the HLE functions that cost the most.
+static bool WriteHLEStatsJson(const Path &filename) {
+	int frames = 0;
+	std::vector<HLESyscallStats> stats = hleGetSyscallStats(&frames);
+
+	json::JsonWriter writer(json::JsonWriter::PRETTY);
+	writer.begin();
+	writer.writeInt("frames", frames);
+	writer.pushArray("functions");
+	for (const HLESyscallStats &s : stats) {
+		writer.pushDict();
+		writer.writeString("module", s.module);
+		writer.writeString("name", s.name);
+		writer.writeFloat("calls", (double)s.calls);
+		writer.writeFloat("cycles", (double)s.cycles);
+		writer.writeFloat("total", s.totalTime);
+		writer.writeFloat("p50", s.p50Time);
+		writer.writeFloat("p99", s.p99Time);
+		writer.writeFloat("max", s.maxTime);
+		writer.pop();
+	}
+	writer.pop();
+	writer.end();
+	return File::WriteStringToFile(true, writer.str(), filename);
+}
+
 std::vector<std::string> ReadFromListFile(const std::string &listFilename) {
 	std::vector<std::string> testFilenames;
 	char temp[2048]{};
@@ -333,6 +445,7 @@ int main(int argc, const char* argv[])
 
 	AutoTestOptions testOptions{};
 	testOptions.timeout = std::numeric_limits<double>::infinity();
+	testOptions.benchRuns = 100;
 	bool fullLog = false;
 	const char *stateToLoad = 0;
 	GPUCore gpuCore = GPUCORE_SOFTWARE;
@@ -343,6 +456,8 @@ int main(int argc, const char* argv[])
 	const char *mountIso = nullptr;
 	const char *mountRoot = nullptr;
 	const char *screenshotFilename = nullptr;
+	const char *benchJsonFilename = nullptr;
+	const char *hleStatsFilename = nullptr;
 
 	for (int i = 1; i < argc; i++)
 	{
@@ -372,6 +487,12 @@ int main(int argc, const char* argv[])
 			testOptions.compare = true;
 		else if (!strcmp(argv[i], "--bench"))
 			testOptions.bench = true;
+		else if (!strncmp(argv[i], "--bench-runs=", strlen("--bench-runs=")) && strlen(argv[i]) > strlen("--bench-runs="))
+			testOptions.benchRuns = std::max(1, (int)strtol(argv[i] + strlen("--bench-runs="), nullptr, 10));
+		else if (!strncmp(argv[i], "--bench-json=", strlen("--bench-json=")) && strlen(argv[i]) > strlen("--bench-json="))
+			benchJsonFilename = argv[i] + strlen("--bench-json=");
+		else if (!strncmp(argv[i], "--hle-stats=", strlen("--hle-stats=")) && strlen(argv[i]) > strlen("--hle-stats="))
+			hleStatsFilename = argv[i] + strlen("--hle-stats=");
 		else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose"))
 			testOptions.verbose = true;
 		else if (!strncmp(argv[i], "--graphics=", strlen("--graphics=")) && strlen(argv[i]) > strlen("--graphics="))
@@ -418,6 +539,8 @@ int main(int argc, const char* argv[])
 
 	if (testFilenames.size() == 1 && testFilenames[0][0] == '@')
 		testFilenames = ReadFromListFile(testFilenames[0].substr(1));
+	if (testOptions.bench)
+		ExpandDirectories(testFilenames);
 
 	if (testFilenames.empty())
 		return printUsage(argv[0], argc <= 1 ? NULL : "No executables specified");
@@ -557,6 +680,15 @@ int main(int argc, const char* argv[])
 	if (stateToLoad != NULL)
 		SaveState::Load(Path(stateToLoad), -1);
 
+	if (hleStatsFilename)
+		Core_ForceDebugStats(true);
+
+	json::JsonWriter benchJson(json::JsonWriter::PRETTY);
+	benchJson.begin();
+	benchJson.writeString("graphics", coreParameter.gpuCore == GPUCORE_SOFTWARE ? "software" : "hardware");
+	benchJson.writeInt("runs", testOptions.benchRuns);
+	benchJson.pushArray("tests");
+
 	std::vector<std::string> failedTests;
 	std::vector<std::string> passedTests;
 	for (size_t i = 0; i < testFilenames.size(); ++i)
@@ -566,11 +698,15 @@ int main(int argc, const char* argv[])
 			printf("%s:\n", coreParameter.fileToStart.c_str());
 		bool passed = RunAutoTest(headlessHost, coreParameter, testOptions);
 		if (testOptions.bench) {
+			// GE dumps also get a breakdown of where the GPU time went.
+			const bool isGEDump = coreParameter.fileToStart.GetFileExtension() == ".ppdmp";
+			GPUBenchStats gpuBench;
+
 			double st = time_now_d();
 			double deadline = st + testOptions.timeout;
 			double runs = 0.0;
-			for (int i = 0; i < 100; ++i) {
-				RunAutoTest(headlessHost, coreParameter, testOptions);
+			for (int i = 0; i < testOptions.benchRuns; ++i) {
+				RunAutoTest(headlessHost, coreParameter, testOptions, isGEDump ? &gpuBench : nullptr);
 				runs++;
 
 				if (time_now_d() > deadline)
@@ -580,6 +716,16 @@ int main(int argc, const char* argv[])
 
 			std::string testName = GetTestName(coreParameter.fileToStart);
 			printf("  %s - %f seconds average\n", testName.c_str(), (et - st) / runs);
+			if (isGEDump)
+				PrintGPUBench(gpuBench);
+
+			benchJson.pushDict();
+			benchJson.writeString("name", testName);
+			benchJson.writeInt("runs", (int)runs);
+			benchJson.writeFloat("secondsPerRun", (et - st) / runs);
+			if (isGEDump)
+				WriteGPUBenchJson(benchJson, gpuBench);
+			benchJson.pop();
 		}
 		if (testOptions.compare) {
 			std::string testName = GetTestName(coreParameter.fileToStart);
@@ -592,6 +738,18 @@ int main(int argc, const char* argv[])
 		}
 	}
 
+	benchJson.pop();
+	benchJson.end();
+	if (testOptions.bench && benchJsonFilename) {
+		if (!File::WriteStringToFile(true, benchJson.str(), Path(std::string(benchJsonFilename))))
+			fprintf(stderr, "Unable to write bench results to '%s'\n", benchJsonFilename);
+	}
+	if (hleStatsFilename) {
+		Core_ForceDebugStats(false);
+		if (!WriteHLEStatsJson(Path(std::string(hleStatsFilename))))
+			fprintf(stderr, "Unable to write HLE stats to '%s'\n", hleStatsFilename);
+	}
+
 	if (testOptions.compare) {
 		printf("%d tests passed, %d tests failed.\n", (int)passedTests.size(), (int)failedTests.size());
 		if (!failedTests.empty())
@@ -0,0 +1,162 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Common/CPUDetect.h"
+#include "Common/File/FileUtil.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/FileLoaders/LocalFileLoader.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/FileSystems/DirectoryFileSystem.h"
+#include "Core/FileSystems/ISOFileSystem.h"
+#include "Core/FileSystems/MetaFileSystem.h"
+#include "Core/HW/AsyncIOManager.h"
+#include "Core/System.h"
+#include "unittest/UnitTest.h"
+
+static const int FILE_SIZE = 8 * 1024 * 1024;
+static const int CHUNK_SIZE = 64 * 1024;
+static const int NUM_STREAMS = 2;
+static const int SECTOR_SIZE = 2048;
+static const int SECTORS_PER_READ = 16;
+
+static bool ReadChunk(AsyncIOManager &manager, u32 handle, u8 *dest, size_t bytes, bool ordered) {
+	AsyncIOEvent ev = IO_EVENT_READ;
+	ev.handle = handle;
+	ev.buf = dest;
+	ev.bytes = bytes;
+	ev.invalidateAddr = 0;
+	ev.ordered = ordered;
+	manager.ScheduleOperation(ev);
+
+	AsyncIOResult result;
+	EXPECT_TRUE(manager.WaitResult(handle, result));
+	EXPECT_EQ_INT((int)result.result, (int)bytes);
+	return true;
+}
+
+// Streams through the file on a few handles at once, like a game playing a movie and music.
+static bool StreamFile(AsyncIOManager &manager, const std::vector<u8> &data, bool ordered, double *seconds) {
+	u32 handles[NUM_STREAMS];
+	for (int i = 0; i < NUM_STREAMS; ++i) {
+		handles[i] = pspFileSystem.OpenFile("asynctest:/stream.bin", FILEACCESS_READ);
+		EXPECT_TRUE((int)handles[i] > 0);
+	}
+
+	std::vector<u8> chunk(CHUNK_SIZE);
+	double start = time_now_d();
+	for (int offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE) {
+		for (int i = 0; i < NUM_STREAMS; ++i) {
+			EXPECT_TRUE(ReadChunk(manager, handles[i], chunk.data(), CHUNK_SIZE, ordered));
+			EXPECT_TRUE(memcmp(chunk.data(), &data[offset], CHUNK_SIZE) == 0);
+		}
+	}
+	*seconds = time_now_d() - start;
+
+	// Jumping around must not return stale read-ahead data, including jumping back into it.
+	const int seeks[] = { 4096, 1 * 1024 * 1024, 4096 + CHUNK_SIZE + 100, FILE_SIZE - CHUNK_SIZE / 2 };
+	for (int pos : seeks) {
+		manager.SyncThread();
+		pspFileSystem.SeekFile(handles[0], pos, FILEMOVE_BEGIN);
+		size_t expected = std::min(CHUNK_SIZE, FILE_SIZE - pos);
+		for (int r = 0; r < 3 && expected > 0; ++r) {
+			memset(chunk.data(), 0, CHUNK_SIZE);
+			EXPECT_TRUE(ReadChunk(manager, handles[0], chunk.data(), expected, ordered));
+			EXPECT_TRUE(memcmp(chunk.data(), &data[pos], expected) == 0);
+			pos += (int)expected;
+			expected = std::min(CHUNK_SIZE, FILE_SIZE - pos);
+		}
+	}
+
+	manager.SyncThread();
+	for (int i = 0; i < NUM_STREAMS; ++i) {
+		manager.ForgetHandle(handles[i]);
+		pspFileSystem.CloseFile(handles[i]);
+	}
+	return true;
+}
+
+// The whole disc as a block device, where reads and positions are in sectors.
+static bool StreamSectors(AsyncIOManager &manager, const std::vector<u8> &data) {
+	u32 handle = pspFileSystem.OpenFile("asyncumd0:", FILEACCESS_READ);
+	EXPECT_TRUE((int)handle > 0);
+
+	// Exactly sized, so a read-ahead in the wrong units would overrun it.
+	std::unique_ptr<u8[]> chunk(new u8[SECTORS_PER_READ * SECTOR_SIZE]);
+	for (int sector = 0; sector < FILE_SIZE / SECTOR_SIZE; sector += SECTORS_PER_READ) {
+		memset(chunk.get(), 0, SECTORS_PER_READ * SECTOR_SIZE);
+		EXPECT_TRUE(ReadChunk(manager, handle, chunk.get(), SECTORS_PER_READ, false));
+		EXPECT_TRUE(memcmp(chunk.get(), &data[sector * SECTOR_SIZE], SECTORS_PER_READ * SECTOR_SIZE) == 0);
+	}
+
+	manager.SyncThread();
+	manager.ForgetHandle(handle);
+	pspFileSystem.CloseFile(handle);
+	return true;
+}
+
+bool TestAsyncIOManager() {
+	const Path dir("asyncio_test");
+	File::CreateDir(dir);
+	std::vector<u8> data(FILE_SIZE);
+	for (int i = 0; i < FILE_SIZE; ++i)
+		data[i] = (u8)((i >> 8) ^ (i * 13));
+	// Enough of a volume descriptor for the file to also pass as a disc image.
+	memcpy(&data[16 * SECTOR_SIZE], "\001CD001\001", 7);
+	EXPECT_TRUE(File::WriteDataToFile(false, data.data(), data.size(), dir / "stream.bin"));
+	// Flagged as a disc, so read-ahead applies.
+	pspFileSystem.Mount("asynctest:", std::shared_ptr<IFileSystem>(new DirectoryFileSystem(&pspFileSystem, dir, FileSystemFlags::UMD)));
+	std::unique_ptr<FileLoader> loader(new LocalFileLoader(dir / "stream.bin"));
+	pspFileSystem.Mount("asyncumd0:", std::shared_ptr<IFileSystem>(new ISOFileSystem(&pspFileSystem, new FileBlockDevice(loader.get()))));
+
+	bool ownThreadManager = !g_threadManager.IsInitialized();
+	if (ownThreadManager)
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+	CoreState oldState = coreState;
+	coreState = CORE_RUNNING;
+
+	AsyncIOManager manager;
+	manager.SetThreadEnabled(true);
+	std::thread ioThread([&] {
+		manager.RunEventsUntil(CoreTiming::GetTicks() + msToCycles(1000));
+	});
+
+	double laneTime = 0.0, orderedTime = 0.0;
+	bool success = StreamFile(manager, data, false, &laneTime) && StreamFile(manager, data, true, &orderedTime);
+	success = success && StreamSectors(manager, data);
+
+	manager.FinishEventLoop();
+	ioThread.join();
+	manager.Shutdown();
+	coreState = oldState;
+	if (ownThreadManager)
+		g_threadManager.Teardown();
+	pspFileSystem.Unmount("asynctest:");
+	pspFileSystem.Unmount("asyncumd0:");
+	loader.reset();
+	File::DeleteDirRecursively(dir);
+
+	if (success)
+		printf("Async reads, %d streams of %d MB in %d KB reads: lanes %0.2f ms, ordered %0.2f ms\n", NUM_STREAMS, FILE_SIZE >> 20, CHUNK_SIZE >> 10, laneTime * 1000.0, orderedTime * 1000.0);
+	return success;
+}
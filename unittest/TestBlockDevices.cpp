@@ -0,0 +1,204 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Common/CPUDetect.h"
+#include "Common/Data/Random/Rng.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/Loaders.h"
+#include "unittest/UnitTest.h"
+
+extern "C" {
+#include "zlib.h"
+}
+
+static const int SECTOR_SIZE = 2048;
+static const int IMAGE_SECTORS = 16384;  // 32 MB
+static const int READ_SECTORS = 128;
+
+class MemoryFileLoader : public FileLoader {
+public:
+	MemoryFileLoader(std::vector<u8> &&data) : data_(std::move(data)) {}
+
+	bool Exists() override {
+		return true;
+	}
+	bool IsDirectory() override {
+		return false;
+	}
+	s64 FileSize() override {
+		return (s64)data_.size();
+	}
+	Path GetPath() const override {
+		return Path("memory.iso");
+	}
+	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override {
+		readCalls_++;
+		if (absolutePos >= (s64)data_.size())
+			return 0;
+		size_t avail = std::min(bytes * count, data_.size() - (size_t)absolutePos);
+		memcpy(data, &data_[(size_t)absolutePos], avail);
+		return avail / bytes;
+	}
+
+	int readCalls_ = 0;
+
+private:
+	std::vector<u8> data_;
+};
+
+// Roughly as compressible as game data: runs of noise mixed with repetitive structures.
+static std::vector<u8> MakeImage() {
+	std::vector<u8> image(IMAGE_SECTORS * SECTOR_SIZE);
+	GMRng rng;
+	for (size_t i = 0; i < image.size(); i += 4) {
+		u32 value = (i & 0x1000) ? (rng.R32() & 0x0F0F0F0F) : (u32)(i / 64);
+		memcpy(&image[i], &value, 4);
+	}
+	return image;
+}
+
+static std::vector<u8> MakeCSO(const std::vector<u8> &image) {
+	const u32 numFrames = (u32)(image.size() / SECTOR_SIZE);
+	std::vector<u8> cso(0x18 + (numFrames + 1) * 4);
+	memcpy(&cso[0], "CISO", 4);
+	u32 headerSize = 0x18;
+	u64 totalBytes = image.size();
+	u32 blockSize = SECTOR_SIZE;
+	memcpy(&cso[4], &headerSize, 4);
+	memcpy(&cso[8], &totalBytes, 8);
+	memcpy(&cso[0x10], &blockSize, 4);
+	cso[0x14] = 1;
+	cso[0x15] = 0;
+
+	std::vector<u8> compressed(SECTOR_SIZE * 2);
+	for (u32 frame = 0; frame <= numFrames; ++frame) {
+		u32 indexValue = (u32)cso.size();
+		if (frame == numFrames) {
+			memcpy(&cso[0x18 + frame * 4], &indexValue, 4);
+			break;
+		}
+
+		z_stream z{};
+		deflateInit2(&z, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		z.next_in = (Bytef *)&image[frame * SECTOR_SIZE];
+		z.avail_in = SECTOR_SIZE;
+		z.next_out = compressed.data();
+		z.avail_out = (uInt)compressed.size();
+		deflate(&z, Z_FINISH);
+		size_t size = z.total_out;
+		deflateEnd(&z);
+
+		if (size >= SECTOR_SIZE) {
+			// Stored plain.
+			indexValue |= 0x80000000;
+			cso.insert(cso.end(), &image[frame * SECTOR_SIZE], &image[frame * SECTOR_SIZE] + SECTOR_SIZE);
+		} else {
+			cso.insert(cso.end(), compressed.begin(), compressed.begin() + size);
+		}
+		memcpy(&cso[0x18 + frame * 4], &indexValue, 4);
+	}
+	return cso;
+}
+
+static bool ReadAllSectors(BlockDevice *device, std::vector<u8> &out, bool perSector, double *seconds) {
+	out.assign(IMAGE_SECTORS * SECTOR_SIZE, 0);
+	double start = time_now_d();
+	for (int sector = 0; sector < IMAGE_SECTORS; sector += READ_SECTORS) {
+		if (perSector) {
+			for (int i = 0; i < READ_SECTORS; ++i) {
+				if (!device->ReadBlock(sector + i, &out[(sector + i) * SECTOR_SIZE]))
+					return false;
+			}
+		} else if (!device->ReadBlocks(sector, READ_SECTORS, &out[sector * SECTOR_SIZE])) {
+			return false;
+		}
+	}
+	*seconds = time_now_d() - start;
+	return true;
+}
+
+static bool TestVectoredReads(const std::vector<u8> &image) {
+	MemoryFileLoader *loader = new MemoryFileLoader(std::vector<u8>(image));
+	FileBlockDevice device(loader);
+
+	// Two adjacent ranges with adjacent buffers should be a single read, the third can't be.
+	std::vector<u8> buffer(10 * SECTOR_SIZE);
+	u8 other[SECTOR_SIZE];
+	BlockRange ranges[3] = {
+		{ 100, 4, &buffer[0] },
+		{ 104, 6, &buffer[4 * SECTOR_SIZE] },
+		{ 110, 1, other },
+	};
+	EXPECT_TRUE(device.ReadBlocksVectored(ranges, 3));
+	EXPECT_EQ_INT(loader->readCalls_, 2);
+	EXPECT_TRUE(memcmp(&buffer[0], &image[100 * SECTOR_SIZE], buffer.size()) == 0);
+	EXPECT_TRUE(memcmp(other, &image[110 * SECTOR_SIZE], SECTOR_SIZE) == 0);
+
+	delete loader;
+	return true;
+}
+
+static bool TestCSOThroughput(const std::vector<u8> &image) {
+	MemoryFileLoader *loader = new MemoryFileLoader(MakeCSO(image));
+	printf("CSO image: %d MB, compressed to %d MB\n", (int)(image.size() >> 20), (int)(loader->FileSize() >> 20));
+
+	bool ownThreadManager = !g_threadManager.IsInitialized();
+	std::vector<u8> out;
+	double perSectorTime = 0.0, serialTime = 0.0, parallelTime = 0.0;
+	{
+		CISOFileBlockDevice device(loader);
+		EXPECT_EQ_INT(device.GetNumBlocks(), IMAGE_SECTORS);
+
+		EXPECT_TRUE(ReadAllSectors(&device, out, true, &perSectorTime));
+		EXPECT_TRUE(out == image);
+
+		if (ownThreadManager) {
+			EXPECT_TRUE(ReadAllSectors(&device, out, false, &serialTime));
+			EXPECT_TRUE(out == image);
+			g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+		}
+
+		EXPECT_TRUE(ReadAllSectors(&device, out, false, &parallelTime));
+		EXPECT_TRUE(out == image);
+
+		// Unaligned reads, that end with partial frames.
+		std::vector<u8> partial(300 * SECTOR_SIZE);
+		EXPECT_TRUE(device.ReadBlocks(1001, 300, partial.data()));
+		EXPECT_TRUE(memcmp(partial.data(), &image[1001 * SECTOR_SIZE], partial.size()) == 0);
+	}
+	if (ownThreadManager)
+		g_threadManager.Teardown();
+	delete loader;
+
+	double mb = (double)image.size() / (1024.0 * 1024.0);
+	printf("CSO reads of %d sectors: per sector %0.1f MB/s", READ_SECTORS, mb / perSectorTime);
+	if (serialTime > 0.0)
+		printf(", serial %0.1f MB/s", mb / serialTime);
+	printf(", parallel %0.1f MB/s\n", mb / parallelTime);
+	// There's no CHD writer in the tree, so CHD isn't covered here.
+	return true;
+}
+
+bool TestBlockDevices() {
+	std::vector<u8> image = MakeImage();
+	return TestVectoredReads(image) && TestCSOThroughput(image);
+}
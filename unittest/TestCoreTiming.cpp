@@ -0,0 +1,192 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <vector>
+#include "Common/Data/Random/Rng.h"
+#include "Common/Serialize/Serializer.h"
+#include "Common/TimeUtil.h"
+#include "Core/CoreTiming.h"
+#include "Core/MIPS/MIPS.h"
+#include "unittest/UnitTest.h"
+
+static std::vector<int> firedEvents;
+
+static void RecordEvent(u64 userdata, int cyclesLate) {
+	firedEvents.push_back((int)userdata);
+}
+
+static void IgnoreEvent(u64 userdata, int cyclesLate) {
+}
+
+// Runs until nothing is scheduled anymore.
+static void RunPendingEvents() {
+	for (int i = 0; i < 1000; ++i) {
+		CoreTiming::Idle();
+		CoreTiming::Advance();
+	}
+}
+
+static bool TestEventOrder(int evA, int evB) {
+	firedEvents.clear();
+
+	// Events at the same time must run in the order they were scheduled.
+	CoreTiming::ScheduleEvent(1000, evA, 1);
+	CoreTiming::ScheduleEvent(500, evB, 2);
+	CoreTiming::ScheduleEvent(1000, evB, 3);
+	CoreTiming::ScheduleEvent(1000, evA, 4);
+	CoreTiming::ScheduleEvent(2000, evA, 5);
+	CoreTiming::ScheduleEvent(3000, evA, 6);
+	CoreTiming::ScheduleEvent(1500, evA, 6);
+
+	EXPECT_TRUE(CoreTiming::IsScheduled(evB));
+	EXPECT_EQ_INT((int)CoreTiming::UnscheduleEvent(evA, 5), 2000);
+	// Both are removed, and the later one determines the result.
+	EXPECT_EQ_INT((int)CoreTiming::UnscheduleEvent(evA, 6), 3000);
+	EXPECT_EQ_INT((int)CoreTiming::UnscheduleEvent(evA, 7), 0);
+
+	RunPendingEvents();
+	EXPECT_EQ_INT((int)firedEvents.size(), 4);
+	EXPECT_EQ_INT(firedEvents[0], 2);
+	EXPECT_EQ_INT(firedEvents[1], 1);
+	EXPECT_EQ_INT(firedEvents[2], 3);
+	EXPECT_EQ_INT(firedEvents[3], 4);
+
+	firedEvents.clear();
+	CoreTiming::ScheduleEvent(100, evB, 1);
+	CoreTiming::ScheduleEvent(200, evA, 2);
+	CoreTiming::ScheduleEvent(300, evB, 3);
+	CoreTiming::RemoveEvent(evB);
+	EXPECT_FALSE(CoreTiming::IsScheduled(evB));
+	EXPECT_TRUE(CoreTiming::IsScheduled(evA));
+
+	RunPendingEvents();
+	EXPECT_EQ_INT((int)firedEvents.size(), 1);
+	EXPECT_EQ_INT(firedEvents[0], 2);
+	return true;
+}
+
+static bool TestEventState(int &evA, int &evB) {
+	firedEvents.clear();
+	for (int i = 0; i < 20; ++i) {
+		// Plenty of ties, to check they keep their order.
+		CoreTiming::ScheduleEvent(100 * (i % 4), (i & 1) ? evA : evB, i);
+	}
+
+	u8 *ptr = nullptr;
+	PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+	CoreTiming::DoState(p);
+	std::vector<u8> buffer(p.Offset());
+	p.RewindForWrite(buffer.data());
+	CoreTiming::DoState(p);
+	EXPECT_TRUE(p.CheckAfterWrite());
+
+	CoreTiming::ClearPendingEvents();
+	EXPECT_FALSE(CoreTiming::IsScheduled(evA));
+
+	u8 *readPtr = buffer.data();
+	PointerWrap r(&readPtr, PointerWrap::MODE_READ);
+	CoreTiming::DoState(r);
+	EXPECT_TRUE(r.error == PointerWrap::ERROR_NONE);
+	CoreTiming::RestoreRegisterEvent(evA, "TestEventA", &RecordEvent);
+	CoreTiming::RestoreRegisterEvent(evB, "TestEventB", &RecordEvent);
+
+	RunPendingEvents();
+	EXPECT_EQ_INT((int)firedEvents.size(), 20);
+	int pos = 0;
+	for (int t = 0; t < 4; ++t) {
+		for (int i = t; i < 20; i += 4) {
+			EXPECT_EQ_INT(firedEvents[pos++], i);
+		}
+	}
+	return true;
+}
+
+// The sorted linked list that used to hold the events, for comparison.
+struct OldListEvent {
+	s64 time;
+	u64 userdata;
+	int type;
+	OldListEvent *next;
+};
+
+static void BenchmarkEventChurn(int evA) {
+	const int TIMERS = 512;
+	const int ROUNDS = 200000;
+	GMRng rng;
+
+	std::vector<s64> delays(ROUNDS);
+	for (int i = 0; i < ROUNDS; ++i)
+		delays[i] = 1000 + (rng.R32() % 1000000);
+
+	double start = time_now_d();
+	for (int i = 0; i < TIMERS; ++i)
+		CoreTiming::ScheduleEvent(delays[i], evA, i);
+	for (int i = 0; i < ROUNDS; ++i) {
+		u64 timer = i % TIMERS;
+		CoreTiming::UnscheduleEvent(evA, timer);
+		CoreTiming::ScheduleEvent(delays[i], evA, timer);
+	}
+	double heapTime = time_now_d() - start;
+	CoreTiming::ClearPendingEvents();
+
+	OldListEvent *first = nullptr;
+	std::vector<OldListEvent> pool(TIMERS);
+	auto insert = [&](OldListEvent *ne) {
+		OldListEvent **pNext = &first;
+		while (*pNext && (*pNext)->time <= ne->time)
+			pNext = &(*pNext)->next;
+		ne->next = *pNext;
+		*pNext = ne;
+	};
+
+	start = time_now_d();
+	for (int i = 0; i < TIMERS; ++i) {
+		pool[i] = OldListEvent{ delays[i], (u64)i, evA, nullptr };
+		insert(&pool[i]);
+	}
+	for (int i = 0; i < ROUNDS; ++i) {
+		u64 timer = i % TIMERS;
+		OldListEvent **pNext = &first;
+		while (*pNext) {
+			if ((*pNext)->type == evA && (*pNext)->userdata == timer)
+				*pNext = (*pNext)->next;
+			else
+				pNext = &(*pNext)->next;
+		}
+		pool[timer].time = delays[i];
+		insert(&pool[timer]);
+	}
+	double listTime = time_now_d() - start;
+
+	printf("CoreTiming churn, %d timers x %d reschedules: heap %0.2f ms, sorted list %0.2f ms\n", TIMERS, ROUNDS, heapTime * 1000.0, listTime * 1000.0);
+}
+
+bool TestCoreTiming() {
+	CoreTiming::Init();
+	int evA = CoreTiming::RegisterEvent("TestEventA", &RecordEvent);
+	int evB = CoreTiming::RegisterEvent("TestEventB", &RecordEvent);
+	int evChurn = CoreTiming::RegisterEvent("TestEventChurn", &IgnoreEvent);
+
+	bool success = TestEventOrder(evA, evB) && TestEventState(evA, evB);
+	if (success)
+		BenchmarkEventChurn(evChurn);
+
+	CoreTiming::ClearPendingEvents();
+	CoreTiming::Shutdown();
+	return success;
+}
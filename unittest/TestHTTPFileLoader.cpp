@@ -0,0 +1,152 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "Common/CPUDetect.h"
+#include "Common/File/FileUtil.h"
+#include "Common/Net/HTTPServer.h"
+#include "Common/Net/Resolve.h"
+#include "Common/Net/Sinks.h"
+#include "Common/StringUtils.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/FileLoaders/DiskCachingFileLoader.h"
+#include "Core/FileLoaders/HTTPFileLoader.h"
+#include "unittest/UnitTest.h"
+
+static const int FILE_SIZE = 4 * 1024 * 1024;
+static const int BOOT_SIZE = 2 * 1024 * 1024;
+static const int READ_SIZE = 32 * 1024;
+static const int LATENCY_MS = 10;
+
+static std::atomic<int> rangeRequests;
+
+// Like the remote ISO server, but slow to answer.
+static void ServeDisc(const http::ServerRequest &request, const std::vector<u8> &data) {
+	sleep_ms(LATENCY_MS);
+	std::string range;
+	s64 begin = 0, last = 0;
+	if (request.Method() == http::RequestHeader::HEAD) {
+		request.WriteHttpResponseHeader("1.0", 200, data.size(), "application/octet-stream", "Accept-Ranges: bytes\r\n");
+	} else if (request.GetHeader("range", &range) && sscanf(range.c_str(), "bytes=%lld-%lld", &begin, &last) == 2 && begin <= last && last < (s64)data.size()) {
+		rangeRequests++;
+		std::string contentRange = StringFromFormat("Content-Range: bytes %lld-%lld/%lld\r\n", begin, last, (s64)data.size());
+		request.WriteHttpResponseHeader("1.0", 206, last - begin + 1, "application/octet-stream", contentRange.c_str());
+		request.Out()->Push((const char *)&data[begin], last - begin + 1);
+		request.Out()->Flush();
+	} else {
+		request.WriteHttpResponseHeader("1.0", 400, -1, "text/plain");
+	}
+}
+
+// Reads the start of the disc in small pieces, the way a game boot does, with a few jumps back to the directory.
+static bool Boot(FileLoader *loader, const std::vector<u8> &data, double *seconds) {
+	std::vector<u8> buf(READ_SIZE);
+	double start = time_now_d();
+	EXPECT_EQ_INT((int)loader->FileSize(), FILE_SIZE);
+	for (int pos = 0; pos < BOOT_SIZE; pos += READ_SIZE) {
+		EXPECT_EQ_INT((int)loader->ReadAt(pos, READ_SIZE, buf.data()), READ_SIZE);
+		EXPECT_TRUE(memcmp(buf.data(), &data[pos], READ_SIZE) == 0);
+		if (pos % (BOOT_SIZE / 4) == 0) {
+			EXPECT_EQ_INT((int)loader->ReadAt(0x8000, 2048, buf.data()), 2048);
+			EXPECT_TRUE(memcmp(buf.data(), &data[0x8000], 2048) == 0);
+		}
+	}
+
+	// And the very end, which is short.
+	EXPECT_EQ_INT((int)loader->ReadAt(FILE_SIZE - 100, READ_SIZE, buf.data()), 100);
+	EXPECT_TRUE(memcmp(buf.data(), &data[FILE_SIZE - 100], 100) == 0);
+	*seconds = time_now_d() - start;
+	return true;
+}
+
+static bool BootHTTP(const Path &url, const std::vector<u8> &data, double *seconds, int *stalls) {
+	HTTPFileLoader loader(url);
+	EXPECT_TRUE(Boot(&loader, data, seconds));
+	*stalls = loader.StallCount();
+	return true;
+}
+
+bool TestHTTPFileLoader() {
+	std::vector<u8> data(FILE_SIZE);
+	for (int i = 0; i < FILE_SIZE; ++i)
+		data[i] = (u8)((i >> 10) ^ (i * 7));
+
+	net::Init();
+	http::Server *server = new http::Server(new NewThreadExecutor());
+	server->RegisterHandler("/disc.iso", [&](const http::ServerRequest &request) {
+		ServeDisc(request, data);
+	});
+	EXPECT_TRUE(server->Listen(0, net::DNSType::IPV4));
+	std::atomic<bool> serving(true);
+	std::thread serverThread([&] {
+		while (serving)
+			server->RunSlice(0.05);
+	});
+	const Path url(StringFromFormat("http://127.0.0.1:%d/disc.iso", server->Port()));
+
+	// Without worker threads, every read waits for its own request.
+	bool ownThreadManager = !g_threadManager.IsInitialized();
+	double syncTime = 0.0, aheadTime = 0.0;
+	int syncStalls = 0, aheadStalls = 0;
+	bool success = true;
+	if (ownThreadManager) {
+		success = BootHTTP(url, data, &syncTime, &syncStalls);
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+	}
+	success = success && BootHTTP(url, data, &aheadTime, &aheadStalls);
+	if (success && ownThreadManager && aheadStalls >= syncStalls) {
+		printf("Read-ahead didn't avoid stalls: %d vs %d\n", aheadStalls, syncStalls);
+		success = false;
+	}
+
+	// What was fetched once lands in the disk cache, so the next boot doesn't need the network for it.
+	const Path cacheDir("httploader_test");
+	DiskCachingFileLoaderCache::SetCacheDir(cacheDir);
+	double firstTime = 0.0, secondTime = 0.0;
+	int secondRequests = -1;
+	if (success) {
+		DiskCachingFileLoader loader(new HTTPFileLoader(url));
+		success = Boot(&loader, data, &firstTime);
+	}
+	if (success) {
+		rangeRequests = 0;
+		DiskCachingFileLoader loader(new HTTPFileLoader(url));
+		success = Boot(&loader, data, &secondTime);
+		secondRequests = rangeRequests;
+	}
+	DiskCachingFileLoaderCache::SetCacheDir(Path());
+	File::DeleteDirRecursively(cacheDir);
+
+	serving = false;
+	serverThread.join();
+	server->Stop();
+	delete server;
+	if (ownThreadManager)
+		g_threadManager.Teardown();
+	net::Shutdown();
+
+	EXPECT_TRUE(success);
+	EXPECT_EQ_INT(secondRequests, 0);
+	printf("HTTP boot, %d MB in %d KB reads at %d ms latency: read-ahead %0.1f ms (%d stalls), sync %0.1f ms (%d stalls), disk cached %0.1f ms\n", BOOT_SIZE >> 20, READ_SIZE >> 10, LATENCY_MS, aheadTime * 1000.0, aheadStalls, syncTime * 1000.0, syncStalls, secondTime * 1000.0);
+	return true;
+}
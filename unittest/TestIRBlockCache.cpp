@@ -0,0 +1,176 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Common/TimeUtil.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/IR/IRJit.h"
+#include "unittest/UnitTest.h"
+
+using namespace MIPSComp;
+
+static const int NUM_BLOCKS = 50000;
+static const int NUM_LOOKUP_ROUNDS = 20;
+
+static u32 BlockAddress(int i) {
+	// Spread over most of user RAM, with a few blocks sharing each page.
+	return 0x08804000 + (u32)i * 0x1A4;
+}
+
+static std::vector<IRInst> BlockInstructions(int i) {
+	std::vector<IRInst> inst;
+	int count = 4 + (i % 24);
+	for (int j = 0; j < count; ++j) {
+		inst.push_back({ IROp::AddConst, { (u8)(j & 31) }, (u8)(i & 31), 0, (u32)i });
+	}
+	inst.push_back({ IROp::ExitToConst, { 0 }, 0, 0, BlockAddress(i + 1) });
+	return inst;
+}
+
+// The layout used before the arena: a heap allocation per block, and a hashed page map.
+struct OldStyleBlock {
+	std::unique_ptr<IRInst[]> instr;
+	int numInstructions;
+	u32 addr;
+	u32 size;
+};
+
+bool TestIRBlockCache() {
+	IRBlockCache cache;
+	std::vector<OldStyleBlock> oldBlocks;
+	std::unordered_map<u32, std::vector<int>> oldPages;
+	oldBlocks.reserve(NUM_BLOCKS);
+
+	size_t totalInstructions = 0;
+	for (int i = 0; i < NUM_BLOCKS; ++i) {
+		std::vector<IRInst> inst = BlockInstructions(i);
+		u32 size = (u32)(inst.size() - 1) * 4;
+		totalInstructions += inst.size();
+
+		int num = cache.AllocateBlock(BlockAddress(i));
+		cache.SetBlockInstructions(num, inst);
+		cache.GetBlock(num)->SetOriginalSize(size);
+		// Preload mode avoids writing emuhacks into emulated memory.
+		cache.FinalizeBlock(num, true);
+
+		OldStyleBlock old;
+		old.instr.reset(new IRInst[inst.size()]);
+		std::copy(inst.begin(), inst.end(), old.instr.get());
+		old.numInstructions = (int)inst.size();
+		old.addr = BlockAddress(i);
+		old.size = size;
+		for (u32 page = (old.addr & 0x3FFFFFFF) >> 10; page <= ((old.addr + size) & 0x3FFFFFFF) >> 10; ++page)
+			oldPages[page].push_back(i);
+		oldBlocks.push_back(std::move(old));
+	}
+
+	// Verify that everything landed where expected.
+	for (int i = 0; i < NUM_BLOCKS; i += 97) {
+		EXPECT_EQ_INT(cache.GetBlockNumberFromStartAddress(BlockAddress(i)), i);
+		const IRBlock *block = cache.GetBlock(i);
+		const IRInst *inst = cache.GetBlockInstructionPtr(*block);
+		EXPECT_EQ_INT(block->GetNumInstructions(), oldBlocks[i].numInstructions);
+		EXPECT_TRUE(inst[0].constant == (u32)i);
+		EXPECT_TRUE(inst[block->GetNumInstructions() - 1].op == IROp::ExitToConst);
+	}
+	EXPECT_EQ_INT(cache.GetBlockNumberFromStartAddress(BlockAddress(NUM_BLOCKS)), -1);
+	EXPECT_EQ_INT(cache.GetBlockNumberFromStartAddress(0x08000000), -1);
+
+	std::vector<int> invalidated = cache.FindInvalidatedBlockNumbers(BlockAddress(100), 4);
+	EXPECT_EQ_INT((int)invalidated.size(), 1);
+	EXPECT_EQ_INT(invalidated[0], 100);
+
+	// Lookup timing, new layout.
+	double start = time_now_d();
+	int found = 0;
+	for (int r = 0; r < NUM_LOOKUP_ROUNDS; ++r) {
+		for (int i = 0; i < NUM_BLOCKS; ++i) {
+			int num = cache.GetBlockNumberFromStartAddress(BlockAddress(i));
+			found += cache.GetBlockInstructionPtr(*cache.GetBlock(num))->src1;
+		}
+	}
+	double newTime = time_now_d() - start;
+
+	// Lookup timing, old layout.
+	start = time_now_d();
+	int oldFound = 0;
+	for (int r = 0; r < NUM_LOOKUP_ROUNDS; ++r) {
+		for (int i = 0; i < NUM_BLOCKS; ++i) {
+			u32 addr = BlockAddress(i);
+			auto iter = oldPages.find((addr & 0x3FFFFFFF) >> 10);
+			if (iter == oldPages.end())
+				continue;
+			for (int num : iter->second) {
+				if (oldBlocks[num].addr == addr) {
+					oldFound += oldBlocks[num].instr[0].src1;
+					break;
+				}
+			}
+		}
+	}
+	double oldTime = time_now_d() - start;
+	EXPECT_EQ_INT(found, oldFound);
+
+	size_t oldBytes = totalInstructions * sizeof(IRInst) + NUM_BLOCKS * (sizeof(OldStyleBlock) + 16);
+	for (const auto &it : oldPages)
+		oldBytes += it.second.capacity() * sizeof(int) + 32;
+	size_t arenaBytes = cache.GetArenaCapacity() * sizeof(IRInst);
+
+	printf("IRBlockCache: %d blocks, %d instructions\n", NUM_BLOCKS, (int)totalInstructions);
+	printf("  lookups: arena %0.2f ms, per-block heap %0.2f ms\n", newTime * 1000.0, oldTime * 1000.0);
+	printf("  instruction storage: arena %d KB, per-block heap ~%d KB (plus allocator overhead)\n", (int)(arenaBytes / 1024), (int)(oldBytes / 1024));
+
+	// Recompiling the same block over and over should not grow the arena forever.
+	// The JIT collects garbage before each compile, when no block is running.
+	size_t capacityBefore = cache.GetArenaCapacity();
+	std::vector<IRInst> replacement = BlockInstructions(7);
+	for (int r = 0; r < 100000; ++r) {
+		cache.CollectGarbage();
+		cache.SetBlockInstructions(7, replacement);
+	}
+	EXPECT_TRUE(cache.GetArenaCapacity() <= capacityBefore * 2);
+	for (int i = 0; i < NUM_BLOCKS; i += 97) {
+		const IRBlock *block = cache.GetBlock(i);
+		const IRInst *inst = cache.GetBlockInstructionPtr(*block);
+		EXPECT_EQ_INT(block->GetNumInstructions(), oldBlocks[i].numInstructions);
+		EXPECT_TRUE(inst[0].constant == (u32)i);
+	}
+
+	// A syscall can compile or clear while a block is running, which must not move its instructions.
+	const IRInst *running = cache.GetBlockInstructionPtr(*cache.GetBlock(0));
+	const int runningCount = cache.GetBlock(0)->GetNumInstructions();
+	for (int r = 0; r < 100000; ++r) {
+		cache.SetBlockInstructions(7, replacement);
+	}
+	// Clearing restores the original opcodes, so memory has to be there.
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	cache.Clear();
+	Memory::Shutdown();
+	int num = cache.AllocateBlock(BlockAddress(0));
+	cache.SetBlockInstructions(num, BlockInstructions(1));
+	EXPECT_TRUE(running[0].constant == 0);
+	EXPECT_TRUE(running[runningCount - 1].op == IROp::ExitToConst);
+	cache.CollectGarbage();
+	EXPECT_TRUE(cache.GetBlockInstructionPtr(*cache.GetBlock(num))[0].constant == 1);
+
+	return true;
+}
@@ -0,0 +1,272 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Common/StringUtils.h"
+#include "Common/TimeUtil.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/FileSystems/ISOFileSystem.h"
+#include "Core/Loaders.h"
+#include "unittest/UnitTest.h"
+
+static const int SECTOR_SIZE = 2048;
+static const int NUM_DIRS = 48;
+static const int FILES_PER_DIR = 160;
+static const int FILES_PER_SUBDIR = 40;
+static const int LOOKUP_ROUNDS = 10;
+
+class SyntheticISOLoader : public FileLoader {
+public:
+	SyntheticISOLoader(std::vector<u8> &&data) : data_(std::move(data)) {}
+
+	bool Exists() override {
+		return true;
+	}
+	bool IsDirectory() override {
+		return false;
+	}
+	s64 FileSize() override {
+		return (s64)data_.size();
+	}
+	Path GetPath() const override {
+		return Path("synthetic.iso");
+	}
+	size_t ReadAt(s64 absolutePos, size_t bytes, size_t count, void *data, Flags flags = Flags::NONE) override {
+		if (absolutePos >= (s64)data_.size())
+			return 0;
+		size_t avail = std::min(bytes * count, data_.size() - (size_t)absolutePos);
+		memcpy(data, &data_[(size_t)absolutePos], avail);
+		return avail / bytes;
+	}
+
+private:
+	std::vector<u8> data_;
+};
+
+struct SyntheticNode {
+	std::string name;
+	std::string path;
+	bool isDirectory;
+	int parent;
+	std::vector<int> children;
+	u32 sector = 0;
+	u32 size = 0;
+};
+
+static int AddNode(std::vector<SyntheticNode> &nodes, int parent, const std::string &name, bool isDirectory) {
+	SyntheticNode node;
+	node.name = name;
+	node.path = parent < 0 ? "" : nodes[parent].path + "/" + name;
+	node.isDirectory = isDirectory;
+	node.parent = parent;
+	nodes.push_back(node);
+	int index = (int)nodes.size() - 1;
+	if (parent >= 0)
+		nodes[parent].children.push_back(index);
+	return index;
+}
+
+static std::vector<SyntheticNode> MakeTree() {
+	std::vector<SyntheticNode> nodes;
+	AddNode(nodes, -1, "", true);
+	for (int d = 0; d < NUM_DIRS; ++d) {
+		int dir = AddNode(nodes, 0, StringFromFormat("DIR%03d", d), true);
+		for (int f = 0; f < FILES_PER_DIR; ++f)
+			AddNode(nodes, dir, StringFromFormat("FILE%04d.BIN", f), false);
+		int sub = AddNode(nodes, dir, "DATA", true);
+		for (int f = 0; f < FILES_PER_SUBDIR; ++f)
+			AddNode(nodes, sub, StringFromFormat("SUB%04d.DAT", f), false);
+	}
+	return nodes;
+}
+
+static int RecordSize(size_t nameLength) {
+	return (int)((33 + nameLength + 1) & ~1);
+}
+
+static void WriteRecord(u8 *dest, const std::string &id, u32 sector, u32 size, bool isDirectory) {
+	dest[0] = (u8)RecordSize(id.size());
+	for (int i = 0; i < 4; ++i) {
+		dest[2 + i] = (u8)(sector >> (i * 8));
+		dest[9 - i] = (u8)(sector >> (i * 8));
+		dest[10 + i] = (u8)(size >> (i * 8));
+		dest[17 - i] = (u8)(size >> (i * 8));
+	}
+	dest[25] = isDirectory ? 2 : 0;
+	dest[28] = 1;
+	dest[31] = 1;
+	dest[32] = (u8)id.size();
+	memcpy(dest + 33, id.data(), id.size());
+}
+
+// Lays out the directories after the volume descriptor, followed by one sector per file.
+static std::vector<u8> MakeISO(std::vector<SyntheticNode> &nodes) {
+	auto directorySectors = [&](const SyntheticNode &dir) {
+		int sectors = 1;
+		int offset = RecordSize(1) * 2;
+		for (int child : dir.children) {
+			int size = RecordSize(nodes[child].name.size());
+			if (offset + size > SECTOR_SIZE) {
+				sectors++;
+				offset = 0;
+			}
+			offset += size;
+		}
+		return sectors;
+	};
+
+	u32 nextSector = 18;
+	for (auto &node : nodes) {
+		if (node.isDirectory) {
+			node.sector = nextSector;
+			node.size = directorySectors(node) * SECTOR_SIZE;
+			nextSector += node.size / SECTOR_SIZE;
+		}
+	}
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (!nodes[i].isDirectory) {
+			nodes[i].sector = nextSector++;
+			nodes[i].size = 1 + (u32)(i % SECTOR_SIZE);
+		}
+	}
+
+	std::vector<u8> image((size_t)nextSector * SECTOR_SIZE);
+	u8 *desc = &image[16 * SECTOR_SIZE];
+	desc[0] = 1;
+	memcpy(desc + 1, "CD001", 5);
+	desc[6] = 1;
+	WriteRecord(desc + 156, std::string(1, '\0'), nodes[0].sector, nodes[0].size, true);
+
+	for (auto &node : nodes) {
+		if (!node.isDirectory)
+			continue;
+		u8 *dest = &image[(size_t)node.sector * SECTOR_SIZE];
+		const SyntheticNode &parent = node.parent < 0 ? node : nodes[node.parent];
+		WriteRecord(dest, std::string(1, '\0'), node.sector, node.size, true);
+		WriteRecord(dest + RecordSize(1), std::string(1, '\1'), parent.sector, parent.size, true);
+		int offset = RecordSize(1) * 2;
+		for (int child : node.children) {
+			const SyntheticNode &c = nodes[child];
+			int size = RecordSize(c.name.size());
+			if (offset + size > SECTOR_SIZE) {
+				dest += SECTOR_SIZE;
+				offset = 0;
+			}
+			WriteRecord(dest + offset, c.name, c.sector, c.size, c.isDirectory);
+			offset += size;
+		}
+	}
+	return image;
+}
+
+// The per-component linear search that used to be the only way, as a reference.
+static int LinearLookup(const std::vector<SyntheticNode> &nodes, const std::string &path) {
+	int current = 0;
+	size_t pos = 1;
+	while (pos < path.size()) {
+		size_t slash = path.find('/', pos);
+		if (slash == std::string::npos)
+			slash = path.size();
+		const std::string component = path.substr(pos, slash - pos);
+		int next = -1;
+		for (int child : nodes[current].children) {
+			if (nodes[child].name == component) {
+				next = child;
+				break;
+			}
+		}
+		if (next < 0)
+			return -1;
+		current = next;
+		pos = slash + 1;
+	}
+	return current;
+}
+
+bool TestISOFileSystem() {
+	std::vector<SyntheticNode> nodes = MakeTree();
+	// Declared first, so they outlive the file systems.
+	std::unique_ptr<FileLoader> loader(new SyntheticISOLoader(MakeISO(nodes)));
+	std::unique_ptr<FileLoader> freshLoader(new SyntheticISOLoader(MakeISO(nodes)));
+	SequentialHandleAllocator handles;
+	ISOFileSystem fs(&handles, new FileBlockDevice(loader.get()));
+
+	// The first pass reads every directory along the way.
+	double start = time_now_d();
+	for (const auto &node : nodes) {
+		if (node.isDirectory)
+			continue;
+		PSPFileInfo info = fs.GetFileInfo(node.path);
+		EXPECT_TRUE(info.exists);
+		EXPECT_EQ_INT(info.startSector, node.sector);
+		EXPECT_EQ_INT((int)info.size, (int)node.size);
+	}
+	double coldTime = time_now_d() - start;
+
+	int files = 0;
+	start = time_now_d();
+	for (int r = 0; r < LOOKUP_ROUNDS; ++r) {
+		for (const auto &node : nodes) {
+			if (!node.isDirectory)
+				files += fs.GetFileInfo(node.path).exists ? 1 : 0;
+		}
+	}
+	double indexedTime = time_now_d() - start;
+
+	int found = 0;
+	start = time_now_d();
+	for (int r = 0; r < LOOKUP_ROUNDS; ++r) {
+		for (const auto &node : nodes) {
+			if (!node.isDirectory)
+				found += LinearLookup(nodes, node.path) >= 0 ? 1 : 0;
+		}
+	}
+	double linearTime = time_now_d() - start;
+	EXPECT_EQ_INT(files, found);
+
+	// Case doesn't matter, and a trailing slash or leading ./ is fine.
+	EXPECT_EQ_INT(fs.GetFileInfo("/dir007/data/sub0012.dat").startSector, nodes[LinearLookup(nodes, "/DIR007/DATA/SUB0012.DAT")].sector);
+	EXPECT_TRUE(fs.GetFileInfo("./DIR003/DATA/").type == FILETYPE_DIRECTORY);
+	EXPECT_FALSE(fs.GetFileInfo("/DIR003/NOPE.BIN").exists);
+	EXPECT_FALSE(fs.GetFileInfo("/DIR003/FILE0001.BIN/X").exists);
+	EXPECT_FALSE(fs.GetFileInfo("/NOPE/FILE0001.BIN").exists);
+	EXPECT_FALSE(fs.GetFileInfo("/DIR003//FILE0001.BIN").exists);
+
+	bool exists = false;
+	std::vector<PSPFileInfo> listing = fs.GetDirListing("/DIR005", &exists);
+	EXPECT_TRUE(exists);
+	EXPECT_EQ_INT((int)listing.size(), FILES_PER_DIR + 1);
+
+	// A fresh mount, resolving paths in a directory that hasn't been read yet.
+	{
+		ISOFileSystem fresh(&handles, new FileBlockDevice(freshLoader.get()));
+		EXPECT_TRUE(fresh.GetFileInfo("/DIR040/DATA/SUB0039.DAT").exists);
+		EXPECT_FALSE(fresh.GetFileInfo("/DIR041/DATA/SUB0040.DAT").exists);
+	}
+
+	const SyntheticNode &lbnFile = nodes[LinearLookup(nodes, "/DIR010/FILE0100.BIN")];
+	int fd = fs.OpenFile(StringFromFormat("/sce_lbn0x%x_size0x%x", lbnFile.sector, lbnFile.size), FILEACCESS_READ, "disc0:");
+	EXPECT_TRUE(fd > 0);
+	fs.CloseFile(fd);
+
+	printf("ISOFileSystem, %d files: first pass %0.2f ms, indexed %0.2f ms/pass, linear %0.2f ms/pass\n", files / LOOKUP_ROUNDS, coldTime * 1000.0, indexedTime * 1000.0 / LOOKUP_ROUNDS, linearTime * 1000.0 / LOOKUP_ROUNDS);
+	return true;
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Common/ConsoleListener.h"
+#include "Common/File/FileUtil.h"
+#include "Common/LogManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/Config.h"
+#include "unittest/UnitTest.h"
+
+static const int NUM_THREADS = 4;
+static const int MESSAGES_PER_THREAD = 50000;
+// Small enough to fit in the ring all at once.
+static const int BURST_PER_THREAD = 1000;
+
+// Checks that each thread's messages arrive in the order they were logged.
+class OrderCheckingListener : public LogListener {
+public:
+	void Log(const LogMessage &msg) override {
+		int thread = -1, seq = -1;
+		if (sscanf(msg.msg.c_str(), "bench %d: %d", &thread, &seq) == 2 && thread >= 0 && thread < NUM_THREADS) {
+			if (seq <= lastSeq_[thread])
+				outOfOrder_++;
+			lastSeq_[thread] = seq;
+			received_++;
+		} else if (msg.msg.size() > 1000 && msg.msg.back() == '\n' && msg.msg[0] == 'x') {
+			longMessages_++;
+		}
+	}
+
+	int Received() const {
+		return received_;
+	}
+	int OutOfOrder() const {
+		return outOfOrder_;
+	}
+	int LongMessages() const {
+		return longMessages_;
+	}
+
+private:
+	int lastSeq_[NUM_THREADS]{ -1, -1, -1, -1 };
+	int received_ = 0;
+	int outOfOrder_ = 0;
+	int longMessages_ = 0;
+};
+
+static int CountLines(const Path &filename, const char *match) {
+	std::string data;
+	if (!File::ReadTextFileToString(filename, &data))
+		return -1;
+	int lines = 0;
+	size_t pos = 0;
+	while ((pos = data.find(match, pos)) != data.npos) {
+		lines++;
+		pos = data.find('\n', pos);
+	}
+	return lines;
+}
+
+static double LogFromThreads(int first, int count) {
+	double start = time_now_d();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < NUM_THREADS; ++t) {
+		threads.emplace_back([t, first, count] {
+			for (int i = first; i < first + count; ++i)
+				GenericLog(LogLevel::LVERBOSE, LogType::HLE, __FILE__, __LINE__, "bench %d: %d (%08x, %s)", t, i, i * 0x1234567, "sceIoRead");
+		});
+	}
+	for (auto &th : threads)
+		th.join();
+	return time_now_d() - start;
+}
+
+bool TestLogManager() {
+	bool oldEnabled = g_Config.bEnableLogging;
+	g_Config.bEnableLogging = true;
+	bool ownLogManager = LogManager::GetInstance() == nullptr;
+	if (ownLogManager)
+		LogManager::Init(&g_Config.bEnableLogging);
+	LogManager *logman = LogManager::GetInstance();
+	logman->RemoveListener(logman->GetConsoleListener());
+	logman->SetEnabled(LogType::HLE, true);
+	logman->SetLogLevel(LogType::HLE, LogLevel::LVERBOSE);
+
+	OrderCheckingListener checker;
+	logman->AddListener(&checker);
+	// The file log is the slow listener, which callers shouldn't have to wait on.
+	const Path logFilename("logmanager_test.txt");
+	File::Delete(logFilename);
+	logman->ChangeFileLog(logFilename.c_str());
+
+	std::string longMessage(4000, 'x');
+	GenericLog(LogLevel::LINFO, LogType::HLE, __FILE__, __LINE__, "%s", longMessage.c_str());
+
+	// A burst the ring can hold shouldn't lose anything.
+	logman->Flush();
+	u64 droppedBefore = logman->GetDroppedCount();
+	double burstTime = LogFromThreads(0, BURST_PER_THREAD);
+	logman->Flush();
+	int burstDropped = (int)(logman->GetDroppedCount() - droppedBefore);
+	int burstReceived = checker.Received();
+
+	// Then as fast as possible, more than the listeners can keep up with.
+	double start = time_now_d();
+	double logTime = LogFromThreads(BURST_PER_THREAD, MESSAGES_PER_THREAD);
+	logman->Flush();
+	double drainTime = time_now_d() - start;
+	int dropped = (int)(logman->GetDroppedCount() - droppedBefore);
+
+	logman->ChangeFileLog(nullptr);
+	logman->RemoveListener(&checker);
+	logman->AddListener(logman->GetConsoleListener());
+	int fileLines = CountLines(logFilename, "]: bench ");
+	File::Delete(logFilename);
+	if (ownLogManager)
+		LogManager::Shutdown();
+	g_Config.bEnableLogging = oldEnabled;
+
+	const int total = NUM_THREADS * (BURST_PER_THREAD + MESSAGES_PER_THREAD);
+	const int flood = NUM_THREADS * MESSAGES_PER_THREAD;
+	printf("Logging from %d threads: bursts of %d at %0.1f ns per call, floods of %d at %0.1f ns per call (%d written in %0.1f ms, %d dropped)\n", NUM_THREADS, BURST_PER_THREAD, burstTime * 1e9 / (NUM_THREADS * BURST_PER_THREAD), MESSAGES_PER_THREAD, logTime * 1e9 / flood, checker.Received() - burstReceived, drainTime * 1000.0, dropped);
+	EXPECT_EQ_INT(burstDropped, 0);
+	EXPECT_EQ_INT(burstReceived, NUM_THREADS * BURST_PER_THREAD);
+	EXPECT_EQ_INT(checker.LongMessages(), 1);
+	EXPECT_EQ_INT(checker.OutOfOrder(), 0);
+	EXPECT_EQ_INT(checker.Received() + dropped, total);
+	EXPECT_EQ_INT(fileLines, checker.Received());
+	return true;
+}
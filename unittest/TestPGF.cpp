@@ -0,0 +1,150 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "Common/File/FileUtil.h"
+#include "Common/TimeUtil.h"
+#include "Core/Font/PGF.h"
+#include "Core/MemMap.h"
+#include "ext/xxhash.h"
+#include "unittest/UnitTest.h"
+
+static const u32 BUF_ADDR = 0x08800000;
+static const int BUF_WIDTH = 480;
+static const int BUF_HEIGHT = 272;
+static const int BENCH_PAGES = 50;
+
+// Output of the per-pixel renderer this replaced, for the pages below.
+static const u64 GOLDEN_LATIN = 0x57031a352f028071ULL;
+static const u64 GOLDEN_KOREAN = 0x6274aaa1019517b2ULL;
+
+static bool LoadFont(PGF &pgf, const char *name) {
+	Path path = Path("assets/flash0/font") / name;
+	if (!File::Exists(path))
+		path = Path("../assets/flash0/font") / name;
+	std::string data;
+	if (!File::ReadBinaryFileToString(path, &data)) {
+		printf("Unable to read %s\n", path.c_str());
+		return false;
+	}
+	return pgf.ReadPtr((const u8 *)data.data(), data.size());
+}
+
+static int BytesPerLine(int format) {
+	switch (format) {
+	case PSP_FONT_PIXELFORMAT_4:
+	case PSP_FONT_PIXELFORMAT_4_REV:
+		return BUF_WIDTH / 2;
+	case PSP_FONT_PIXELFORMAT_24:
+		return BUF_WIDTH * 3;
+	case PSP_FONT_PIXELFORMAT_32:
+		return BUF_WIDTH * 4;
+	default:
+		return BUF_WIDTH;
+	}
+}
+
+// Lays out a page of text the way a game would, one glyph at a time, running off the edges.
+static int DrawPage(const PGF &pgf, int format, int firstChar, int numChars, bool subpixel, bool clip, int glyphType) {
+	GlyphImage image{};
+	image.pixelFormat = (FontPixelFormat)format;
+	image.bufWidth = BUF_WIDTH;
+	image.bufHeight = BUF_HEIGHT;
+	image.bytesPerLine = BytesPerLine(format);
+	image.bufferPtr = BUF_ADDR;
+
+	int x = -5 * 64;
+	int y = -6 * 64;
+	int glyphs = 0;
+	for (int i = 0; i < numChars; ++i) {
+		int charCode = firstChar + i;
+		PGFCharInfo info;
+		if (!pgf.GetCharInfo(charCode, &info, '?', glyphType))
+			continue;
+
+		image.xPos64 = x;
+		image.yPos64 = y;
+		if (clip)
+			pgf.DrawCharacter(&image, 10, 6, BUF_WIDTH - 30, BUF_HEIGHT - 20, charCode, '?', glyphType);
+		else
+			pgf.DrawCharacter(&image, -1, -1, -1, -1, charCode, '?', glyphType);
+		glyphs++;
+
+		int advance = (int)info.sfp26AdvanceH;
+		x += subpixel ? advance + 7 : (advance + 63) & ~63;
+		if (x > (BUF_WIDTH + 8) * 64) {
+			x = subpixel ? -5 * 64 + (i & 63) : -5 * 64;
+			y += subpixel ? 17 * 64 + 21 : 18 * 64;
+		}
+	}
+	return glyphs;
+}
+
+// Every format, with and without subpixel positions and clipping.
+static u64 HashPages(const PGF &pgf, int firstChar, int numChars) {
+	XXH3_state_t *state = XXH3_createState();
+	XXH3_64bits_reset(state);
+	for (int format = PSP_FONT_PIXELFORMAT_4; format <= PSP_FONT_PIXELFORMAT_32 + 1; ++format) {
+		for (int variant = 0; variant < 6; ++variant) {
+			u8 *buf = Memory::GetPointerWriteUnchecked(BUF_ADDR);
+			memset(buf, 0x5A, BUF_WIDTH * 4 * BUF_HEIGHT);
+			int glyphType = variant >= 4 ? FONT_PGF_SHADOWGLYPH : FONT_PGF_CHARGLYPH;
+			DrawPage(pgf, format, firstChar, numChars, (variant & 1) != 0, (variant & 2) != 0, glyphType);
+			XXH3_64bits_update(state, buf, BytesPerLine(format) * BUF_HEIGHT);
+		}
+	}
+	u64 hash = XXH3_64bits_digest(state);
+	XXH3_freeState(state);
+	return hash;
+}
+
+static double BenchPages(const PGF &pgf, int format, int firstChar, int numChars, int *glyphs) {
+	double start = time_now_d();
+	*glyphs = 0;
+	for (int i = 0; i < BENCH_PAGES; ++i)
+		*glyphs += DrawPage(pgf, format, firstChar, numChars, (i & 1) != 0, false, FONT_PGF_CHARGLYPH);
+	return time_now_d() - start;
+}
+
+bool TestPGF() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+
+	PGF latin, korean;
+	bool success = LoadFont(latin, "ltn0.pgf") && LoadFont(korean, "kr0.pgf");
+	u64 latinHash = 0, koreanHash = 0;
+	if (success) {
+		latinHash = HashPages(latin, 0x20, 224);
+		koreanHash = HashPages(korean, 0xAC00, 400);
+	}
+
+	if (success) {
+		int latinGlyphs, koreanGlyphs;
+		double latinTime = BenchPages(latin, PSP_FONT_PIXELFORMAT_4, 0x20, 224, &latinGlyphs);
+		double koreanTime = BenchPages(korean, PSP_FONT_PIXELFORMAT_8, 0xAC00, 400, &koreanGlyphs);
+		printf("PGF glyphs: latin 4-bit %0.1f us per page of %d, korean 8-bit %0.1f us per page of %d\n", latinTime * 1000000.0 / BENCH_PAGES, latinGlyphs / BENCH_PAGES, koreanTime * 1000000.0 / BENCH_PAGES, koreanGlyphs / BENCH_PAGES);
+	}
+
+	Memory::Shutdown();
+	if (success && (latinHash != GOLDEN_LATIN || koreanHash != GOLDEN_KOREAN)) {
+		printf("Output hashes: %016llx %016llx\n", (unsigned long long)latinHash, (unsigned long long)koreanHash);
+		success = false;
+	}
+	return success;
+}
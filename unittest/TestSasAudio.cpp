@@ -0,0 +1,160 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <memory>
+#include "Common/CPUDetect.h"
+#include "Common/Data/Random/Rng.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
+#include "Core/Config.h"
+#include "Core/HW/SasAudio.h"
+#include "Core/MemMap.h"
+#include "ext/xxhash.h"
+#include "unittest/UnitTest.h"
+
+static const u32 VAG_ADDR = 0x08800000;
+static const int VAG_BLOCKS = 600;
+static const u32 PCM_ADDR = 0x08900000;
+static const int PCM_SAMPLES = 0x8000;
+static const u32 OUT_ADDR = 0x08A00000;
+static const int NUM_VOICES = 28;
+static const int NUM_GRAINS = 300;
+
+// Output of the scalar mixer this replaced, for the scenes below.
+static const u64 GOLDEN_MIXED = 0xc2e3ff0fe8f07ea0ULL;
+static const u64 GOLDEN_RAW = 0xe4e4b7e56fa1c2aeULL;
+static const u64 GOLDEN_LARGE = 0x65219435919a3a39ULL;
+
+static void WriteSampleData() {
+	GMRng rng;
+	u8 *vag = Memory::GetPointerWriteUnchecked(VAG_ADDR);
+	for (int b = 0; b < VAG_BLOCKS; ++b) {
+		u8 *block = vag + b * 16;
+		// Filters 0-4 with a varying shift, and a loop start/end somewhere in the middle.
+		block[0] = (u8)(((b % 5) << 4) | (2 + (b % 9)));
+		block[1] = b == 40 ? 6 : (b == VAG_BLOCKS - 2 ? 3 : 0);
+		for (int i = 2; i < 16; ++i)
+			block[i] = (u8)rng.R32();
+	}
+
+	s16 *pcm = (s16 *)Memory::GetPointerWriteUnchecked(PCM_ADDR);
+	for (int i = 0; i < PCM_SAMPLES; ++i)
+		pcm[i] = (s16)((i * 37) ^ (int)(rng.R32() & 0x3FF)) - 0x4000 + (i & 0x7FFF);
+}
+
+// A busy scene: several voice types, pitches, envelopes and volumes, with key on/off along the way.
+static void SetupVoices(SasInstance &sas) {
+	static const int pitches[] = { 0x1000, 0x0800, 0x1800, 0x3000, 0x1234, 0x0E00, 0x4000 };
+	for (int v = 0; v < NUM_VOICES; ++v) {
+		SasVoice &voice = sas.voices[v];
+		if (v % 3 == 2) {
+			voice.type = VOICETYPE_PCM;
+			voice.pcmAddr = PCM_ADDR + v * 64;
+			voice.pcmSize = PCM_SAMPLES / 2 - v * 100;
+			voice.pcmIndex = 0;
+			voice.pcmLoopPos = v & 1 ? 100 : 0;
+			voice.loop = (v & 1) != 0;
+		} else {
+			voice.type = VOICETYPE_VAG;
+			voice.vagAddr = VAG_ADDR + (v % 4) * 16 * 32;
+			voice.vagSize = (VAG_BLOCKS - (v % 4) * 32) * 16;
+			voice.loop = (v & 4) != 0;
+		}
+		voice.pitch = pitches[v % ARRAY_SIZE(pitches)];
+		// Quiet enough that the sum doesn't just clip.
+		voice.volumeLeft = (0x1000 - v * 97) / 8;
+		voice.volumeRight = v & 1 ? -0x180 : (0x1000 - v * 31) / 8;
+		voice.effectLeft = v * 20;
+		voice.effectRight = (0x1000 - v * 60) / 8;
+		voice.envelope.SetSimpleEnvelope(0x000F + v * 0x0123, 0x1FC0 + v * 0x0105);
+		voice.KeyOn();
+	}
+}
+
+static u64 RunScene(int grainSize, int outputMode, double *seconds) {
+	std::unique_ptr<SasInstance> sas(new SasInstance());
+	sas->SetGrainSize(grainSize);
+	sas->outputMode = outputMode;
+	sas->waveformEffect.isWetOn = 1;
+	sas->waveformEffect.leftVol = 0x1000;
+	sas->waveformEffect.rightVol = 0x0C00;
+	sas->SetWaveformEffectType(PSP_SAS_EFFECT_TYPE_HALL);
+	SetupVoices(*sas);
+
+	const int outBytes = grainSize * 2 * sizeof(s16) * (outputMode == PSP_SAS_OUTPUTMODE_RAW ? 2 : 1);
+	XXH3_state_t *state = XXH3_createState();
+	XXH3_64bits_reset(state);
+	double time = 0.0;
+	for (int grain = 0; grain < NUM_GRAINS; ++grain) {
+		if (grain == NUM_GRAINS / 3) {
+			for (int v = 0; v < NUM_VOICES; v += 4)
+				sas->voices[v].KeyOff();
+		}
+		if (grain == NUM_GRAINS / 2) {
+			sas->voices[1].pitch = 0x0C00;
+			sas->voices[3].paused = true;
+		}
+
+		double start = time_now_d();
+		sas->Mix(OUT_ADDR);
+		time += time_now_d() - start;
+		XXH3_64bits_update(state, Memory::GetPointerUnchecked(OUT_ADDR), outBytes);
+	}
+	u64 hash = XXH3_64bits_digest(state);
+	XXH3_freeState(state);
+
+	*seconds = time;
+	return hash;
+}
+
+static bool CheckScenes(const char *name) {
+	double seconds[3];
+	u64 mixed = RunScene(256, PSP_SAS_OUTPUTMODE_MIXED, &seconds[0]);
+	u64 raw = RunScene(256, PSP_SAS_OUTPUTMODE_RAW, &seconds[1]);
+	u64 large = RunScene(1024, PSP_SAS_OUTPUTMODE_MIXED, &seconds[2]);
+	printf("SAS mix (%s), %d voices: %0.1f us per 256-sample grain, %0.1f us per 1024-sample grain\n", name, NUM_VOICES, seconds[0] * 1000000.0 / NUM_GRAINS, seconds[2] * 1000000.0 / NUM_GRAINS);
+	if (mixed != GOLDEN_MIXED || raw != GOLDEN_RAW || large != GOLDEN_LARGE) {
+		printf("Output hashes: %016llx %016llx %016llx\n", (unsigned long long)mixed, (unsigned long long)raw, (unsigned long long)large);
+		return false;
+	}
+	return true;
+}
+
+bool TestSasAudio() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	WriteSampleData();
+	// The default, which the config might not have been loaded with.
+	int oldReverbVolume = g_Config.iReverbVolume;
+	g_Config.iReverbVolume = 10;
+
+	// Once on this thread, and then with worker threads around.
+	bool ownThreadManager = !g_threadManager.IsInitialized();
+	bool success = true;
+	if (ownThreadManager) {
+		success = CheckScenes("serial");
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+	}
+	success = success && CheckScenes("threaded");
+
+	if (ownThreadManager)
+		g_threadManager.Teardown();
+	g_Config.iReverbVolume = oldReverbVolume;
+	Memory::Shutdown();
+	return success;
+}
@@ -17,6 +17,7 @@
 
 #include "Common/Data/Random/Rng.h"
 #include "Common/StringUtils.h"
+#include "Common/TimeUtil.h"
 #include "Core/Config.h"
 #include "GPU/Software/BinManager.h"
 #include "GPU/Software/DrawPixel.h"
@@ -161,6 +162,166 @@ static bool TestPixelJit() {
 	return successes == count && !HitAnyAsserts();
 }
 
+static void RandomizeQuadInputs(GMRng &rng, Math3D::Vec4<int> &z, Math3D::Vec4<int> &fog, Math3D::Vec4<int> *colors, Math3D::Vec4<int> &mask) {
+	for (int i = 0; i < 4; ++i) {
+		z[i] = rng.R32() & 0xFFFF;
+		fog[i] = rng.R32() & 0xFF;
+		// Include some out of range values, which need clamping.
+		for (int c = 0; c < 4; ++c)
+			colors[i][c] = (int)(rng.R32() % 320) - 32;
+		mask[i] = (rng.R32() & 3) == 0 ? -1 : 0;
+	}
+}
+
+static bool TestPixelQuad() {
+	using namespace Rasterizer;
+	PixelFuncID probeID;
+	probeID.fbFormat = GE_FORMAT_8888;
+	if (!GetQuadFunc(probeID)) {
+		// Not every platform has the quad path.
+		return true;
+	}
+
+	PixelJitCache *cache = new PixelJitCache();
+	BinManager binner;
+
+	GMRng rng;
+	int successes = 0;
+	int count = 2000;
+	bool header = false;
+
+	const int stride = 512;
+	u32 *fb_data = new u32[stride * 2];
+	u16 *zb_data = new u16[stride * 2];
+	u32 *fb_expected = new u32[stride * 2];
+	u16 *zb_expected = new u16[stride * 2];
+	u32 *fb_saved = new u32[stride * 2];
+	u16 *zb_saved = new u16[stride * 2];
+	fb.as32 = fb_data;
+	depthbuf.as16 = zb_data;
+
+	for (int i = 0; i < count; ) {
+		PixelFuncID id;
+		memset(&id, 0, sizeof(id));
+		id.fullKey = (uint64_t)rng.R32() | ((uint64_t)rng.R32() << 32);
+		id.clearMode = false;
+		id.stencilTest = false;
+		id.colorTest = false;
+		id.applyLogicOp = false;
+		id.applyColorWriteMask = false;
+		id.fbFormat = (rng.R32() & 1) ? GE_FORMAT_8888 : GE_FORMAT_565;
+		id.cached.framebufStride = stride;
+		id.cached.depthbufStride = stride;
+		id.cached.fogColor = rng.R32();
+		id.cached.minz = rng.R32() & 0xFFFF;
+		id.cached.maxz = id.cached.minz + (rng.R32() & 0xFFFF);
+		id.cached.alphaTestMask = rng.R32();
+		id.cached.alphaBlendSrc = rng.R32();
+		id.cached.alphaBlendDst = rng.R32();
+		for (int j = 0; j < 16; ++j)
+			id.cached.ditherMatrix[j] = (int8_t)((rng.R32() & 7) - 4);
+
+		std::string desc = DescribePixelFuncID(id);
+		if (startsWith(desc, "INVALID"))
+			continue;
+		i++;
+
+		QuadFunc quadFunc = GetQuadFunc(id);
+		SingleFunc singleFunc = cache->GenericSingle(id);
+
+		bool matched = true;
+		for (int j = 0; j < 16 && matched; ++j) {
+			for (int k = 0; k < stride * 2; ++k) {
+				fb_data[k] = rng.R32();
+				zb_data[k] = (u16)rng.R32();
+			}
+
+			Math3D::Vec4<int> z, fog, colors[4], mask;
+			RandomizeQuadInputs(rng, z, fog, colors, mask);
+			int x = (rng.R32() % (stride / 2)) * 2;
+
+			memcpy(fb_saved, fb_data, stride * 2 * sizeof(u32));
+			memcpy(zb_saved, zb_data, stride * 2 * sizeof(u16));
+
+			for (int lane = 0; lane < 4; ++lane) {
+				if (mask[lane] >= 0)
+					singleFunc(x + (lane & 1), lane / 2, z[lane], fog[lane], ToVec4IntArg(colors[lane]), id);
+			}
+			memcpy(fb_expected, fb_data, stride * 2 * sizeof(u32));
+			memcpy(zb_expected, zb_data, stride * 2 * sizeof(u16));
+
+			memcpy(fb_data, fb_saved, stride * 2 * sizeof(u32));
+			memcpy(zb_data, zb_saved, stride * 2 * sizeof(u16));
+
+			quadFunc(x, 0, z, fog, colors, mask, id);
+			matched = memcmp(fb_data, fb_expected, stride * 2 * sizeof(u32)) == 0 && memcmp(zb_data, zb_expected, stride * 2 * sizeof(u16)) == 0;
+		}
+
+		if (matched) {
+			successes++;
+		} else {
+			if (!header)
+				printf("Failed pixel quad funcs:\n");
+			header = true;
+			printf(" * %s\n", desc.c_str());
+		}
+	}
+
+	if (successes < count)
+		printf("PixelQuad success: %d / %d\n", successes, count);
+
+	// Benchmark a common textured and blended state, against the per pixel path.
+	PixelFuncID id;
+	memset(&id, 0, sizeof(id));
+	id.fbFormat = GE_FORMAT_8888;
+	id.alphaTestFunc = GE_COMP_ALWAYS;
+	id.depthTestFunc = GE_COMP_ALWAYS;
+	id.stencilTestFunc = GE_COMP_ALWAYS;
+	id.alphaBlend = true;
+	id.alphaBlendEq = GE_BLENDMODE_MUL_AND_ADD;
+	id.alphaBlendSrc = (uint8_t)PixelBlendFactor::SRCALPHA;
+	id.alphaBlendDst = (uint8_t)PixelBlendFactor::INVSRCALPHA;
+	id.dithering = true;
+	id.earlyZChecks = true;
+	id.cached.framebufStride = stride;
+	id.cached.depthbufStride = stride;
+
+	QuadFunc quadFunc = GetQuadFunc(id);
+	SingleFunc singleFunc = cache->GetSingle(id, &binner);
+	if (quadFunc && singleFunc) {
+		Math3D::Vec4<int> z, fog, colors[4], mask;
+		RandomizeQuadInputs(rng, z, fog, colors, mask);
+		mask = Math3D::Vec4<int>::AssignToAll(0);
+		const int quads = 1000000;
+
+		double start = time_now_d();
+		for (int i = 0; i < quads; ++i) {
+			int x = (i * 2) & (stride - 1);
+			for (int lane = 0; lane < 4; ++lane)
+				singleFunc(x + (lane & 1), lane / 2, z[lane], fog[lane], ToVec4IntArg(colors[lane]), id);
+		}
+		double singleTime = time_now_d() - start;
+
+		start = time_now_d();
+		for (int i = 0; i < quads; ++i) {
+			int x = (i * 2) & (stride - 1);
+			quadFunc(x, 0, z, fog, colors, mask, id);
+		}
+		double quadTime = time_now_d() - start;
+
+		printf("Pixel quads (%s): per pixel %0.2f ms, quad %0.2f ms\n", singleFunc == cache->GenericSingle(id) ? "generic" : "jit", singleTime * 1000.0, quadTime * 1000.0);
+	}
+
+	delete [] fb_data;
+	delete [] zb_data;
+	delete [] fb_expected;
+	delete [] zb_expected;
+	delete [] fb_saved;
+	delete [] zb_saved;
+	delete cache;
+	return successes == count && !HitAnyAsserts();
+}
+
 bool TestSoftwareGPUJit() {
 	g_Config.bSoftwareRenderingJit = true;
 	ResetHitAnyAsserts();
@@ -173,5 +334,9 @@ bool TestSoftwareGPUJit() {
 		return false;
 	}
 
+	if (!TestPixelQuad()) {
+		return false;
+	}
+
 	return true;
 }
@@ -0,0 +1,159 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <vector>
+#include "Common/Data/Random/Rng.h"
+#include "Common/TimeUtil.h"
+#include "GPU/GPUState.h"
+#include "GPU/Common/TextureDecoder.h"
+#include "unittest/UnitTest.h"
+
+static const int TEX_SIZE = 512;
+static const int BENCH_ROUNDS = 20;
+
+// The scalar loops that used to be the only implementation, as a reference.
+template <typename ClutT>
+static void RefDeIndex8(ClutT *dest, const u8 *indexed, int length, const ClutT *clut, u32 *outAlphaSum) {
+	ClutT alphaSum = (ClutT)(-1);
+	for (int i = 0; i < length; ++i) {
+		ClutT color = clut[indexed[i]];
+		alphaSum &= color;
+		dest[i] = color;
+	}
+	*outAlphaSum &= (u32)alphaSum;
+}
+
+template <typename ClutT>
+static void RefDeIndex4(ClutT *dest, const u8 *indexed, int length, const ClutT *clut, u32 *outAlphaSum) {
+	const bool nakedIndex = gstate.isClutIndexSimple();
+	ClutT alphaSum = (ClutT)(-1);
+	for (int i = 0; i < length; i += 2) {
+		u8 index = *indexed++;
+		ClutT color0 = clut[nakedIndex ? (index & 0xf) : gstate.transformClutIndex(index & 0xf)];
+		ClutT color1 = clut[nakedIndex ? (index >> 4) : gstate.transformClutIndex(index >> 4)];
+		dest[i] = color0;
+		alphaSum &= color0;
+		if (i + 1 < length) {
+			dest[i + 1] = color1;
+			alphaSum &= color1;
+		}
+	}
+	*outAlphaSum &= (u32)alphaSum;
+}
+
+template <typename ClutT>
+static std::vector<ClutT> MakeClut(GMRng &rng, bool opaque) {
+	// Room for shifts and start positions in the non-simple case.
+	std::vector<ClutT> clut(512);
+	for (auto &c : clut) {
+		c = (ClutT)rng.R32();
+		if (opaque)
+			c |= (ClutT)(sizeof(ClutT) == 2 ? 0xF000 : 0xFF000000);
+	}
+	return clut;
+}
+
+template <typename ClutT>
+static bool CheckDeIndex(GMRng &rng, const std::vector<u8> &indices, bool fourBit) {
+	for (int opaque = 0; opaque < 2; ++opaque) {
+		std::vector<ClutT> clut = MakeClut<ClutT>(rng, opaque != 0);
+		std::vector<ClutT> expected(1024), actual(1024);
+		for (int trial = 0; trial < 200; ++trial) {
+			int length = 1 + (rng.R32() % 700);
+			int offset = fourBit ? (rng.R32() % 16) * 2 : rng.R32() % 16;
+			u32 expectedSum = 0xFFFFFFFF, actualSum = 0xFFFFFFFF;
+			if (fourBit) {
+				RefDeIndex4(expected.data(), &indices[offset / 2], length, clut.data(), &expectedSum);
+				DeIndexTexture4(actual.data() + 1, &indices[offset / 2], length, clut.data(), &actualSum);
+			} else {
+				RefDeIndex8(expected.data(), &indices[offset], length, clut.data(), &expectedSum);
+				DeIndexTexture(actual.data() + 1, &indices[offset], length, clut.data(), &actualSum);
+			}
+			EXPECT_EQ_HEX(actualSum, expectedSum);
+			for (int i = 0; i < length; ++i) {
+				EXPECT_EQ_HEX((u32)actual[i + 1], (u32)expected[i]);
+			}
+		}
+	}
+	return true;
+}
+
+template <typename ClutT>
+static void BenchmarkDeIndex(GMRng &rng, const std::vector<u8> &indices, bool fourBit, const char *name) {
+	std::vector<ClutT> clut = MakeClut<ClutT>(rng, true);
+	std::vector<ClutT> out(TEX_SIZE * TEX_SIZE);
+	const int rowBytes = fourBit ? TEX_SIZE / 2 : TEX_SIZE;
+
+	u32 alphaSum = 0xFFFFFFFF;
+	double start = time_now_d();
+	for (int r = 0; r < BENCH_ROUNDS; ++r) {
+		for (int y = 0; y < TEX_SIZE; ++y) {
+			if (fourBit)
+				DeIndexTexture4(&out[y * TEX_SIZE], &indices[y * rowBytes], TEX_SIZE, clut.data(), &alphaSum);
+			else
+				DeIndexTexture(&out[y * TEX_SIZE], &indices[y * rowBytes], TEX_SIZE, clut.data(), &alphaSum);
+		}
+	}
+	double newTime = time_now_d() - start;
+
+	start = time_now_d();
+	for (int r = 0; r < BENCH_ROUNDS; ++r) {
+		for (int y = 0; y < TEX_SIZE; ++y) {
+			if (fourBit)
+				RefDeIndex4(&out[y * TEX_SIZE], &indices[y * rowBytes], TEX_SIZE, clut.data(), &alphaSum);
+			else
+				RefDeIndex8(&out[y * TEX_SIZE], &indices[y * rowBytes], TEX_SIZE, clut.data(), &alphaSum);
+		}
+	}
+	double refTime = time_now_d() - start;
+
+	double mtexels = (double)TEX_SIZE * TEX_SIZE * BENCH_ROUNDS / 1000000.0;
+	printf("  %s: %0.1f Mtexels/s (scalar %0.1f Mtexels/s)\n", name, mtexels / newTime, mtexels / refTime);
+}
+
+bool TestTextureDecoder() {
+	GMRng rng;
+	std::vector<u8> indices(TEX_SIZE * TEX_SIZE);
+	for (auto &i : indices)
+		i = (u8)rng.R32();
+
+	u32 oldClutFormat = gstate.clutformat;
+	// No shift, full mask, no start position.
+	gstate.clutformat = 0xC500FF00;
+	EXPECT_TRUE(gstate.isClutIndexSimple());
+
+	EXPECT_TRUE(CheckDeIndex<u16>(rng, indices, false));
+	EXPECT_TRUE(CheckDeIndex<u32>(rng, indices, false));
+	EXPECT_TRUE(CheckDeIndex<u16>(rng, indices, true));
+	EXPECT_TRUE(CheckDeIndex<u32>(rng, indices, true));
+
+	printf("CLUT decoding, %dx%d:\n", TEX_SIZE, TEX_SIZE);
+	BenchmarkDeIndex<u16>(rng, indices, true, "CLUT4 -> 16-bit");
+	BenchmarkDeIndex<u32>(rng, indices, true, "CLUT4 -> 32-bit");
+	BenchmarkDeIndex<u16>(rng, indices, false, "CLUT8 -> 16-bit");
+	BenchmarkDeIndex<u32>(rng, indices, false, "CLUT8 -> 32-bit");
+
+	// A shift, mask and start position take the generic path, which must still match.
+	gstate.clutformat = 0xC5010F04;
+	EXPECT_FALSE(gstate.isClutIndexSimple());
+	EXPECT_TRUE(CheckDeIndex<u16>(rng, indices, true));
+	EXPECT_TRUE(CheckDeIndex<u32>(rng, indices, true));
+
+	gstate.clutformat = oldClutFormat;
+	return true;
+}
@@ -1,3 +1,5 @@
+#include <functional>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include <cstdio>
@@ -119,11 +121,148 @@ bool TestMultithreadedScheduling() {
 
 	threads.clear();
 
-	printf("Stress test elapsed: %0.2f", start.Elapsed());
+	printf("Stress test elapsed: %0.2f\n", start.Elapsed());
 
 	return true;
 }
 
+class CountTask : public Task {
+public:
+	CountTask(TaskPriority priority, WaitableCounter *counter) : priority_(priority), counter_(counter) {}
+	TaskType Type() const override { return TaskType::CPU_COMPUTE; }
+	TaskPriority Priority() const override { return priority_; }
+	void Run() override {
+		g_atomicCounter++;
+		counter_->Count();
+	}
+private:
+	TaskPriority priority_;
+	WaitableCounter *counter_;
+};
+
+class RecordTask : public Task {
+public:
+	RecordTask(TaskPriority priority, std::function<void()> func) : priority_(priority), func_(func) {}
+	TaskType Type() const override { return TaskType::CPU_COMPUTE; }
+	TaskPriority Priority() const override { return priority_; }
+	void Run() override { func_(); }
+private:
+	TaskPriority priority_;
+	std::function<void()> func_;
+};
+
+// Queued HIGH tasks must run before queued LOW ones, whatever the order they came in.
+// With more than fit in the thread queues (256 per priority), some end up in the overflow queues.
+bool TestTaskPriority(int count) {
+	ThreadManager manager;
+	manager.Init(1, 1);
+
+	LimitedWaitable gate;
+	std::mutex orderLock;
+	std::vector<TaskPriority> order;
+	WaitableCounter *counter = new WaitableCounter(count + 1);
+
+	manager.EnqueueTask(new RecordTask(TaskPriority::NORMAL, [&] {
+		gate.Wait();
+		counter->Count();
+	}));
+	for (int i = 0; i < count; ++i) {
+		TaskPriority priority = (i & 1) ? TaskPriority::HIGH : TaskPriority::LOW;
+		manager.EnqueueTask(new RecordTask(priority, [&, priority] {
+			std::lock_guard<std::mutex> guard(orderLock);
+			order.push_back(priority);
+			counter->Count();
+		}));
+	}
+	gate.Notify();
+	counter->WaitAndRelease();
+	manager.Teardown();
+
+	EXPECT_EQ_INT((int)order.size(), count);
+	for (int i = 0; i < count; ++i) {
+		EXPECT_TRUE(order[i] == (i < count / 2 ? TaskPriority::HIGH : TaskPriority::LOW));
+	}
+	return true;
+}
+
+// Tasks put on a specific thread must stay there, even when other threads are idle.
+bool TestTaskAffinity(ThreadManager *threadMan) {
+	const int numThreads = threadMan->GetNumLooperThreads();
+	std::vector<int> firstId(numThreads, -1);
+	std::atomic<int> mismatches{};
+	std::mutex idLock;
+	WaitableCounter *counter = new WaitableCounter(numThreads * 50);
+	for (int i = 0; i < numThreads * 50; ++i) {
+		int threadNum = i % numThreads;
+		threadMan->EnqueueTaskOnThread(threadNum, new RecordTask(TaskPriority::NORMAL, [&, threadNum] {
+			int id = GetCurrentThreadIdForDebug();
+			std::lock_guard<std::mutex> guard(idLock);
+			if (firstId[threadNum] == -1)
+				firstId[threadNum] = id;
+			else if (firstId[threadNum] != id)
+				mismatches++;
+			counter->Count();
+		}));
+	}
+	counter->WaitAndRelease();
+
+	EXPECT_EQ_INT(mismatches, 0);
+	for (int i = 1; i < numThreads; ++i) {
+		EXPECT_TRUE(firstId[i] != firstId[0]);
+	}
+	return true;
+}
+
+const int BURST_TASKS = 200000;
+const int PRODUCER_COUNT = 4;
+const int LOOP_BURSTS = 5000;
+
+// Many tiny tasks, from one and then several producers, and lots of small parallel loops.
+// The interesting thing is the logged throughput.
+bool TestTaskThroughput(ThreadManager *threadMan) {
+	g_atomicCounter = 0;
+	WaitableCounter *counter = new WaitableCounter(BURST_TASKS);
+	double start = time_now_d();
+	for (int i = 0; i < BURST_TASKS; ++i) {
+		threadMan->EnqueueTask(new CountTask((TaskPriority)(i % 3), counter));
+	}
+	counter->WaitAndRelease();
+	double singleTime = time_now_d() - start;
+	EXPECT_EQ_INT(g_atomicCounter, BURST_TASKS);
+
+	g_atomicCounter = 0;
+	counter = new WaitableCounter(BURST_TASKS);
+	start = time_now_d();
+	std::vector<std::thread> producers;
+	for (int p = 0; p < PRODUCER_COUNT; ++p) {
+		producers.push_back(std::thread([=] {
+			for (int i = 0; i < BURST_TASKS / PRODUCER_COUNT; ++i) {
+				threadMan->EnqueueTask(new CountTask(TaskPriority::NORMAL, counter));
+			}
+		}));
+	}
+	for (auto &producer : producers) {
+		producer.join();
+	}
+	counter->WaitAndRelease();
+	double contendedTime = time_now_d() - start;
+	EXPECT_EQ_INT(g_atomicCounter, BURST_TASKS);
+
+	std::atomic<int> sum{};
+	start = time_now_d();
+	for (int i = 0; i < LOOP_BURSTS; ++i) {
+		ParallelRangeLoop(threadMan, [&](int l, int h) {
+			sum += h - l;
+		}, 0, 64, 1);
+	}
+	double loopTime = time_now_d() - start;
+	EXPECT_EQ_INT(sum, LOOP_BURSTS * 64);
+
+	printf("Task throughput: one producer %0.2f Mtasks/s, %d producers %0.2f Mtasks/s, %d parallel loops %0.2f ms\n",
+		BURST_TASKS / singleTime / 1000000.0, PRODUCER_COUNT, BURST_TASKS / contendedTime / 1000000.0, LOOP_BURSTS, loopTime * 1000.0);
+	return true;
+}
+
 bool TestThreadManager() {
 	ThreadManager manager;
 	manager.Init(8, 1);
@@ -152,5 +291,10 @@ bool TestThreadManager() {
 		return false;
 	}
 
+	if (!TestTaskAffinity(&manager) || !TestTaskThroughput(&manager) || !TestTaskPriority(40) || !TestTaskPriority(1200)) {
+		return false;
+	}
+
+	manager.Teardown();
 	return true;
 }
@@ -0,0 +1,152 @@
+// Copyright (c) 2024- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Common/TimeUtil.h"
+#include "GPU/GPU.h"
+#include "GPU/GPUState.h"
+#include "GPU/Common/DrawEngineCommon.h"
+#include "GPU/Common/VertexDecoderCommon.h"
+#include "unittest/UnitTest.h"
+
+static const int NUM_VERTS = 3000;
+static const int BENCH_FRAMES = 200;
+
+struct TestVertex {
+	float u, v;
+	u32 color;
+	float x, y, z;
+};
+
+// Just enough of a draw engine to run the decode step of a flush.
+class VertexCacheTestEngine : public DrawEngineCommon {
+public:
+	void DeviceLost() override {}
+	void DeviceRestore(Draw::DrawContext *draw) override {}
+	void DispatchFlush() override {
+		Flush();
+	}
+
+	void Flush() {
+		if (!numDrawVerts_)
+			return;
+		DecodeVerts(decoded_);
+		decodedBytes_ = numDecodedVerts_ * dec_->GetDecVtxFmt().stride;
+		fullAlpha_ = gstate_c.vertexFullAlpha;
+		ResetAfterDrawInline();
+	}
+
+	// Submits the whole buffer as one draw, and returns the decoded data.
+	const u8 *Draw(const std::vector<TestVertex> &verts, u32 vertType, size_t *size) {
+		int bytesRead = 0;
+		SubmitPrim(verts.data(), nullptr, GE_PRIM_TRIANGLES, (int)verts.size(), vertType, true, &bytesRead);
+		Flush();
+		*size = decodedBytes_;
+		return decoded_;
+	}
+
+	bool LastDrawFullAlpha() const {
+		return fullAlpha_;
+	}
+
+	void SetUseCache(bool enabled) {
+		useVertexCache_ = enabled;
+		ClearTrackedVertexArrays();
+	}
+
+private:
+	size_t decodedBytes_ = 0;
+	bool fullAlpha_ = false;
+};
+
+static bool DecodesMatch(VertexCacheTestEngine &engine, const std::vector<TestVertex> &verts, u32 vertType) {
+	VertexDecoder dec;
+	VertexDecoderOptions options{};
+	dec.SetVertexType(vertType, options);
+	std::vector<u8> expected(verts.size() * dec.GetDecVtxFmt().stride);
+	dec.DecodeVerts(expected.data(), verts.data(), &gstate_c.uv, 0, (int)verts.size() - 1);
+
+	size_t size = 0;
+	const u8 *actual = engine.Draw(verts, vertType, &size);
+	EXPECT_EQ_INT((int)size, (int)expected.size());
+	EXPECT_TRUE(memcmp(actual, expected.data(), size) == 0);
+	return true;
+}
+
+bool TestVertexCache() {
+	const u32 vertType = GE_VTYPE_TC_FLOAT | GE_VTYPE_COL_8888 | GE_VTYPE_POS_FLOAT;
+	std::vector<TestVertex> verts(NUM_VERTS);
+	for (int i = 0; i < NUM_VERTS; ++i) {
+		verts[i] = TestVertex{ (float)(i & 255) / 256.0f, (float)(i >> 8) / 16.0f, 0xFF000000 | (u32)i * 0x1357, (float)i, (float)(i * 3 % 272), 0.5f };
+	}
+
+	gstate_c.uv = UVScale{ 1.0f, 1.0f, 0.0f, 0.0f };
+	gpuStats.Reset();
+	VertexCacheTestEngine engine;
+	engine.Init();
+	engine.SetUseCache(true);
+
+	// The first draw is a miss, then the same data in later frames hits.
+	EXPECT_TRUE(DecodesMatch(engine, verts, vertType));
+	EXPECT_EQ_INT(gpuStats.numVertexCacheMisses, 1);
+	for (int frame = 0; frame < 3; ++frame) {
+		gpuStats.numFlips++;
+		EXPECT_TRUE(DecodesMatch(engine, verts, vertType));
+	}
+	EXPECT_EQ_INT(gpuStats.numVertexCacheHits, 3);
+	EXPECT_TRUE(engine.LastDrawFullAlpha());
+
+	// A change must be picked up, including its effect on the alpha flag.
+	gpuStats.numFlips += 10;
+	verts[NUM_VERTS / 2].color = 0x7F123456;
+	EXPECT_TRUE(DecodesMatch(engine, verts, vertType));
+	EXPECT_EQ_INT(gpuStats.numVertexCacheMisses, 2);
+	EXPECT_FALSE(engine.LastDrawFullAlpha());
+	gpuStats.numFlips++;
+	EXPECT_TRUE(DecodesMatch(engine, verts, vertType));
+	EXPECT_EQ_INT(gpuStats.numVertexCacheHits, 4);
+	EXPECT_FALSE(engine.LastDrawFullAlpha());
+
+	// Data that changes every frame stops being cached.
+	for (int frame = 0; frame < 10; ++frame) {
+		gpuStats.numFlips++;
+		verts[frame].x += 1.0f;
+		EXPECT_TRUE(DecodesMatch(engine, verts, vertType));
+	}
+	EXPECT_EQ_INT(gpuStats.numVertexCacheMisses, 3);
+	EXPECT_EQ_INT(gpuStats.numVertexCacheHits, 4);
+
+	// Static geometry over many frames, with and without the cache.
+	std::vector<TestVertex> staticVerts = verts;
+	double times[2];
+	for (int cached = 0; cached < 2; ++cached) {
+		engine.SetUseCache(cached != 0);
+		size_t size;
+		double start = time_now_d();
+		for (int frame = 0; frame < BENCH_FRAMES; ++frame) {
+			gpuStats.numFlips++;
+			engine.Draw(staticVerts, vertType, &size);
+		}
+		times[cached] = time_now_d() - start;
+	}
+	printf("Vertex cache, %d verts x %d frames: cached %0.2f ms, decoded %0.2f ms\n", NUM_VERTS, BENCH_FRAMES, times[1] * 1000.0, times[0] * 1000.0);
+
+	gpuStats.Reset();
+	return true;
+}
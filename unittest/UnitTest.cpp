@@ -67,6 +67,7 @@
 #include "Common/Log.h"
 #include "Common/StringUtils.h"
 #include "Core/Config.h"
+#include "Core/Debugger/MemBlockInfo.h"
 #include "Common/File/VFS/VFS.h"
 #include "Common/File/VFS/DirectoryReader.h"
 #include "Core/FileSystems/ISOFileSystem.h"
@@ -691,6 +692,34 @@ static bool TestMemMap() {
 	return true;
 }
 
+static bool TestMemWriteTracking() {
+	bool oldTracking = g_memWriteTracking;
+	g_memWriteTracking = true;
+
+	uint32_t snapshot = MemWriteTrackingSnapshot();
+	EXPECT_FALSE(MemWriteTrackingChanged(0x08900000, 0x10000, snapshot));
+	// Uncached addresses count as the same memory.
+	MemWriteTrackingMark(0x48904000, 4);
+	EXPECT_TRUE(MemWriteTrackingChanged(0x08900000, 0x10000, snapshot));
+	EXPECT_FALSE(MemWriteTrackingChanged(0x08905000, 0x1000, snapshot));
+	EXPECT_TRUE(MemWriteTrackingChanged(0x08905000, 0x1000, 0));
+
+	snapshot = MemWriteTrackingSnapshot();
+	EXPECT_FALSE(MemWriteTrackingChanged(0x08900000, 0x10000, snapshot));
+	// VRAM mirrors too.
+	MemWriteTrackingMark(0x04600010, 16);
+	EXPECT_TRUE(MemWriteTrackingChanged(0x04000000, 0x100, snapshot));
+	// Scratchpad isn't tracked, so it could always have changed.
+	EXPECT_TRUE(MemWriteTrackingChanged(0x00010000, 0x100, snapshot));
+
+	snapshot = MemWriteTrackingSnapshot();
+	MemWriteTrackingMarkAll();
+	EXPECT_TRUE(MemWriteTrackingChanged(0x08900000, 0x10, snapshot));
+
+	g_memWriteTracking = oldTracking;
+	return true;
+}
+
 static bool TestPath() {
 	// Also test the Path class while we're at it.
 	Path path("/asdf/jkl/");
@@ -1011,6 +1040,17 @@ bool TestX64Emitter();
 bool TestRiscVEmitter();
 bool TestShaderGenerators();
 bool TestSoftwareGPUJit();
+bool TestIRBlockCache();
+bool TestCoreTiming();
+bool TestBlockDevices();
+bool TestTextureDecoder();
+bool TestISOFileSystem();
+bool TestVertexCache();
+bool TestAsyncIOManager();
+bool TestSasAudio();
+bool TestHTTPFileLoader();
+bool TestLogManager();
+bool TestPGF();
 bool TestIRPassSimplify();
 bool TestThreadManager();
 bool TestVFS();
@@ -1034,6 +1074,17 @@ TestItem availableTests[] = {
 	TEST_ITEM(VFPUSinCos),
 	TEST_ITEM(MathUtil),
 	TEST_ITEM(Parsers),
+	TEST_ITEM(IRBlockCache),
+	TEST_ITEM(CoreTiming),
+	TEST_ITEM(BlockDevices),
+	TEST_ITEM(TextureDecoder),
+	TEST_ITEM(ISOFileSystem),
+	TEST_ITEM(VertexCache),
+	TEST_ITEM(AsyncIOManager),
+	TEST_ITEM(SasAudio),
+	TEST_ITEM(HTTPFileLoader),
+	TEST_ITEM(LogManager),
+	TEST_ITEM(PGF),
 	TEST_ITEM(IRPassSimplify),
 	TEST_ITEM(Jit),
 	TEST_ITEM(MatrixTranspose),
@@ -1041,6 +1092,7 @@ TestItem availableTests[] = {
 	TEST_ITEM(QuickTexHash),
 	TEST_ITEM(CLZ),
 	TEST_ITEM(MemMap),
+	TEST_ITEM(MemWriteTracking),
 	TEST_ITEM(ShaderGenerators),
 	TEST_ITEM(SoftwareGPUJit),
 	TEST_ITEM(Path),